@@ -27,6 +27,7 @@
 #include "math/transform.hpp"
 
 #include "utility/openmp.hpp"
+#include "utility/duration.hpp"
 
 #include "vts-libs/vts/nodeinfo.hpp"
 #include "vts-libs/vts/csconvertor.hpp"
@@ -121,13 +122,45 @@ public:
         step.height /= steps.height;
     }
 
-    bool run(double invGsdScale, double tileFractionLimit) {
-        if (sample(invGsdScale, tileFractionLimit)) {
-            refine();
-            minLod();
-            return true;
-        }
-        return false;
+    /** Border block: grid cell only partially convertible to node's SRS.
+     */
+    struct BorderBlock {
+        math::Extents2 extents;
+        OptCorners corners;
+
+        BorderBlock(const math::Extents2 &extents, const OptCorners &corners)
+            : extents(extents), corners(corners)
+        {}
+
+        typedef std::vector<BorderBlock> list;
+    };
+
+    /** Samples dataset grid in this node. Returns false if node cannot be
+     *  used.
+     */
+    bool sample(double invGsdScale, double tileFractionLimit);
+
+    /** Returns list of all border blocks to be refined.
+     */
+    BorderBlock::list borderBlocks() const;
+
+    /** Refines given border block. Uses provided convertor (must convert
+     *  between the same SRS as ds2node) since CS convertors cannot be shared
+     *  between threads. Refined points are accumulated in given extents.
+     *
+     *  Can be run in parallel.
+     */
+    void refine(const vts::CsConvertor &conv, const BorderBlock &block
+                , math::Extents2 &extents) const;
+
+    /** Finishes computation, merges extents of refined border blocks.
+     */
+    void finish(const math::Extents2 &borderExtents);
+
+    /** Creates new convertor for this node.
+     */
+    vts::CsConvertor convertor() const {
+        return vts::CsConvertor(ds.srs, node.srs());
     }
 
     vts::Ranges ranges() const {
@@ -145,34 +178,43 @@ public:
     const std::string& srs() const { return node.srs(); }
 
 private:
-    bool convert(math::Point2 &c, double x, double y) {
+    bool convert(const vts::CsConvertor &conv, math::Extents2 &le
+                 , math::Point2 &c, double x, double y) const
+    {
         try {
             // try to convert corner
-            c = ds2node(math::Point2d(x, y));
+            c = conv(math::Point2d(x, y));
             // check if it is inside the node
             if (!node.inside(c)) { return true; }
 
             // update local extents
-            math::update(localExtents, c);
+            math::update(le, c);
         } catch (...) {
             return true;
         }
         return false;
     }
 
-    boost::optional<math::Point2> convert(double x, double y) {
+    bool convert(math::Point2 &c, double x, double y) {
+        return convert(ds2node, localExtents, c, x, y);
+    }
+
+    boost::optional<math::Point2> convert(const vts::CsConvertor &conv
+                                          , math::Extents2 &le
+                                          , double x, double y) const
+    {
         math::Point2 c;
-        if (convert(c, x, y)) { return boost::none; }
+        if (convert(conv, le, c, x, y)) { return boost::none; }
         return c;
     }
 
-    bool sample(double invGsdScale, double tileFractionLimit);
-    void refine();
     void minLod();
 
-    void divideBorderBlock(math::Size2f blockPxSize
+    void divideBorderBlock(const vts::CsConvertor &conv
+                           , math::Extents2 &le
+                           , math::Size2f blockPxSize
                            , const math::Extents2 &extents
-                           , const OptCorners &corners);
+                           , const OptCorners &corners) const;
 
     vts::TileRange globalRange() const;
 
@@ -320,9 +362,11 @@ bool Node::sample(double invGsdScale, double tileFractionLimit)
     return true;
 }
 
-void Node::divideBorderBlock(math::Size2f blockPxSize
+void Node::divideBorderBlock(const vts::CsConvertor &conv
+                             , math::Extents2 &le
+                             , math::Size2f blockPxSize
                              , const math::Extents2 &extents
-                             , const OptCorners &corners)
+                             , const OptCorners &corners) const
 {
     if ((blockPxSize.width < sourceBlockLimit.width)
         && (blockPxSize.height < sourceBlockLimit.height))
@@ -338,18 +382,18 @@ void Node::divideBorderBlock(math::Size2f blockPxSize
     const auto ec(math::center(extents));
 
     // try to transform 5 points on the cross in the center of block
-    auto center(convert(ec(0), ec(1)));
-    auto left(convert(extents.ll(0), ec(1)));
-    auto right(convert(extents.ur(0), ec(1)));
-    auto lower(convert(ec(0), extents.ll(1)));
-    auto upper(convert(ec(0), extents.ur(1)));
+    auto center(convert(conv, le, ec(0), ec(1)));
+    auto left(convert(conv, le, extents.ll(0), ec(1)));
+    auto right(convert(conv, le, extents.ur(0), ec(1)));
+    auto lower(convert(conv, le, ec(0), extents.ll(1)));
+    auto upper(convert(conv, le, ec(0), extents.ur(1)));
 
     // construct 4 sub-blocks and try again
     {
         // ll
         OptCorners c{{corners[0], left, center, lower}};
         if (partial(c)) {
-            divideBorderBlock(blockPxSize
+            divideBorderBlock(conv, le, blockPxSize
                               , math::Extents2(extents.ll, ec), c);
         }
     }
@@ -358,7 +402,7 @@ void Node::divideBorderBlock(math::Size2f blockPxSize
         // ul
         OptCorners c{{left, corners[1], upper, center}};
         if (partial(c)) {
-            divideBorderBlock(blockPxSize
+            divideBorderBlock(conv, le, blockPxSize
                               , math::Extents2(extents.ll(0), ec(1)
                                                , ec(0), extents.ur(1))
                               , c);
@@ -369,7 +413,7 @@ void Node::divideBorderBlock(math::Size2f blockPxSize
         // ur
         OptCorners c{{center, upper, corners[2], right}};
         if (partial(c)) {
-            divideBorderBlock(blockPxSize
+            divideBorderBlock(conv, le, blockPxSize
                               , math::Extents2(ec, extents.ur), c);
         }
     }
@@ -378,7 +422,7 @@ void Node::divideBorderBlock(math::Size2f blockPxSize
         // lr
         OptCorners c{{lower, center, right, corners[3]}};
         if (partial(c)) {
-            divideBorderBlock(blockPxSize
+            divideBorderBlock(conv, le, blockPxSize
                               , math::Extents2(ec(0), extents.ll(1)
                                                , extents.ur(0), ec(1))
                               , c);
@@ -386,8 +430,10 @@ void Node::divideBorderBlock(math::Size2f blockPxSize
     }
 }
 
-void Node::refine()
+Node::BorderBlock::list Node::borderBlocks() const
 {
+    BorderBlock::list blocks;
+
     double y(extents.ll(1));
     for (int j = 1; j < grid.rows; ++j, y += step.height) {
         double x(extents.ll(0));
@@ -411,7 +457,7 @@ void Node::refine()
                 if (cx) { corners[2] = projectedGrid(j, i); }
                 if (px) { corners[3] = projectedGrid(j - 1, i); }
 
-                divideBorderBlock(stepInPixels, be, corners);
+                blocks.emplace_back(be, corners);
             }
 
             ppx = px;
@@ -419,6 +465,25 @@ void Node::refine()
         }
     }
 
+    return blocks;
+}
+
+void Node::refine(const vts::CsConvertor &conv, const BorderBlock &block
+                  , math::Extents2 &extents) const
+{
+    divideBorderBlock(conv, extents, stepInPixels, block.extents
+                      , block.corners);
+}
+
+void Node::finish(const math::Extents2 &borderExtents)
+{
+    // NB: extents union is order independent -> same result as serial
+    // processing
+    if (math::valid(borderExtents)) {
+        math::update(localExtents, borderExtents.ll);
+        math::update(localExtents, borderExtents.ur);
+    }
+
     const auto ts(vts::tileSize(node.extents(), localLod));
     const auto origin(math::ul(node.extents()));
 
@@ -434,6 +499,8 @@ void Node::refine()
     math::update(tileRange_, point2tile(ul(localExtents)));
     math::update(tileRange_, point2tile(ur(localExtents)));
     math::update(tileRange_, point2tile(lr(localExtents)));
+
+    minLod();
 }
 
 void Node::minLod()
@@ -577,25 +644,94 @@ Measurement measure(const vtslibs::registry::ReferenceFrame &referenceFrame
     // division of source dataset
     math::Size2 steps(255, 255);
 
-    Node::list nodes;
+    utility::DurationMeter timer;
 
     const auto rfNodes(vts::NodeInfo::nodes(referenceFrame));
+    const int rfNodeCount(rfNodes.size());
+
+    // sample all nodes in parallel; results are kept in reference frame node
+    // order to get stable output regardless on thread scheduling
+    Node::list sampled(rfNodes.size());
 
-    UTILITY_OMP(parallel for)
-    for (std::size_t nodeIndex = 0; nodeIndex < rfNodes.size(); ++nodeIndex) {
+    UTILITY_OMP(parallel for schedule(dynamic))
+    for (int nodeIndex = 0; nodeIndex < rfNodeCount; ++nodeIndex) {
         auto node(std::make_shared<Node>(dataset, rfNodes[nodeIndex], steps));
 
-        if (node->run(invGsdScale, config.tileFractionLimit)) {
-            UTILITY_OMP(critical(calipers))
-                nodes.push_back(node);
+        if (node->sample(invGsdScale, config.tileFractionLimit)) {
+            sampled[nodeIndex] = node;
         }
     }
 
+    Node::list nodes;
+    for (const auto &node : sampled) {
+        if (node) { nodes.push_back(node); }
+    }
+
     if (nodes.empty()) {
         // not feasible
         return {};
     }
 
+    // collect border blocks from all nodes into one flat job list to keep all
+    // threads busy even when there is only a single reference frame node
+    struct Job {
+        std::size_t node;
+        const Node::BorderBlock *block;
+        Job(std::size_t node, const Node::BorderBlock *block)
+            : node(node), block(block)
+        {}
+    };
+
+    std::vector<Node::BorderBlock::list> blocks;
+    std::vector<Job> jobs;
+    blocks.reserve(nodes.size());
+    for (std::size_t n(0), e(nodes.size()); n != e; ++n) {
+        blocks.push_back(nodes[n]->borderBlocks());
+        for (const auto &block : blocks.back()) { jobs.emplace_back(n, &block); }
+    }
+
+    // per job refined extents
+    std::vector<math::Extents2> refined
+        (jobs.size(), math::Extents2(math::InvalidExtents{}));
+    const int jobCount(jobs.size());
+
+    UTILITY_OMP(parallel)
+    {
+        // convertors cannot be shared between threads -> one set per thread
+        std::vector<boost::optional<vts::CsConvertor>> convertors
+            (nodes.size());
+
+        UTILITY_OMP(for schedule(dynamic))
+        for (int j = 0; j < jobCount; ++j) {
+            const auto &job(jobs[j]);
+            const auto &node(*nodes[job.node]);
+            auto &conv(convertors[job.node]);
+            if (!conv) { conv = node.convertor(); }
+            node.refine(*conv, *job.block, refined[j]);
+        }
+    }
+
+    {
+        // merge refined extents back to nodes
+        std::vector<math::Extents2> borderExtents
+            (nodes.size(), math::Extents2(math::InvalidExtents{}));
+        for (std::size_t j(0), e(jobs.size()); j != e; ++j) {
+            const auto &r(refined[j]);
+            if (!math::valid(r)) { continue; }
+            auto &be(borderExtents[jobs[j].node]);
+            math::update(be, r.ll);
+            math::update(be, r.ur);
+        }
+
+        for (std::size_t n(0), e(nodes.size()); n != e; ++n) {
+            nodes[n]->finish(borderExtents[n]);
+        }
+    }
+
+    LOG(info2)
+        << "Refined " << jobs.size() << " border blocks in "
+        << nodes.size() << " node(s).";
+
     auto &lodRange(m.lodRange);
     auto &tileRange(m.tileRange);
 
@@ -672,6 +808,10 @@ Measurement measure(const vtslibs::registry::ReferenceFrame &referenceFrame
         position.verticalExtent *= 1.3;
     }
 
+    LOG(info3)
+        << "Dataset measured in "
+        << utility::formatDuration(timer.duration()) << ".";
+
     return m;
 }
 
@@ -28,8 +28,19 @@
 #include <utility>
 #include <functional>
 #include <map>
+#include <set>
 #include <numeric>
 #include <algorithm>
+#include <vector>
+#include <queue>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <exception>
+#include <chrono>
+#include <iomanip>
 
 #include <boost/optional.hpp>
 #include <boost/utility/in_place_factory.hpp>
@@ -46,7 +57,6 @@
 
 #include "utility/streams.hpp"
 #include "utility/buildsys.hpp"
-#include "utility/openmp.hpp"
 #include "utility/raise.hpp"
 #include "utility/duration.hpp"
 #include "utility/time.hpp"
@@ -305,10 +315,16 @@ public:
                          , const OptionalRect &srcRect = boost::none
                          , const OptionalRect &dstRect = boost::none);
 
+    /** NB: band is zero-based!
+     */
+    void addSource(int band, const BandDescriptor &bd);
 
-    void addBackground(const fs::path &path, const Color::optional &color
-                       , const boost::optional<fs::path> &localTo
-                       = boost::none);
+    /** Adds background and returns its sources (one per band).
+     */
+    BandDescriptor::list
+    addBackground(const fs::path &path, const Color::optional &color
+                  , const boost::optional<fs::path> &localTo
+                  = boost::none);
 
     const geo::GeoDataset& dataset() const { return ds_; }
 
@@ -376,8 +392,11 @@ void VrtDs::addSimpleSource(int band, const fs::path &filename
                             , const OptionalRect &srcRect
                             , const OptionalRect &dstRect)
 {
-    BandDescriptor bd(filename, ds, srcBand, srcRect, dstRect);
+    addSource(band, BandDescriptor(filename, ds, srcBand, srcRect, dstRect));
+}
 
+void VrtDs::addSource(int band, const BandDescriptor &bd)
+{
     // set source
     {
         std::ostringstream os;
@@ -417,11 +436,12 @@ void VrtDs::addSimpleSource(int band, const fs::path &filename
     maskBand_->AddSource(src.release());
 }
 
-void VrtDs::addBackground(const fs::path &path
-                          , const Color::optional &color
-                          , const boost::optional<fs::path> &localTo)
+BandDescriptor::list
+VrtDs::addBackground(const fs::path &path
+                     , const Color::optional &color
+                     , const boost::optional<fs::path> &localTo)
 {
-    if (!color) { return; }
+    if (!color) { return {}; }
 
     auto background(*color);
     background.resize(bandCount_);
@@ -448,9 +468,12 @@ void VrtDs::addBackground(const fs::path &path
             (gdal_drivers::SolidDataset::create(bgPath, cfg)));
 
     // map layers
+    BandDescriptor::list sources;
     for (std::size_t i(0); i != bandCount_; ++i) {
-        addSimpleSource(i, storePath, bg, i);
+        sources.emplace_back(storePath, bg, i, boost::none, boost::none);
+        addSource(i, sources.back());
     }
+    return sources;
 }
 
 void addOverview(const fs::path &vrtPath, const fs::path &ovrPath)
@@ -789,6 +812,10 @@ void copyWithMask(const geo::GeoDataset &src, geo::GeoDataset &dst)
     }
 }
 
+/** Serializes GTiff dataset creation.
+ */
+std::mutex createOutputDatasetMutex;
+
 void createOutputDataset(const geo::GeoDataset &original
                          , const geo::GeoDataset &src
                          , const fs::path &path
@@ -797,8 +824,8 @@ void createOutputDataset(const geo::GeoDataset &original
 {
     if (maskType != MaskType::band) {
         // we can copy as is
-        UTILITY_OMP(critical(createOutputDataset))
-            src.copy(path, "GTiff", createOptions);
+        std::unique_lock<std::mutex> lock(createOutputDatasetMutex);
+        src.copy(path, "GTiff", createOptions);
         return;
     }
 
@@ -810,199 +837,885 @@ void createOutputDataset(const geo::GeoDataset &original
 
     auto dst(geo::GeoDataset::placeholder());
 
-    UTILITY_OMP(critical(createOutputDataset))
+    {
+        std::unique_lock<std::mutex> lock(createOutputDatasetMutex);
         dst = geo::GeoDataset::create(path, src.srs(), src.extents()
                                       , src.size(), format, boost::none
                                       , createOptions);
+    }
 
     copyWithMask(src, dst);
     dst.flush();
 }
 
-fs::path createOverview(const Config &config
-                        , const boost::filesystem::path &output
-                        , int ovrIndex
-                        , const fs::path &srcPath
-                        , const fs::path &dir
-                        , const math::Size2 &size
-                        , const math::Size2 &tiled
-                        , std::atomic<int> &progress, int total
-                        , MaskType maskType)
-{
-    auto ovrName(dir / "ovr.vrt");
-    auto ovrPath(output / ovrName);
-    const auto &ts(config.tileSize);
-
-    LOG(info3)
-        << "Creating overview #" << ovrIndex
-        << " of " << math::area(tiled) << " tiles in "
-        << ovrPath << " from " << srcPath << ".";
+/** Dataset parameters shared by all overview levels.
+ */
+struct DatasetParams {
+    geo::SrsDefinition srs;
+    math::Extents2 extents;
+    math::Size2 size;
+    geo::GeoDataset::Format format;
+    geo::GeoDataset::NodataValue nodata;
+    ::GDALDataType dataType;
+};
 
+/** Returns create options with PREDICTOR value checked/set based on dataset
+ *  data type.
+ */
+geo::Options createOptions(const Config &config, const DatasetParams &params)
+{
     // copy options so that the PREDICTOR can be possibly modified
     geo::Options createOptions(config.createOptions);
 
-    VrtDs ovr([&]() -> VrtDs
-    {
-        auto src(geo::GeoDataset::open(srcPath));
+    // If create options contain PREDICTOR, check/set its value based on
+    // original dataset type.
+    auto &opts(createOptions.options);
+    auto it(std::find_if( opts.begin(), opts.end()
+                         , [](const geo::Options::Option &op)
+                           {
+                                return op.first == "PREDICTOR";
+                           }));
 
-        // If create options contain PREDICTOR, check/set its value based on
-        // original dataset type.
-        auto &opts(createOptions.options);
-        auto it(std::find_if( opts.begin(), opts.end()
-                             , [](const geo::Options::Option &op)
-                               {
-                                    return op.first == "PREDICTOR";
-                               }));
+    if (it == opts.end()) { return createOptions; }
 
-        if (it != opts.end()) {
-            // find out what the value of predictor should be
-            auto predictor([&]() -> std::string {
-                switch (src.descriptor().dataType) {
-                case ::GDT_Float32:
-                case ::GDT_Float64:
-                    return "3";
-                default:
-                    break;
-                }
-                return "2";
-            }());
-
-            // set predictor to optimal
-            if (it->second.empty()) {
-                it->second = predictor;
-
-            // leave it if predictor is turned off
-            } else if (it->second == "1") {
-
-            // if predictor is set, check if the value is right
-            } else if (it->second != predictor) {
-                LOGTHROW(err2, std::runtime_error)
-                    << "PREDICTOR value and bandtype mismatch. Use 2 for "
-                    << "integer and 3 for floating point or leave without "
-                    << "value to be determined automatically.";
+    // find out what the value of predictor should be
+    auto predictor([&]() -> std::string {
+        switch (params.dataType) {
+        case ::GDT_Float32:
+        case ::GDT_Float64:
+            return "3";
+        default:
+            break;
+        }
+        return "2";
+    }());
+
+    // set predictor to optimal
+    if (it->second.empty()) {
+        it->second = predictor;
+
+    // leave it if predictor is turned off
+    } else if (it->second == "1") {
+
+    // if predictor is set, check if the value is right
+    } else if (it->second != predictor) {
+        LOGTHROW(err2, std::runtime_error)
+            << "PREDICTOR value and bandtype mismatch. Use 2 for "
+            << "integer and 3 for floating point or leave without "
+            << "value to be determined automatically.";
+    }
+
+    return createOptions;
+}
+
+/** Single overview tile.
+ */
+struct Tile {
+    math::Point2i id;
+
+    /** Number of unfinished tiles this tile waits for.
+     */
+    std::size_t waiting;
+
+    /** Indices of tiles in the previous level this tile is warped from.
+     */
+    std::vector<std::size_t> deps;
+
+    /** Indices of tiles in the next level warped from this tile.
+     */
+    std::vector<std::size_t> dependents;
+
+    /** Sources of generated tile (one per band), empty if tile is empty.
+     */
+    BandDescriptor::list sources;
+
+    /** Tile is done (i.e. generated or left intact by update).
+     */
+    bool done;
+
+    Tile(const math::Point2i &id) : id(id), waiting(), done(false) {}
+
+    fs::path name() const {
+        return str(boost::format("%d-%d.tif") % id(0) % id(1));
+    }
+
+    typedef std::vector<Tile> list;
+};
+
+/** Single overview level.
+ */
+struct Level {
+    int index;
+    fs::path dir;
+    fs::path ovrName;
+    math::Size2 size;
+    math::Size2 tiled;
+
+    /** Tile size in real extents.
+     */
+    math::Size2f tileSize;
+
+    /** Size of last tile in row/column.
+     */
+    math::Size2 lts;
+
+    std::unique_ptr<VrtDs> ovr;
+    BandDescriptor::list background;
+
+    Tile::list tiles;
+
+    /** Number of unfinished tiles.
+     */
+    std::size_t pending;
+
+    bool finalized;
+
+    Level(int index, const math::Size2 &size, const math::Size2 &tiled)
+        : index(index), dir(str(boost::format("%d") % index))
+        , ovrName(dir / "ovr.vrt"), size(size), tiled(tiled)
+        , pending(), finalized(false)
+    {}
+
+    typedef std::vector<Level> list;
+};
+
+/** Radius of resampling filter in destination pixels. GDAL stretches the
+ *  filter by downsampling ratio, i.e. radius in source pixels is this value
+ *  times scale.
+ */
+double filterRadius(geo::GeoDataset::Resampling resampling)
+{
+    typedef geo::GeoDataset::Resampling Resampling;
+    switch (resampling) {
+    case Resampling::nearest:
+    case Resampling::average:
+    case Resampling::minimum:
+    case Resampling::maximum:
+        // pixel footprint
+        return 0.5;
+
+    case Resampling::bilinear: return 1.0;
+
+    case Resampling::cubic:
+    case Resampling::cubicspline:
+        return 2.0;
+
+    default:
+        // lanczos (widest GDAL filter) or anything mapped to it
+        return 3.0;
+    }
+}
+
+/** Computes pixel window [first, second) in source raster of given size
+ *  (prevSize) needed to warp pixels [start, end) of raster of given size;
+ *  margin covers resampling filter support plus rounding of source
+ *  coordinates.
+ */
+std::pair<int, int> sourceWindow(int start, int end, int size, int prevSize
+                                 , geo::GeoDataset::Resampling resampling)
+{
+    const double scale(double(prevSize) / size);
+    const int margin
+        (int(std::ceil(filterRadius(resampling) * std::max(scale, 1.0))) + 2);
+    return { std::max(0, int(std::floor(start * scale)) - margin)
+            , std::min(prevSize, int(std::ceil(end * scale)) + margin) };
+}
+
+/** Generates all overviews at once.
+ *
+ *  Every overview tile is a node in a dependency graph: tile at level i+1
+ *  is scheduled as soon as all tiles at level i it is warped from are
+ *  written. Such tile is warped from a temporary VRT containing only these
+ *  tiles (and background); source window of the warp lies inside these
+ *  tiles thus the result is identical to warping from the complete level.
+ *
+ *  In non-cascade mode, level i+1 is started after level i is complete.
+ *
+ *  In update mode only tiles affected by changed areas of the input dataset
+ *  are generated, the rest is taken from existing overviews.
+ */
+class OverviewGenerator {
+public:
+    /** Full generation if changed is null.
+     */
+    OverviewGenerator(const Config &config
+                      , const boost::filesystem::path &output
+                      , const Setup &setup
+                      , const std::vector<math::Extents2> *changed
+                      = nullptr);
+
+    /** Generates all overviews. Returns list of overview VRT paths (relative
+     *  to output directory).
+     */
+    std::vector<fs::path> run();
+
+    /** List of tiles (to be) generated.
+     */
+    UpdatedTile::list affected() const;
+
+private:
+    struct Item {
+        std::size_t level;
+        std::size_t tile;
+
+        /** Prefer deeper levels to keep pipeline short.
+         */
+        bool operator<(const Item &o) const {
+            if (level != o.level) { return level < o.level; }
+            return tile > o.tile;
+        }
+    };
+
+    typedef std::unique_lock<std::mutex> Lock;
+
+    void worker();
+
+    /** Generates tile, returns its sources.
+     */
+    BandDescriptor::list process(const Level &level, const Tile &tile
+                                 , const fs::path &srcPath);
+
+    /** Creates VRT containing only given tiles of given level.
+     */
+    fs::path dependencyDataset(const Level &level, const Tile &tile
+                               , const std::vector<const BandDescriptor::list*>
+                               &sources);
+
+    void dependencies(Level &prev, Level &level);
+
+    /** Marks tiles not affected by changed areas as done.
+     */
+    void markUnaffected(const std::vector<math::Extents2> &changed);
+
+    /** Loads sources of done tiles from existing overview.
+     */
+    void loadExisting(Level &level);
+
+    void done(Level &level, Tile &tile, BandDescriptor::list &&sources);
+
+    void ready(std::size_t level, std::size_t tile) {
+        queue_.push({ level, tile });
+        cond_.notify_one();
+    }
+
+    math::Size2 tileSize(const Level &level, const Tile &tile) const;
+
+    math::Extents2 tileExtents(const Level &level, const Tile &tile) const;
+
+    const Config &config_;
+    const fs::path output_;
+    const Setup &setup_;
+    const DatasetParams params_;
+    const geo::Options createOptions_;
+    const math::Size2 &ts_;
+    const bool update_;
+
+    Level::list levels_;
+    int total_;
+    std::atomic<int> progress_;
+
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::priority_queue<Item> queue_;
+    std::size_t remaining_;
+    std::exception_ptr error_;
+
+    /** Accumulated time spent in tile processing.
+     */
+    std::chrono::steady_clock::duration busy_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+DatasetParams datasetParams(const fs::path &path)
+{
+    auto ds(geo::GeoDataset::open(path));
+    return { ds.srs(), ds.extents(), ds.size(), ds.getFormat()
+            , ds.rawNodataValue(), ds.descriptor().dataType };
+}
+
+OverviewGenerator::OverviewGenerator(const Config &config
+                                     , const boost::filesystem::path &output
+                                     , const Setup &setup
+                                     , const std::vector<math::Extents2>
+                                     *changed)
+    : config_(config), output_(output), setup_(setup)
+    , params_(datasetParams(setup.outputDataset))
+    , createOptions_(createOptions(config, params_))
+    , ts_(config.tileSize), update_(changed), total_(), progress_(0)
+    , remaining_(), busy_()
+{
+    // NB: all levels share dataset parameters, every level would get them
+    // from the previous one anyway
+    const auto es(math::size(params_.extents));
+
+    for (std::size_t i(0); i != setup.ovrSizes.size(); ++i) {
+        levels_.emplace_back(i, setup.ovrSizes[i], setup.ovrTiled[i]);
+        auto &level(levels_.back());
+        const auto &size(level.size);
+        const auto &tiled(level.tiled);
+
+        // compute tile size in real extents
+        level.tileSize = math::Size2f
+            ((es.width * ts_.width) / size.width
+             , (es.height * ts_.height) / size.height);
+
+        // last tile size
+        level.lts = math::Size2(size.width - (tiled.width - 1) * ts_.width
+                                , size.height
+                                - (tiled.height - 1) * ts_.height);
+
+        for (int j(0), ej(math::area(tiled)); j != ej; ++j) {
+            level.tiles.emplace_back
+                (math::Point2i(j % tiled.width, j / tiled.width));
+        }
+
+        if (i) { dependencies(levels_[i - 1], level); }
+    }
+
+    if (changed) { markUnaffected(*changed); }
+
+    for (std::size_t i(0); i != levels_.size(); ++i) {
+        auto &level(levels_[i]);
+
+        for (auto &tile : level.tiles) {
+            if (tile.done) { continue; }
+            ++level.pending;
+
+            if (!i) { continue; }
+            if (!config_.cascade) {
+                // wait for whole previous level
+                tile.waiting = 1;
+                continue;
+            }
+
+            const auto &prev(levels_[i - 1]);
+            for (auto dep : tile.deps) {
+                if (!prev.tiles[dep].done) { ++tile.waiting; }
             }
         }
 
-        return VrtDs(ovrPath, src.srs(), src.extents()
-                     , size, src.getFormat(), src.rawNodataValue()
-                     , maskType);
-    }());
+        total_ += level.pending;
+
+        if (!level.pending) {
+            // nothing to do, existing overview is kept intact
+            level.finalized = true;
+            continue;
+        }
+
+        fs::create_directories(output_ / level.dir);
+
+        // NB: existing sources must be loaded before VRT is re-created
+        if (update_) { loadExisting(level); }
+
+        level.ovr.reset(new VrtDs(output_ / level.ovrName, params_.srs
+                                  , params_.extents, level.size
+                                  , params_.format, params_.nodata
+                                  , setup.maskType));
+        level.background = level.ovr->addBackground
+            (output_ / level.dir, config_.background, fs::path());
+
+        for (const auto &tile : level.tiles) {
+            for (std::size_t b(0), eb(tile.sources.size()); b != eb; ++b) {
+                level.ovr->addSource(b, tile.sources[b]);
+            }
+        }
+    }
+
+    remaining_ = total_;
+}
 
-    (void) maskType;
+void OverviewGenerator::dependencies(Level &prev, Level &level)
+{
+    for (std::size_t i(0), ei(level.tiles.size()); i != ei; ++i) {
+        auto &tile(level.tiles[i]);
+        const auto &id(tile.id);
+
+        const auto xStart(id(0) * ts_.width);
+        const auto yStart(id(1) * ts_.height);
+        const auto pxSize(tileSize(level, tile));
+
+        const auto xw(sourceWindow(xStart, xStart + pxSize.width
+                                   , level.size.width, prev.size.width
+                                   , config_.resampling));
+        const auto yw(sourceWindow(yStart, yStart + pxSize.height
+                                   , level.size.height, prev.size.height
+                                   , config_.resampling));
+
+        for (int y(yw.first / ts_.height)
+                 , ey((yw.second - 1) / ts_.height); y <= ey; ++y)
+        {
+            for (int x(xw.first / ts_.width)
+                     , ex((xw.second - 1) / ts_.width); x <= ex; ++x)
+            {
+                const std::size_t dep(y * prev.tiled.width + x);
+                tile.deps.push_back(dep);
+                prev.tiles[dep].dependents.push_back(i);
+            }
+        }
+    }
+}
 
-    auto extents(ovr.dataset().extents());
-    ovr.addBackground(output / dir, config.background, fs::path());
+void OverviewGenerator::markUnaffected
+(const std::vector<math::Extents2> &changed)
+{
+    const auto &extents(params_.extents);
+    const auto &size(params_.size);
+    const auto es(math::size(extents));
+    const math::Size2f px(es.width / size.width, es.height / size.height);
+
+    // changed areas in base dataset pixels, [ll, ur)
+    std::vector<math::Extents2i> windows;
+    auto add([&](const math::Extents2 &e) {
+        math::Extents2i w
+            (std::max(0, int(std::floor((e.ll(0) - extents.ll(0)) / px.width)))
+             , std::max(0, int(std::floor((extents.ur(1) - e.ur(1))
+                                          / px.height)))
+             , std::min(size.width
+                        , int(std::ceil((e.ur(0) - extents.ll(0))
+                                        / px.width)))
+             , std::min(size.height
+                        , int(std::ceil((extents.ur(1) - e.ll(1))
+                                        / px.height))));
+        if ((w.ll(0) < w.ur(0)) && (w.ll(1) < w.ur(1))) {
+            windows.push_back(w);
+        }
+    });
 
+    for (const auto &e : changed) {
+        add(e);
+
+        if (config_.wrapx) {
+            // wrapped dataset: change is replicated on the other side; wrap
+            // strips are taken from input shifted by wrapx overlap (see
+            // buildDatasetBase), i.e. the copy is (W - wrapx) pixels away
+            const auto offset
+                ((size.width - 2 * setup_.xPlus - *config_.wrapx)
+                 * px.width);
+            add(math::Extents2(e.ll(0) - offset, e.ll(1)
+                               , e.ur(0) - offset, e.ur(1)));
+            add(math::Extents2(e.ll(0) + offset, e.ll(1)
+                               , e.ur(0) + offset, e.ur(1)));
+        }
+    }
 
-    // compute tile size in real extents
-    auto tileSize([&]() -> math::Size2f
+    if (levels_.empty()) { return; }
+
+    // bottom level: check source window against changed areas
+    auto &bottom(levels_.front());
+    for (auto &tile : bottom.tiles) {
+        const auto &id(tile.id);
+        const auto xStart(id(0) * ts_.width);
+        const auto yStart(id(1) * ts_.height);
+        const auto pxSize(tileSize(bottom, tile));
+
+        const auto xw(sourceWindow(xStart, xStart + pxSize.width
+                                   , bottom.size.width, size.width
+                                   , config_.resampling));
+        const auto yw(sourceWindow(yStart, yStart + pxSize.height
+                                   , bottom.size.height, size.height
+                                   , config_.resampling));
+
+        tile.done = std::none_of
+            (windows.begin(), windows.end()
+             , [&](const math::Extents2i &w)
+             {
+                 return ((xw.first < w.ur(0)) && (w.ll(0) < xw.second)
+                         && (yw.first < w.ur(1)) && (w.ll(1) < yw.second));
+             });
+    }
+
+    // upper levels: affected if any dependency is affected
+    for (std::size_t i(1); i < levels_.size(); ++i) {
+        const auto &prev(levels_[i - 1]);
+        for (auto &tile : levels_[i].tiles) {
+            tile.done = std::all_of(tile.deps.begin(), tile.deps.end()
+                                    , [&](std::size_t dep)
+                                    {
+                                        return prev.tiles[dep].done;
+                                    });
+        }
+    }
+}
+
+void OverviewGenerator::loadExisting(Level &level)
+{
+    const auto path(output_ / level.ovrName);
+    if (!fs::exists(path)) {
+        LOGTHROW(err2, std::runtime_error)
+            << "Cannot update overview #" << level.index << ": " << path
+            << " does not exist.";
+    }
+
+    // collect files referenced by first band of existing overview
+    std::set<std::string> referenced;
     {
-        auto es(math::size(extents));
-        return math::Size2f((es.width * ts.width) / size.width
-                            , (es.height * ts.height) / size.height);
-    }());
+        auto root(xmlNode(path));
+        for (NodeIterator ni(root.get(), "VRTRasterBand"); ni; ++ni) {
+            const auto band(::CPLGetXMLValue(*ni, "band", ""));
+            if (std::strcmp(band, "1")) { continue; }
+
+            for (NodeIterator si(*ni, "SimpleSource"); si; ++si) {
+                referenced.insert
+                    (::CPLGetXMLValue(*si, "SourceFilename", ""));
+            }
+        }
+    }
+
+    for (auto &tile : level.tiles) {
+        if (!tile.done) { continue; }
+
+        const auto name(tile.name());
+        if (!referenced.count(name.string())) { continue; }
+
+        auto ds(geo::GeoDataset::open(output_ / level.dir / name));
+        Rect drect(math::Point2i(tile.id(0) * ts_.width
+                                 , tile.id(1) * ts_.height)
+                   , tileSize(level, tile));
+        for (std::size_t b(0), eb(ds.bandCount()); b != eb; ++b) {
+            tile.sources.emplace_back(name, ds, b, boost::none, drect);
+        }
+    }
+}
+
+math::Size2 OverviewGenerator::tileSize(const Level &level
+                                        , const Tile &tile) const
+{
+    return math::Size2((tile.id(0) == (level.tiled.width - 1))
+                       ? level.lts.width : ts_.width
+                       , (tile.id(1) == (level.tiled.height - 1))
+                       ? level.lts.height : ts_.height);
+}
+
+math::Extents2 OverviewGenerator::tileExtents(const Level &level
+                                              , const Tile &tile) const
+{
+    const auto &extents(params_.extents);
+    const auto &tileSize(level.tileSize);
+    const auto &id(tile.id);
+
+    bool lastX(id(0) == (level.tiled.width - 1));
+    bool lastY(id(1) == (level.tiled.height - 1));
+
     // extent's upper-left corner is origin for tile calculations
     math::Point2 origin(ul(extents));
 
-    auto tc(math::area(tiled));
+    math::Point2 ul(origin(0) + tileSize.width * id(0)
+                    , origin(1) - tileSize.height * id(1));
+    math::Point2 lr(lastX ? extents.ur(0) : ul(0) + tileSize.width
+                    , lastY ? extents.ll(1): ul(1) - tileSize.height);
+
+    return math::Extents2(ul(0), lr(1), lr(0), ul(1));
+}
+
+UpdatedTile::list OverviewGenerator::affected() const
+{
+    UpdatedTile::list affected;
+    for (const auto &level : levels_) {
+        for (const auto &tile : level.tiles) {
+            if (tile.done) { continue; }
+            affected.push_back
+                ({ level.index, tile.id, tileExtents(level, tile) });
+        }
+    }
+    return affected;
+}
+
+std::vector<fs::path> OverviewGenerator::run()
+{
+    for (const auto &level : levels_) {
+        if (!level.pending) { continue; }
+        LOG(info3)
+            << (update_ ? "Updating overview #" : "Creating overview #")
+            << level.index << " of " << level.pending << '/'
+            << level.tiles.size() << " tiles in "
+            << (output_ / level.ovrName) << " from "
+            << (level.index
+                ? (output_ / levels_[level.index - 1].ovrName)
+                : setup_.outputDataset)
+            << ".";
+    }
+
+    // bottom level is ready to go
+    if (!levels_.empty()) {
+        const auto &tiles(levels_.front().tiles);
+        for (std::size_t i(0), ei(tiles.size()); i != ei; ++i) {
+            if (!tiles[i].done) { queue_.push({ 0, i }); }
+        }
+    }
+
+    auto threadCount(config_.threadCount);
+    if (!threadCount) {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    LOG(info3)
+        << "Generating " << total_ << " tiles using " << threadCount
+        << " thread(s) in " << (config_.cascade ? "cascade" : "level-by-level")
+        << " mode.";
+
+    utility::DurationMeter timer;
+    start_ = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> workers;
+    for (unsigned int i(0); i != threadCount; ++i) {
+        workers.emplace_back(&OverviewGenerator::worker, this);
+    }
+    for (auto &w : workers) { w.join(); }
+
+    if (error_) { std::rethrow_exception(error_); }
+
+    const std::chrono::duration<double> wall
+        (std::chrono::steady_clock::now() - start_);
+    const std::chrono::duration<double> busy(busy_);
+
+    LOG(info3)
+        << std::fixed << std::setprecision(1)
+        << "Generated " << total_ << " tiles in " << levels_.size()
+        << " overviews in " << utility::formatDuration(timer.duration())
+        << " using " << threadCount << " thread(s) in "
+        << (config_.cascade ? "cascade" : "level-by-level")
+        << " mode; thread utilization: "
+        << (wall.count()
+            ? (100.0 * busy.count() / (wall.count() * threadCount))
+            : 100.0)
+        << "%.";
+
+    std::vector<fs::path> ovrNames;
+    for (const auto &level : levels_) {
+        ovrNames.push_back(level.ovrName);
+    }
+    return ovrNames;
+}
+
+void OverviewGenerator::worker()
+{
+    Lock lock(mutex_);
+
+    for (;;) {
+        cond_.wait(lock, [&]() {
+                return (error_ || !queue_.empty() || !remaining_);
+            });
+        if (error_ || queue_.empty()) { return; }
+
+        const auto item(queue_.top());
+        queue_.pop();
 
-    // last tile size
-    math::Size2 lts(size.width - (tiled.width - 1) * ts.width
-                    , size.height - (tiled.height - 1) * ts.height);
+        auto &level(levels_[item.level]);
+        auto &tile(level.tiles[item.tile]);
 
-    // Dataset dataset(srcPath.string());
+        // determine source dataset
+        fs::path srcPath;
+        bool temporary(false);
+        std::vector<const BandDescriptor::list*> sources;
+
+        if (!item.level) {
+            srcPath = setup_.outputDataset;
+        } else {
+            const auto &prev(levels_[item.level - 1]);
+            if (prev.finalized) {
+                srcPath = output_ / prev.ovrName;
+            } else {
+                // NB: dependencies are done and thus never modified again
+                for (auto dep : tile.deps) {
+                    const auto &s(prev.tiles[dep].sources);
+                    if (!s.empty()) { sources.push_back(&s); }
+                }
+                temporary = true;
+            }
+        }
+
+        lock.unlock();
+
+        const auto start(std::chrono::steady_clock::now());
+        BandDescriptor::list result;
+        try {
+            if (temporary) {
+                srcPath = dependencyDataset(levels_[item.level - 1], tile
+                                            , sources);
+            }
+
+            result = process(level, tile, srcPath);
+
+            if (temporary) { fs::remove(srcPath); }
+        } catch (...) {
+            lock.lock();
+            if (!error_) { error_ = std::current_exception(); }
+            cond_.notify_all();
+            return;
+        }
+        const auto duration(std::chrono::steady_clock::now() - start);
+
+        lock.lock();
+        busy_ += duration;
+
+        try {
+            done(level, tile, std::move(result));
+        } catch (...) {
+            if (!error_) { error_ = std::current_exception(); }
+            cond_.notify_all();
+            return;
+        }
+    }
+}
+
+fs::path OverviewGenerator::dependencyDataset
+(const Level &level, const Tile &tile
+ , const std::vector<const BandDescriptor::list*> &sources)
+{
+    // place VRT into level directory to have valid relative paths
+    const auto path(output_ / level.dir
+                    / str(boost::format("next-%d-%d.vrt")
+                          % tile.id(0) % tile.id(1)));
+
+    VrtDs vrt(path, params_.srs, params_.extents, level.size
+              , params_.format, params_.nodata, setup_.maskType);
+
+    for (std::size_t b(0), eb(level.background.size()); b != eb; ++b) {
+        vrt.addSource(b, level.background[b]);
+    }
+
+    for (const auto *s : sources) {
+        for (std::size_t b(0), eb(s->size()); b != eb; ++b) {
+            vrt.addSource(b, (*s)[b]);
+        }
+    }
+
+    vrt.flush();
+    return path;
+}
+
+BandDescriptor::list OverviewGenerator::process(const Level &level
+                                                , const Tile &tile
+                                                , const fs::path &srcPath)
+{
+    utility::DurationMeter timer;
+
+    const auto &id(tile.id);
+    const auto ovrIndex(level.index);
 
     // use full dataset and disable safe-chunking
     geo::GeoDataset::WarpOptions warpOptions;
     warpOptions.overview = geo::GeoDataset::Overview();
     warpOptions.safeChunks = false;
 
-    // UTILITY_OMP(parallel for firstprivate(dataset) schedule(dynamic))
-    UTILITY_OMP(parallel for schedule(dynamic))
-        for (int i = 0; i < tc; ++i) {
-            utility::DurationMeter timer;
-            math::Point2i tile(i % tiled.width, i / tiled.width);
-
-            bool lastX(tile(0) == (tiled.width - 1));
-            bool lastY(tile(1) == (tiled.height - 1));
-
-            math::Size2 pxSize(lastX ? lts.width : ts.width
-                               , lastY ? lts.height : ts.height);
-
-            // calculate extents
-            math::Point2 ul(origin(0) + tileSize.width * tile(0)
-                            , origin(1) - tileSize.height * tile(1));
-            math::Point2 lr(lastX ? extents.ur(0) : ul(0) + tileSize.width
-                            , lastY ? extents.ll(1): ul(1) - tileSize.height);
-
-            math::Extents2 te(ul(0), lr(1), lr(0), ul(1));
-            TIDGuard tg(str(boost::format("tile:%d-%d-%d")
-                            % ovrIndex % tile(0) % tile(1)));
-
-            LOG(info2)
-                << std::fixed
-                << "Processing tile " << ovrIndex
-                << '-' << tile(0) << '-' << tile(1) << " (size: " << pxSize
-                << ", extents: " << te << ").";
-
-            // try warp
-            auto src(geo::GeoDataset::open(srcPath));
-
-            // auto &src(dataset.ds());
-
-            // strore result to file
-            fs::path tileName(str(boost::format("%d-%d.tif")
-                                  % tile(0) % tile(1)));
-            fs::path tilePath(output / dir / tileName);
-
-            auto tmp(createTmpDataset(src, te, pxSize, maskType));
-
-            src.warpInto(tmp, config.resampling, warpOptions);
-
-            // check result and skip if no need to store
-            if (emptyTile(config, tmp)) {
-                auto id(++progress);
-                LOG(info3)
-                    << std::fixed
-                    << "Processed tile #" << id << '/' << total << ' '
-                    << ovrIndex
-                    << '-' << tile(0) << '-' << tile(1) << " (size: " << pxSize
-                    << ", extents: " << te << ") [empty]"
-                    << "; duration: "
-                    << utility::formatDuration(timer.duration()) << ".";
-                continue;
-            }
+    const auto pxSize(tileSize(level, tile));
+    const auto te(tileExtents(level, tile));
 
-            // make room for output file
-            fs::remove(tilePath);
+    TIDGuard tg(str(boost::format("tile:%d-%d-%d")
+                    % ovrIndex % id(0) % id(1)));
 
-            createOutputDataset(src, tmp, tilePath
-                                , createOptions // use modified options
-                                , maskType);
+    LOG(info2)
+        << std::fixed
+        << "Processing tile " << ovrIndex
+        << '-' << id(0) << '-' << id(1) << " (size: " << pxSize
+        << ", extents: " << te << ").";
 
-            // store result
-            Rect drect(math::Point2i(tile(0) * ts.width, tile(1) * ts.height)
-                       , pxSize);
+    // try warp
+    auto src(geo::GeoDataset::open(srcPath));
 
-            UTILITY_OMP(critical(createOverwiew_addSimpleSource))
-                for (std::size_t b(0), eb(ovr.bandCount()); b != eb; ++b) {
-                    ovr.addSimpleSource(b, tileName, tmp, b
-                                        , boost::none, drect);
-                }
+    // strore result to file
+    const auto tileName(tile.name());
+    fs::path tilePath(output_ / level.dir / tileName);
+
+    auto tmp(createTmpDataset(src, te, pxSize, setup_.maskType));
+
+    src.warpInto(tmp, config_.resampling, warpOptions);
+
+    // check result and skip if no need to store
+    if (emptyTile(config_, tmp)) {
+        // get rid of previous content
+        if (update_) { fs::remove(tilePath); }
+
+        auto pid(++progress_);
+        LOG(info3)
+            << std::fixed
+            << "Processed tile #" << pid << '/' << total_ << ' '
+            << ovrIndex
+            << '-' << id(0) << '-' << id(1) << " (size: " << pxSize
+            << ", extents: " << te << ") [empty]"
+            << "; duration: "
+            << utility::formatDuration(timer.duration()) << ".";
+        return {};
+    }
+
+    // make room for output file
+    fs::remove(tilePath);
+
+    createOutputDataset(src, tmp, tilePath
+                        , createOptions_ // use modified options
+                        , setup_.maskType);
+
+    // store result
+    Rect drect(math::Point2i(id(0) * ts_.width, id(1) * ts_.height)
+               , pxSize);
 
-            auto id(++progress);
-            LOG(info3)
-                << std::fixed
-                << "Processed tile #" << id << '/' << total << ' ' << ovrIndex
-                << '-' << tile(0) << '-' << tile(1) << " (size: " << pxSize
-                << ", extents: " << te << ") [valid]"
-                << "; duration: "
-                << utility::formatDuration(timer.duration()) << ".";
+    BandDescriptor::list sources;
+    for (std::size_t b(0), eb(level.ovr->bandCount()); b != eb; ++b) {
+        sources.emplace_back(tileName, tmp, b, boost::none, drect);
+    }
+
+    auto pid(++progress_);
+    LOG(info3)
+        << std::fixed
+        << "Processed tile #" << pid << '/' << total_ << ' ' << ovrIndex
+        << '-' << id(0) << '-' << id(1) << " (size: " << pxSize
+        << ", extents: " << te << ") [valid]"
+        << "; duration: "
+        << utility::formatDuration(timer.duration()) << ".";
+
+    return sources;
+}
+
+void OverviewGenerator::done(Level &level, Tile &tile
+                             , BandDescriptor::list &&sources)
+{
+    // NB: called under lock
+
+    tile.done = true;
+    tile.sources = std::move(sources);
+    for (std::size_t b(0), eb(tile.sources.size()); b != eb; ++b) {
+        level.ovr->addSource(b, tile.sources[b]);
+    }
+
+    --remaining_;
+
+    auto next(std::size_t(level.index) + 1);
+    const bool hasNext(next < levels_.size());
+
+    if (hasNext && config_.cascade) {
+        auto &nextLevel(levels_[next]);
+        for (auto dependent : tile.dependents) {
+            auto &t(nextLevel.tiles[dependent]);
+            if (!t.done && !--t.waiting) { ready(next, dependent); }
         }
+    }
 
-    ovr.flush();
+    if (--level.pending) {
+        if (!remaining_) { cond_.notify_all(); }
+        return;
+    }
+
+    // level complete, write it down
+    level.ovr->flush();
+    level.finalized = true;
+
+    const std::chrono::duration<double> elapsed
+        (std::chrono::steady_clock::now() - start_);
+    LOG(info3)
+        << std::fixed << std::setprecision(1)
+        << "Overview #" << level.index << " complete after "
+        << elapsed.count() << " s.";
+
+    if (hasNext && !config_.cascade) {
+        // release whole next level
+        auto &nextLevel(levels_[next]);
+        for (std::size_t i(0), ei(nextLevel.tiles.size()); i != ei; ++i) {
+            auto &t(nextLevel.tiles[i]);
+            if (!t.done && !--t.waiting) { ready(next, i); }
+        }
+    }
 
-    return ovrName;
+    if (!remaining_) { cond_.notify_all(); }
 }
 
 } // namespace
@@ -1031,25 +1744,47 @@ void generate(const boost::filesystem::path &input
                << " overviews with " << total << " tiles of size "
                << config.tileSize << ".";
 
-    std::atomic<int> progress(0);
-
     // generate overviews
-    fs::path inputPath(setup.outputDataset);
-    for (std::size_t i(0); i != setup.ovrSizes.size(); ++i) {
-        auto dir(str(boost::format("%d") % i));
-        fs::create_directories(output / dir);
-
-        auto path(createOverview
-                  (config, output, i, inputPath, dir, setup.ovrSizes[i]
-                   , setup.ovrTiled[i], progress, total
-                   , setup.maskType));
-
+    OverviewGenerator generator(config, output, setup);
+    for (const auto &path : generator.run()) {
         // add overview (manually by manipulating the XML)
         addOverview(setup.outputDataset, path);
+    }
+}
+
+UpdatedTile::list update(const boost::filesystem::path &input
+                         , const boost::filesystem::path &output
+                         , const std::vector<math::Extents2> &changed
+                         , const Config &config)
+{
+    // same setup as used by generate
+    auto setup(makeSetup(geo::GeoDataset::open(input).descriptor(), config));
+    setup.outputDataset = output / "dataset";
 
-        // use previous level in the next round
-        inputPath = output / path;
+    if (!fs::exists(setup.outputDataset)) {
+        LOGTHROW(err2, std::runtime_error)
+            << "No dataset to update in " << output << ".";
+    }
+
+    {
+        const auto ds(geo::GeoDataset::open(setup.outputDataset));
+        if (ds.size() != setup.size) {
+            LOGTHROW(err2, std::runtime_error)
+                << "Dataset in " << output << " does not match input "
+                << "dataset and configuration; full rebuild is needed.";
+        }
     }
+
+    OverviewGenerator generator(config, output, setup, &changed);
+    auto affected(generator.affected());
+
+    LOG(info3) << "About to update " << affected.size() << " tiles in "
+               << setup.ovrSizes.size() << " overviews.";
+
+    // overviews are already registered in the dataset
+    generator.run();
+
+    return affected;
 }
 
 } // namespace vrtwo
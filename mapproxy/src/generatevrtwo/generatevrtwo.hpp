@@ -27,6 +27,8 @@
 #ifndef mapproxy_generatevrtwo_generatevrtwo_hpp_included_
 #define mapproxy_generatevrtwo_generatevrtwo_hpp_included_
 
+#include <vector>
+
 #include <boost/optional.hpp>
 #include <boost/filesystem/path.hpp>
 
@@ -76,12 +78,21 @@ struct Config {
 
     geo::Options createOptions;
 
+    /** Start overview tile as soon as tiles it is warped from are ready.
+     *  Level-by-level generation if false.
+     */
+    bool cascade;
+
+    /** Number of worker threads, 0 = hardware concurrency.
+     */
+    unsigned int threadCount;
 
     Config()
         : tileSize(4096, 4096)
         , minOvrSize(2, 2)
         , overwrite(false)
         , pathToOriginalDataset(PathToOriginalDataset::absoluteSymlink)
+        , cascade(true), threadCount(0)
     {}
 };
 
@@ -91,6 +102,28 @@ void generate(const boost::filesystem::path &input
               , const boost::filesystem::path &output
               , const Config &config);
 
+/** Overview tile regenerated by update.
+ */
+struct UpdatedTile {
+    int overview;
+    math::Point2i id;
+    math::Extents2 extents;
+
+    typedef std::vector<UpdatedTile> list;
+};
+
+/** Regenerates tiles of existing virtual geodataset with overviews affected
+ *  by change of given areas (in input dataset's SRS) of input dataset.
+ *  Overviews are rewritten in place. Config must be the same as used to
+ *  generate the dataset.
+ *
+ *  Returns list of regenerated tiles.
+ */
+UpdatedTile::list update(const boost::filesystem::path &input
+                         , const boost::filesystem::path &output
+                         , const std::vector<math::Extents2> &changed
+                         , const Config &config);
+
 } // namespace vrtwo
 
 #endif // mapproxy_generatevrtwo_generatevrtwo_hpp_included_
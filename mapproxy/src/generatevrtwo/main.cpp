@@ -29,6 +29,7 @@
 #include <functional>
 #include <map>
 #include <numeric>
+#include <fstream>
 
 #include <boost/optional.hpp>
 #include <boost/utility/in_place_factory.hpp>
@@ -84,6 +85,7 @@ class VrtWo : public service::Cmdline {
 public:
     VrtWo()
         : service::Cmdline("generageVrtWo", BUILD_TARGET_VERSION)
+        , update_(false)
     {
     }
 
@@ -102,6 +104,11 @@ private:
     fs::path output_;
     std::vector<std::string> co_;
     vrtwo::Config config_;
+
+    bool update_;
+    std::vector<math::Extents2> changedExtents_;
+    std::vector<fs::path> changedFiles_;
+    boost::optional<fs::path> affectedTiles_;
 };
 
 void VrtWo::configuration(po::options_description &cmdline
@@ -150,6 +157,29 @@ void VrtWo::configuration(po::options_description &cmdline
          , "Optional nodata value override. Can be NONE (to disable any "
          "nodata value) or a (real) number. Original input dataset's nodata "
          "value is used if not specified.")
+        ("cascade", po::value(&config_.cascade)
+         ->default_value(config_.cascade)->implicit_value(true)
+        , "Start overview tile as soon as all tiles it is warped from "
+         "are written instead of waiting for the whole previous overview. "
+         "Output is identical in both modes; use false to measure speedup.")
+        ("threadCount", po::value(&config_.threadCount)
+         ->default_value(config_.threadCount)
+        , "Number of worker threads; 0 means number of available CPUs.")
+
+        ("update", po::value(&update_)
+         ->default_value(false)->implicit_value(true)
+        , "Update existing output: regenerate only overview tiles affected "
+         "by areas given by --changedExtents and --changedFile. Other "
+         "options must be the same as used to generate the output.")
+        ("changedExtents", po::value(&changedExtents_)
+        , "Changed area of input dataset (in input dataset's SRS) in format "
+         "llx,lly:urx,ury; can be used multiple times.")
+        ("changedFile", po::value(&changedFiles_)
+        , "Changed file (part of input mosaic, in input dataset's SRS); "
+         "can be used multiple times.")
+        ("affectedTiles", po::value<fs::path>()
+        , "Where to write list of regenerated tiles (one tile per line: "
+         "overview x y llx lly urx ury) in update mode.")
         ;
 
     pd.add("input", 1)
@@ -173,6 +203,15 @@ void VrtWo::configure(const po::variables_map &vars)
         co_ = def::createOptions;
     }
 
+    if (vars.count("affectedTiles")) {
+        affectedTiles_ = vars["affectedTiles"].as<fs::path>();
+    }
+
+    if (update_ && changedExtents_.empty() && changedFiles_.empty()) {
+        throw po::validation_error
+            (po::validation_error::required_option, "changedExtents");
+    }
+
     input_ = fs::absolute(input_);
 
     // prepare create options
@@ -245,6 +284,10 @@ bool VrtWo::help(std::ostream &out, const std::string &what) const
         out << ("generatevrtwo input output [options]\n"
                 "    Generates virtual GDAL dataset with overviews.\n"
                 "\n"
+                "generatevrtwo input output --update [options]\n"
+                "    Regenerates overview tiles affected by changed parts "
+                "of input dataset.\n"
+                "\n"
                 );
 
         return true;
@@ -255,6 +298,36 @@ bool VrtWo::help(std::ostream &out, const std::string &what) const
 
 int VrtWo::run()
 {
+    if (update_) {
+        auto changed(changedExtents_);
+        for (const auto &file : changedFiles_) {
+            changed.push_back(geo::GeoDataset::open(file).extents());
+        }
+
+        const auto affected(vrtwo::update(input_, output_, changed
+                                          , config_));
+
+        if (affectedTiles_) {
+            std::ofstream f;
+            f.exceptions(std::ios::badbit | std::ios::failbit);
+            f.open(affectedTiles_->string()
+                   , std::ios_base::out | std::ios_base::trunc);
+            f.precision(15);
+            for (const auto &tile : affected) {
+                f << tile.overview << ' ' << tile.id(0) << ' ' << tile.id(1)
+                  << ' ' << tile.extents.ll(0) << ' ' << tile.extents.ll(1)
+                  << ' ' << tile.extents.ur(0) << ' ' << tile.extents.ur(1)
+                  << '\n';
+            }
+            f.close();
+        }
+
+        LOG(info4) << "VRT with overviews in " << output_
+                   << " successfully updated (" << affected.size()
+                   << " tiles regenerated).";
+        return EXIT_SUCCESS;
+    }
+
     vrtwo::generate(input_, output_, config_);
 
     LOG(info4) << "VRT with overviews in " << output_
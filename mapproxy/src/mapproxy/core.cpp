@@ -24,10 +24,15 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <set>
 #include <thread>
+#include <cctype>
+#include <sstream>
 
 #include <boost/format.hpp>
 #include <boost/asio.hpp>
+#include <boost/optional.hpp>
+#include <boost/utility/in_place_factory.hpp>
 
 #include "utility/raise.hpp"
 
@@ -41,6 +46,10 @@
 #include "error.hpp"
 #include "core.hpp"
 #include "sink.hpp"
+#include "support/resampling.hpp"
+#include "support/coverage.hpp"
+#include "generator/warpcache.hpp"
+#include "generator/metatile.hpp"
 
 namespace asio = boost::asio;
 namespace vts = vtslibs::vts;
@@ -50,14 +59,17 @@ namespace vre = vtslibs::registry::extensions;
 class Core::Detail : boost::noncopyable {
 public:
     Detail(Generators &generators, GdalWarper &warper
-           , unsigned int threadCount, http::ContentFetcher &contentFetcher)
+           , const ThreadPool::Config &poolConfig
+           , http::ContentFetcher &contentFetcher
+           , const CpuSet &cpus)
         : resourceFetcher_(contentFetcher, &ios_)
         , generators_(generators)
+        , warper_(warper)
         , arsenal_(warper, resourceFetcher_)
-        , work_(ios_)
+        , cpus_(cpus)
     {
         generators_.start(arsenal_);
-        start(threadCount);
+        start(poolConfig);
     }
 
     ~Detail() {
@@ -79,76 +91,73 @@ public:
         return false;
     }
 
+    void stat(std::ostream &os, std::size_t top) const;
+
+    void monitor(std::ostream &os, std::size_t top) const;
+
 private:
-    void start(std::size_t count);
+    void start(const ThreadPool::Config &poolConfig);
     void stop();
-    void worker(std::size_t id);
     void post(const Generator::Task &task, Sink sink);
 
     asio::io_service ios_;
     http::ResourceFetcher resourceFetcher_;
 
     Generators &generators_;
+    GdalWarper &warper_;
     Arsenal arsenal_;
+    CpuSet cpus_;
+
+    /** Per-resource usage.
+     */
+    Accounting accounting_;
 
-    /** Processing pool stuff.
+    /** Processing pool.
      */
-    asio::io_service::work work_;
-    std::vector<std::thread> workers_;
+    boost::optional<ThreadPool> pool_;
 };
 
-void Core::Detail::start(std::size_t count)
+void Core::Detail::start(const ThreadPool::Config &poolConfig)
 {
-    // make sure threads are released when something goes wrong
-    struct Guard {
-        Guard(const std::function<void()> &func) : func(func) {}
-        ~Guard() { if (func) { func(); } }
-        void release() { func = {}; }
-        std::function<void()> func;
-    } guard([this]() { stop(); });
-
-    for (std::size_t id(1); id <= count; ++id) {
-        workers_.emplace_back(&Detail::worker, this, id);
-    }
-
-    guard.release();
+    pool_ = boost::in_place
+        (std::ref(ios_), poolConfig, "core"
+         , [this]() { return warper_.waiting(); }
+         , [this](std::size_t id)
+         {
+             const auto name(str(boost::format("core:%u") % id));
+             dbglog::thread_id(name);
+             pinThread(cpus_, name);
+         });
 }
 
 void Core::Detail::stop()
 {
     LOG(info2) << "Stopping core.";
-    ios_.stop();
-
-    while (!workers_.empty()) {
-        workers_.back().join();
-        workers_.pop_back();
-    }
+    if (pool_) { pool_->stop(); }
 }
 
-void Core::Detail::worker(std::size_t id)
+void Core::Detail::stat(std::ostream &os, std::size_t top) const
 {
-    dbglog::thread_id(str(boost::format("core:%u") % id));
-    LOG(info2) << "Spawned worker id:" << id << ".";
+    if (pool_) { pool_->stat(os, "core.pool."); }
+    accounting_.stat(os, "accounting.", top);
+    ResamplingPolicy::stat(os, "resampling.");
+    watertightStat(os, "watertight.");
+    cachedWarpStat(os, "warpcache.");
+    heightTableStat(os, "heighttable.");
+}
 
-    for (;;) {
-        try {
-            ios_.run();
-            LOG(info2) << "Terminated worker id:" << id << ".";
-            return;
-        } catch (const std::exception &e) {
-            LOG(err3)
-                << "Uncaught exception in worker: <" << e.what()
-                << ">. Going on.";
-        }
-    }
+void Core::Detail::monitor(std::ostream &os, std::size_t top) const
+{
+    accounting_.monitor(os, top);
 }
 
 void Core::Detail::post(const Generator::Task &task, Sink sink)
 {
     if (!task) { return; }
 
-    ios_.post([=]() mutable // sink is passed as non-const ref
+    pool_->post([=]() mutable // sink is passed as non-const ref
     {
+        Accounting::Scope accountingScope(sink.accounting());
         try {
             task(sink, arsenal_);
         } catch (...) {
@@ -158,11 +167,31 @@ void Core::Detail::post(const Generator::Task &task, Sink sink)
 }
 
 Core::Core(Generators &generators, GdalWarper &warper
-           , unsigned int threadCount, http::ContentFetcher &contentFetcher)
+           , unsigned int threadCount, http::ContentFetcher &contentFetcher
+           , const CpuSet &cpus)
+    : detail_(std::make_shared<Detail>
+              (generators, warper, ThreadPool::Config(threadCount)
+               , contentFetcher, cpus))
+{}
+
+Core::Core(Generators &generators, GdalWarper &warper
+           , const ThreadPool::Config &poolConfig
+           , http::ContentFetcher &contentFetcher
+           , const CpuSet &cpus)
     : detail_(std::make_shared<Detail>
-              (generators, warper, threadCount, contentFetcher))
+              (generators, warper, poolConfig, contentFetcher, cpus))
 {}
 
+void Core::stat(std::ostream &os, std::size_t top) const
+{
+    detail().stat(os, top);
+}
+
+void Core::monitor(std::ostream &os, std::size_t top) const
+{
+    detail().monitor(os, top);
+}
+
 void Core::generate_impl(const http::Request &request
                          , const http::ServerSink::pointer &sink)
 {
@@ -249,6 +278,46 @@ buildListing(const Container &container
     return buildListing<true, Container>(container, bootstrap);
 }
 
+/** Accounting resource: reference frame, generator interface, group and id.
+ */
+std::string accountingResource(const FileInfo &fi)
+{
+    std::ostringstream os;
+    os << fi.resourceId.referenceFrame << '/' << fi.interface << '/'
+       << fi.resourceId.group << '/' << fi.resourceId.id;
+    return os.str();
+}
+
+/** Accounting file type: "tile" + extension for tile files (their names start
+ *  with LOD), filename itself for well-known resource documents. Anything else
+ *  (support files, scanner probes) is accounted as "other": filename comes
+ *  from the client and must not create new records.
+ */
+std::string accountingFileType(const FileInfo &fi)
+{
+    static const std::set<std::string> tileExtensions = {
+        ".jpg", ".png", ".mask", ".meta", ".bin", ".nav", ".geo"
+        , ".terrain"
+    };
+
+    static const std::set<std::string> documents = {
+        "mapConfig.json", "boundlayer.json", "freelayer.json", "debug.json"
+        , "index.html", "browser.html", "README", "dems.html", "style.json"
+        , "tileset.conf", "tileset.index", "tileset.registry", "layer.json"
+        , "cesium.conf", "WMTSCapabilities.xml"
+    };
+
+    const auto &filename(fi.filename);
+    if (filename.empty() || !std::isdigit(filename[0])) {
+        return documents.count(filename) ? filename : "other";
+    }
+
+    const auto dot(filename.rfind('.'));
+    if (dot == std::string::npos) { return "other"; }
+    const auto extension(filename.substr(dot));
+    return tileExtensions.count(extension) ? ("tile" + extension) : "other";
+}
+
 } // namespace
 
 void Core::Detail::generate(const http::Request &request, Sink sink)
@@ -298,8 +367,19 @@ void Core::Detail::generateResourceFile(const FileInfo &fi, Sink &sink)
     // assign file class stuff
     sink.assignFileClassSettings(generator->resource().fileClassSettings);
 
+    // charge this request to its resource
+    auto record(accounting_.record(accountingResource(fi)
+                                   , accountingFileType(fi)));
+    record->request();
+    sink.assignAccounting(record);
+
     // run machinery
-    post(generator->generateFile(fi, sink), sink);
+    Generator::Task task;
+    {
+        Accounting::Scope accountingScope(record);
+        task = generator->generateFile(fi, sink);
+    }
+    post(task, sink);
 }
 
 void Core::Detail::generateReferenceFrameDems(const FileInfo &fi, Sink &sink)
@@ -30,13 +30,35 @@
 #include "http/contentgenerator.hpp"
 
 #include "generator.hpp"
+#include "support/placement.hpp"
+#include "support/threadpool.hpp"
+#include "support/accounting.hpp"
 
 class Core : boost::noncopyable
            , public http::ContentGenerator
 {
 public:
+    /** Processing threads are pinned to given CPUs (if non-empty).
+     */
     Core(Generators &generators, GdalWarper &warper
-         , unsigned int threadCount, http::ContentFetcher &contentFetcher);
+         , unsigned int threadCount, http::ContentFetcher &contentFetcher
+         , const CpuSet &cpus = CpuSet());
+
+    /** Processing pool is sized (possibly adaptively) by given config. Pool
+     *  treats threads waiting for GDAL warper as blocked.
+     */
+    Core(Generators &generators, GdalWarper &warper
+         , const ThreadPool::Config &poolConfig
+         , http::ContentFetcher &contentFetcher
+         , const CpuSet &cpus = CpuSet());
+
+    /** Writes pool stat and top N per-resource usage records.
+     */
+    void stat(std::ostream &os, std::size_t top = 10) const;
+
+    /** Writes table of top N resources by CPU usage.
+     */
+    void monitor(std::ostream &os, std::size_t top = 10) const;
 
     struct Detail;
 
@@ -53,6 +53,11 @@ void parseDefinition(GeodataVectorTiled &def, const Json::Value &value)
         def.maxSourceLod = boost::in_place();
         Json::get(*def.maxSourceLod, value, "maxSourceLod");
     }
+
+    if (value.isMember("heightTableLod")) {
+        def.heightTableLod = boost::in_place();
+        Json::get(*def.heightTableLod, value, "heightTableLod");
+    }
 }
 
 void buildDefinition(Json::Value &value, const GeodataVectorTiled &def)
@@ -60,6 +65,10 @@ void buildDefinition(Json::Value &value, const GeodataVectorTiled &def)
     if (def.maxSourceLod) {
         value["maxSourceLod"] = *def.maxSourceLod;
     }
+
+    if (def.heightTableLod) {
+        value["heightTableLod"] = int(*def.heightTableLod);
+    }
 }
 
 } // namespace
@@ -94,6 +103,11 @@ Changed GeodataVectorTiled::changed_impl(const DefinitionBase &o)
         return Changed::withRevisionBump;
     }
 
+    // height table is only an accelerator, it is recomputed when prepared
+    if ((changed == Changed::no) && (heightTableLod != other.heightTableLod)) {
+        return Changed::safely;
+    }
+
     // pass result from parent
     return changed;
 }
@@ -113,6 +113,10 @@ struct GeodataVectorTiled : GeodataVectorBase {
      */
     boost::optional<vts::Lod> maxSourceLod;
 
+    /** Precompute per-tile height table down to this LOD at prepare time.
+     */
+    boost::optional<vts::Lod> heightTableLod;
+
     virtual void from_impl(const Json::Value &value);
     virtual void to_impl(Json::Value &value) const;
 
@@ -67,6 +67,11 @@ void parseDefinition(SurfaceDem &def, const Json::Value &value)
         Json::get(*def.heightcodingAlias, value, "heightcodingAlias");
     }
 
+    if (value.isMember("heightTableLod")) {
+        def.heightTableLod = boost::in_place();
+        Json::get(*def.heightTableLod, value, "heightTableLod");
+    }
+
     def.parse(value);
 }
 
@@ -86,6 +91,9 @@ void buildDefinition(Json::Value &value, const SurfaceDem &def)
     if (def.heightcodingAlias) {
         value["heightcodingAlias"] = *def.heightcodingAlias;
     }
+    if (def.heightTableLod) {
+        value["heightTableLod"] = int(*def.heightTableLod);
+    }
 
     def.build(value);
 }
@@ -110,7 +118,14 @@ Changed SurfaceDem::changed_impl(const DefinitionBase &o) const
     if (mask != other.mask) { return Changed::yes; }
     if (textureLayerId != other.textureLayerId) { return Changed::yes; }
 
-    return Surface::changed_impl(o);
+    const auto changed(Surface::changed_impl(o));
+
+    // height table is only an accelerator, it is recomputed when prepared
+    if ((changed == Changed::no) && (heightTableLod != other.heightTableLod)) {
+        return Changed::safely;
+    }
+
+    return changed;
 }
 
 } // namespace resource
@@ -98,6 +98,10 @@ struct SurfaceDem : public Surface {
     unsigned int textureLayerId;
     boost::optional<std::string> heightcodingAlias;
 
+    /** Precompute per-tile height table down to this LOD at prepare time.
+     */
+    boost::optional<vts::Lod> heightTableLod;
+
     SurfaceDem() : textureLayerId() {}
 
     static constexpr char driverName[] = "surface-dem";
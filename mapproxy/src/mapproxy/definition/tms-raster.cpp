@@ -69,6 +69,34 @@ void parseDefinition(TmsRaster &def, const Json::Value &value)
 
     Json::get(def.resampling, value, "resampling");
 
+    if (value.isMember("resamplingPolicy")) {
+        const auto &policy(value["resamplingPolicy"]);
+        if (!policy.isArray()) {
+            utility::raise<Json::Error>
+                ("Value stored in resamplingPolicy is not an array");
+        }
+
+        for (const auto &item : policy) {
+            ResamplingPolicy::Rule rule;
+            Json::get(rule.overzoom, item, "overzoom");
+            Json::get(s, item, "resampling");
+            try {
+                rule.resampling
+                    = boost::lexical_cast<geo::GeoDataset::Resampling>(s);
+            } catch (const boost::bad_lexical_cast&) {
+                utility::raise<Json::Error>
+                    ("Value stored in resamplingPolicy is not "
+                     "Resampling value");
+            }
+            def.resamplingPolicy.add(rule);
+        }
+    }
+
+    if (value.isMember("prerender")) {
+        def.prerender = boost::in_place();
+        Json::get(*def.prerender, value, "prerender");
+    }
+
     def.parse(value);
 }
 
@@ -87,6 +115,20 @@ void buildDefinition(Json::Value &value, const TmsRaster &def)
             = boost::lexical_cast<std::string>(*def.resampling);
     }
 
+    if (!def.resamplingPolicy.empty()) {
+        auto &policy(value["resamplingPolicy"] = Json::arrayValue);
+        for (const auto &rule : def.resamplingPolicy.rules) {
+            auto &item(policy.append(Json::objectValue));
+            item["overzoom"] = rule.overzoom;
+            item["resampling"]
+                = boost::lexical_cast<std::string>(rule.resampling);
+        }
+    }
+
+    if (def.prerender) {
+        value["prerender"] = int(*def.prerender);
+    }
+
     def.build(value);
 }
 
@@ -119,6 +161,14 @@ Changed TmsRaster::changed_impl(const DefinitionBase &o) const
     // format can change
     if (resampling != other.resampling) { return Changed::safely; }
 
+    // resampling policy can change
+    if (resamplingPolicy != other.resamplingPolicy) {
+        return Changed::safely;
+    }
+
+    // pre-rendering can change, pack is regenerated
+    if (prerender != other.prerender) { return Changed::safely; }
+
     return TmsCommon::changed_impl(o);
 }
 
@@ -33,6 +33,7 @@
 #include "geo/geodataset.hpp"
 
 #include "../resource.hpp"
+#include "../support/resampling.hpp"
 
 // fwd
 namespace Json { class Value; }
@@ -100,6 +101,14 @@ struct TmsRaster : public TmsCommon {
     bool transparent;
     boost::optional<geo::GeoDataset::Resampling> resampling;
 
+    /** Overzoom-based resampling override (both image and mask).
+     */
+    ResamplingPolicy resamplingPolicy;
+
+    /** Pre-render image, mask and metatiles up to this LOD at prepare time.
+     */
+    boost::optional<vts::Lod> prerender;
+
     TmsRaster(): format(RasterFormat::jpg), transparent(false) {}
 
     static constexpr char driverName[] = "tms-raster";
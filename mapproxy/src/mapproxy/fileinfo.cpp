@@ -24,10 +24,12 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <array>
+#include <vector>
+#include <utility>
+
 #include <boost/lexical_cast.hpp>
-#include <boost/algorithm/string/split.hpp>
-#include <boost/algorithm/string/classification.hpp>
-#include <boost/range/iterator.hpp>
+#include <boost/utility/string_ref.hpp>
 
 #include "utility/streams.hpp"
 
@@ -43,7 +45,6 @@
 #include "cesium.hpp"
 #include "ol.hpp"
 
-namespace ba = boost::algorithm;
 namespace vr = vtslibs::registry;
 
 namespace constants {
@@ -80,19 +81,66 @@ namespace constants {
 
 namespace {
 
+typedef boost::string_ref StringRef;
+
+/** Exception-free enum parser. Maps exact textual representation of each
+ *  enumeration value (as produced by operator<<) to the value; built once.
+ */
 template <typename E>
-bool asEnum(const std::string &str, E &value)
-{
-    try {
-        value = boost::lexical_cast<E>(str);
-    } catch (const boost::bad_lexical_cast&) {
+class EnumParser {
+public:
+    static const EnumParser& instance() {
+        static const EnumParser parser;
+        return parser;
+    }
+
+    bool operator()(StringRef str, E &value) const {
+        for (const auto &item : table_) {
+            if (StringRef(item.first) == str) {
+                value = item.second;
+                return true;
+            }
+        }
         return false;
     }
-    return true;
+
+private:
+    EnumParser() {
+        for (auto value : enumerationValues(E())) {
+            table_.emplace_back(boost::lexical_cast<std::string>(value)
+                                , value);
+        }
+    }
+
+    std::vector<std::pair<std::string, E>> table_;
+};
+
+template <>
+EnumParser<GeneratorInterface>::EnumParser()
+{
+    // must match operator>>(std::istream&, GeneratorInterface&)
+    typedef GeneratorInterface::Type Type;
+    typedef GeneratorInterface::Interface Interface;
+
+    for (auto type : enumerationValues(Type())) {
+        table_.emplace_back(boost::lexical_cast<std::string>(type)
+                            , GeneratorInterface(type));
+    }
+    table_.emplace_back("terrain"
+                        , GeneratorInterface(Type::surface
+                                             , Interface::terrain));
+    table_.emplace_back("wmts"
+                        , GeneratorInterface(Type::tms, Interface::wmts));
+}
+
+template <typename E>
+bool asEnum(StringRef str, E &value)
+{
+    return EnumParser<E>::instance()(str, value);
 }
 
 template <typename E, typename Error>
-void asEnumChecked(const std::string &str, E &value, const std::string message)
+void asEnumChecked(StringRef str, E &value, const std::string message)
 {
     if (!asEnum(str, value)) {
         LOGTHROW(err1, NotFound)
@@ -100,8 +148,9 @@ void asEnumChecked(const std::string &str, E &value, const std::string message)
     }
 }
 
-const std::string& checkReferenceFrame(const std::string &referenceFrame)
+std::string checkReferenceFrame(StringRef str)
 {
+    std::string referenceFrame(str.data(), str.size());
     if (vr::system.referenceFrames(referenceFrame, std::nothrow)) {
         return referenceFrame;
     }
@@ -111,6 +160,56 @@ const std::string& checkReferenceFrame(const std::string &referenceFrame)
     throw;
 }
 
+/** Splits path into components on runs of slashes without any allocation.
+ *  Produces the same components as
+ *  ba::split(..., ba::is_any_of("/"), ba::token_compress_on).
+ *
+ *  Only first MaxComponents components are kept, the rest is just counted.
+ */
+class PathComponents {
+public:
+    static constexpr std::size_t MaxComponents = 6;
+
+    PathComponents(StringRef path)
+        : size_()
+    {
+        const char *e(path.data() + path.size());
+        const char *start(path.data());
+        for (const char *p(start); ; ++p) {
+            if ((p != e) && (*p != '/')) { continue; }
+
+            push(start, p);
+            if (p == e) { break; }
+
+            // compress run of separators
+            while (((p + 1) != e) && (p[1] == '/')) { ++p; }
+            start = p + 1;
+        }
+    }
+
+    std::size_t size() const { return size_; }
+
+    StringRef operator[](std::size_t index) const {
+        return components_[index];
+    }
+
+    std::string str(std::size_t index) const {
+        return std::string(components_[index].data()
+                           , components_[index].size());
+    }
+
+private:
+    void push(const char *b, const char *e) {
+        if (size_ < MaxComponents) {
+            components_[size_] = StringRef(b, e - b);
+        }
+        ++size_;
+    }
+
+    std::array<StringRef, MaxComponents> components_;
+    std::size_t size_;
+};
+
 } // namespace
 
 FileInfo::FileInfo(const http::Request &request, int f)
@@ -124,18 +223,31 @@ FileInfo::FileInfo(const http::Request &request, int f)
         }
     }
 
-    auto end(path.end());
+    parse();
+}
 
-    std::vector<std::string> components;
-    {
-        auto range(boost::make_iterator_range(path.begin(), end));
-        ba::split(components, range, ba::is_any_of("/")
-                  , ba::token_compress_on);
+FileInfo::FileInfo(const std::string &u, int f)
+    : url(u), flags(f), type(Type::resourceFile)
+{
+    // split local URL into path and query
+    const auto qm(url.find('?'));
+    if (qm == std::string::npos) {
+        path = url;
+    } else {
+        path = url.substr(0, qm);
+        query = url.substr(qm + 1);
     }
 
+    parse();
+}
+
+void FileInfo::parse()
+{
+    const PathComponents components(path);
+
     switch (components.size() - 1) {
     case 1:
-        filename = components[1];
+        filename = components.str(1);
 
         if ((filename == constants::Index)
             || filename == constants::Self)
@@ -150,7 +262,7 @@ FileInfo::FileInfo(const http::Request &request, int f)
 
     case 2:
         resourceId.referenceFrame = checkReferenceFrame(components[1]);
-        filename = components[2];
+        filename = components.str(2);
 
         if (filename == constants::Index) {
             // /rf/index.html -> browser
@@ -175,7 +287,7 @@ FileInfo::FileInfo(const http::Request &request, int f)
         resourceId.referenceFrame = checkReferenceFrame(components[1]);
         asEnumChecked<GeneratorInterface, NotFound>
             (components[2], interface, "Unknown generator interface.");
-        filename = components[3];
+        filename = components.str(3);
 
         if (filename == constants::Index) {
             // /rf/type/index.html -> browser
@@ -196,8 +308,8 @@ FileInfo::FileInfo(const http::Request &request, int f)
         resourceId.referenceFrame = checkReferenceFrame(components[1]);
         asEnumChecked<GeneratorInterface, NotFound>
             (components[2], interface, "Unknown generator interface.");
-        resourceId.group = components[3];
-        filename = components[4];
+        resourceId.group = components.str(3);
+        filename = components.str(4);
 
         if (filename == constants::Index) {
             // /rf/type/group/index.html -> browser
@@ -218,9 +330,9 @@ FileInfo::FileInfo(const http::Request &request, int f)
         resourceId.referenceFrame = checkReferenceFrame(components[1]);
         asEnumChecked<GeneratorInterface, NotFound>
             (components[2], interface, "Unknown generator interface.");
-        resourceId.group = components[3];
-        resourceId.id = components[4];
-        filename = components[5];
+        resourceId.group = components.str(3);
+        resourceId.id = components.str(4);
+        filename = components.str(5);
         return;
 
     default:
@@ -237,12 +349,12 @@ TmsFileInfo::TmsFileInfo(const FileInfo &fi)
     : fileInfo(fi), type(Type::unknown), format(), support()
 {
     if (const auto *p = vts::parseTileIdPrefix(tileId, fi.filename)) {
-        const std::string ext(p);
-        if (ext == "mask") {
+        const StringRef ext(p);
+        if (ext == StringRef("mask")) {
             // mask file
             type = Type::mask;
             return;
-        } else if (ext == "meta") {
+        } else if (ext == StringRef("meta")) {
             // mask file
             type = Type::metatile;
             return;
@@ -459,12 +571,12 @@ GeodataFileInfo::GeodataFileInfo(const FileInfo &fi, bool tiled
 {
     if (tiled) {
         if (const auto *p = vts::parseTileIdPrefix(tileId, fi.filename)) {
-            std::string ext(p);
-            if (ext == "geo") {
+            const StringRef ext(p);
+            if (ext == StringRef("geo")) {
                 // mask file
                 type = Type::geo;
                 return;
-            } else if (ext == "meta") {
+            } else if (ext == StringRef("meta")) {
                 // mask file
                 type = Type::metatile;
                 return;
@@ -561,8 +673,8 @@ TerrainFileInfo::TerrainFileInfo(const FileInfo &fi)
     : fileInfo(fi), type(Type::unknown), support()
 {
     if (const auto *p = vts::parseTileIdPrefix(tileId, fi.filename)) {
-        const std::string ext(p);
-        if (ext == "terrain") {
+        const StringRef ext(p);
+        if (ext == StringRef("terrain")) {
             type = Type::tile;
             return;
         }
@@ -641,7 +753,7 @@ WmtsFileInfo::WmtsFileInfo(const FileInfo &fi)
     : fileInfo(fi), type(Type::unknown), format(), support()
 {
     if (const auto *p = vts::parseTileIdPrefix(tileId, fi.filename)) {
-        const std::string ext(p);
+        const StringRef ext(p);
         // parse as format
         type = Type::image;
         asEnumChecked<RasterFormat, NotFound>(ext, format, "raster format");
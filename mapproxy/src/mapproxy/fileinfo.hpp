@@ -49,6 +49,11 @@ namespace FileFlags { enum {
 struct FileInfo {
     FileInfo(const http::Request &request, int flags = FileFlags::none);
 
+    /** Parses local URL (path[?query]), used by offline tools driving
+     *  generators without HTTP server.
+     */
+    FileInfo(const std::string &url, int flags = FileFlags::none);
+
     /** Full url.
      */
     std::string url;
@@ -93,6 +98,9 @@ struct FileInfo {
      *  Valid only if type == Type::resourceFile.
      */
     std::string filename;
+
+private:
+    void parse();
 };
 
 /** Parsed TMS file information.
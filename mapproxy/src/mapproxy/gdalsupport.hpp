@@ -47,8 +47,10 @@
 #include "support/geo.hpp"
 #include "support/layerenancer.hpp"
 #include "support/aborter.hpp"
+#include "support/placement.hpp"
 
 #include "gdalsupport/workrequestfwd.hpp"
+#include "gdalsupport/sharedmemory.hpp"
 
 class GdalWarper {
 public:
@@ -58,9 +60,27 @@ public:
         std::size_t rssCheckPeriod;
         std::size_t rssLimit;
 
+        /** CPUs for manager and worker processes (empty = no placement).
+         */
+        CpuSet cpus;
+
+        /** Distribute workers round-robin across NUMA nodes of cpus.
+         */
+        bool numaSpread;
+
+        /** NUMA policy of shared memory segment (nodes of cpus).
+         */
+        MemoryPolicy shmPolicy;
+
+        /** Huge page backing of shared memory segment.
+         */
+        HugePages hugePages;
+
         Options()
             : processCount(5), rssCheckPeriod(5)
             , rssLimit(std::size_t(1) << 12)
+            , numaSpread(false), shmPolicy(MemoryPolicy::none)
+            , hugePages(HugePages::none)
         {}
     };
 
@@ -89,7 +109,8 @@ public:
          *
          * * dem:
          *       warps dataset as a DEM using Resampling::dem filter
-         *       returns single channel double matrix
+         *       returns single channel double (or float, see sampleType)
+         *       matrix
          *
          *       warp is done in grid registration (i.e. provided extents are
          *       inflated by half pixel in each direction and raster size is
@@ -97,7 +118,8 @@ public:
          *
          * * demOptimal:
          *       warps dataset as a DEM using Resampling::dem filter
-         *       returns single channel double matrix
+         *       returns single channel double (or float, see sampleType)
+         *       matrix
          *
          *       result raster size is computed from scaling factor, provided
          *       size is upper limit (lower limit is 2x2)
@@ -110,14 +132,22 @@ public:
          *       warps dataset using given filter, dataset.min by minimum filter
          *       and dataset.max by maximum filter
          *
-         *       returns 3-channel double matrix with current value, minimum
-         *       value and maximum value in each pixel
+         *       returns 3-channel double (or float, see sampleType) matrix
+         *       with current value, minimum value and maximum value in each
+         *       pixel
          */
         enum class Operation {
             image, imageNoOpt, mask, maskNoOpt, detailMask, dem
             , demOptimal, valueMinMax
         };
 
+        /** Sample type of dem, demOptimal and valueMinMax results. DEMs are
+         *  warped in single precision anyway, float32 halves shared memory
+         *  footprint. Use demValue/demValueMinMax (support/demraster.hpp)
+         *  to read samples regardless of type.
+         */
+        enum class SampleType { float64, float32 };
+
         Operation operation;
         std::string dataset;
         geo::SrsDefinition srs;
@@ -126,6 +156,15 @@ public:
         geo::GeoDataset::Resampling resampling;
         boost::optional<std::string> mask;
         boost::optional<double> nodata;
+        SampleType sampleType;
+
+        /** Hint: tile grid is aligned with dataset pixels (same SRS, tile
+         *  pixel is 2^k dataset pixels and tile origin lies on pixel
+         *  boundary). Image operation then tries to read tile directly from
+         *  dataset (or its overview) and warps only when this is not
+         *  possible.
+         */
+        bool aligned;
 
         RasterRequest(Operation operation
                       , const std::string &dataset
@@ -138,12 +177,21 @@ public:
                       = boost::none)
             : operation(operation), dataset(dataset)
             , srs(srs), extents(extents), size(size), resampling(resampling)
-            , mask(mask)
+            , mask(mask), sampleType(SampleType::float64)
+            , aligned(false)
         {}
 
         RasterRequest& setNodata(const boost::optional<double> &value) {
             nodata = value; return *this;
         }
+
+        RasterRequest& setSampleType(SampleType value) {
+            sampleType = value; return *this;
+        }
+
+        RasterRequest& setAligned(bool value) {
+            aligned = value; return *this;
+        }
     };
 
     Raster warp(const RasterRequest &request, Aborter &sink);
@@ -190,6 +238,30 @@ public:
 
     void stat(std::ostream &os) const;
 
+    /** Number of GDAL worker processes currently processing a request.
+     */
+    unsigned int busyWorkers() const;
+
+    /** Number of threads (of this process) waiting for a response.
+     */
+    unsigned int waiting() const;
+
+    /** Accounts calling thread as waiting for a response during its lifetime
+     *  even when it waits for a warp issued by another thread (e.g. shared
+     *  warp result).
+     */
+    class Waiting {
+    public:
+        Waiting(GdalWarper &warper);
+        ~Waiting();
+
+        Waiting(const Waiting&) = delete;
+        Waiting& operator=(const Waiting&) = delete;
+
+    private:
+        GdalWarper &warper_;
+    };
+
     struct Detail;
 
 private:
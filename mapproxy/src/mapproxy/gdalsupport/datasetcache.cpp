@@ -24,6 +24,8 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <gdal_priv.h>
+
 #include "../error.hpp"
 #include "datasetcache.hpp"
 
@@ -37,3 +39,22 @@ geo::GeoDataset& DatasetCache::operator()(const std::string &path)
     return datasets_.insert(Cache::value_type
                             (path, geo::GeoDataset::open(path))).first->second;
 }
+
+::GDALDataset* DatasetCache::raster(const std::string &path)
+{
+    auto frasters(rasters_.find(path));
+    if (frasters != rasters_.end()) { return frasters->second.get(); }
+
+    std::shared_ptr< ::GDALDataset> ds
+        (static_cast< ::GDALDataset*>
+         (::GDALOpenEx(path.c_str(), (GDAL_OF_RASTER | GDAL_OF_READONLY)
+                       , nullptr, nullptr, nullptr))
+         , [](::GDALDataset *ds) { if (ds) { ::GDALClose(ds); } });
+
+    if (!ds) {
+        LOG(warn1) << "Cannot open raw raster dataset " << path << ".";
+    }
+
+    return rasters_.insert(RawCache::value_type(path, ds))
+        .first->second.get();
+}
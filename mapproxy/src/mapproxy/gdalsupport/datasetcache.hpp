@@ -28,19 +28,30 @@
 #define mapproxy_datasetcache_hpp_included_
 
 #include <map>
+#include <memory>
 
 #include "geo/geodataset.hpp"
 
+// fwd
+class GDALDataset;
+
 class DatasetCache {
 public:
     DatasetCache() : hits_() {}
 
     geo::GeoDataset& operator()(const std::string &path);
 
+    /** Raw GDAL raster dataset for direct block reads. Returns null if
+     *  dataset cannot be opened. Failure is cached as well.
+     */
+    ::GDALDataset* raster(const std::string &path);
+
 private:
     typedef std::map<std::string, geo::GeoDataset> Cache;
+    typedef std::map<std::string, std::shared_ptr< ::GDALDataset>> RawCache;
 
     Cache datasets_;
+    RawCache rasters_;
 
     std::size_t hits_;
 };
@@ -26,6 +26,7 @@
 
 #include <sys/types.h>
 #include <signal.h>
+#include <unistd.h>
 
 #include <new>
 #include <array>
@@ -33,6 +34,8 @@
 #include <thread>
 #include <algorithm>
 
+#include <gdal/gdal.h>
+
 #include <boost/noncopyable.hpp>
 #include <boost/format.hpp>
 #include <boost/asio.hpp>
@@ -47,6 +50,7 @@
 
 #include "../error.hpp"
 #include "../gdalsupport.hpp"
+#include "../support/accounting.hpp"
 #include "process.hpp"
 #include "datasetcache.hpp"
 #include "types.hpp"
@@ -95,6 +99,7 @@ public:
         , error_(sm.get_allocator<char>())
         , errorType_(ErrorType::none)
         , ec_()
+        , worker_(), cpuStart_(), cpuTime_(), cacheStart_(), cacheDelta_()
     {}
 
     ShRequest(const std::string &vectorDs
@@ -115,6 +120,7 @@ public:
         , error_(sm.get_allocator<char>())
         , errorType_(ErrorType::none)
         , ec_()
+        , worker_(), cpuStart_(), cpuTime_(), cacheStart_(), cacheDelta_()
     {}
 
     ShRequest(const GdalWarper::WorkGenerator &workGenerator
@@ -127,6 +133,7 @@ public:
         , error_(sm.get_allocator<char>())
         , errorType_(ErrorType::none)
         , ec_()
+        , worker_(), cpuStart_(), cpuTime_(), cacheStart_(), cacheDelta_()
     {
         work_ = workGenerator(sm);
     }
@@ -158,6 +165,22 @@ public:
     virtual void done_impl();
     void process(bi::interprocess_mutex &mutex, DatasetCache &cache);
 
+    /** Marks start of processing in worker process (for accounting).
+     */
+    void started();
+
+    /** Worker CPU time (ns) and GDAL cache growth (bytes) caused by this
+     *  request. Valid after response.
+     */
+    std::uint64_t cpuTime() const { return cpuTime_; }
+    std::int64_t cacheDelta() const { return cacheDelta_; }
+
+    /** Aligned-grid passthrough outcome of raster request.
+     */
+    Passthrough passthrough() const {
+        return raster_ ? raster_->passthrough() : Passthrough::none;
+    }
+
     static pointer create(const GdalWarper::RasterRequest &req
                           , ManagedBuffer &mb)
     {
@@ -212,12 +235,39 @@ private:
     };
     ErrorType errorType_;
     std::error_code ec_;
+
+    /** Accounting: worker process and its state at processing start.
+     */
+    ::pid_t worker_;
+    std::uint64_t cpuStart_;
+    std::uint64_t cpuTime_;
+    std::int64_t cacheStart_;
+    std::int64_t cacheDelta_;
+
+    /** Marks request as done, measures worker usage.
+     */
+    void finish();
+};
+
+/** Charges worker usage of a request to current accounting record when
+ *  leaving scope (i.e. on failure as well).
+ */
+struct UsageCharger {
+    const ShRequest &req;
+    std::size_t shm;
+
+    UsageCharger(const ShRequest &req) : req(req), shm() {}
+    ~UsageCharger() {
+        Accounting::gdal(req.cpuTime(), shm, req.cacheDelta());
+    }
 };
 
 void ShRequest::process(bi::interprocess_mutex &mutex, DatasetCache &cache)
 {
     if (raster_) {
-        raster_->response(mutex, ::warp(cache, sm_, *raster_));
+        auto passthrough(Passthrough::none);
+        auto *response(::warp(cache, sm_, *raster_, &passthrough));
+        raster_->response(mutex, response, passthrough);
         return;
     }
 
@@ -247,6 +297,26 @@ void ShRequest::process(bi::interprocess_mutex &mutex, DatasetCache &cache)
 
 void ShRequest::done_impl()
 {
+    finish();
+}
+
+void ShRequest::started()
+{
+    worker_ = ::getpid();
+    // worker processes one request at a time, count its helper threads too
+    cpuStart_ = processCpuTime();
+    cacheStart_ = ::GDALGetCacheUsed64();
+}
+
+void ShRequest::finish()
+{
+    // measure only in worker that processes this request
+    if (worker_ && (worker_ == ::getpid())) {
+        cpuTime_ = processCpuTime() - cpuStart_;
+        cacheDelta_ = ::GDALGetCacheUsed64() - cacheStart_;
+        worker_ = 0;
+    }
+
     done_ = true;
     cond_.notify_one();
 }
@@ -264,8 +334,7 @@ void ShRequest::setError(Lock&, const char *message)
     error_.assign(message);
     errorType_ = ErrorType::errorCode;
     ec_ = make_error_code(utility::HttpCode::InternalServerError);
-    done_ = true;
-    cond_.notify_one();
+    finish();
 }
 
 void ShRequest::setError(Lock&, const utility::HttpError &exc)
@@ -274,8 +343,7 @@ void ShRequest::setError(Lock&, const utility::HttpError &exc)
     error_.assign(exc.what());
     errorType_ = ErrorType::errorCode;
     ec_ = exc.code();
-    done_ = true;
-    cond_.notify_one();
+    finish();
 }
 
 void ShRequest::setError(Lock&, const EmptyImage &exc)
@@ -283,8 +351,7 @@ void ShRequest::setError(Lock&, const EmptyImage &exc)
     if (!error_.empty()) { return; }
     error_.assign(exc.what());
     errorType_ = ErrorType::emptyImage;
-    done_ = true;
-    cond_.notify_one();
+    finish();
 }
 
 void ShRequest::setError(Lock&, const FullImage &exc)
@@ -292,8 +359,7 @@ void ShRequest::setError(Lock&, const FullImage &exc)
     if (!error_.empty()) { return; }
     error_.assign(exc.what());
     errorType_ = ErrorType::fullImage;
-    done_ = true;
-    cond_.notify_one();
+    finish();
 }
 
 void ShRequest::setError(Lock&, const EmptyGeoData &exc)
@@ -301,8 +367,7 @@ void ShRequest::setError(Lock&, const EmptyGeoData &exc)
     if (!error_.empty()) { return; }
     error_.assign(exc.what());
     errorType_ = ErrorType::emptyGeoData;
-    done_ = true;
-    cond_.notify_one();
+    finish();
 }
 
 void ShRequest::setError(Lock &lock, const std::exception &e)
@@ -468,13 +533,18 @@ struct Worker {
 
     Process::Id id() const { return process_.id(); }
 
-    void internalError(bi::interprocess_mutex &mutex)
+    /** Fails associated request (if any). Returns true if there was an
+     *  associated request.
+     */
+    bool internalError(bi::interprocess_mutex &mutex)
     {
         Lock lock(mutex);
         if (req_) {
             req_->setError(lock, InternalError
                            ("GDAL warper process unexpectedly terminated"));
+            return true;
         }
+        return false;
     }
 
     static pointer create(ManagedBuffer &mb) {
@@ -493,6 +563,22 @@ private:
     ShRequest::pointer req_;
 };
 
+/** Counts threads waiting for a response.
+ */
+class WaitingGuard {
+public:
+    WaitingGuard(std::atomic<unsigned int> &waiting)
+        : waiting_(waiting)
+    {
+        ++waiting_;
+    }
+
+    ~WaitingGuard() { --waiting_; }
+
+private:
+    std::atomic<unsigned int> &waiting_;
+};
+
 } // namespace
 
 class GdalWarper::Detail
@@ -519,6 +605,12 @@ public:
 
     void stat(std::ostream &os) const;
 
+    unsigned int busyWorkers() const { return *busy_; }
+
+    unsigned int waiting() const { return waiting_; }
+
+    std::atomic<unsigned int>& waitingCounter() { return waiting_; }
+
 private:
     void runManager(Process::Id parentId);
     void start();
@@ -537,13 +629,22 @@ private:
 
     void reportShm();
 
+    static SharedMemory sharedMemory(const Options &options
+                                     , const NumaNode::list &nodes);
+
     Options options_;
+    NumaNode::list numaNodes_;
     utility::Runnable &runnable_;
 
-    bi::mapped_region mem_;
+    SharedMemory mem_;
     ManagedBuffer mb_;
 
     std::atomic<bool> *running_;
+
+    /** Number of workers processing a request.
+     */
+    std::atomic<unsigned int> *busy_;
+
     ShRequest::Deque *queue_;
 
     bi::interprocess_mutex *mutex_;
@@ -553,10 +654,19 @@ private:
 
     Worker::map workers_;
 
+    /** Number of threads waiting for response (process local).
+     */
+    std::atomic<unsigned int> waiting_;
+
     utility::EventCounter warpCounter_;
     utility::EventCounter heightcodeCounter_;
     utility::EventCounter shmCounter_;
     utility::EventCounter queueCounter_;
+
+    /** Aligned-grid passthrough counters (process local).
+     */
+    std::atomic<std::uint64_t> passthroughHits_;
+    std::atomic<std::uint64_t> passthroughFallbacks_;
 };
 
 GdalWarper::GdalWarper(const Options &options, utility::Runnable &runnable)
@@ -594,10 +704,13 @@ void GdalWarper::housekeeping()
 
 GdalWarper::Detail::Detail(const Options &options
                            , utility::Runnable &runnable)
-    : options_(options), runnable_(runnable)
-    , mem_(bi::anonymous_shared_memory(std::size_t(1) << 30))
-    , mb_(bi::create_only, mem_.get_address(), mem_.get_size())
+    : options_(options), numaNodes_(numaNodes())
+    , runnable_(runnable)
+    , mem_(sharedMemory(options_, numaNodes_))
+    , mb_(bi::create_only, mem_.address(), mem_.size())
     , running_(mb_.construct<std::atomic<bool>>(bi::anonymous_instance)(true))
+    , busy_(mb_.construct<std::atomic<unsigned int>>
+            (bi::anonymous_instance)(0))
     , queue_(mb_.construct<ShRequest::Deque>
              (bi::anonymous_instance)
              (mb_.get_allocator<ShRequest>()))
@@ -605,10 +718,13 @@ GdalWarper::Detail::Detail(const Options &options
              (bi::anonymous_instance)())
     , cond_(mb_.construct<bi::interprocess_condition>
             (bi::anonymous_instance)())
+    , waiting_(0)
     , warpCounter_(512)
     , heightcodeCounter_(512)
     , shmCounter_(512)
     , queueCounter_(512)
+    , passthroughHits_(0)
+    , passthroughFallbacks_(0)
 {
     start();
 }
@@ -618,10 +734,24 @@ GdalWarper::Detail::~Detail()
     stop();
 }
 
+SharedMemory
+GdalWarper::Detail::sharedMemory(const Options &options
+                                 , const NumaNode::list &nodes)
+{
+    SharedMemory mem(std::size_t(1) << 30, options.hugePages);
+
+    // must be applied before memory is touched
+    applyMemoryPolicy(mem.address(), mem.size(), options.shmPolicy
+                      , numaNodes(nodes, options.cpus));
+
+    return mem;
+}
+
 void GdalWarper::Detail::runManager(Process::Id parentId)
 {
     dbglog::thread_id("gdal");
     LOG(info2) << "Started GDAL warper manager process.";
+    pinThread(options_.cpus, "gdal");
 
     auto isRunning([&]()
     {
@@ -656,7 +786,10 @@ void GdalWarper::Detail::runManager(Process::Id parentId)
                     LOG(warn2)
                         << "Process " << id << " terminated unexpectedly.";
                 }
-                worker->internalError(mutex());
+                if (worker->internalError(mutex())) {
+                    // died while processing request
+                    --*busy_;
+                }
 
                 // process terminated -> remove
                 iworkers = workers_.erase(iworkers);
@@ -865,6 +998,9 @@ void GdalWarper::Detail::worker(std::size_t id, Process::Id parentId
 {
     dbglog::thread_id(str(boost::format("gdal:%u") % id));
     LOG(info2) << "Spawned GDAL worker id:" << id << ".";
+    pinThread(gdalWorkerCpus(options_.cpus, options_.numaSpread, id
+                             , numaNodes_)
+              , str(boost::format("gdal:%u") % id));
     DatasetCache cache;
 
     geo::Gdal::setOption("GDAL_ERROR_ON_LIBJPEG_WARNING", true);
@@ -900,6 +1036,8 @@ void GdalWarper::Detail::worker(std::size_t id, Process::Id parentId
 
                 // associate request to this worker
                 worker->associate(req);
+                req->started();
+                ++*busy_;
             }
 
             try {
@@ -922,6 +1060,7 @@ void GdalWarper::Detail::worker(std::size_t id, Process::Id parentId
                 // disassociate request from this worker
                 Lock lock(mutex());
                 worker->disassociate();
+                --*busy_;
             }
         } catch (const std::exception &e) {
             LOG(err3)
@@ -942,8 +1081,10 @@ void GdalWarper::Detail::reportShm()
 GdalWarper::Raster GdalWarper::Detail::warp(const RasterRequest &req
                                             , Aborter &aborter)
 {
+    WaitingGuard waitingGuard(waiting_);
     Lock lock(mutex());
     ShRequest::pointer shReq(ShRequest::create(req, mb_));
+    UsageCharger charger(*shReq);
     queue_->push_back(shReq);
 
     cond().notify_one();
@@ -961,10 +1102,18 @@ GdalWarper::Raster GdalWarper::Detail::warp(const RasterRequest &req
     }
 
     auto result(shReq->getRaster(lock));
+    charger.shm = result->total() * result->elemSize();
+    const auto passthrough(shReq->passthrough());
     lock.unlock();
 
     warpCounter_.event();
 
+    switch (passthrough) {
+    case Passthrough::none: break;
+    case Passthrough::hit: ++passthroughHits_; break;
+    case Passthrough::fallback: ++passthroughFallbacks_; break;
+    }
+
     return result;
 }
 
@@ -977,10 +1126,12 @@ GdalWarper::Heightcoded::pointer GdalWarper::Detail
              , const LayerEnhancer::map &layerEnhancers
              , Aborter &aborter)
 {
+    WaitingGuard waitingGuard(waiting_);
     Lock lock(mutex());
     ShRequest::pointer shReq
         (ShRequest::create(vectorDs, rasterDs, config, vectorGeoidGrid
                            , openOptions, layerEnhancers, mb_));
+    UsageCharger charger(*shReq);
     queue_->push_back(shReq);
     cond().notify_one();
 
@@ -997,6 +1148,7 @@ GdalWarper::Heightcoded::pointer GdalWarper::Detail
     }
 
     auto result(shReq->getHeightcoded(lock));
+    charger.shm = result->size;
     lock.unlock();
 
     heightcodeCounter_.event();
@@ -1007,9 +1159,11 @@ GdalWarper::Heightcoded::pointer GdalWarper::Detail
 WorkRequest::Response GdalWarper::Detail
 ::job(const WorkGenerator &workGenerator, Aborter &aborter)
 {
+    WaitingGuard waitingGuard(waiting_);
     Lock lock(mutex());
 
     auto shReq(ShRequest::create(workGenerator, mb_));
+    UsageCharger charger(*shReq);
     queue_->push_back(shReq);
     cond().notify_one();
 
@@ -1036,10 +1190,37 @@ void GdalWarper::Detail::stat(std::ostream &os) const
     heightcodeCounter_.averageAndMax(os, "gdal.heightcode.");
     shmCounter_.max(os, "gdal.shm.used.");
     os << "gdal.shm.total=" << mb_.get_size() << '\n';
+    os << "gdal.shm.pageSize=" << mem_.pageSize() << '\n';
+    os << "gdal.shm.hugePages=" << mem_.hugePages() << '\n';
     queueCounter_.max(os, "gdal.shm.enqueued.");
+    os << "gdal.workers.busy=" << busyWorkers() << '\n';
+    os << "gdal.clients.waiting=" << waiting() << '\n';
+    os << "gdal.passthrough.hits=" << passthroughHits_ << '\n';
+    os << "gdal.passthrough.fallbacks=" << passthroughFallbacks_ << '\n';
 }
 
 void GdalWarper::stat(std::ostream &os) const
 {
     detail().stat(os);
 }
+
+unsigned int GdalWarper::busyWorkers() const
+{
+    return detail().busyWorkers();
+}
+
+unsigned int GdalWarper::waiting() const
+{
+    return detail().waiting();
+}
+
+GdalWarper::Waiting::Waiting(GdalWarper &warper)
+    : warper_(warper)
+{
+    ++warper_.detail().waitingCounter();
+}
+
+GdalWarper::Waiting::~Waiting()
+{
+    --warper_.detail().waitingCounter();
+}
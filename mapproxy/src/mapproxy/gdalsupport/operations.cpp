@@ -28,6 +28,8 @@
 #include <algorithm>
 #include <cstring>
 #include <type_traits>
+#include <future>
+#include <exception>
 
 #include <boost/iostreams/stream_buffer.hpp>
 #include <boost/iostreams/device/array.hpp>
@@ -83,6 +85,110 @@ inline geo::OptionalNodataValue asOptNodata(const geo::NodataValue &nodata)
     return boost::none;
 }
 
+/** Reads tile directly from dataset (or its overview) when tile pixels
+ *  map 1:1 to dataset pixels. Only plain RGB byte datasets with all pixels
+ *  valid qualify. Returns null if not applicable.
+ */
+cv::Mat* passthroughImage(DatasetCache &cache, ManagedBuffer &mb
+                          , const std::string &dataset
+                          , const geo::SrsDefinition &srs
+                          , const math::Extents2 &extents
+                          , const math::Size2 &size)
+{
+    const auto descriptor(cache(dataset).descriptor());
+    const auto k(gridAlignment(extents, srs, size, descriptor));
+    if (k < 0) { return nullptr; }
+
+    auto *ds(cache.raster(dataset));
+    if (!ds || (ds->GetRasterCount() != 3)) { return nullptr; }
+
+    // dataset must be north-up
+    double gt[6];
+    if ((ds->GetGeoTransform(gt) != CE_None)
+        || (gt[2] != 0.0) || (gt[4] != 0.0))
+    {
+        return nullptr;
+    }
+
+    // window in full resolution dataset
+    const int scale(1 << k);
+    const auto des(math::size(descriptor.extents));
+    const math::Size2f px(des.width / descriptor.size.width
+                          , des.height / descriptor.size.height);
+    const int x(int(std::lround((extents.ll(0) - descriptor.extents.ll(0))
+                                / px.width)));
+    const int y(int(std::lround((descriptor.extents.ur(1) - extents.ur(1))
+                                / px.height)));
+
+    if ((x < 0) || (y < 0)
+        || ((x + size.width * scale) > descriptor.size.width)
+        || ((y + size.height * scale) > descriptor.size.height))
+    {
+        return nullptr;
+    }
+
+    // downscaled window must hit overview pixels exactly
+    if (scale > 1) {
+        if ((x % scale) || (y % scale)
+            || (descriptor.size.width % scale)
+            || (descriptor.size.height % scale))
+        {
+            return nullptr;
+        }
+    }
+
+    // RGB -> BGR
+    const ::GDALColorInterp colors[3] = { GCI_RedBand, GCI_GreenBand
+                                          , GCI_BlueBand };
+
+    ::GDALRasterBand *bands[3];
+    for (int i(0); i < 3; ++i) {
+        auto *band(ds->GetRasterBand(i + 1));
+        if ((band->GetRasterDataType() != GDT_Byte)
+            || (band->GetColorInterpretation() != colors[i])
+            || (band->GetMaskFlags() != GMF_ALL_VALID))
+        {
+            return nullptr;
+        }
+
+        if (scale > 1) {
+            // find matching overview
+            ::GDALRasterBand *ovr(nullptr);
+            for (int o(0), oe(band->GetOverviewCount()); o < oe; ++o) {
+                auto *candidate(band->GetOverview(o));
+                if (candidate
+                    && ((candidate->GetXSize() * scale)
+                        == descriptor.size.width)
+                    && ((candidate->GetYSize() * scale)
+                        == descriptor.size.height))
+                {
+                    ovr = candidate;
+                    break;
+                }
+            }
+            if (!ovr) { return nullptr; }
+            band = ovr;
+        }
+
+        bands[i] = band;
+    }
+
+    auto *tile(allocateMat(mb, size, CV_8UC3));
+    for (int i(0); i < 3; ++i) {
+        if (bands[i]->RasterIO(GF_Read, x / scale, y / scale
+                               , size.width, size.height
+                               , tile->data + (2 - i)
+                               , size.width, size.height, GDT_Byte
+                               , 3, 3 * size.width) != CE_None)
+        {
+            mb.deallocate(tile);
+            return nullptr;
+        }
+    }
+
+    return tile;
+}
+
 cv::Mat* warpImage(DatasetCache &cache, ManagedBuffer &mb
                    , const std::string &dataset
                    , const geo::SrsDefinition &srs
@@ -91,8 +197,21 @@ cv::Mat* warpImage(DatasetCache &cache, ManagedBuffer &mb
                    , geo::GeoDataset::Resampling resampling
                    , const boost::optional<std::string> &maskDataset
                    , bool optimize
-                   , const geo::NodataValue &nodata)
+                   , const geo::NodataValue &nodata
+                   , bool aligned, Passthrough *passthrough)
 {
+    // aligned grid: try to read tile without warping; neither external mask
+    // nor forced nodata can be applied this way
+    if (aligned && !maskDataset && !nodata) {
+        if (auto *tile = passthroughImage(cache, mb, dataset, srs
+                                          , extents, size))
+        {
+            if (passthrough) { *passthrough = Passthrough::hit; }
+            return tile;
+        }
+        if (passthrough) { *passthrough = Passthrough::fallback; }
+    }
+
     auto &src(cache(dataset));
     auto dst(geo::GeoDataset::deriveInMemory
              (src, srs, size, extents, boost::none, asOptNodata(nodata)));
@@ -188,13 +307,58 @@ cv::Mat* warpDetailMask(DatasetCache &cache, ManagedBuffer &mb
 
 const auto ForcedNodata(geo::GeoDataset::NodataValue(-1e10f));
 
+inline int demType(GdalWarper::RasterRequest::SampleType sampleType
+                   , int channels = 1)
+{
+    return ((sampleType == GdalWarper::RasterRequest::SampleType::float32)
+            ? CV_MAKETYPE(CV_32F, channels) : CV_MAKETYPE(CV_64F, channels));
+}
+
+/** Combines warped value, minimum and maximum into 3-channel tile.
+ *
+ *  Branch-free per row so that the compiler can vectorize it: invalid
+ *  minimum/maximum is replaced by value, invalid value by average of valid
+ *  minimum and maximum, pixel without value and without both bounds is
+ *  invalid.
+ */
+template <typename T>
+void combineValueMinMaxImpl(cv::Mat &tile, const cv::Mat &d
+                            , const cv::Mat &dmin, const cv::Mat &dmax
+                            , double nodata)
+{
+    for (int j(0); j < tile.rows; ++j) {
+        const auto *id(d.ptr<double>(j));
+        const auto *idmin(dmin.ptr<double>(j));
+        const auto *idmax(dmax.ptr<double>(j));
+        auto *itile(tile.ptr<T>(j));
+
+        for (int i(0), e(tile.cols); i < e; ++i, itile += 3) {
+            const auto v(id[i]), vmin(idmin[i]), vmax(idmax[i]);
+
+            const bool minValid(vmin != nodata);
+            const bool maxValid(vmax != nodata);
+            const bool valid(v != nodata);
+
+            const auto value(valid ? v : (vmin + vmax) / 2);
+            const bool keep(valid || (minValid && maxValid));
+
+            itile[0] = keep ? value : nodata;
+            itile[1] = keep ? (minValid ? std::min(vmin, value) : value)
+                : nodata;
+            itile[2] = keep ? (maxValid ? std::max(vmax, value) : value)
+                : nodata;
+        }
+    }
+}
+
 cv::Mat* warpValueMinMax(DatasetCache &cache, ManagedBuffer &mb
                          , const std::string &dataset
                          , const geo::SrsDefinition &srs
                          , const math::Extents2 &extents
                          , const math::Size2 &size
                          , geo::GeoDataset::Resampling resampling
-                         , const geo::NodataValue &nodata)
+                         , const geo::NodataValue &nodata
+                         , GdalWarper::RasterRequest::SampleType sampleType)
 {
     // combined result of warped dataset and result of warpMinMax
     auto &src(cache(dataset));
@@ -217,61 +381,39 @@ cv::Mat* warpValueMinMax(DatasetCache &cache, ManagedBuffer &mb
 #endif
     warpOptions.workingDataType = GDT_Float32;
 
-    auto wri(src.warpInto(dst, resampling, warpOptions));
-    minSrc.warpInto(minDst, geo::GeoDataset::Resampling::minimum
-                    , warpOptions);
-    maxSrc.warpInto(maxDst, geo::GeoDataset::Resampling::maximum
-                    , warpOptions);
-
-    // combine data
-    auto *tile(allocateMat(mb, size, CV_64FC3));
-    *tile = cv::Scalar(*ForcedNodata, *ForcedNodata, *ForcedNodata);
-
+    // warp min and max in helper threads while warping value in this one;
+    // all three source and destination datasets are distinct
+    auto minWarp(std::async(std::launch::async, [&]()
     {
-        // TODO: use masks (get them as a byte matrices)
-        const auto &d(dst.cdata());
-        const auto &dmin(minDst.cdata());
-        const auto &dmax(maxDst.cdata());
-
-        auto id(d.begin<double>());
-        auto idmin(dmin.begin<double>());
-        auto idmax(dmax.begin<double>());
-
-        for (auto itile(tile->begin<cv::Vec3d>())
-                 , etile(tile->end<cv::Vec3d>());
-             itile != etile; ++itile, ++id, ++idmin, ++idmax)
-        {
-            // skip invalid value
-            auto value(*id);
-            if (value == ForcedNodata) {
-                if ((*idmin == ForcedNodata) || (*idmax == ForcedNodata)) {
-                    continue;
-                }
-                // no value but we have valid min/max -> average
-                value = (*idmin + *idmax) / 2;
-            }
-
-            auto &sample(*itile);
-            sample[0] = value;
-
-            if ((*idmin == ForcedNodata) || (*idmin > value)) {
-                // clone value into minimum if minimum is invalid or above value
-                sample[1] = value;
-            } else {
-                // copy min
-                sample[1] = *idmin;
-            }
-
-            if ((*idmax == ForcedNodata) || (*idmax < value)) {
-                // clone value into maximum if maximum is invalid or below value
-                sample[2] = value;
-            } else {
-                // copy max
-                sample[2] = *idmax;
-            }
+        minSrc.warpInto(minDst, geo::GeoDataset::Resampling::minimum
+                        , warpOptions);
+    }));
+    auto maxWarp(std::async(std::launch::async, [&]()
+    {
+        maxSrc.warpInto(maxDst, geo::GeoDataset::Resampling::maximum
+                        , warpOptions);
+    }));
+
+    // make sure helpers are finished before propagating any error
+    std::exception_ptr error;
+    try {
+        src.warpInto(dst, resampling, warpOptions);
+    } catch (...) {
+        error = std::current_exception();
+    }
+    for (auto *warp : { &minWarp, &maxWarp }) {
+        try {
+            warp->get();
+        } catch (...) {
+            if (!error) { error = std::current_exception(); }
         }
     }
+    if (error) { std::rethrow_exception(error); }
 
+    // combine data
+    auto *tile(allocateMat(mb, size, demType(sampleType, 3)));
+    combineValueMinMax(*tile, dst.cdata(), minDst.cdata(), maxDst.cdata()
+                       , *ForcedNodata);
     return tile;
 }
 
@@ -281,7 +423,8 @@ cv::Mat* warpDem(DatasetCache &cache, ManagedBuffer &mb
                  , const math::Extents2 &extents
                  , const math::Size2 &requestedSize
                  , bool optimize
-                 , const geo::NodataValue &nodata)
+                 , const geo::NodataValue &nodata
+                 , GdalWarper::RasterRequest::SampleType sampleType)
 {
     auto &src(cache(dataset));
 
@@ -316,17 +459,30 @@ cv::Mat* warpDem(DatasetCache &cache, ManagedBuffer &mb
     LOG(info1) << "Warp result: scale=" << wri.scale
                << ", resampling=" << wri.resampling << ".";
 
-    // mask is guaranteed to have single (double) channel
+    // dem is guaranteed to have single (double) channel, convert to
+    // requested type directly into shared memory
     auto &dstMat(dst.cdata());
-    auto *tile(allocateMat(mb, gridSize, dstMat.type()));
-    dstMat.copyTo(*tile);
+    auto *tile(allocateMat(mb, gridSize, demType(sampleType)));
+    dstMat.convertTo(*tile, tile->type());
     return tile;
 }
 
 } // namespace
 
+void combineValueMinMax(cv::Mat &tile, const cv::Mat &value
+                        , const cv::Mat &min, const cv::Mat &max
+                        , double nodata)
+{
+    if (tile.depth() == CV_32F) {
+        combineValueMinMaxImpl<float>(tile, value, min, max, nodata);
+    } else {
+        combineValueMinMaxImpl<double>(tile, value, min, max, nodata);
+    }
+}
+
 cv::Mat* warp(DatasetCache &cache, ManagedBuffer &mb
-              , const GdalWarper::RasterRequest &req)
+              , const GdalWarper::RasterRequest &req
+              , Passthrough *passthrough)
 {
     typedef GdalWarper::RasterRequest::Operation Operation;
 
@@ -336,7 +492,8 @@ cv::Mat* warp(DatasetCache &cache, ManagedBuffer &mb
         return warpImage
             (cache, mb, req.dataset, req.srs, req.extents, req.size
              , req.resampling, req.mask
-             , (req.operation == Operation::image), req.nodata);
+             , (req.operation == Operation::image), req.nodata
+             , req.aligned, passthrough);
 
     case Operation::mask:
     case Operation::maskNoOpt:
@@ -354,12 +511,12 @@ cv::Mat* warp(DatasetCache &cache, ManagedBuffer &mb
         return warpDem
             (cache, mb, req.dataset, req.srs, req.extents, req.size
              , (req.operation == Operation::demOptimal)
-             , req.nodata);
+             , req.nodata, req.sampleType);
 
     case Operation::valueMinMax:
         return warpValueMinMax
             (cache, mb, req.dataset, req.srs, req.extents, req.size
-             , req.resampling, req.nodata);
+             , req.resampling, req.nodata, req.sampleType);
     }
     throw;
 }
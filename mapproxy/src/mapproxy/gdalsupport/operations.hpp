@@ -31,8 +31,20 @@
 #include "types.hpp"
 #include "datasetcache.hpp"
 
+/** Processes raster request. Outcome of aligned-grid passthrough (image
+ *  operations only) is reported in optional passthrough.
+ */
 cv::Mat* warp(DatasetCache &cache, ManagedBuffer &mb
-              , const GdalWarper::RasterRequest &req);
+              , const GdalWarper::RasterRequest &req
+              , Passthrough *passthrough = nullptr);
+
+/** Combines warped value, minimum and maximum (single channel double
+ *  matrices) into preallocated 3-channel (double or float) valueMinMax
+ *  result. Exposed for testing.
+ */
+void combineValueMinMax(cv::Mat &tile, const cv::Mat &value
+                        , const cv::Mat &min, const cv::Mat &max
+                        , double nodata);
 
 GdalWarper::Heightcoded*
 heightcode(DatasetCache &cache, ManagedBuffer &mb
@@ -44,7 +44,10 @@ ShRaster::ShRaster(const GdalWarper::RasterRequest &other
     , resampling_(other.resampling)
     , mask_(sm.get_allocator<char>())
     , nodata_(other.nodata)
+    , sampleType_(other.sampleType)
+    , aligned_(other.aligned)
     , response_()
+    , passthrough_(Passthrough::none)
 {
     if (other.mask) {
         mask_.assign(other.mask->data(), other.mask->size());
@@ -61,7 +64,8 @@ ShRaster::operator GdalWarper::RasterRequest() const {
          , std::string(dataset_.data(), dataset_.size())
          , geo::SrsDefinition(asString(srs_), srsType_)
          , extents_, size_, resampling_
-         , asOptional(mask_)).setNodata(nodata_);
+         , asOptional(mask_)).setNodata(nodata_)
+        .setSampleType(sampleType_).setAligned(aligned_);
 }
 
 cv::Mat* ShRaster::response() {
@@ -71,11 +75,13 @@ cv::Mat* ShRaster::response() {
 }
 
 
-void ShRaster::response(bi::interprocess_mutex &mutex, cv::Mat *response)
+void ShRaster::response(bi::interprocess_mutex &mutex, cv::Mat *response
+                        , Passthrough passthrough)
 {
     Lock lock(mutex);
     if (response_) { return; }
     response_ = response;
+    passthrough_ = passthrough;
     owner_->done();
 }
 
@@ -42,7 +42,12 @@ public:
     /** Steals response.
      */
     cv::Mat* response();
-    void response(bi::interprocess_mutex &mutex, cv::Mat *response);
+    void response(bi::interprocess_mutex &mutex, cv::Mat *response
+                  , Passthrough passthrough = Passthrough::none);
+
+    /** Passthrough outcome of processed request.
+     */
+    Passthrough passthrough() const { return passthrough_; }
 
 private:
     ManagedBuffer &sm_;
@@ -57,9 +62,12 @@ private:
     geo::GeoDataset::Resampling resampling_;
     String mask_;
     boost::optional<double> nodata_;
+    GdalWarper::RasterRequest::SampleType sampleType_;
+    bool aligned_;
 
     // response matrix
     cv::Mat *response_;
+    Passthrough passthrough_;
 };
 
 class ShHeightCodeConfig {
@@ -0,0 +1,168 @@
+/**
+ * Copyright (c) 2019 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <limits>
+#include <string>
+#include <fstream>
+#include <system_error>
+
+#include <boost/algorithm/string/predicate.hpp>
+
+#include "dbglog/dbglog.hpp"
+
+#include "sharedmemory.hpp"
+
+namespace ba = boost::algorithm;
+
+namespace {
+
+std::size_t regularPageSize()
+{
+    return ::sysconf(_SC_PAGESIZE);
+}
+
+/** Default hugetlb page size (from /proc/meminfo), 0 if unknown.
+ */
+std::size_t hugetlbPageSize()
+{
+    std::ifstream f("/proc/meminfo");
+    std::string key;
+    while (f >> key) {
+        if (key == "Hugepagesize:") {
+            std::size_t kb(0);
+            f >> kb;
+            return kb * 1024;
+        }
+        f.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+    }
+    return 0;
+}
+
+/** Transparent huge page size applicable to shared memory mapped with
+ *  MADV_HUGEPAGE, 0 if THP is disabled for shared memory.
+ */
+std::size_t thpShmemPageSize()
+{
+    std::string mode;
+    {
+        std::ifstream f("/sys/kernel/mm/transparent_hugepage/shmem_enabled");
+        std::getline(f, mode);
+    }
+
+    if (!(ba::contains(mode, "[always]") || ba::contains(mode, "[advise]")
+          || ba::contains(mode, "[within_size]")))
+    {
+        return 0;
+    }
+
+    std::size_t size(0);
+    std::ifstream f("/sys/kernel/mm/transparent_hugepage/hpage_pmd_size");
+    f >> size;
+    return size;
+}
+
+void* mapShared(std::size_t size, int flags)
+{
+    auto *address(::mmap(nullptr, size, PROT_READ | PROT_WRITE
+                         , MAP_SHARED | MAP_ANONYMOUS | flags, -1, 0));
+    return (address == MAP_FAILED) ? nullptr : address;
+}
+
+} // namespace
+
+SharedMemory::SharedMemory(std::size_t size, HugePages hugePages)
+    : address_(), size_(size), pageSize_(regularPageSize())
+    , hugePages_(HugePages::none)
+{
+    if ((hugePages == HugePages::hugetlb)
+        || (hugePages == HugePages::auto_))
+    {
+        if (const auto ps = hugetlbPageSize()) {
+            // round size up to page size
+            const auto hsize(((size + ps - 1) / ps) * ps);
+            if ((address_ = mapShared(hsize, MAP_HUGETLB))) {
+                size_ = hsize;
+                pageSize_ = ps;
+                hugePages_ = HugePages::hugetlb;
+            } else {
+                std::system_error e(errno, std::system_category());
+                LOG(warn3)
+                    << "Unable to map " << hsize << " bytes of explicit "
+                    "huge pages (not enough reserved pages?): <"
+                    << e.what() << ">; falling back.";
+            }
+        } else {
+            LOG(warn3) << "Explicit huge pages not supported; falling back.";
+        }
+    }
+
+    if (!address_) {
+        if (!(address_ = mapShared(size_, 0))) {
+            std::system_error e(errno, std::system_category());
+            LOGTHROW(err3, std::system_error)
+                << "Unable to map " << size_ << " bytes of shared memory: <"
+                << e.what() << ">.";
+        }
+
+        if ((hugePages == HugePages::transparent)
+            || (hugePages == HugePages::auto_))
+        {
+            const auto ps(thpShmemPageSize());
+            if (::madvise(address_, size_, MADV_HUGEPAGE) == -1) {
+                std::system_error e(errno, std::system_category());
+                LOG(warn3) << "Transparent huge pages not available: <"
+                           << e.what() << ">; using regular pages.";
+            } else if (!ps) {
+                LOG(warn3) << "Transparent huge pages are disabled for "
+                    "shared memory (see /sys/kernel/mm/transparent_hugepage/"
+                    "shmem_enabled); using regular pages.";
+            } else {
+                pageSize_ = ps;
+                hugePages_ = HugePages::transparent;
+            }
+        }
+    }
+
+    LOG(info3) << "Mapped " << size_ << " bytes of shared memory, "
+               << hugePages_ << " huge pages, page size "
+               << pageSize_ << " bytes.";
+}
+
+SharedMemory::SharedMemory(SharedMemory &&other)
+    : address_(other.address_), size_(other.size_)
+    , pageSize_(other.pageSize_), hugePages_(other.hugePages_)
+{
+    other.address_ = nullptr;
+}
+
+SharedMemory::~SharedMemory()
+{
+    if (address_) { ::munmap(address_, size_); }
+}
@@ -0,0 +1,80 @@
+/**
+ * Copyright (c) 2019 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef mapproxy_gdalsupport_sharedmemory_hpp_included_
+#define mapproxy_gdalsupport_sharedmemory_hpp_included_
+
+#include <cstddef>
+
+#include "utility/enum-io.hpp"
+
+/** Huge page backing of shared memory:
+ *
+ *  * none: regular pages
+ *  * transparent: regular mapping advised to use transparent huge pages
+ *                 (effective only if enabled for shared memory by kernel)
+ *  * hugetlb: explicit huge pages (MAP_HUGETLB), needs reserved pages
+ *  * auto: tries hugetlb, then transparent
+ *
+ *  Requested mode falls back gracefully to regular pages.
+ */
+UTILITY_GENERATE_ENUM(HugePages,
+    ((none))
+    ((transparent))
+    ((hugetlb))
+    ((auto_)("auto"))
+)
+
+/** Anonymous shared memory segment shared with forked processes.
+ */
+class SharedMemory {
+public:
+    SharedMemory(std::size_t size, HugePages hugePages = HugePages::none);
+    SharedMemory(SharedMemory &&other);
+    ~SharedMemory();
+
+    SharedMemory(const SharedMemory&) = delete;
+    SharedMemory& operator=(const SharedMemory&) = delete;
+
+    void* address() const { return address_; }
+    std::size_t size() const { return size_; }
+
+    /** Effective page size.
+     */
+    std::size_t pageSize() const { return pageSize_; }
+
+    /** Effective huge page mode (none, transparent or hugetlb).
+     */
+    HugePages hugePages() const { return hugePages_; }
+
+private:
+    void* address_;
+    std::size_t size_;
+    std::size_t pageSize_;
+    HugePages hugePages_;
+};
+
+#endif // mapproxy_gdalsupport_sharedmemory_hpp_included_
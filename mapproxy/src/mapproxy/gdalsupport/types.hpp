@@ -108,6 +108,10 @@ asOptional(const ShSrsDefinition &srs)
     return geo::SrsDefinition(srs);
 }
 
+/** Outcome of aligned-grid passthrough of an image warp request.
+ */
+enum class Passthrough { none, hit, fallback };
+
 struct ConstBlock {
     const char *data;
     std::size_t size;
@@ -33,6 +33,7 @@
 #include <iostream>
 #include <atomic>
 #include <cstdint>
+#include <ctime>
 
 #include <boost/noncopyable.hpp>
 #include <boost/any.hpp>
@@ -252,8 +253,22 @@ protected:
     void makeReady();
     bool fresh() const { return fresh_; }
 
+    /** Writes serialized map configuration.
+     *
+     *  Serialized output is cached per root. Cached value is used while this
+     *  resource's revision and all generators looked up (via otherGenerator)
+     *  while building it stay the same (i.e. none is replaced, appears or
+     *  disappears).
+     */
     void mapConfig(std::ostream &os, ResourceRoot root) const;
 
+    /** Serialized map configuration shared between requests (cached as
+     *  described above). Time of serialization is stored in built (if set).
+     */
+    std::shared_ptr<const std::string>
+    serializedMapConfig(ResourceRoot root, std::time_t *built = nullptr)
+        const;
+
     std::string absoluteDataset(const std::string &path) const;
     boost::filesystem::path
     absoluteDataset(const boost::filesystem::path &path) const;
@@ -323,6 +338,9 @@ private:
     DemRegistry::pointer demRegistry_;
     Generator::pointer replace_;
     std::unique_ptr<Provider> provider_;
+
+    struct MapConfigCache;
+    std::shared_ptr<MapConfigCache> mapConfigCache_;
 };
 
 /** Set of dataset generators.
@@ -429,20 +447,6 @@ inline GeneratorFinder::findGenerator(Resource::Generator::Type generatorType
     return findGenerator_impl(generatorType, resourceId, mustBeReady);
 }
 
-inline Generator::pointer
-Generator::otherGenerator(Resource::Generator::Type generatorType
-                          , const Resource::Id &resourceId
-                          , bool mustBeReady, bool mandatory)
-    const
-{
-    auto other(generatorFinder_->findGenerator
-               (generatorType, resourceId, mustBeReady));
-    if (!other && mandatory) {
-        throw GeneratorNotFound(generatorType, resourceId);
-    }
-    return other;
-}
-
 template <typename ProviderType>
 ProviderType* Generator::getProvider() const
 {
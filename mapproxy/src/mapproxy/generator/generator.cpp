@@ -25,6 +25,7 @@
  */
 
 #include <thread>
+#include <mutex>
 #include <condition_variable>
 #include <sstream>
 #include <deque>
@@ -59,8 +60,76 @@ namespace {
 
 const std::string ResourceFile("resource.json");
 
+/** Generator lookup performed while building map configuration.
+ */
+struct Dependency {
+    Resource::Generator::Type type;
+    Resource::Id id;
+    bool mustBeReady;
+    bool found;
+    std::weak_ptr<Generator> generator;
+    unsigned int revision;
+
+    Dependency(Resource::Generator::Type type, const Resource::Id &id
+               , bool mustBeReady, const Generator::pointer &generator)
+        : type(type), id(id), mustBeReady(mustBeReady), found(generator)
+        , generator(generator)
+        , revision(generator ? generator->resource().revision : 0)
+    {}
+
+    typedef std::vector<Dependency> list;
+};
+
+/** Dependencies being recorded by calling thread.
+ */
+thread_local Dependency::list *recordedDependencies(nullptr);
+
+/** Records generator lookups made by calling thread during its lifetime.
+ *  Nested recorders propagate their dependencies to the outer one.
+ */
+class DependencyRecorder {
+public:
+    DependencyRecorder(Dependency::list &dependencies)
+        : dependencies_(dependencies), saved_(recordedDependencies)
+    {
+        recordedDependencies = &dependencies_;
+    }
+
+    ~DependencyRecorder() {
+        recordedDependencies = saved_;
+        if (saved_) {
+            saved_->insert(saved_->end(), dependencies_.begin()
+                           , dependencies_.end());
+        }
+    }
+
+private:
+    Dependency::list &dependencies_;
+    Dependency::list *saved_;
+};
+
 } // namespace
 
+struct Generator::MapConfigCache {
+    struct Entry {
+        unsigned int revision;
+        Dependency::list dependencies;
+        std::shared_ptr<const std::string> serialized;
+        std::time_t built;
+
+        typedef std::shared_ptr<const Entry> pointer;
+    };
+
+    typedef std::pair<int, int> Key;
+
+    std::mutex mutex;
+    std::map<Key, Entry::pointer> entries;
+
+    static Key key(const ResourceRoot &root) {
+        return Key(root.depth, root.backup);
+    }
+};
+
 void Generator::registerType(const Resource::Generator &type
                              , const Factory::pointer &factory)
 {
@@ -93,6 +162,7 @@ Generator::Generator(const Params &params, const Properties &properties)
     , ready_(false), readySince_(0)
     , demRegistry_(params.demRegistry)
     , replace_(params.replace)
+    , mapConfigCache_(std::make_shared<MapConfigCache>())
 {
     config_.root = (config_.root / resource_.id.referenceFrame
                     / resource_.id.group / resource_.id.id);
@@ -196,8 +266,84 @@ void Generator::makeReady()
 void Generator::mapConfig(std::ostream &os, ResourceRoot root)
     const
 {
-    vts::MapConfig mc(mapConfig(root));
-    vts::saveMapConfig(mc, os);
+    os << *serializedMapConfig(root);
+}
+
+std::shared_ptr<const std::string>
+Generator::serializedMapConfig(ResourceRoot root, std::time_t *built) const
+{
+    auto &cache(*mapConfigCache_);
+    const auto key(MapConfigCache::key(root));
+
+    MapConfigCache::Entry::pointer cached;
+    {
+        std::unique_lock<std::mutex> lock(cache.mutex);
+        auto fentries(cache.entries.find(key));
+        if (fentries != cache.entries.end()) { cached = fentries->second; }
+    }
+
+    const auto valid([&](const MapConfigCache::Entry &entry) -> bool
+    {
+        if (entry.revision != resource_.revision) { return false; }
+
+        for (const auto &dep : entry.dependencies) {
+            const auto current(generatorFinder_->findGenerator
+                               (dep.type, dep.id, dep.mustBeReady));
+            if (bool(current) != dep.found) { return false; }
+            if (!current) { continue; }
+            if (current != dep.generator.lock()) { return false; }
+            if (current->resource().revision != dep.revision) {
+                return false;
+            }
+        }
+        return true;
+    });
+
+    if (cached && valid(*cached)) {
+        if (built) { *built = cached->built; }
+        return cached->serialized;
+    }
+
+    auto entry(std::make_shared<MapConfigCache::Entry>());
+    entry->revision = resource_.revision;
+    {
+        DependencyRecorder recorder(entry->dependencies);
+        vts::MapConfig mc(mapConfig(root));
+        std::ostringstream tmp;
+        vts::saveMapConfig(mc, tmp);
+        entry->serialized = std::make_shared<const std::string>(tmp.str());
+        entry->built = std::time(nullptr);
+    }
+
+    LOG(info1) << "Built map configuration of <" << id() << "> (root "
+               << root.depth << "/" << root.backup << ", "
+               << entry->dependencies.size() << " dependencies).";
+
+    if (built) { *built = entry->built; }
+
+    std::unique_lock<std::mutex> lock(cache.mutex);
+    cache.entries[key] = entry;
+    return entry->serialized;
+}
+
+Generator::pointer
+Generator::otherGenerator(Resource::Generator::Type generatorType
+                          , const Resource::Id &resourceId
+                          , bool mustBeReady, bool mandatory)
+    const
+{
+    auto other(generatorFinder_->findGenerator
+               (generatorType, resourceId, mustBeReady));
+
+    if (recordedDependencies) {
+        recordedDependencies->emplace_back
+            (generatorType, resourceId, mustBeReady, other);
+    }
+
+    if (!other && mandatory) {
+        throw GeneratorNotFound(generatorType, resourceId);
+    }
+    return other;
 }
 
 namespace {
@@ -153,6 +153,19 @@ GeodataVectorTiled::GeodataVectorTiled(const Params &params)
                 fs::rename(tmpPath, deliveryIndexPath);
             }
 
+            if (definition_.heightTableLod) {
+                const auto heightTablePath(root() / "height.table");
+                if (mmapped::HeightTable::readStamp(heightTablePath)
+                    != heightTableStamp(resource()))
+                {
+                    // stale or missing height table, recomputed in prepare
+                    LOG(info1) << "Generator for <" << id() << "> not ready "
+                               << "(height table is out of date).";
+                    return;
+                }
+                heightTable_ = boost::in_place(heightTablePath);
+            }
+
             // load delivery index
             index_ = boost::in_place(referenceFrame().metaBinaryOrder
                                      , deliveryIndexPath);
@@ -166,7 +179,7 @@ GeodataVectorTiled::GeodataVectorTiled(const Params &params)
     LOG(info1) << "Generator for <" << id() << "> not ready.";
 }
 
-void GeodataVectorTiled::prepare_impl(Arsenal&)
+void GeodataVectorTiled::prepare_impl(Arsenal &arsenal)
 {
     LOG(info2) << "Preparing <" << id() << ">.";
 
@@ -198,6 +211,15 @@ void GeodataVectorTiled::prepare_impl(Arsenal&)
         index_ = boost::in_place(referenceFrame().metaBinaryOrder
                                  , deliveryIndexPath);
     }
+
+    heightTable_ = boost::none;
+    if (definition_.heightTableLod) {
+        const auto heightTablePath(root() / "height.table");
+        prepareHeightTable(heightTablePath, *definition_.heightTableLod
+                           , arsenal, r, *index_, dem_.dataset
+                           , dem_.geoidGrid);
+        heightTable_ = boost::in_place(heightTablePath);
+    }
 }
 
 vr::FreeLayer GeodataVectorTiled::freeLayer_impl(ResourceRoot root) const
@@ -290,7 +312,9 @@ void GeodataVectorTiled::generateMetatile(Sink &sink
                   (fi.tileId, sink, arsenal, resource()
                    , index_->tileIndex, dem_.dataset
                    , dem_.geoidGrid
-                   , MaskTree(), definition_.displaySize));
+                   , MaskTree(), definition_.displaySize
+                   , HeightFunction::pointer(), {}
+                   , heightTable_.get_ptr()));
 
     // write metatile to stream
     std::ostringstream os;
@@ -34,6 +34,7 @@
 #include "vts-libs/vts/urltemplate.hpp"
 
 #include "../support/mmapped/tilesetindex.hpp"
+#include "../support/mmapped/heighttable.hpp"
 #include "geodatavectorbase.hpp"
 
 namespace generator {
@@ -73,6 +74,10 @@ private:
     const vr::Srs &physicalSrs_;
 
     boost::optional<mmapped::Index> index_;
+
+    /** Precomputed per-tile heights. Only when configured.
+     */
+    boost::optional<mmapped::HeightTable> heightTable_;
 };
 
 } // namespace generator
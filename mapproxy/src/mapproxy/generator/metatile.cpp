@@ -24,14 +24,28 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <atomic>
+#include <sstream>
+
+#include <boost/filesystem.hpp>
+
 #include "utility/raise.hpp"
+#include "utility/path.hpp"
+
+#include "jsoncpp/json.hpp"
+#include "jsoncpp/io.hpp"
+
+#include "vts-libs/vts/tileop.hpp"
 
 #include "../support/metatile.hpp"
 #include "../support/geo.hpp"
 #include "../support/grid.hpp"
+#include "../support/demraster.hpp"
 #include "../support/srs.hpp"
 #include "../support/mesh.hpp"
 
+#include "../localsink.hpp"
+
 #include "metatile.hpp"
 
 namespace {
@@ -46,8 +60,23 @@ const int metatileSamplesPerTileBinLog(3);
 // real size computed from binary logarithm above
 const int metatileSamplesPerTile(1 << metatileSamplesPerTileBinLog);
 
+/** NOTICE: increment each time some height table related bug is fixed.
+ */
+int GeneratorRevision(0);
+
 typedef vs::Range<double> HeightRange;
 
+typedef mmapped::HeightTable::Node HeightTableNode;
+
+/** Height table usage counters (metatile blocks).
+ */
+struct HeightTableStat {
+    std::atomic<std::uint64_t> hits;
+    std::atomic<std::uint64_t> misses;
+
+    HeightTableStat() : hits(0), misses(0) {}
+} heightTableCounters;
+
 /** One sample in metatile.
  */
 struct Sample {
@@ -98,14 +127,14 @@ inline bool validSample(double value)
 
 class ValueMinMaxSampler {
 public:
-    ValueMinMaxSampler(const GdalWarper::Raster &dem
+    ValueMinMaxSampler(const cv::Mat &dem
                        , const HeightFunction::pointer &heightFunction)
         : dem_(dem), heightFunction_(heightFunction)
     {}
 
     boost::optional<cv::Vec3d> operator()(int i, int j) const {
         // first, try exact value
-        const auto &v(dem_->at<cv::Vec3d>(j, i));
+        const auto v(demValueMinMax(dem_, i, j));
         if (validSample(v[0])) { return applyHeightFunction(v); }
 
         // output vector and count of valid samples
@@ -120,11 +149,11 @@ public:
 
                 auto x(i + ii), y(j + jj);
                 // check bounds
-                if ((x < 0) || (x >= dem_->cols)
-                    || (y < 0) || (y >= dem_->rows))
+                if ((x < 0) || (x >= dem_.cols)
+                    || (y < 0) || (y >= dem_.rows))
                     { continue; }
 
-                const auto &v(dem_->at<cv::Vec3d>(y, x));
+                const auto v(demValueMinMax(dem_, x, y));
                 if (validSample(v[0])) {
                     out[0] += v[0];
                     out[1] = std::min(out[1], v[1]);
@@ -149,7 +178,7 @@ private:
         return std::move(value);
     }
 
-    GdalWarper::Raster dem_;
+    const cv::Mat &dem_;
     const HeightFunction::pointer &heightFunction_;
 };
 
@@ -180,7 +209,9 @@ metatileFromDemImpl(const vts::TileId &tileId, Sink &sink, Arsenal &arsenal
                     , const MaskTree &maskTree
                     , const boost::optional<int> &displaySize
                     , const HeightFunction::pointer &heightFunction
-                    , const MetatileOverrides &overrides)
+                    , const MetatileOverrides &overrides
+                    , const mmapped::HeightTable *heightTable
+                    , mmapped::HeightTable::Writer *heightTableWriter)
 {
     auto blocks(metatileBlocks(resource, tileId));
 
@@ -250,10 +281,114 @@ metatileFromDemImpl(const vts::TileId &tileId, Sink &sink, Arsenal &arsenal
         }
     });
 
+    // builds metanode from precomputed per-tile values
+    auto buildNode([&](const MetatileBlock &block, const vts::TileId &nodeId
+                       , const HeightTableNode &n) -> void
+    {
+        vts::MetaNode node;
+        node.flags(ti2metaFlags(tileIndex.get(nodeId)));
+        bool geometry(node.geometry());
+
+        node.geomExtents.z.min = n.geomMin;
+        node.geomExtents.z.max = n.geomMax;
+        node.geomExtents.surrogate = n.geomSurrogate;
+
+        // build children from tile index
+        setChildren(block, nodeId, node);
+
+        // set extents
+        node.extents = vr::normalizedExtents
+            (rf, math::Extents3
+             (math::Point3(n.extents[0], n.extents[1], n.extents[2])
+              , math::Point3(n.extents[3], n.extents[4], n.extents[5])));
+
+        // build height range
+        node.heightRange.min = std::floor(n.heightMin);
+        node.heightRange.max = std::ceil(n.heightMax);
+
+        if (!n.triangleCount) {
+            // reset content flags
+            node.geometry(geometry = false);
+            node.navtile(false);
+            // reset geom extents
+            node.geomExtents = {};
+        }
+
+        // calculate texel size and surrogate
+        if (geometry) {
+            // set credits
+            node.updateCredits(credits);
+
+            // texturing
+            node.internalTextureCount(internalTextureCount);
+
+            if (displaySize) {
+                // use display size
+                node.applyDisplaySize(true);
+                node.displaySize = *displaySize;
+            } else {
+                // use texel size
+                node.applyTexelSize(true);
+
+                // calculate texture size using node mask
+                auto textureArea([&]() -> double
+                {
+                    math::Size2 size(metatileSamplesPerTile
+                                     , metatileSamplesPerTile);
+
+                    // return scaled coverage; NB: triangle covers half
+                    // of pixel so real area is in pixels is half of
+                    // number of pixels
+                    return ((n.triangleCount * vr::BoundLayer::tileArea())
+                            / (2.0 * math::area(size)));
+                }());
+
+                // calculate texel size
+                node.texelSize = std::sqrt(n.area / textureArea);
+            }
+
+            // surrogate
+            if (n.avgHeightCount) {
+                node.geomExtents.surrogate
+                    = (n.avgHeightSum / n.avgHeightCount);
+            }
+        }
+
+        // store metata node
+        metatile.set(nodeId, node);
+    });
+
+    // generates block from height table, fails if any node is missing
+    auto generateFromTable([&](const MetatileBlock &block
+                               , const math::Size2 &bSize) -> bool
+    {
+        const auto &view(block.view);
+        std::vector<const HeightTableNode*> nodes;
+        nodes.reserve(math::area(bSize));
+        for (int j(0), je(bSize.height); j < je; ++j) {
+            for (int i(0), ie(bSize.width); i < ie; ++i) {
+                const auto *n(heightTable->find
+                              (vts::TileId(tileId.lod, view.ll(0) + i
+                                           , view.ll(1) + j)));
+                if (!n) { return false; }
+                nodes.push_back(n);
+            }
+        }
+
+        auto inodes(nodes.begin());
+        for (int j(0), je(bSize.height); j < je; ++j) {
+            for (int i(0), ie(bSize.width); i < ie; ++i) {
+                buildNode(block, vts::TileId(tileId.lod, view.ll(0) + i
+                                             , view.ll(1) + j)
+                          , **inodes++);
+            }
+        }
+        return true;
+    });
+
     for (const auto &block : blocks) {
         const auto &view(block.view);
         auto extents = block.extents;
-        const auto es(math::size(extents));
         const math::Size2 bSize(vts::tileRangesSize(view));
 
         if (!block.commonAncestor.productive()) {
@@ -262,9 +397,16 @@ metatileFromDemImpl(const vts::TileId &tileId, Sink &sink, Arsenal &arsenal
             continue;
         }
 
-        const math::Size2 gridSize
-            (bSize.width * metatileSamplesPerTile + 1
-             , bSize.height * metatileSamplesPerTile + 1);
+        if (heightTable && (tileId.lod <= heightTable->bottomLod())) {
+            if (generateFromTable(block, bSize)) {
+                // precomputed, no need to warp
+                ++heightTableCounters.hits;
+                continue;
+            }
+            ++heightTableCounters.misses;
+        }
+
+        const auto gridSize(metatileGridSize(block));
 
         LOG(info1) << "Processing metatile block ["
                    << vts::tileId(tileId.lod, block.view.ll)
@@ -297,180 +439,186 @@ metatileFromDemImpl(const vts::TileId &tileId, Sink &sink, Arsenal &arsenal
                    , extentsPlusHalfPixel
                    (extents, { gridSize.width - 1, gridSize.height - 1 })
                    , gridSize, resampling)
+                  .setSampleType
+                  (GdalWarper::RasterRequest::SampleType::float32)
                   , sink));
 
         sink.checkAborted();
 
-        Grid<Sample> grid(gridSize);
-
-        // tile size in grid and in real SDS
-        math::Size2f gts
-            (es.width / (metatileSamplesPerTile * bSize.width)
-             , es.height / (metatileSamplesPerTile * bSize.height));
-        math::Size2f ts(es.width / bSize.width
-                        , es.height / bSize.height);
-
-        auto conv(sds2phys(block.commonAncestor, geoidGrid));
-        auto navConv(sds2nav(block.commonAncestor, geoidGrid));
-        auto geConv(sdsg2sdsr(block.commonAncestor, geoidGrid));
-
-        // grid mask
-        const ShiftMask rfmask(block, metatileSamplesPerTile, maskTree);
-
-        // fill in grid
-        ValueMinMaxSampler vmm(dem, heightFunction);
-        for (int j(0), je(gridSize.height); j < je; ++j) {
-            auto y(extents.ur(1) - j * gts.height);
-            for (int i(0), ie(gridSize.width); i < ie; ++i) {
-                // work only with pixels not masked by combined mask
-                if (!rfmask(i, j)) { continue; }
-
-                auto value(vmm(i, j));
-
-                // skip out invalid data
-                if (!value) { continue; }
-
-                auto x(extents.ll(0) + i * gts.width);
-
-                // compute all 3 world points (value, min, max) and height range
-                // in navigation space
-                grid(i, j) = { x, y, *value, conv, navConv, geConv };
+        // per-node tile index flags
+        std::vector<TiFlag::value_type> flags;
+        flags.reserve(math::area(bSize));
+        for (int j(0), je(bSize.height); j < je; ++j) {
+            for (int i(0), ie(bSize.width); i < ie; ++i) {
+                flags.push_back(tileIndex.get
+                                (vts::TileId(tileId.lod, view.ll(0) + i
+                                             , view.ll(1) + j)));
             }
         }
 
+        const auto nodes(sampleMetatileBlock(block, *dem, flags, maskTree
+                                             , geoidGrid, heightFunction));
+
         // release shared data
         dem.reset();
 
         // generate metatile content
+        auto inodes(nodes.begin());
         for (int j(0), je(bSize.height); j < je; ++j) {
             for (int i(0), ie(bSize.width); i < ie; ++i) {
                 // ID of current tile
                 const vts::TileId nodeId
                     (tileId.lod, view.ll(0) + i, view.ll(1) + j);
+                const auto &n(*inodes++);
 
-                // build metanode
-                vts::MetaNode node;
-                node.flags(ti2metaFlags(tileIndex.get(nodeId)));
-                bool geometry(node.geometry());
-                bool navtile(node.navtile());
-
-                // compute tile extents and height range
-                auto heightRange(HeightRange::emptyRange());
-                math::Extents3 te(math::InvalidExtents{});
-                double area(0.0);
-                int triangleCount(0);
-                double avgHeightSum(0.f);
-                int avgHeightCount(0);
-
-                // process all node's vertices in grid
-                for (int jj(0); jj <= metatileSamplesPerTile; ++jj) {
-                    auto yy(j * metatileSamplesPerTile + jj);
-                    for (int ii(0); ii <= metatileSamplesPerTile; ++ii) {
-                        auto xx(i * metatileSamplesPerTile + ii);
-
-                        const auto *p(getSample(grid(xx, yy)));
-
-                        // update tile extents (if sample valid)
-                        if (p) {
-                            // update by both minimum and maximum
-                            math::update(te, p->min);
-                            math::update(te, p->max);
-                            vts::update(node.geomExtents, p->ge);
-                            avgHeightSum += p->ge.surrogate;
-                            ++avgHeightCount;
-                        }
-
-                        if (geometry && ii && jj) {
-                            // compute area of the quad composed of 1 or 2
-                            // triangles
-                            auto qa(quadArea
-                                    (getValue(grid(xx - 1, yy - 1))
-                                     , getValue(p)
-                                     , getValue(grid(xx - 1, yy))
-                                     , getValue(grid(xx, yy - 1))));
-                            area += std::get<0>(qa);
-                            triangleCount += std::get<1>(qa);
-                        }
-
-                        if (p && navtile) {
-                            heightRange
-                                = vs::unite(heightRange, p->heightRange);
-                        }
-                    }
-                }
+                if (heightTableWriter) { heightTableWriter->add(nodeId, n); }
 
-                // build children from tile index
-                setChildren(block, nodeId, node);
+                buildNode(block, nodeId, n);
+            }
+        }
+    }
 
-                // set extents
-                node.extents = vr::normalizedExtents(rf, te);
-
-                // build height range
-                node.heightRange.min = std::floor(heightRange.min);
-                node.heightRange.max = std::ceil(heightRange.max);
-
-                if (!triangleCount) {
-                    // reset content flags
-                    node.geometry(geometry = false);
-                    node.navtile(navtile = false);
-                    // reset height range
-                    heightRange = heightRange.emptyRange();
-                    // reset geom extents
-                    node.geomExtents = {};
-                }
+    return metatile;
+}
+
+} // namespace
+
+math::Size2 metatileGridSize(const MetatileBlock &block)
+{
+    const math::Size2 bSize(vts::tileRangesSize(block.view));
+    return math::Size2(bSize.width * metatileSamplesPerTile + 1
+                       , bSize.height * metatileSamplesPerTile + 1);
+}
 
-                // calculate texel size and surrogate
-                if (geometry) {
-                    // set credits
-                    node.updateCredits(credits);
-
-                    // texturing
-                    node.internalTextureCount(internalTextureCount);
-
-                    if (displaySize) {
-                        // use display size
-                        node.applyDisplaySize(true);
-                        node.displaySize = *displaySize;
-                    } else {
-                        // use texel size
-                        node.applyTexelSize(true);
-
-                        // calculate texture size using node mask
-                        auto textureArea([&]() -> double
-                        {
-                            math::Size2 size(metatileSamplesPerTile
-                                             , metatileSamplesPerTile);
-
-                            // return scaled coverage; NB: triangle covers half
-                            // of pixel so real area is in pixels is half of
-                            // number of pixels
-                            return ((triangleCount
-                                     * vr::BoundLayer::tileArea())
-                                    / (2.0 * math::area(size)));
-                        }());
-
-                        // calculate texel size
-                        node.texelSize = std::sqrt(area / textureArea);
+std::vector<mmapped::HeightTable::Node>
+sampleMetatileBlock(const MetatileBlock &block, const cv::Mat &dem
+                    , const std::vector<vts::TileIndex::Flag::value_type>
+                    &tiFlags
+                    , const MaskTree &maskTree
+                    , const boost::optional<std::string> &geoidGrid
+                    , const HeightFunction::pointer &heightFunction)
+{
+    const auto &extents(block.extents);
+    const auto es(math::size(extents));
+    const math::Size2 bSize(vts::tileRangesSize(block.view));
+    const auto gridSize(metatileGridSize(block));
+
+    Grid<Sample> grid(gridSize);
+
+    // tile size in grid
+    math::Size2f gts
+        (es.width / (metatileSamplesPerTile * bSize.width)
+         , es.height / (metatileSamplesPerTile * bSize.height));
+
+    auto conv(sds2phys(block.commonAncestor, geoidGrid));
+    auto navConv(sds2nav(block.commonAncestor, geoidGrid));
+    auto geConv(sdsg2sdsr(block.commonAncestor, geoidGrid));
+
+    // grid mask
+    const ShiftMask rfmask(block, metatileSamplesPerTile, maskTree);
+
+    // fill in grid
+    ValueMinMaxSampler vmm(dem, heightFunction);
+    for (int j(0), je(gridSize.height); j < je; ++j) {
+        auto y(extents.ur(1) - j * gts.height);
+        for (int i(0), ie(gridSize.width); i < ie; ++i) {
+            // work only with pixels not masked by combined mask
+            if (!rfmask(i, j)) { continue; }
+
+            auto value(vmm(i, j));
+
+            // skip out invalid data
+            if (!value) { continue; }
+
+            auto x(extents.ll(0) + i * gts.width);
+
+            // compute all 3 world points (value, min, max) and height range
+            // in navigation space
+            grid(i, j) = { x, y, *value, conv, navConv, geConv };
+        }
+    }
+
+    std::vector<HeightTableNode> nodes;
+    nodes.reserve(math::area(bSize));
+
+    auto itiFlags(tiFlags.begin());
+    for (int j(0), je(bSize.height); j < je; ++j) {
+        for (int i(0), ie(bSize.width); i < ie; ++i) {
+            // content flags
+            vts::MetaNode flags;
+            flags.flags(ti2metaFlags(*itiFlags++));
+            const bool geometry(flags.geometry());
+            const bool navtile(flags.navtile());
+
+            // compute tile extents and height range
+            auto heightRange(HeightRange::emptyRange());
+            math::Extents3 te(math::InvalidExtents{});
+            vts::GeomExtents ge;
+            double area(0.0);
+            int triangleCount(0);
+            double avgHeightSum(0.f);
+            int avgHeightCount(0);
+
+            // process all node's vertices in grid
+            for (int jj(0); jj <= metatileSamplesPerTile; ++jj) {
+                auto yy(j * metatileSamplesPerTile + jj);
+                for (int ii(0); ii <= metatileSamplesPerTile; ++ii) {
+                    auto xx(i * metatileSamplesPerTile + ii);
+
+                    const auto *p(getSample(grid(xx, yy)));
+
+                    // update tile extents (if sample valid)
+                    if (p) {
+                        // update by both minimum and maximum
+                        math::update(te, p->min);
+                        math::update(te, p->max);
+                        vts::update(ge, p->ge);
+                        avgHeightSum += p->ge.surrogate;
+                        ++avgHeightCount;
                     }
 
-                    // surrogate
-                    if (avgHeightCount) {
-                        node.geomExtents.surrogate
-                            = (avgHeightSum / avgHeightCount);
+                    if (geometry && ii && jj) {
+                        // compute area of the quad composed of 1 or 2
+                        // triangles
+                        auto qa(quadArea
+                                (getValue(grid(xx - 1, yy - 1))
+                                 , getValue(p)
+                                 , getValue(grid(xx - 1, yy))
+                                 , getValue(grid(xx, yy - 1))));
+                        area += std::get<0>(qa);
+                        triangleCount += std::get<1>(qa);
                     }
-                }
 
-                // store metata node
-                metatile.set(nodeId, node);
+                    if (p && navtile) {
+                        heightRange
+                            = vs::unite(heightRange, p->heightRange);
+                    }
+                }
             }
+
+            nodes.emplace_back();
+            auto &n(nodes.back());
+            n.extents[0] = te.ll(0);
+            n.extents[1] = te.ll(1);
+            n.extents[2] = te.ll(2);
+            n.extents[3] = te.ur(0);
+            n.extents[4] = te.ur(1);
+            n.extents[5] = te.ur(2);
+            n.geomMin = ge.z.min;
+            n.geomMax = ge.z.max;
+            n.geomSurrogate = ge.surrogate;
+            n.heightMin = heightRange.min;
+            n.heightMax = heightRange.max;
+            n.area = area;
+            n.avgHeightSum = avgHeightSum;
+            n.triangleCount = triangleCount;
+            n.avgHeightCount = avgHeightCount;
         }
     }
 
-    return metatile;
+    return nodes;
 }
 
-} // namespace
-
 vts::MetaTile
 metatileFromDem(const vts::TileId &tileId, Sink &sink, Arsenal &arsenal
                 , const Resource &resource
@@ -480,12 +628,14 @@ metatileFromDem(const vts::TileId &tileId, Sink &sink, Arsenal &arsenal
                 , const MaskTree &maskTree
                 , const boost::optional<int> &displaySize
                 , const HeightFunction::pointer &heightFunction
-                , const MetatileOverrides &overrides)
+                , const MetatileOverrides &overrides
+                , const mmapped::HeightTable *heightTable)
 
 {
     return metatileFromDemImpl(tileId, sink, arsenal, resource, tileIndex
                                , demDataset, geoidGrid, maskTree, displaySize
-                               , heightFunction, overrides);
+                               , heightFunction, overrides, heightTable
+                               , nullptr);
 }
 
 
@@ -498,10 +648,96 @@ metatileFromDem(const vts::TileId &tileId, Sink &sink, Arsenal &arsenal
                 , const MaskTree &maskTree
                 , const boost::optional<int> &displaySize
                 , const HeightFunction::pointer &heightFunction
-                , const MetatileOverrides &overrides)
+                , const MetatileOverrides &overrides
+                , const mmapped::HeightTable *heightTable)
 {
     return metatileFromDemImpl(tileId, sink, arsenal, resource, tileIndex
                                , demDataset, geoidGrid, maskTree, displaySize
-                               , heightFunction, overrides);
+                               , heightFunction, overrides, heightTable
+                               , nullptr);
+
+}
+
+mmapped::HeightTable::Stamp heightTableStamp(const Resource &resource)
+{
+    Json::Value value;
+    resource.definition()->to(value);
+
+    std::ostringstream os;
+    Json::write(os, value);
+    os << "\n" << GeneratorRevision;
+
+    mmapped::HeightTable::Stamp stamp;
+    stamp.revision = resource.revision;
+    stamp.fingerprint = mmapped::TilePack::fingerprint(os.str());
+    return stamp;
+}
+
+void prepareHeightTable(const boost::filesystem::path &path
+                        , vts::Lod bottomLod, Arsenal &arsenal
+                        , const Resource &resource
+                        , const mmapped::Index &index
+                        , const std::string &demDataset
+                        , const boost::optional<std::string> &geoidGrid
+                        , const MaskTree &maskTree
+                        , const HeightFunction::pointer &heightFunction)
+{
+    const auto stamp(heightTableStamp(resource));
+    if (mmapped::HeightTable::readStamp(path) == stamp) {
+        LOG(info2) << "Using existing height table " << path << ".";
+        return;
+    }
 
+    const auto bottom(std::min(bottomLod, resource.lodRange.max));
+    LOG(info2) << "Computing height table for LODs "
+               << resource.lodRange.min << "-" << bottom << ".";
+
+    const auto tmpPath(utility::addExtension(path, ".tmp"));
+    mmapped::HeightTable::Writer writer(tmpPath, stamp, bottom);
+
+    // nobody listens to this sink, it serves only as an aborter
+    Sink sink(std::make_shared<LocalSink>());
+
+    const auto metaOrder(resource.referenceFrame->metaBinaryOrder);
+    const unsigned int metaSize(1 << metaOrder);
+    const unsigned int metaMask(~(metaSize - 1));
+
+    std::size_t metatiles(0);
+    for (auto lod(resource.lodRange.min); lod <= bottom; ++lod) {
+        const auto range(vts::shiftRange(resource.lodRange.min
+                                         , resource.tileRange, lod));
+
+        for (unsigned int y(range.ll(1) & metaMask); y <= range.ur(1)
+                 ; y += metaSize)
+        {
+            for (unsigned int x(range.ll(0) & metaMask); x <= range.ur(0)
+                     ; x += metaSize)
+            {
+                const vts::TileId tileId(lod, x, y);
+                if (!index.meta(tileId)) { continue; }
+
+                try {
+                    metatileFromDemImpl
+                        (tileId, sink, arsenal, resource, index.tileIndex
+                         , demDataset, geoidGrid, maskTree, boost::none
+                         , heightFunction, {}, nullptr, &writer);
+                    ++metatiles;
+                } catch (const NotFound&) {
+                    // nothing to do here
+                }
+            }
+        }
+    }
+
+    writer.close();
+    boost::filesystem::rename(tmpPath, path);
+
+    LOG(info2) << "Height table " << path << " computed from "
+               << metatiles << " metatiles.";
+}
+
+void heightTableStat(std::ostream &os, const std::string &prefix)
+{
+    os << prefix << "hits=" << heightTableCounters.hits << '\n'
+       << prefix << "misses=" << heightTableCounters.misses << '\n';
 }
@@ -27,11 +27,18 @@
 #ifndef mapproxy_metatile_hpp_included_
 #define mapproxy_metatile_hpp_included_
 
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
 #include "vts-libs/vts/tileindex.hpp"
 #include "vts-libs/vts/metatile.hpp"
 
 #include "../support/coverage.hpp"
+#include "../support/metatile.hpp"
 #include "../support/mmapped/tileindex.hpp"
+#include "../support/mmapped/tilesetindex.hpp"
+#include "../support/mmapped/heighttable.hpp"
 
 #include "../generator.hpp"
 
@@ -67,7 +74,9 @@ vts::MetaTile metatileFromDem(const vts::TileId &tileId, Sink &sink
                               = boost::none
                               , const HeightFunction::pointer &heightFunction
                               = HeightFunction::pointer()
-                              , const MetatileOverrides &overrides = {});
+                              , const MetatileOverrides &overrides = {}
+                              , const mmapped::HeightTable *heightTable
+                              = nullptr);
 
 vts::MetaTile metatileFromDem(const vts::TileId &tileId, Sink &sink
                               , Arsenal &arsenal
@@ -80,7 +89,53 @@ vts::MetaTile metatileFromDem(const vts::TileId &tileId, Sink &sink
                               = boost::none
                               , const HeightFunction::pointer &heightFunction
                               = HeightFunction::pointer()
-                              , const MetatileOverrides &overrides = {});
+                              , const MetatileOverrides &overrides = {}
+                              , const mmapped::HeightTable *heightTable
+                              = nullptr);
+
+/** Size of DEM grid (valueMinMax, grid registration) sampled by metatile
+ *  generator for given metatile block.
+ */
+math::Size2 metatileGridSize(const MetatileBlock &block);
+
+/** Metatile sampling kernel: converts DEM grid warped for given block into
+ *  per-node values (in row-major order of block's view).
+ *
+ *  Tile index flags of block's nodes (in the same order) select what is
+ *  computed: area and triangle count for nodes with mesh, height range for
+ *  nodes with navtile.
+ */
+std::vector<mmapped::HeightTable::Node>
+sampleMetatileBlock(const MetatileBlock &block, const cv::Mat &dem
+                    , const std::vector<vts::TileIndex::Flag::value_type>
+                    &tiFlags
+                    , const MaskTree &maskTree
+                    , const boost::optional<std::string> &geoidGrid
+                    , const HeightFunction::pointer &heightFunction
+                    = HeightFunction::pointer());
+
+/** Stamp of height table computed for given resource (revision, definition
+ *  and generator revision).
+ */
+mmapped::HeightTable::Stamp heightTableStamp(const Resource &resource);
+
+/** Computes per-tile height table for all metatiles from the top of the
+ *  resource's LOD range down to bottomLod and stores it at given path. Valid
+ *  existing table is kept intact.
+ */
+void prepareHeightTable(const boost::filesystem::path &path
+                        , vts::Lod bottomLod, Arsenal &arsenal
+                        , const Resource &resource
+                        , const mmapped::Index &index
+                        , const std::string &demDataset
+                        , const boost::optional<std::string> &geoidGrid
+                        , const MaskTree &maskTree = MaskTree()
+                        , const HeightFunction::pointer &heightFunction
+                        = HeightFunction::pointer());
+
+/** Dumps height table usage counters.
+ */
+void heightTableStat(std::ostream &os, const std::string &prefix);
 
 // inines
 
@@ -64,6 +64,7 @@
 #include "../support/srs.hpp"
 #include "../support/geo.hpp"
 #include "../support/grid.hpp"
+#include "../support/demraster.hpp"
 #include "../support/coverage.hpp"
 #include "../support/tileindex.hpp"
 
@@ -104,7 +105,18 @@ SurfaceDem::SurfaceDem(const Params &params)
            , definition_.dem.geoidGrid)
     , maskTree_(absoluteDatasetRf(definition_.mask))
 {
+    if (!heightTableValid()) {
+        // stale or missing height table, recomputed in prepare
+        LOG(info1) << "Generator for <" << id() << "> not ready "
+                   << "(height table is out of date).";
+        return;
+    }
+
     if (loadFiles(definition_)) {
+        if (definition_.heightTableLod) {
+            heightTable_ = boost::in_place(root() / "height.table");
+        }
+
         // remember dem in registry
         addToRegistry();
     }
@@ -115,7 +127,7 @@ SurfaceDem::~SurfaceDem()
     removeFromRegistry();
 }
 
-void SurfaceDem::prepare_impl(Arsenal&)
+void SurfaceDem::prepare_impl(Arsenal &arsenal)
 {
     LOG(info2) << "Preparing <" << id() << ">.";
 
@@ -169,9 +181,26 @@ void SurfaceDem::prepare_impl(Arsenal&)
                                  , deliveryIndexPath);
     }
 
+    heightTable_ = boost::none;
+    if (definition_.heightTableLod) {
+        const auto heightTablePath(root() / "height.table");
+        prepareHeightTable(heightTablePath, *definition_.heightTableLod
+                           , arsenal, r, *index_, dem_.dataset
+                           , dem_.geoidGrid, maskTree_
+                           , definition_.heightFunction);
+        heightTable_ = boost::in_place(heightTablePath);
+    }
+
     addToRegistry();
 }
 
+bool SurfaceDem::heightTableValid() const
+{
+    if (!definition_.heightTableLod) { return true; }
+    return (mmapped::HeightTable::readStamp(root() / "height.table")
+            == heightTableStamp(resource()));
+}
+
 void SurfaceDem::addToRegistry()
 {
     demRegistry().add(DemRegistry::Record
@@ -256,7 +285,7 @@ SurfaceDem::generateMetatileImpl(const vts::TileId &tileId
                            , index_->tileIndex, dem_.dataset
                            , dem_.geoidGrid, maskTree_, boost::none
                            , definition_.heightFunction
-                           , overrides);
+                           , overrides, heightTable_.get_ptr());
 }
 
 namespace {
@@ -282,7 +311,7 @@ public:
         // ignore masked-out pixels
         if (!mask_.get(i, j)) { return false; }
 
-        h = dem_.at<double>(j, i);
+        h = demValue(dem_, i, j);
         if (validSample(h)) {
             if (heightFunction_) { h = (*heightFunction_)(h); }
             return true;
@@ -306,7 +335,7 @@ public:
                 if (!mask_.get(x, y)) { continue; }
 
                 // sample pixel and use if valid
-                auto v(dem_.at<double>(y, x));
+                auto v(demValue(dem_, x, y));
                 if (!validSample(v)) { continue; }
 
                 h += v;
@@ -350,6 +379,7 @@ AugmentedMesh SurfaceDem
                , nodeInfo.srsDef(), nodeInfo.extents()
                , math::Size2(samplesPerSide, samplesPerSide))
               .setNodata(defaultHeight)
+              .setSampleType(GdalWarper::RasterRequest::SampleType::float32)
               , sink));
 
     sink.checkAborted();
@@ -440,6 +470,7 @@ void SurfaceDem::generateNavtile(const vts::TileId &tileId
                , dem_.dataset
                , node.srsDef(), node.extents()
                , math::Size2(ntd.cols - 1, ntd.rows -1))
+              .setSampleType(GdalWarper::RasterRequest::SampleType::float32)
               , sink));
 
     sink.checkAborted();
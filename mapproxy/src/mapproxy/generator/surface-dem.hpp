@@ -33,6 +33,7 @@
 #include "surface.hpp"
 
 #include "../support/coverage.hpp"
+#include "../support/mmapped/heighttable.hpp"
 
 namespace vts = vtslibs::vts;
 namespace vr = vtslibs::registry;
@@ -75,6 +76,10 @@ private:
 
     void addToRegistry();
 
+    /** Checks whether height table (if configured) is up to date.
+     */
+    bool heightTableValid() const;
+
     void removeFromRegistry();
 
     const Definition &definition_;
@@ -85,6 +90,10 @@ private:
 
     // mask tree
     MaskTree maskTree_;
+
+    /** Precomputed per-tile heights. Only when configured.
+     */
+    boost::optional<mmapped::HeightTable> heightTable_;
 };
 
 } // namespace generator
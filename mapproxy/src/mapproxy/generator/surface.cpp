@@ -25,6 +25,10 @@
  */
 
 #include <new>
+#include <map>
+#include <mutex>
+#include <tuple>
+#include <ctime>
 
 #include <boost/filesystem.hpp>
 #include <boost/format.hpp>
@@ -181,10 +185,106 @@ SurfaceBase::SurfaceBase(const Params &params)
     : Generator(params, terrainSupport(params))
     , definition_(resource().definition<Definition>())
     , tms_(params.resource.referenceFrame->findExtension<vre::Tms>())
+    , documents_(std::make_shared<DocumentCache>())
 {
     setProvider(std::make_unique<SurfaceProvider>(*this));
 }
 
+struct SurfaceBase::DocumentCache {
+    struct Entry {
+        std::shared_ptr<const std::string> data;
+        std::time_t built;
+    };
+
+    /** (document, revision, root depth, root backup)
+     */
+    typedef std::tuple<Document, unsigned int, int, int> Key;
+
+    std::mutex mutex;
+    std::map<Key, Entry> entries;
+};
+
+std::string SurfaceBase::serialize(Document document, ResourceRoot root)
+    const
+{
+    std::ostringstream os;
+
+    switch (document) {
+    case Document::definition:
+        vr::saveFreeLayer
+            (os, vts::freeLayer
+             (vts::meshTilesConfig
+              (properties_, vts::ExtraTileSetProperties()
+               , prependRoot(fs::path(), resource(), root))));
+        break;
+
+    case Document::mapConfig:
+        vts::saveMapConfig(mapConfig(root), os);
+        break;
+
+    case Document::debug:
+        vts::saveDebug
+            (os, vts::debugConfig
+             (vts::meshTilesConfig
+              (properties_, vts::ExtraTileSetProperties()
+               , prependRoot(fs::path(), resource(), root))));
+        break;
+
+    case Document::registry:
+        save(os, resource().registry);
+        break;
+    }
+
+    return os.str();
+}
+
+void SurfaceBase::sendDocument(Document document
+                               , const SurfaceFileInfo &fi, Sink &sink)
+    const
+{
+    const ResourceRoot root(ResourceRoot::none);
+
+    DocumentCache::Entry entry;
+    if (document == Document::mapConfig) {
+        // follows introspected resources, has its own cache
+        entry.data = serializedMapConfig(root, &entry.built);
+    } else {
+        auto &cache(*documents_);
+        const DocumentCache::Key key
+            (document, resource().revision, root.depth, root.backup);
+
+        {
+            std::unique_lock<std::mutex> lock(cache.mutex);
+            auto fentries(cache.entries.find(key));
+            if (fentries != cache.entries.end()) {
+                entry = fentries->second;
+            }
+        }
+
+        if (!entry.data) {
+            entry.data = std::make_shared<const std::string>
+                (serialize(document, root));
+            entry.built = std::time(nullptr);
+
+            std::unique_lock<std::mutex> lock(cache.mutex);
+            // drop documents of previous revisions
+            for (auto ientries(cache.entries.begin());
+                 ientries != cache.entries.end(); )
+            {
+                if (std::get<1>(ientries->first) != std::get<1>(key)) {
+                    ientries = cache.entries.erase(ientries);
+                } else {
+                    ++ientries;
+                }
+            }
+            entry = cache.entries.insert
+                (decltype(cache.entries)::value_type(key, entry)).first->second;
+        }
+    }
+
+    sink.content(entry.data, fi.sinkFileInfo(entry.built));
+}
+
 bool SurfaceBase::loadFiles(const Definition &definition)
 {
     if (changeEnforced()) {
@@ -281,28 +381,17 @@ Generator::Task SurfaceBase
         sink.error(utility::makeError<NotFound>("Unrecognized filename."));
         break;
 
-    case SurfaceFileInfo::Type::definition: {
-        auto fl(vts::freeLayer
-                (vts::meshTilesConfig
-                 (properties_, vts::ExtraTileSetProperties()
-                  , prependRoot(fs::path(), resource(), ResourceRoot::none))));
-
-        std::ostringstream os;
-        vr::saveFreeLayer(os, fl);
-        sink.content(os.str(), fi.sinkFileInfo());
+    case SurfaceFileInfo::Type::definition:
+        sendDocument(Document::definition, fi, sink);
         break;
-    }
 
     case SurfaceFileInfo::Type::file: {
         switch (fi.fileType) {
         case vts::File::config: {
             switch (fi.flavor) {
-            case vts::FileFlavor::regular: {
-                std::ostringstream os;
-                mapConfig(os, ResourceRoot::none);
-                sink.content(os.str(), fi.sinkFileInfo());
+            case vts::FileFlavor::regular:
+                sendDocument(Document::mapConfig, fi, sink);
                 break;
-            }
 
             case vts::FileFlavor::raw:
                 sink.content(vs::fileIStream
@@ -310,18 +399,9 @@ Generator::Task SurfaceBase
                              , FileClass::unknown);
                 break;
 
-            case vts::FileFlavor::debug: {
-                std::ostringstream os;
-                const auto debug
-                    (vts::debugConfig
-                     (vts::meshTilesConfig
-                      (properties_, vts::ExtraTileSetProperties()
-                       , prependRoot(fs::path(), resource()
-                                     , ResourceRoot::none))));
-                vts::saveDebug(os, debug);
-                sink.content(os.str(), fi.sinkFileInfo());
+            case vts::FileFlavor::debug:
+                sendDocument(Document::debug, fi, sink);
                 break;
-            }
 
             default:
                 sink.error(utility::makeError<NotFound>
@@ -337,11 +417,9 @@ Generator::Task SurfaceBase
                          , FileClass::unknown);
             break;
 
-        case vts::File::registry: {
-            std::ostringstream os;
-            save(os, resource().registry);
-            sink.content(os.str(), fi.sinkFileInfo());
-            break; }
+        case vts::File::registry:
+            sendDocument(Document::registry, fi, sink);
+            break;
 
         default:
             sink.error(utility::makeError<NotFound>("Not found"));
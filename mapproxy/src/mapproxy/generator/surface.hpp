@@ -51,6 +51,14 @@ public:
 
     typedef resource::Surface Definition;
 
+    /** Documents derived from tileset properties.
+     */
+    enum class Document { definition, mapConfig, debug, registry };
+
+    /** Serializes given document from scratch (no caching).
+     */
+    std::string serialize(Document document, ResourceRoot root) const;
+
 protected:
     boost::filesystem::path filePath(vts::File fileType) const;
     bool updateProperties(const Definition &def);
@@ -69,6 +77,16 @@ private:
     virtual Task generateFile_impl(const FileInfo &fileInfo
                                    , Sink &sink) const;
 
+    /** Sends document serialized on first use. Documents are kept per
+     *  resource revision and root; map configuration is taken from
+     *  generator's map configuration cache.
+     */
+    void sendDocument(Document document, const SurfaceFileInfo &fileInfo
+                      , Sink &sink) const;
+
+    struct DocumentCache;
+    std::shared_ptr<DocumentCache> documents_;
+
     virtual void generateMetatile(const vts::TileId &tileId
                                   , Sink &sink
                                   , const SurfaceFileInfo &fileInfo
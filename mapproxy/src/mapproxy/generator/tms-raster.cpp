@@ -24,7 +24,12 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <sstream>
+#include <chrono>
+#include <set>
+
 #include <boost/filesystem.hpp>
+#include <boost/lexical_cast.hpp>
 
 #include <opencv2/highgui/highgui.hpp>
 
@@ -40,12 +45,15 @@
 
 #include "jsoncpp/json.hpp"
 #include "jsoncpp/as.hpp"
+#include "jsoncpp/io.hpp"
 
 #include "vts-libs/vts/io.hpp"
 #include "vts-libs/vts/nodeinfo.hpp"
 #include "vts-libs/vts/tileindex.hpp"
+#include "vts-libs/vts/tileop.hpp"
 
 #include "../error.hpp"
+#include "../localsink.hpp"
 #include "../support/metatile.hpp"
 #include "../support/tileindex.hpp"
 #include "../support/mmapped/qtree.hpp"
@@ -53,8 +61,10 @@
 #include "../support/revision.hpp"
 #include "../support/atlas.hpp"
 #include "../support/wmts.hpp"
+#include "../support/geo.hpp"
 
 #include "tms-raster.hpp"
+#include "warpcache.hpp"
 #include "factory.hpp"
 
 #include "browser2d/index.html.hpp"
@@ -124,6 +134,19 @@ TmsRaster::TmsRaster(const Params &params
         hasMetatiles_ = true;
         complexDataset_
             = fs::exists(absoluteDataset(definition_.dataset + "/ophoto"));
+        sourceDescriptor(TmsRaster::dataset_impl().path);
+
+        if (definition_.prerender) {
+            const auto packPath(root() / "prerender.pack");
+            if (mmapped::TilePack::readStamp(packPath) != packStamp()) {
+                // stale or missing pack, regenerate in prepare
+                LOG(info1) << "Generator for <" << id() << "> not ready "
+                           << "(pre-rendered tiles are out of date).";
+                return;
+            }
+            pack_ = boost::in_place(packPath);
+        }
+
         makeReady();
         return;
     };
@@ -141,7 +164,7 @@ TmsRaster::DatasetDesc TmsRaster::dataset_impl() const
     return { definition_.dataset };
 }
 
-void TmsRaster::prepare_impl(Arsenal&)
+void TmsRaster::prepare_impl(Arsenal &arsenal)
 {
     LOG(info2) << "Preparing <" << id() << ">.";
 
@@ -152,8 +175,10 @@ void TmsRaster::prepare_impl(Arsenal&)
         complexDataset_ = true;
 
         // try to open
-        geo::GeoDataset::open
-            (absoluteDataset(definition_.dataset + "/ophoto"));
+        auto ds(geo::GeoDataset::open
+                (absoluteDataset(definition_.dataset + "/ophoto")));
+        sourceDescriptor_ = ds.descriptor();
+        detectAlignment();
 
         const auto &r(resource());
 
@@ -173,12 +198,16 @@ void TmsRaster::prepare_impl(Arsenal&)
         fs::rename(tmpPath, deliveryIndexPath);
         index_ = boost::in_place(deliveryIndexPath);
 
+        prerender(arsenal);
+
         // done
         return;
     }
 
     // try to open datasets
     auto ds(geo::GeoDataset::open(absoluteDataset(dataset().path)));
+    sourceDescriptor_ = ds.descriptor();
+    detectAlignment();
     if (maskTree_) {
         // we have mask tree -> metatiles exist
         hasMetatiles_ = true;
@@ -204,6 +233,86 @@ void TmsRaster::prepare_impl(Arsenal&)
         // some invalid pixels
         hasMetatiles_ = !ds.allValid();
     }
+
+    prerender(arsenal);
+}
+
+void TmsRaster::sourceDescriptor(const std::string &path)
+{
+    try {
+        sourceDescriptor_
+            = geo::GeoDataset::open(absoluteDataset(path)).descriptor();
+    } catch (const std::exception &e) {
+        LOG(warn2)
+            << "<" << id() << ">: cannot open dataset " << path
+            << " (" << e.what() << "); resampling policy and aligned "
+            "passthrough are not applied.";
+    }
+
+    detectAlignment();
+}
+
+void TmsRaster::detectAlignment()
+{
+    alignedLods_.clear();
+    if (!sourceDescriptor_) { return; }
+
+    // tiles at one LOD in one subtree are shifted by whole tiles, therefore
+    // first tile in range represents the whole LOD
+    const auto &r(resource());
+    for (auto lod(r.lodRange.min); lod <= r.lodRange.max; ++lod) {
+        const auto range(vts::shiftRange(r.lodRange.min, r.tileRange, lod));
+        vts::NodeInfo nodeInfo
+            (referenceFrame(), vts::TileId(lod, range.ll(0), range.ll(1)));
+        if (!nodeInfo.valid()) { continue; }
+
+        const auto k(gridAlignment(nodeInfo.extents(), nodeInfo.srsDef()
+                                   , math::Size2(256, 256)
+                                   , *sourceDescriptor_));
+        if (k < 0) { continue; }
+
+        alignedLods_[lod] = nodeInfo.srs();
+        LOG(info1) << "<" << id() << ">: LOD " << lod
+                   << " is aligned with dataset pixels (scale 2^" << k
+                   << ").";
+    }
+}
+
+bool TmsRaster::aligned(const vts::NodeInfo &nodeInfo) const
+{
+    // passthrough cannot apply external mask
+    if (maskDataset_) { return false; }
+
+    auto falignedLods(alignedLods_.find(nodeInfo.nodeId().lod));
+    return ((falignedLods != alignedLods_.end())
+            && (falignedLods->second == nodeInfo.srs()));
+}
+
+bool TmsRaster::watertight(const vts::TileId &tileId
+                           , TileOperation operation) const
+{
+    // no index -> no knowledge
+    if (!index_) { return false; }
+
+    // only mask tree (or its pyramid) gives pixel precise watertight flag;
+    // flag from dataset tiling is sampled on a coarse grid (or even forced)
+    if (!maskTree_) { return false; }
+    return watertightTile(index_->get(tileId), operation);
+}
+
+geo::GeoDataset::Resampling
+TmsRaster::pickResampling(const vts::NodeInfo &nodeInfo
+                          , geo::GeoDataset::Resampling base
+                          , TileOperation operation) const
+{
+    // overzoom is unknown without source dataset -> base resampling
+    double overzoom(0.0);
+    if (sourceDescriptor_ && !definition_.resamplingPolicy.empty()) {
+        overzoom = tileOverzoom(nodeInfo.extents(), nodeInfo.srsDef()
+                                , math::Size2(256, 256), *sourceDescriptor_);
+    }
+
+    return definition_.resamplingPolicy(overzoom, base, operation);
 }
 
 RasterFormat TmsRaster::format() const
@@ -311,6 +420,14 @@ Generator::Task TmsRaster::generateVtsFile_impl(const FileInfo &fileInfo
     default: break;
     }
 
+    // serve pre-rendered tile if available
+    if (const auto file = prerendered(fi)) {
+        auto sfi(fi.sinkFileInfo());
+        sfi.contentType = file->contentType;
+        sink.content(file->data, file->size, sfi, true);
+        return {};
+    }
+
     switch (fi.type) {
     case TmsFileInfo::Type::unknown:
         sink.error(utility::makeError<NotFound>("Unrecognized filename."));
@@ -409,35 +526,61 @@ void TmsRaster::generateTileImage(const vts::TileId &tileId
     // grab dataset to use
     const auto ds(dataset());
 
-    // what operation should we do with the dataset? optimized or non-optimized
-    // return?
+    // fully covered tile (according to mask tree): cannot be empty
+    const auto full(watertight(tileId, TileOperation::image));
+
+    // what should we do with empty tile? report it or return black image?
     //
-    // * dynamic dataset: cannot use since we are unable report different
+    // * dynamic dataset: cannot report since we are unable report different
     //                    caching for empty/full image
     // * transparent: we cannot report transparecny for empty/full image
     // * dontOptimize set: we are forbidden to return empty/full image
-    const auto operation
-        ((ds.dynamic || transparent() || imageFlags.dontOptimize)
-         ? GdalWarper::RasterRequest::Operation::imageNoOpt
-         : GdalWarper::RasterRequest::Operation::image);
+    const auto reportEmpty
+        (!(ds.dynamic || transparent() || imageFlags.dontOptimize));
+
+    // choose resampling (configured or default) adjusted by policy
+    const auto resampling
+        (pickResampling(nodeInfo
+                        , (definition_.resampling ? *definition_.resampling
+                           : geo::GeoDataset::Resampling::cubic)
+                        , TileOperation::image));
+
+    // interface this image is generated for (accounting)
+    const auto interface(imageFlags.forceFormat ? WarpInterface::atlas
+                         : (imageFlags.dontOptimize ? WarpInterface::wmts
+                            : WarpInterface::vts));
+
+    // warp result is shared by all interfaces, optimization is applied
+    // afterwards; watertight tile cannot be empty, no need to check
+    const auto result(cachedWarp
+                      (arsenal.warper
+                       , GdalWarper::RasterRequest
+                       ((full ? GdalWarper::RasterRequest::Operation::imageNoOpt
+                         : GdalWarper::RasterRequest::Operation::image)
+                        , absoluteDataset(ds.path)
+                        , nodeInfo.srsDef()
+                        , nodeInfo.extents()
+                        , math::Size2(256, 256)
+                        , resampling
+                        , absoluteDataset(maskDataset_))
+                       .setAligned(aligned(nodeInfo))
+                       , resource().revision, interface, sink));
+    sink.checkAborted();
 
-    // choose resampling (configured or default)
-    const auto resampling(definition_.resampling ? *definition_.resampling
-                          : geo::GeoDataset::Resampling::cubic);
+    if (result.empty()) {
+        if (reportEmpty) {
+            return sink.error
+                (utility::makeError<EmptyImage>("No valid data."));
+        }
 
-    auto tile(arsenal.warper.warp
-              (GdalWarper::RasterRequest
-               (operation
-                , absoluteDataset(ds.path)
-                , nodeInfo.srsDef()
-                , nodeInfo.extents()
-                , math::Size2(256, 256)
-                , resampling
-                , absoluteDataset(maskDataset_))
-               , sink));
-    sink.checkAborted();
+        // return full blown black image
+        return serialize(cv::Mat_<cv::Vec3b>(vr::BoundLayer::tileHeight
+                                             , vr::BoundLayer::tileWidth
+                                             , cv::Vec3b(0, 0, 0))
+                         , ds);
+    }
 
-    serialize(*tile, ds);
+    serialize(*result.image, ds);
 }
 
 void TmsRaster::generateTileMask(const vts::TileId &tileId
@@ -471,7 +614,9 @@ void TmsRaster::generateTileMask(const vts::TileId &tileId
                 , nodeInfo.srsDef()
                 , nodeInfo.extents()
                 , math::Size2(256, 256)
-                , geo::GeoDataset::Resampling::cubic)
+                , pickResampling(nodeInfo
+                                 , geo::GeoDataset::Resampling::cubic
+                                 , TileOperation::mask))
                , sink));
 
     sink.checkAborted();
@@ -508,6 +653,12 @@ void TmsRaster::generateTileMaskFromTree(const vts::TileId &tileId
         return;
     }
 
+    if (watertight(tileId, TileOperation::mask)) {
+        sink.error(utility::makeError<FullImage>
+                   ("All pixels valid, optimize."));
+        return;
+    }
+
     auto mask(boundlayerMask(tileId, maskTree_));
 
     const auto nz(countNonZero(mask));
@@ -689,4 +840,142 @@ void TmsRaster::generateMetatile(const vts::TileId &tileId
     sink.content(buf, fi.sinkFileInfo().setMaxAge(ds.maxAge));
 }
 
+mmapped::TilePack::Stamp TmsRaster::packStamp() const
+{
+    Json::Value value;
+    definition_.to(value);
+
+    std::ostringstream os;
+    Json::write(os, value);
+    os << "\n" << GeneratorRevision;
+
+    mmapped::TilePack::Stamp stamp;
+    stamp.revision = resource().revision;
+    stamp.fingerprint = mmapped::TilePack::fingerprint(os.str());
+    return stamp;
+}
+
+boost::optional<mmapped::TilePack::File>
+TmsRaster::prerendered(const TmsFileInfo &fi) const
+{
+    if (!pack_) { return boost::none; }
+
+    typedef mmapped::TilePack::FileType FileType;
+    switch (fi.type) {
+    case TmsFileInfo::Type::image:
+        // only native format is pre-rendered
+        if (fi.format != format()) { return boost::none; }
+        return pack_->find(FileType::image, fi.tileId);
+
+    case TmsFileInfo::Type::mask:
+        return pack_->find(FileType::mask, fi.tileId);
+
+    case TmsFileInfo::Type::metatile:
+        return pack_->find(FileType::metatile, fi.tileId);
+
+    default: break;
+    }
+
+    return boost::none;
+}
+
+void TmsRaster::prerender(Arsenal &arsenal)
+{
+    pack_ = boost::none;
+    if (!definition_.prerender) { return; }
+
+    if (dataset().dynamic) {
+        LOG(info2) << "<" << id() << ">: dynamic dataset, not pre-rendering.";
+        return;
+    }
+
+    const auto packPath(root() / "prerender.pack");
+    const auto stamp(packStamp());
+    if (mmapped::TilePack::readStamp(packPath) == stamp) {
+        LOG(info2) << "<" << id() << ">: using existing pre-rendered tiles.";
+        pack_ = boost::in_place(packPath);
+        return;
+    }
+
+    const auto &r(resource());
+    const auto bottom(std::min(*definition_.prerender, r.lodRange.max));
+    LOG(info2) << "<" << id() << ">: pre-rendering LODs "
+               << r.lodRange.min << "-" << bottom << ".";
+
+    const auto prefix(utility::format("/%s/tms/%s/%s/", r.id.referenceFrame
+                                      , r.id.group, r.id.id));
+
+    const auto tmpPath(utility::addExtension(packPath, ".tmp"));
+    mmapped::TilePack::Writer writer(tmpPath, stamp);
+    std::size_t stored(0), skipped(0);
+
+    typedef mmapped::TilePack::FileType FileType;
+    const auto render([&](FileType type, const vts::TileId &tileId
+                          , const std::string &ext)
+    {
+        const TmsFileInfo fi
+            (FileInfo(prefix + utility::format
+                      ("%d-%d-%d.%s", int(tileId.lod), tileId.x, tileId.y
+                       , ext)));
+
+        auto ls(std::make_shared<LocalSink>());
+        auto response(ls->response());
+        Sink sink(ls);
+
+        try {
+            if (const auto task = generateVtsFile_impl(fi.fileInfo, sink)) {
+                task(sink, arsenal);
+            }
+        } catch (...) {
+            sink.error();
+        }
+
+        if (response.wait_for(std::chrono::seconds(0))
+            != std::future_status::ready)
+        {
+            ++skipped;
+            return;
+        }
+
+        const auto resp(response.get());
+        if (!resp.ok()) {
+            ++skipped;
+            return;
+        }
+
+        writer.add(type, tileId, resp.contentType, resp.data);
+        ++stored;
+    });
+
+    const auto ext(boost::lexical_cast<std::string>(format()));
+    const auto metaMask(~((1u << Constants::RasterMetatileBinaryOrder) - 1));
+
+    for (auto lod(r.lodRange.min); lod <= bottom; ++lod) {
+        const auto range(vts::shiftRange(r.lodRange.min, r.tileRange, lod));
+
+        std::set<vts::TileId> metatiles;
+        for (auto y(range.ll(1)); y <= range.ur(1); ++y) {
+            for (auto x(range.ll(0)); x <= range.ur(0); ++x) {
+                const vts::TileId tileId(lod, x, y);
+                render(FileType::image, tileId, ext);
+                render(FileType::mask, tileId, "mask");
+                metatiles.insert
+                    (vts::TileId(lod, x & metaMask, y & metaMask));
+            }
+        }
+
+        if (!hasMetatiles_) { continue; }
+        for (const auto &tileId : metatiles) {
+            render(FileType::metatile, tileId, "meta");
+        }
+    }
+
+    writer.close();
+    fs::rename(tmpPath, packPath);
+    pack_ = boost::in_place(packPath);
+
+    LOG(info2) << "<" << id() << ">: pre-rendered " << stored
+               << " files (" << skipped << " skipped).";
+}
+
 } // namespace generator
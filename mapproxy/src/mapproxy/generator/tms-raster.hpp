@@ -31,6 +31,7 @@
 
 #include "../support/coverage.hpp"
 #include "../support/mmapped/tileindex.hpp"
+#include "../support/mmapped/tilepack.hpp"
 
 #include "../definition/tms.hpp"
 
@@ -128,6 +129,46 @@ private:
 
     void update(vr::BoundLayer &bl) const;
 
+    /** Picks resampling for given tile using resampling policy.
+     */
+    geo::GeoDataset::Resampling
+    pickResampling(const vts::NodeInfo &nodeInfo
+                   , geo::GeoDataset::Resampling base
+                   , TileOperation operation) const;
+
+    /** Grabs source dataset descriptor (used by resampling policy and grid
+     *  alignment detection).
+     */
+    void sourceDescriptor(const std::string &path);
+
+    /** Detects LODs where tile grid is aligned with source dataset pixels.
+     */
+    void detectAlignment();
+
+    /** Is tile's grid aligned with source dataset pixels?
+     */
+    bool aligned(const vts::NodeInfo &nodeInfo) const;
+
+    /** Is tile fully covered according to tile index? Trusted only when
+     *  index is clipped by mask tree. Accounted under given operation.
+     */
+    bool watertight(const vts::TileId &tileId, TileOperation operation)
+        const;
+
+    /** Renders configured low LODs into tile pack (or opens existing valid
+     *  pack).
+     */
+    void prerender(Arsenal &arsenal);
+
+    /** Stamp expected in pre-rendered tile pack.
+     */
+    mmapped::TilePack::Stamp packStamp() const;
+
+    /** Returns pre-rendered file if available.
+     */
+    boost::optional<mmapped::TilePack::File>
+    prerendered(const TmsFileInfo &fi) const;
+
     // customizable stuff
 
     /** Path to dataset and its validity. Defaults to path from resource.
@@ -159,6 +200,19 @@ private:
     /** Mask dataset path. Only when defined and not a RF tree.
      */
     boost::optional<std::string> maskDataset_;
+
+    /** Source dataset descriptor. Unset when dataset cannot be opened.
+     */
+    boost::optional<geo::GeoDataset::Descriptor> sourceDescriptor_;
+
+    /** LODs with tile grid aligned to source dataset pixels, mapped to SRS
+     *  of aligned subtree.
+     */
+    std::map<vts::Lod, std::string> alignedLods_;
+
+    /** Pre-rendered low-LOD tiles. Only when configured.
+     */
+    boost::optional<mmapped::TilePack> pack_;
 };
 
 // inlines
@@ -0,0 +1,222 @@
+/**
+ * Copyright (c) 2019 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <map>
+#include <list>
+#include <mutex>
+#include <future>
+#include <chrono>
+#include <ostream>
+#include <sstream>
+#include <limits>
+
+#include "../error.hpp"
+
+#include "warpcache.hpp"
+
+namespace {
+
+/** Number of cached results. Tile is 256x256x3 bytes, i.e. the cache holds
+ *  ~48 MB at most.
+ */
+const std::size_t Capacity(256);
+
+/** Waiting for a warp issued by another request is split into slices to
+ *  check for abort.
+ */
+const std::chrono::milliseconds WaitSlice(100);
+
+typedef std::shared_future<WarpResult> Future;
+
+UTILITY_GENERATE_ENUM(WarpOutcome,
+    ((hit))
+    ((miss))
+    ((retry))
+)
+
+class Cache {
+public:
+    /** Returns future result. Promise is returned as well when caller is
+     *  responsible for the warp.
+     */
+    std::pair<Future, std::shared_ptr<std::promise<WarpResult>>>
+    get(const std::string &key, WarpInterface interface);
+
+    void forget(const std::string &key, const Future &future);
+
+    void count(WarpInterface interface, WarpOutcome outcome) {
+        counters_.count(interface, outcome);
+    }
+
+    void stat(std::ostream &os, const std::string &prefix);
+
+private:
+    struct Entry {
+        Future future;
+        std::list<std::string>::iterator lru;
+    };
+
+    std::mutex mutex_;
+    std::map<std::string, Entry> entries_;
+
+    /** Most recently used at front.
+     */
+    std::list<std::string> lru_;
+
+    StatCounters<WarpInterface, 3, WarpOutcome, 3> counters_;
+};
+
+std::pair<Future, std::shared_ptr<std::promise<WarpResult>>>
+Cache::get(const std::string &key, WarpInterface interface)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    auto fentries(entries_.find(key));
+    if (fentries != entries_.end()) {
+        auto &entry(fentries->second);
+        lru_.splice(lru_.begin(), lru_, entry.lru);
+        count(interface, WarpOutcome::hit);
+        return { entry.future, nullptr };
+    }
+
+    count(interface, WarpOutcome::miss);
+
+    auto promise(std::make_shared<std::promise<WarpResult>>());
+    Future future(promise->get_future().share());
+
+    lru_.push_front(key);
+    entries_.insert(std::map<std::string, Entry>::value_type
+                    (key, Entry{ future, lru_.begin() }));
+
+    // drop least recently used results; pending warps are kept alive by
+    // their waiters
+    while (lru_.size() > Capacity) {
+        entries_.erase(lru_.back());
+        lru_.pop_back();
+    }
+
+    return { future, promise };
+}
+
+void Cache::forget(const std::string &key, const Future &future)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto fentries(entries_.find(key));
+    if ((fentries == entries_.end())
+        || (fentries->second.future != future))
+    {
+        return;
+    }
+
+    lru_.erase(fentries->second.lru);
+    entries_.erase(fentries);
+}
+
+void Cache::stat(std::ostream &os, const std::string &prefix)
+{
+    counters_.stat(os, prefix);
+    std::unique_lock<std::mutex> lock(mutex_);
+    os << prefix << "size=" << entries_.size() << '\n';
+}
+
+Cache& cache()
+{
+    static Cache cache;
+    return cache;
+}
+
+std::string cacheKey(const GdalWarper::RasterRequest &req
+                     , unsigned int revision)
+{
+    std::ostringstream os;
+    os.precision(std::numeric_limits<double>::max_digits10);
+    os << revision << '|' << int(req.operation) << '|' << req.dataset
+       << '|' << int(req.srs.type) << ':' << req.srs.srs
+       << '|' << req.extents << '|' << req.size
+       << '|' << req.resampling
+       << '|' << (req.mask ? *req.mask : std::string())
+       << '|' << bool(req.nodata) << ':' << (req.nodata ? *req.nodata : 0.0)
+       << '|' << req.aligned;
+    return os.str();
+}
+
+WarpResult warp(GdalWarper &warper, const GdalWarper::RasterRequest &req
+                , Aborter &aborter)
+{
+    try {
+        auto tile(warper.warp(req, aborter));
+        // copy out of warper's shared memory
+        return { std::make_shared<const cv::Mat>(tile->clone()) };
+    } catch (const EmptyImage&) {
+        return {};
+    }
+}
+
+} // namespace
+
+WarpResult cachedWarp(GdalWarper &warper
+                      , const GdalWarper::RasterRequest &request
+                      , unsigned int revision, WarpInterface interface
+                      , Sink &sink)
+{
+    auto &c(cache());
+    const auto key(cacheKey(request, revision));
+    const auto entry(c.get(key, interface));
+
+    if (const auto &promise = entry.second) {
+        // we are the first one, warp and share the result
+        try {
+            auto result(warp(warper, request, sink));
+            promise->set_value(result);
+            return result;
+        } catch (...) {
+            promise->set_exception(std::current_exception());
+            c.forget(key, entry.first);
+            throw;
+        }
+    }
+
+    {
+        // blocked the same way as when waiting for own warp
+        GdalWarper::Waiting waiting(warper);
+        while (entry.first.wait_for(WaitSlice) != std::future_status::ready) {
+            sink.checkAborted();
+        }
+    }
+
+    try {
+        return entry.first.get();
+    } catch (...) {}
+
+    // warp failed in another request (e.g. aborted), do it on our own
+    c.count(interface, WarpOutcome::retry);
+    return warp(warper, request, sink);
+}
+
+void cachedWarpStat(std::ostream &os, const std::string &prefix)
+{
+    cache().stat(os, prefix);
+}
@@ -0,0 +1,86 @@
+/**
+ * Copyright (c) 2019 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef mapproxy_generator_warpcache_hpp_included_
+#define mapproxy_generator_warpcache_hpp_included_
+
+#include <memory>
+#include <string>
+#include <iosfwd>
+
+#include <opencv2/core/core.hpp>
+
+#include "../gdalsupport.hpp"
+#include "../sink.hpp"
+#include "../support/statcounters.hpp"
+
+/** Result of cached image warp.
+ */
+struct WarpResult {
+    /** Warped image. Null when tile has no valid data.
+     */
+    std::shared_ptr<const cv::Mat> image;
+
+    bool empty() const { return !image; }
+};
+
+/** Interface the cached warp is requested through.
+ */
+UTILITY_GENERATE_ENUM(WarpInterface,
+    ((vts))
+    ((atlas))
+    ((wmts))
+)
+
+/** Warps image through process-wide cache of recent warp results.
+ *
+ *  The same tile can be requested through several interfaces (VTS, atlas,
+ *  WMTS), each applying its own optimization and packaging. All of them ask
+ *  for the same underlying warp (request is the cache key), therefore the
+ *  tile is warped once; concurrent callers wait for the first one.
+ *
+ *  Resource revision is part of the cache key: dataset replaced in place
+ *  (with revision bump) is not served from stale results.
+ *
+ *  Request's image operation should be optimizing one: EmptyImage is stored
+ *  as an empty result and it is up to the caller to report it or to
+ *  substitute black image. Other errors are not cached.
+ *
+ *  Waiting for a warp issued by another request is abortable by the sink and
+ *  accounted in warper's waiting clients.
+ *
+ *  Hits and misses are accounted under given interface.
+ */
+WarpResult cachedWarp(GdalWarper &warper
+                      , const GdalWarper::RasterRequest &request
+                      , unsigned int revision, WarpInterface interface
+                      , Sink &sink);
+
+/** Dumps cached warp counters.
+ */
+void cachedWarpStat(std::ostream &os, const std::string &prefix);
+
+#endif // mapproxy_generator_warpcache_hpp_included_
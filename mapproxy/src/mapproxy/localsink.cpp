@@ -0,0 +1,171 @@
+/**
+ * Copyright (c) 2019 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "dbglog/dbglog.hpp"
+
+#include "http/error.hpp"
+
+#include "localsink.hpp"
+
+LocalSink::LocalSink(const Handler &handler)
+    : handler_(handler), delivered_(false), aborted_(false)
+{}
+
+std::future<LocalSink::Response> LocalSink::response()
+{
+    return promise_.get_future();
+}
+
+void LocalSink::deliver(Response &&response)
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (delivered_) {
+            LOG(warn2) << "Response already delivered, ignoring another one.";
+            return;
+        }
+        delivered_ = true;
+    }
+
+    if (handler_) {
+        handler_(std::move(response));
+    } else {
+        promise_.set_value(std::move(response));
+    }
+}
+
+void LocalSink::content_impl(const void *data, std::size_t size
+                             , const FileInfo &stat, bool
+                             , const http::Header::list*)
+{
+    Response r;
+    r.contentType = stat.contentType;
+    r.data.assign(static_cast<const char*>(data), size);
+    deliver(std::move(r));
+}
+
+void LocalSink::content_impl(const DataSource::pointer &source)
+{
+    Response r;
+    r.contentType = source->stat().contentType;
+
+    const auto size(source->size());
+    if (size >= 0) {
+        // known size, read at once
+        r.data.resize(size);
+        std::size_t off(0);
+        while (off < r.data.size()) {
+            const auto read(source->read(&r.data[off], r.data.size() - off
+                                         , off));
+            if (!read) { break; }
+            off += read;
+        }
+        r.data.resize(off);
+    } else {
+        // unknown size, read until end
+        char buf[1 << 16];
+        std::size_t off(0);
+        while (const auto read(source->read(buf, sizeof(buf), off))) {
+            r.data.append(buf, read);
+            off += read;
+        }
+    }
+
+    source->close();
+    deliver(std::move(r));
+}
+
+void LocalSink::error_impl(const std::exception_ptr &exc)
+{
+    Response r;
+
+    try {
+        std::rethrow_exception(exc);
+    } catch (const http::NotFound &e) {
+        r.status = utility::HttpCode::NotFound;
+        r.data = e.what();
+    } catch (const http::BadRequest &e) {
+        r.status = utility::HttpCode::BadRequest;
+        r.data = e.what();
+    } catch (const http::ServiceUnavailable &e) {
+        r.status = utility::HttpCode::ServiceUnavailable;
+        r.data = e.what();
+    } catch (const std::exception &e) {
+        r.status = utility::HttpCode::InternalServerError;
+        r.data = e.what();
+    } catch (...) {
+        r.status = utility::HttpCode::InternalServerError;
+        r.data = "Unknown exception.";
+    }
+
+    deliver(std::move(r));
+}
+
+void LocalSink::listing_impl(const Listing &list, const std::string&
+                             , const std::string&)
+{
+    // plain-text listing, one item per line
+    Response r;
+    r.contentType = "text/plain; charset=utf-8";
+    for (const auto &item : list) {
+        r.data.append(item.name);
+        r.data.push_back('\n');
+    }
+    deliver(std::move(r));
+}
+
+void LocalSink::redirect_impl(const std::string &url, utility::HttpCode code)
+{
+    Response r;
+    r.status = code;
+    r.location = url;
+    deliver(std::move(r));
+}
+
+void LocalSink::setAborter_impl(const AbortedCallback &ac)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    aborter_ = ac;
+}
+
+bool LocalSink::checkAborted_impl() const
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    return aborted_;
+}
+
+void LocalSink::abort()
+{
+    AbortedCallback ac;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (aborted_) { return; }
+        aborted_ = true;
+        ac = aborter_;
+    }
+
+    if (ac) { ac(); }
+}
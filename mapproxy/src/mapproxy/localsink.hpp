@@ -0,0 +1,116 @@
+/**
+ * Copyright (c) 2019 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef mapproxy_localsink_hpp_included_
+#define mapproxy_localsink_hpp_included_
+
+#include <string>
+#include <memory>
+#include <mutex>
+#include <future>
+#include <functional>
+
+#include "utility/httpcode.hpp"
+
+#include "http/contentgenerator.hpp"
+
+/** In-process sink: collects generated content in memory instead of sending
+ *  it over the network. Used by offline tools that drive generators without
+ *  HTTP server.
+ *
+ *  Exactly one response is delivered either to the handler (if provided) or
+ *  via future obtained by response().
+ */
+class LocalSink : public http::ServerSink {
+public:
+    typedef std::shared_ptr<LocalSink> pointer;
+
+    struct Response {
+        /** HTTP status as would be sent to the client.
+         */
+        utility::HttpCode status;
+
+        /** Content type (valid for status OK).
+         */
+        std::string contentType;
+
+        /** Content (status OK) or error message (otherwise).
+         */
+        std::string data;
+
+        /** Redirect location (status 3xx).
+         */
+        std::string location;
+
+        Response() : status(utility::HttpCode::OK) {}
+
+        bool ok() const { return status == utility::HttpCode::OK; }
+    };
+
+    typedef std::function<void(Response&&)> Handler;
+
+    LocalSink(const Handler &handler = Handler());
+
+    /** Future response. Can be called only once. Valid only when no handler
+     *  has been provided.
+     */
+    std::future<Response> response();
+
+    /** Simulates client abort.
+     */
+    void abort();
+
+private:
+    virtual void content_impl(const void *data, std::size_t size
+                              , const FileInfo &stat, bool needCopy
+                              , const http::Header::list *headers);
+
+    virtual void content_impl(const DataSource::pointer &source);
+
+    virtual void error_impl(const std::exception_ptr &exc);
+
+    virtual void listing_impl(const Listing &list
+                              , const std::string &header
+                              , const std::string &footer);
+
+    virtual void redirect_impl(const std::string &url
+                               , utility::HttpCode code);
+
+    virtual void setAborter_impl(const AbortedCallback &ac);
+
+    virtual bool checkAborted_impl() const;
+
+    void deliver(Response &&response);
+
+    mutable std::mutex mutex_;
+    Handler handler_;
+    std::promise<Response> promise_;
+    bool delivered_;
+    bool aborted_;
+    AbortedCallback aborter_;
+};
+
+#endif // mapproxy_localsink_hpp_included_
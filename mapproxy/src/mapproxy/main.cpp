@@ -28,6 +28,7 @@
 #include <utility>
 #include <functional>
 #include <map>
+#include <chrono>
 
 #include <boost/optional.hpp>
 #include <boost/utility/in_place_factory.hpp>
@@ -50,6 +51,7 @@
 #include "http/http.hpp"
 
 #include "support/wmts.hpp"
+#include "support/placement.hpp"
 
 #include "error.hpp"
 #include "resourcebackend.hpp"
@@ -74,8 +76,11 @@ public:
         , httpThreadCount_(boost::thread::hardware_concurrency())
         , httpClientThreadCount_(1)
         , coreThreadCount_(boost::thread::hardware_concurrency())
+        , coreLatency_(corePool_.latency.count())
         , httpEnableBrowser_(false)
     {
+        corePool_.min = 2;
+        corePool_.max = 4 * boost::thread::hardware_concurrency();
         generatorsConfig_.root
             = utility::buildsys::installPath("var/mapproxy/store");
         generatorsConfig_.resourceRoot
@@ -141,7 +146,11 @@ private:
     unsigned int httpThreadCount_;
     unsigned int httpClientThreadCount_;
     unsigned int coreThreadCount_;
+    ThreadPool::Config corePool_;
+    long coreLatency_;
     bool httpEnableBrowser_;
+    CpuSet httpCpus_;
+    CpuSet coreCpus_;
     ResourceBackend::GenericConfig resourceBackendGenericConfig_;
     ResourceBackend::TypedConfig resourceBackendConfig_;
     vs::SupportFile::Vars variables_;
@@ -185,7 +194,23 @@ void Daemon::configuration(po::options_description &cmdline
 
         ("core.threadCount", po::value(&coreThreadCount_)
          ->default_value(coreThreadCount_)->required()
-         , "Number of processing threads.")
+         , "Number of processing threads (initial number "
+         "when core.adaptive is on).")
+        ("core.adaptive", po::value(&corePool_.adaptive)
+         ->default_value(corePool_.adaptive)->required()
+         , "Grow and shrink processing pool between core.minThreadCount "
+         "and core.maxThreadCount based on queue length, threads waiting "
+         "for GDAL and queueing latency.")
+        ("core.minThreadCount", po::value(&corePool_.min)
+         ->default_value(corePool_.min)->required()
+         , "Minimum number of processing threads in adaptive mode.")
+        ("core.maxThreadCount", po::value(&corePool_.max)
+         ->default_value(corePool_.max)->required()
+         , "Maximum number of processing threads in adaptive mode.")
+        ("core.latencyThreshold", po::value(&coreLatency_)
+         ->default_value(coreLatency_)->required()
+         , "Queueing latency (in milliseconds) above which adaptive "
+         "processing pool grows.")
 
         ("gdal.processCount"
          , po::value(&gdalWarperOptions_.processCount)
@@ -204,6 +229,37 @@ void Daemon::configuration(po::options_description &cmdline
          ->default_value(gdalWarperOptions_.rssCheckPeriod)->required()
          , "Memory check period (in seconds)")
 
+        ("gdal.hugePages"
+         , po::value(&gdalWarperOptions_.hugePages)
+         ->default_value(gdalWarperOptions_.hugePages)->required()
+         , utility::concat
+         ("Huge page backing of GDAL shared memory, one of "
+          , enumerationString(HugePages{}), "; transparent needs THP "
+          "enabled for shared memory, hugetlb needs reserved huge pages. "
+          "Falls back to regular pages when unavailable.").c_str())
+
+        ("placement.http", po::value(&httpCpus_)
+         , "CPUs (cpulist syntax, e.g. 0-7,16-23) for HTTP server and "
+         "client threads. Placed by OS scheduler if not set.")
+        ("placement.core", po::value(&coreCpus_)
+         , "CPUs (cpulist syntax) for core processing threads. Placed by "
+         "OS scheduler if not set.")
+        ("placement.gdal", po::value(&gdalWarperOptions_.cpus)
+         , "CPUs (cpulist syntax) for GDAL processes. Placed by "
+         "OS scheduler if not set.")
+        ("placement.gdalNumaSpread"
+         , po::value(&gdalWarperOptions_.numaSpread)
+         ->default_value(gdalWarperOptions_.numaSpread)->required()
+         , "Distribute GDAL worker processes evenly across NUMA nodes "
+         "(of placement.gdal CPUs); each worker is pinned to one node.")
+        ("placement.shmPolicy"
+         , po::value(&gdalWarperOptions_.shmPolicy)
+         ->default_value(gdalWarperOptions_.shmPolicy)->required()
+         , utility::concat
+         ("NUMA policy of GDAL shared memory (interleave or bind to NUMA "
+          "nodes of placement.gdal CPUs, all nodes if not set); one of "
+          , enumerationString(MemoryPolicy{}), ".").c_str())
+
         ("resource-backend.type"
          , po::value(&resourceBackendConfig_.type)->required()
          , ("Resource backend type, possible values: "
@@ -283,6 +339,16 @@ void Daemon::configure(const po::variables_map &vars)
 
     gdalWarperOptions_.tmpRoot = fs::absolute(gdalWarperOptions_.tmpRoot);
 
+    corePool_.size = coreThreadCount_;
+    corePool_.latency = std::chrono::milliseconds(coreLatency_);
+    if (corePool_.adaptive
+        && (!corePool_.min || (corePool_.min > corePool_.max)))
+    {
+        throw po::validation_error
+            (po::validation_error::invalid_option_value
+             , "core.minThreadCount");
+    }
+
     {
         const auto &value(vars["resource-backend.freeze"].as<std::string>());
         std::vector<std::string> parts;
@@ -315,8 +381,19 @@ void Daemon::configure(const po::variables_map &vars)
         << "\n\thttp.client.threadCount = " << httpClientThreadCount_
         << "\n\thttp.enableBrowser = " << std::boolalpha << httpEnableBrowser_
         << "\n\tcore.threadCount = " << coreThreadCount_
+        << "\n\tcore.adaptive = " << corePool_.adaptive
+        << "\n\tcore.minThreadCount = " << corePool_.min
+        << "\n\tcore.maxThreadCount = " << corePool_.max
+        << "\n\tcore.latencyThreshold = " << coreLatency_
         << "\n\tgdal.processCount = " << gdalWarperOptions_.processCount
         << "\n\tgdal.tmpRoot = " << gdalWarperOptions_.tmpRoot
+        << "\n\tgdal.hugePages = " << gdalWarperOptions_.hugePages
+        << "\n\tplacement.http = [" << httpCpus_ << "]"
+        << "\n\tplacement.core = [" << coreCpus_ << "]"
+        << "\n\tplacement.gdal = [" << gdalWarperOptions_.cpus << "]"
+        << "\n\tplacement.gdalNumaSpread = "
+        << gdalWarperOptions_.numaSpread
+        << "\n\tplacement.shmPolicy = " << gdalWarperOptions_.shmPolicy
         << "\n\tresource-backend.updatePeriod = "
         << generatorsConfig_.resourceUpdatePeriod
         << "\n\tresource-backend.root = "
@@ -379,6 +456,11 @@ service::Service::Cleanup Daemon::start()
 
     auto guard(std::make_shared<Stopper>(*this));
 
+    for (const auto &node : numaNodes()) {
+        LOG(info3) << "NUMA node " << node.id << ": CPUs ["
+                   << node.cpus << "].";
+    }
+
     // warper must be first since it uses processes
     gdalWarper_ = boost::in_place(gdalWarperOptions_, std::ref(*this));
 
@@ -391,15 +473,23 @@ service::Service::Cleanup Daemon::start()
                         ("%s/%s", utility::buildsys::TargetName
                          , utility::buildsys::TargetVersion));
 
-    http_->startClient(httpClientThreadCount_);
+    {
+        // HTTP threads inherit placement of spawning thread
+        ScopedPlacement placement(httpCpus_, "http.client");
+        http_->startClient(httpClientThreadCount_);
+    }
 
     // starts core + generators
     core_ = boost::in_place(std::ref(*generators_), std::ref(*gdalWarper_)
-                            , coreThreadCount_
-                            , std::ref(http_->fetcher()));
+                            , std::cref(corePool_)
+                            , std::ref(http_->fetcher())
+                            , std::cref(coreCpus_));
 
-    http_->listen(httpListen_, std::ref(*core_));
-    http_->startServer(httpThreadCount_);
+    {
+        ScopedPlacement placement(httpCpus_, "http.server");
+        http_->listen(httpListen_, std::ref(*core_));
+        http_->startServer(httpThreadCount_);
+    }
 
     return guard;
 }
@@ -419,12 +509,13 @@ void Daemon::cleanup()
 void Daemon::stat(std::ostream &os)
 {
     http_->stat(os);
+    core_->stat(os);
     gdalWarper_->stat(os);
 }
 
 void Daemon::monitor(std::ostream &os)
 {
-    (void) os;
+    if (core_) { core_->monitor(os); }
 }
 
 inline void sendBoolean(std::ostream &os, bool value)
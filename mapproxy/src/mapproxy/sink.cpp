@@ -24,6 +24,8 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <algorithm>
+
 #include <boost/lexical_cast.hpp>
 #include <boost/format.hpp>
 
@@ -159,15 +161,57 @@ private:
     http::Header::list headers_;
 };
 
+class BufferDataSource : public http::ServerSink::DataSource {
+public:
+    BufferDataSource(const std::shared_ptr<const std::string> &data
+                     , const Sink::FileInfo &stat)
+        : data_(data), stat_(stat)
+    {}
+
+    virtual http::SinkBase::FileInfo stat() const { return stat_; }
+
+    virtual std::size_t read(char *buf, std::size_t size
+                             , std::size_t off)
+    {
+        if (off >= data_->size()) { return 0; }
+        size = std::min(size, data_->size() - off);
+        std::copy(data_->data() + off, data_->data() + off + size, buf);
+        return size;
+    }
+
+    virtual std::string name() const { return "buffer"; }
+
+    virtual void close() const {}
+
+    virtual long size() const { return data_->size(); }
+
+    virtual const http::Header::list *headers() const {
+        return &stat_.headers;
+    }
+
+private:
+    std::shared_ptr<const std::string> data_;
+    Sink::FileInfo stat_;
+};
+
 } //namesapce
 
+void Sink::content(const std::shared_ptr<const std::string> &data
+                   , const FileInfo &stat)
+{
+    charge(data->size());
+    sink_->content(std::make_shared<BufferDataSource>(data, update(stat)));
+}
+
 void Sink::content(const vs::IStream::pointer &stream, FileClass fileClass
                    , const http::SinkBase::CacheControl &cacheControl
                    , bool gzipped)
 {
-    sink_->content(std::make_shared<IStreamDataSource>
-                   (stream, fileClass, fileClassSettings_, cacheControl
-                    , gzipped));
+    auto source(std::make_shared<IStreamDataSource>
+                (stream, fileClass, fileClassSettings_, cacheControl
+                 , gzipped));
+    charge(source->size());
+    sink_->content(source);
 }
 
 void Sink::error(const std::exception_ptr &exc)
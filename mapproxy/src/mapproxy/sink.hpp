@@ -43,6 +43,7 @@
 
 #include "support/fileclass.hpp"
 #include "support/aborter.hpp"
+#include "support/accounting.hpp"
 
 namespace vs = vtslibs::storage;
 
@@ -106,6 +107,14 @@ public:
     void content(const void *data, std::size_t size
                  , const FileInfo &stat, bool needCopy);
 
+    /** Sends shared immutable buffer to client. Buffer is not copied, it is
+     *  held until sent.
+     * \param data data to send
+     * \param stat file info (size is ignored)
+     */
+    void content(const std::shared_ptr<const std::string> &data
+                 , const FileInfo &stat);
+
     /** Sends content to client.
      * \param stream stream to send
      * \param fileclass file class
@@ -159,6 +168,16 @@ public:
      */
     void assignFileClassSettings(const FileClassSettings &fileClasssettings);
 
+    /** Assigns accounting record to be charged with sent data.
+     */
+    void assignAccounting(const Accounting::Record::pointer &record) {
+        accounting_ = record;
+    }
+
+    const Accounting::Record::pointer& accounting() const {
+        return accounting_;
+    }
+
 private:
     /** Sends given error to the client.
      */
@@ -166,9 +185,15 @@ private:
 
     FileInfo update(const FileInfo &stat) const;
 
+    void charge(std::size_t size) const {
+        if (accounting_) { accounting_->output(size); }
+    }
+
     http::ServerSink::pointer sink_;
 
     const FileClassSettings *fileClassSettings_;
+
+    Accounting::Record::pointer accounting_;
 };
 
 /** Formats markdown as a HTML.
@@ -190,17 +215,20 @@ inline void Sink::error(const T &exc)
 inline void Sink::error() { error(std::current_exception()); }
 
 inline void Sink::content(const std::string &data, const FileInfo &stat) {
+    charge(data.size());
     sink_->content(data, update(stat), &stat.headers);
 }
 
 template <typename T>
 inline void Sink::content(const std::vector<T> &data, const FileInfo &stat) {
+    charge(data.size() * sizeof(T));
     sink_->content(data, update(stat), &stat.headers);
 }
 
 inline void Sink::content(const void *data, std::size_t size
                           , const FileInfo &stat, bool needCopy)
 {
+    charge(size);
     sink_->content(data, size, update(stat), needCopy, &stat.headers);
 }
 
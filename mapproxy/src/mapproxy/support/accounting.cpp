@@ -0,0 +1,207 @@
+/**
+ * Copyright (c) 2019 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <ctime>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <ostream>
+
+#include <boost/format.hpp>
+
+#include "accounting.hpp"
+
+namespace {
+
+thread_local Accounting::Record *currentRecord(nullptr);
+
+typedef std::pair<std::string, Accounting::Usage> Entry;
+typedef std::vector<Entry> Entries;
+
+struct Metric {
+    const char *name;
+    std::function<std::int64_t(const Accounting::Usage&)> value;
+};
+
+const std::vector<Metric> metrics = {
+    { "requests", [](const Accounting::Usage &u) -> std::int64_t
+      { return u.requests; } }
+    , { "coreCpuUs", [](const Accounting::Usage &u) -> std::int64_t
+        { return u.coreCpu / 1000; } }
+    , { "gdalCpuUs", [](const Accounting::Usage &u) -> std::int64_t
+        { return u.gdalCpu / 1000; } }
+    , { "shmBytes", [](const Accounting::Usage &u) -> std::int64_t
+        { return u.shm; } }
+    , { "outputBytes", [](const Accounting::Usage &u) -> std::int64_t
+        { return u.output; } }
+    , { "datasetCacheBytes", [](const Accounting::Usage &u) -> std::int64_t
+        { return u.datasetCache; } }
+};
+
+void writeTop(std::ostream &os, const std::string &prefix
+              , Entries entries, std::size_t top)
+{
+    for (const auto &metric : metrics) {
+        const auto n(std::min(top, entries.size()));
+        std::partial_sort(entries.begin(), entries.begin() + n
+                          , entries.end()
+                          , [&](const Entry &l, const Entry &r)
+        {
+            return metric.value(l.second) > metric.value(r.second);
+        });
+
+        for (std::size_t i(0); i < n; ++i) {
+            const auto value(metric.value(entries[i].second));
+            if (!value) { break; }
+            os << prefix << metric.name << '.' << (i + 1) << '='
+               << value << ' ' << entries[i].first << '\n';
+        }
+    }
+}
+
+} // namespace
+
+std::uint64_t threadCpuTime()
+{
+    struct ::timespec ts;
+    if (::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == -1) { return 0; }
+    return std::uint64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+std::uint64_t processCpuTime()
+{
+    struct ::timespec ts;
+    if (::clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts) == -1) { return 0; }
+    return std::uint64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+Accounting::Usage& Accounting::Usage::operator+=(const Usage &o)
+{
+    requests += o.requests;
+    coreCpu += o.coreCpu;
+    gdalCpu += o.gdalCpu;
+    shm += o.shm;
+    output += o.output;
+    datasetCache += o.datasetCache;
+    return *this;
+}
+
+Accounting::Usage Accounting::Record::usage() const
+{
+    Usage u;
+    u.requests = requests_;
+    u.coreCpu = coreCpu_;
+    u.gdalCpu = gdalCpu_;
+    u.shm = shm_;
+    u.output = output_;
+    u.datasetCache = datasetCache_;
+    return u;
+}
+
+Accounting::Record::pointer
+Accounting::record(const std::string &resource, const std::string &fileType)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto &record(records_[Key(resource, fileType)]);
+    if (!record) { record = std::make_shared<Record>(); }
+    return record;
+}
+
+Accounting::Scope::Scope(const Record::pointer &record)
+    : record_(record.get()), saved_(currentRecord)
+    , start_(record_ ? threadCpuTime() : 0)
+{
+    currentRecord = record_;
+}
+
+Accounting::Scope::~Scope()
+{
+    if (record_) { record_->coreCpu(threadCpuTime() - start_); }
+    currentRecord = saved_;
+}
+
+void Accounting::gdal(std::uint64_t cpu, std::uint64_t shm
+                      , std::int64_t datasetCache)
+{
+    if (currentRecord) { currentRecord->gdal(cpu, shm, datasetCache); }
+}
+
+void Accounting::stat(std::ostream &os, const std::string &prefix
+                      , std::size_t top) const
+{
+    Entries records;
+    std::map<std::string, Usage> resources;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        for (const auto &item : records_) {
+            const auto usage(item.second->usage());
+            records.emplace_back(item.first.first + ' ' + item.first.second
+                                 , usage);
+            resources[item.first.first] += usage;
+        }
+    }
+
+    os << prefix << "records=" << records.size() << '\n'
+       << prefix << "resources=" << resources.size() << '\n';
+
+    writeTop(os, prefix + "top.", records, top);
+    writeTop(os, prefix + "resource.top."
+             , Entries(resources.begin(), resources.end()), top);
+}
+
+void Accounting::monitor(std::ostream &os, std::size_t top) const
+{
+    Entries records;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        for (const auto &item : records_) {
+            records.emplace_back(item.first.first + ' ' + item.first.second
+                                 , item.second->usage());
+        }
+    }
+
+    const auto n(std::min(top, records.size()));
+    std::partial_sort(records.begin(), records.begin() + n, records.end()
+                      , [&](const Entry &l, const Entry &r)
+    {
+        return ((l.second.coreCpu + l.second.gdalCpu)
+                > (r.second.coreCpu + r.second.gdalCpu));
+    });
+
+    const double ms(1e6);
+    const double mb(1 << 20);
+
+    os << boost::format("%-60s %10s %12s %12s %10s %10s %10s\n")
+        % "resource file-type" % "requests" % "coreCpu[ms]"
+        % "gdalCpu[ms]" % "shm[MB]" % "output[MB]" % "cache[MB]";
+    for (std::size_t i(0); i < n; ++i) {
+        const auto &u(records[i].second);
+        os << boost::format("%-60s %10d %12.1f %12.1f %10.1f %10.1f %10.1f\n")
+            % records[i].first % u.requests
+            % (u.coreCpu / ms) % (u.gdalCpu / ms)
+            % (u.shm / mb) % (u.output / mb) % (u.datasetCache / mb);
+    }
+}
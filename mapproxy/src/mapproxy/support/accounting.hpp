@@ -0,0 +1,162 @@
+/**
+ * Copyright (c) 2019 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef mapproxy_support_accounting_hpp_included_
+#define mapproxy_support_accounting_hpp_included_
+
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <cstdint>
+#include <iosfwd>
+
+#include <boost/noncopyable.hpp>
+
+/** CPU time consumed by calling thread (ns).
+ */
+std::uint64_t threadCpuTime();
+
+/** CPU time consumed by all threads of calling process (ns).
+ */
+std::uint64_t processCpuTime();
+
+/** Per-resource usage accounting.
+ *
+ *  Usage is charged to records identified by resource and file type. Record
+ *  of the request processed by the calling thread is installed by
+ *  Accounting::Scope; code deeper in the stack (GDAL warper client) charges
+ *  the current record via Accounting::gdal().
+ */
+class Accounting : boost::noncopyable {
+public:
+    struct Usage {
+        std::uint64_t requests;
+
+        /** CPU time in core threads (ns).
+         */
+        std::uint64_t coreCpu;
+
+        /** CPU time in GDAL workers (ns).
+         */
+        std::uint64_t gdalCpu;
+
+        /** Bytes passed through GDAL shared memory.
+         */
+        std::uint64_t shm;
+
+        /** Bytes sent to clients.
+         */
+        std::uint64_t output;
+
+        /** Dataset (block) cache growth in GDAL workers (bytes).
+         */
+        std::int64_t datasetCache;
+
+        Usage()
+            : requests(), coreCpu(), gdalCpu(), shm(), output()
+            , datasetCache()
+        {}
+
+        Usage& operator+=(const Usage &o);
+    };
+
+    class Record : boost::noncopyable {
+    public:
+        typedef std::shared_ptr<Record> pointer;
+
+        Record()
+            : requests_(0), coreCpu_(0), gdalCpu_(0), shm_(0), output_(0)
+            , datasetCache_(0)
+        {}
+
+        void request() { ++requests_; }
+        void coreCpu(std::uint64_t ns) { coreCpu_ += ns; }
+        void gdal(std::uint64_t cpu, std::uint64_t shm
+                  , std::int64_t datasetCache)
+        {
+            gdalCpu_ += cpu; shm_ += shm; datasetCache_ += datasetCache;
+        }
+        void output(std::uint64_t bytes) { output_ += bytes; }
+
+        Usage usage() const;
+
+    private:
+        std::atomic<std::uint64_t> requests_;
+        std::atomic<std::uint64_t> coreCpu_;
+        std::atomic<std::uint64_t> gdalCpu_;
+        std::atomic<std::uint64_t> shm_;
+        std::atomic<std::uint64_t> output_;
+        std::atomic<std::int64_t> datasetCache_;
+    };
+
+    Accounting() {}
+
+    /** Returns (creates on demand) record for given resource and file type.
+     */
+    Record::pointer record(const std::string &resource
+                           , const std::string &fileType);
+
+    /** Installs record as current for calling thread and charges CPU time
+     *  consumed by the thread during its lifetime to it.
+     */
+    class Scope : boost::noncopyable {
+    public:
+        Scope(const Record::pointer &record);
+        ~Scope();
+
+    private:
+        Record *record_;
+        Record *saved_;
+        std::uint64_t start_;
+    };
+
+    /** Charges GDAL worker usage to current record (if any).
+     */
+    static void gdal(std::uint64_t cpu, std::uint64_t shm
+                     , std::int64_t datasetCache);
+
+    /** Writes top N records and top N resources for each metric in stat
+     *  (key=value) format.
+     */
+    void stat(std::ostream &os, const std::string &prefix
+              , std::size_t top) const;
+
+    /** Writes human readable table of top N records ordered by total CPU
+     *  time.
+     */
+    void monitor(std::ostream &os, std::size_t top) const;
+
+private:
+    typedef std::pair<std::string, std::string> Key;
+    typedef std::map<Key, Record::pointer> Records;
+
+    mutable std::mutex mutex_;
+    Records records_;
+};
+
+#endif // mapproxy_support_accounting_hpp_included_
@@ -24,6 +24,8 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <ostream>
+
 #include <opencv2/highgui/highgui.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
 
@@ -35,6 +37,44 @@
 
 namespace vr = vtslibs::registry;
 
+namespace {
+
+UTILITY_GENERATE_ENUM(WatertightOutcome,
+    ((skipped))
+    ((computed))
+)
+
+typedef StatCounters<TileOperation, TileOperations
+                     , WatertightOutcome, 2> WatertightCounters;
+
+WatertightCounters& watertightCounters()
+{
+    static WatertightCounters counters;
+    return counters;
+}
+
+} // namespace
+
+bool watertightTile(vts::TileIndex::Flag::value_type flags
+                    , TileOperation operation)
+{
+    // NB: mesh flag must be present as well, watertight flag alone marks
+    // internal node in mmapped tile index
+    const bool watertight
+        ((flags & vts::TileIndex::Flag::mesh)
+         && (flags & vts::TileIndex::Flag::watertight));
+
+    watertightCounters().count(operation
+                               , (watertight ? WatertightOutcome::skipped
+                                  : WatertightOutcome::computed));
+    return watertight;
+}
+
+void watertightStat(std::ostream &os, const std::string &prefix)
+{
+    watertightCounters().stat(os, prefix);
+}
+
 vts::NodeInfo::CoverageMask
 generateCoverage(const int size, const vts::NodeInfo &nodeInfo
                  , const MaskTree &maskTree
@@ -60,6 +100,27 @@ generateCoverage(const int size, const vts::NodeInfo &nodeInfo
     // tile size in pixels
     const int ws(1 << detail);
 
+    // check precomputed pyramid first; mask of neighbouring tiles leaks into
+    // this tile's margin and dilation (at most 4 pixels) -> whole
+    // neighbourhood must agree and tile must be big enough
+    if (const auto *pyramid = maskTree.pyramid()) {
+        if (ws >= 4) {
+            switch (pyramid->neighbourhood(nodeInfo.nodeId())) {
+            case MaskPyramid::Coverage::full:
+                // fully covered -> only node's coverage applies
+                return coverage;
+
+            case MaskPyramid::Coverage::empty:
+                // nothing is valid
+                return vts::NodeInfo::CoverageMask
+                    (gridSize.width, gridSize.height
+                     , vts::NodeInfo::CoverageMask::EMPTY);
+
+            default: break;
+            }
+        }
+    }
+
     // margin added around mask (2 by default, reset to 0 if
     const int margin([&]() -> int
     {
@@ -202,11 +263,26 @@ generateCoverage(const int size, const vts::NodeInfo &nodeInfo
 }
 
 cv::Mat boundlayerMask(const vts::TileId &coarseTileId
-                       , const imgproc::mappedqtree::RasterMask &maskTree)
+                       , const MaskTree &maskTree)
 {
     cv::Mat mask(vr::BoundLayer::tileHeight, vr::BoundLayer::tileWidth
                  , CV_8UC1, cv::Scalar(0x00));
 
+    // check precomputed pyramid first; no dilation here -> no need to check
+    // neighbours
+    if (const auto *pyramid = maskTree.pyramid()) {
+        switch (pyramid->coverage(coarseTileId)) {
+        case MaskPyramid::Coverage::full:
+            mask = cv::Scalar(0xff);
+            return mask;
+
+        case MaskPyramid::Coverage::empty:
+            return mask;
+
+        default: break;
+        }
+    }
+
     // map to detailed tileId
     vts::TileId tileId(coarseTileId.lod + vr::BoundLayer::binaryOrder
                          , coarseTileId.x << vr::BoundLayer::binaryOrder
@@ -28,25 +28,49 @@
 #define mapproxy_support_coverage_hpp_included_
 
 
+#include <iosfwd>
+#include <string>
+
 #include "vts-libs/vts/nodeinfo.hpp"
-#include "imgproc/rastermask/mappedqtree.hpp"
+#include "vts-libs/vts/tileindex.hpp"
 
-namespace vts = vtslibs::vts;
+#include "masktree.hpp"
+#include "statcounters.hpp"
 
-typedef imgproc::mappedqtree::RasterMask MaskTree;
+namespace vts = vtslibs::vts;
 
 /** Complex converage, used for surface mask.
+ *
+ *  Mask tree rasterization is skipped when mask tree's pyramid says the tile
+ *  and its neighbours are completely full or empty.
  */
 vts::NodeInfo::CoverageMask
 generateCoverage(const int size, const vts::NodeInfo &nodeInfo
-                 , const imgproc::mappedqtree::RasterMask &maskTree
+                 , const MaskTree &maskTree
                  , vts::NodeInfo::CoverageType type
                  = vts::NodeInfo::CoverageType::pixel);
 
 /** Boundlayer mask, used for TMS mask.
+ *
+ *  Mask tree rasterization is skipped when mask tree's pyramid says the tile
+ *  is completely full or empty.
  */
 cv::Mat boundlayerMask(const vts::TileId &tileId, const MaskTree &maskTree);
 
+/** Watertight (fully covered) tile shortcut: tile index says there are no
+ *  holes in tile's data, therefore no mask needs to be computed (or warped)
+ *  for it.
+ *
+ *  Outcome is accounted under given operation as either "skipped" or
+ *  "computed".
+ */
+bool watertightTile(vts::TileIndex::Flag::value_type flags
+                    , TileOperation operation);
+
+/** Dumps watertight shortcut counters.
+ */
+void watertightStat(std::ostream &os, const std::string &prefix);
+
 /** Helper for positive/negative bit shift
  */
 template <typename T>
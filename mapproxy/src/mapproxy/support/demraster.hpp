@@ -0,0 +1,49 @@
+/**
+ * Copyright (c) 2019 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef mapproxy_support_demraster_hpp_included_
+#define mapproxy_support_demraster_hpp_included_
+
+#include <opencv2/core/core.hpp>
+
+/** Sample access to DEM rasters returned by GdalWarper (dem/demOptimal: single
+ *  channel, valueMinMax: 3 channels) stored either in double or float
+ *  precision (see GdalWarper::RasterRequest::SampleType).
+ */
+
+inline double demValue(const cv::Mat &dem, int x, int y)
+{
+    if (dem.depth() == CV_32F) { return dem.at<float>(y, x); }
+    return dem.at<double>(y, x);
+}
+
+inline cv::Vec3d demValueMinMax(const cv::Mat &dem, int x, int y)
+{
+    if (dem.depth() == CV_32F) { return dem.at<cv::Vec3f>(y, x); }
+    return dem.at<cv::Vec3d>(y, x);
+}
+
+#endif // mapproxy_support_demraster_hpp_included_
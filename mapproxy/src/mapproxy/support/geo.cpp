@@ -24,6 +24,13 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <map>
+#include <cmath>
+#include <tuple>
+#include <utility>
+
+#include "dbglog/dbglog.hpp"
+
 #include "math/math.hpp"
 
 #include "geo/csconvertor.hpp"
@@ -34,13 +41,15 @@
 
 namespace ublas = boost::numeric::ublas;
 
-double tileCircumference(const math::Extents2 &extents
-                         , const geo::SrsDefinition &srs
-                         , const geo::GeoDataset &dataset
-                         , int samples)
-{
-    geo::CsConvertor conv(srs, dataset.srs());
+namespace {
 
+/** Measures tile circumference in raster (pixel) coordinates. Point in tile
+ *  SRS is converted to raster by toRaster.
+ */
+template <typename ToRaster>
+double circumference(const math::Extents2 &extents, int samples
+                     , const ToRaster &toRaster)
+{
     auto es(math::size(extents));
     math::Size2f step(es.width / samples, es.height / samples);
 
@@ -48,11 +57,11 @@ double tileCircumference(const math::Extents2 &extents
 
     try {
         // previous point, i.e. first
-        auto prev(dataset.geo2raster<math::Point2>(conv(extents.ll)));
+        auto prev(toRaster(extents.ll));
 
         auto add([&](const math::Point2 &p)
         {
-            auto px(dataset.geo2raster<math::Point2>(conv(p)));
+            auto px(toRaster(p));
             length += boost::numeric::ublas::norm_2(px - prev);
             prev = px;
         });
@@ -83,6 +92,130 @@ double tileCircumference(const math::Extents2 &extents
     return length;
 }
 
+/** Convertor from tile SRS to dataset SRS used by tileOverzoom. Convertors
+ *  are expensive to create and must not be shared between threads, therefore
+ *  they are cached per thread.
+ */
+geo::CsConvertor& overzoomConvertor(const geo::SrsDefinition &srs
+                                    , const geo::SrsDefinition &datasetSrs)
+{
+    typedef std::map<std::string, geo::CsConvertor> Convertors;
+    thread_local Convertors convertors;
+
+    // there are only few SRS pairs in practice, keep the cache bounded anyway
+    const std::size_t Capacity(64);
+
+    const auto key(std::to_string(int(srs.type)) + ':' + srs.srs + '|'
+                   + std::to_string(int(datasetSrs.type)) + ':'
+                   + datasetSrs.srs);
+
+    auto fconvertors(convertors.find(key));
+    if (fconvertors != convertors.end()) { return fconvertors->second; }
+
+    if (convertors.size() >= Capacity) { convertors.clear(); }
+
+    return convertors.emplace(std::piecewise_construct
+                              , std::forward_as_tuple(key)
+                              , std::forward_as_tuple(srs, datasetSrs))
+        .first->second;
+}
+
+} // namespace
+
+double tileCircumference(const math::Extents2 &extents
+                         , const geo::SrsDefinition &srs
+                         , const geo::GeoDataset &dataset
+                         , int samples)
+{
+    geo::CsConvertor conv(srs, dataset.srs());
+
+    return circumference(extents, samples, [&](const math::Point2 &p)
+    {
+        return dataset.geo2raster<math::Point2>(conv(p));
+    });
+}
+
+double tileOverzoom(const math::Extents2 &extents
+                    , const geo::SrsDefinition &srs
+                    , const math::Size2 &size
+                    , const geo::GeoDataset::Descriptor &dataset
+                    , int samples)
+{
+    try {
+        auto &conv(overzoomConvertor(srs, dataset.srs));
+
+        // pixel size of (north-up) dataset
+        const auto des(math::size(dataset.extents));
+        const math::Size2f px(des.width / dataset.size.width
+                              , des.height / dataset.size.height);
+        const auto &origin(dataset.extents);
+
+        const auto length
+            (circumference(extents, samples, [&](const math::Point2 &p)
+            {
+                const auto g(conv(p));
+                return math::Point2((g(0) - origin.ll(0)) / px.width
+                                    , (origin.ur(1) - g(1)) / px.height);
+            }));
+
+        if (!std::isfinite(length) || (length <= 0.0)) { return 0.0; }
+        return (2.0 * (size.width + size.height)) / length;
+    } catch (const std::exception &e) {
+        LOG(debug) << "Cannot compute tile overzoom (tile SRS <"
+                   << srs.srs << ">, dataset SRS <" << dataset.srs.srs
+                   << ">): <" << e.what() << ">.";
+    }
+
+    return 0.0;
+}
+
+int gridAlignment(const math::Extents2 &extents
+                  , const geo::SrsDefinition &srs
+                  , const math::Size2 &size
+                  , const geo::GeoDataset::Descriptor &dataset)
+{
+    // tolerance in dataset pixels
+    const double eps(1e-3);
+
+    try {
+        const auto tileSrs(srs.reference());
+        const auto datasetSrs(dataset.srs.reference());
+        if (!tileSrs.IsSame(&datasetSrs)) { return -1; }
+    } catch (...) {
+        return -1;
+    }
+
+    const auto des(math::size(dataset.extents));
+    const math::Size2f px(des.width / dataset.size.width
+                          , des.height / dataset.size.height);
+    const auto es(math::size(extents));
+
+    // scale (tile pixel in dataset pixels) must be the same power of two in
+    // both directions
+    const auto scale(es.width / size.width / px.width);
+    if ((scale < (1.0 - eps))
+        || (std::abs(es.height / size.height / px.height - scale) > eps))
+    {
+        return -1;
+    }
+
+    const int k(int(std::lround(std::log2(scale))));
+    if (std::abs(std::ldexp(1.0, k) - scale) > eps) { return -1; }
+
+    // upper-left corner must lie on pixel boundary
+    const auto onGrid([&](double value) -> bool
+    {
+        return std::abs(value - std::round(value)) <= eps;
+    });
+
+    if (!onGrid((extents.ll(0) - dataset.extents.ll(0)) / px.width)
+        || !onGrid((dataset.extents.ur(1) - extents.ur(1)) / px.height))
+    {
+        return -1;
+    }
+
+    return k;
+}
 
 math::Extents2 extentsPlusHalfPixel(const math::Extents2 &extents
                                     , const math::Size2 &pixels)
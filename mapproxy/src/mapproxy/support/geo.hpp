@@ -59,6 +59,27 @@ double tileCircumference(const math::Extents2 &extents
                          , const geo::GeoDataset &dataset
                          , int samples = 20);
 
+/** Tile overzoom: number of tile pixels per one dataset pixel, measured
+ *  along tile circumference. Dataset is expected to be north-up. Returns
+ *  zero if tile cannot be converted to dataset SRS. SRS convertor is cached
+ *  per calling thread.
+ */
+double tileOverzoom(const math::Extents2 &extents
+                    , const geo::SrsDefinition &srs
+                    , const math::Size2 &size
+                    , const geo::GeoDataset::Descriptor &dataset
+                    , int samples = 20);
+
+/** Tile grid alignment with (north-up) dataset pixels: tile must be in
+ *  dataset SRS, tile pixel must be 2^k dataset pixels (k >= 0) and tile's
+ *  upper-left corner must lie on dataset pixel boundary. Returns k or -1
+ *  when not aligned.
+ */
+int gridAlignment(const math::Extents2 &extents
+                  , const geo::SrsDefinition &srs
+                  , const math::Size2 &size
+                  , const geo::GeoDataset::Descriptor &dataset);
+
 math::Extents2 extentsPlusHalfPixel(const math::Extents2 &extents
                                     , const math::Size2 &pixels);
 
@@ -0,0 +1,165 @@
+/**
+ * Copyright (c) 2019 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <boost/filesystem.hpp>
+
+#include "dbglog/dbglog.hpp"
+
+#include "utility/path.hpp"
+
+#include "vts-libs/vts/tileop.hpp"
+
+#include "masktree.hpp"
+
+namespace fs = boost::filesystem;
+
+namespace {
+
+typedef vts::TileIndex::Flag TiFlag;
+
+const TiFlag::value_type PartialFlag(TiFlag::mesh);
+const TiFlag::value_type FullFlag(TiFlag::mesh | TiFlag::watertight);
+
+} // namespace
+
+MaskPyramid::MaskPyramid(const imgproc::mappedqtree::RasterMask &maskTree
+                         , vts::Lod bottomLod)
+    : bottomLod_(std::min(bottomLod, vts::Lod(maskTree.depth())))
+{
+    typedef imgproc::mappedqtree::RasterMask RasterMask;
+
+    index_.makeAvailable(vts::LodRange(0, bottomLod_));
+
+    // same classification as used in prepareTileIndex
+    const auto treeDepth(maskTree.depth());
+    for (vts::Lod lod(0); lod <= bottomLod_; ++lod) {
+        maskTree.forEachQuad([&](RasterMask::Node node
+                                 , boost::tribool value)
+        {
+            // empty -> nothing to be done
+            if (!value) { return; }
+
+            // update node to match lod grid
+            node.shift(treeDepth - lod);
+
+            index_.set(lod, vts::TileRange
+                       (node.x, node.y
+                        , node.x + node.size - 1, node.y + node.size - 1)
+                       , (value ? FullFlag : PartialFlag));
+        }, RasterMask::Constraints(lod));
+    }
+}
+
+MaskPyramid::MaskPyramid(const fs::path &path)
+{
+    index_.load(path);
+    bottomLod_ = index_.maxLod();
+}
+
+void MaskPyramid::save(const fs::path &path) const
+{
+    index_.save(path);
+}
+
+MaskPyramid::Coverage
+MaskPyramid::classify(vts::TileIndex::Flag::value_type flags)
+{
+    if (!flags) { return Coverage::empty; }
+    if ((flags & FullFlag) == FullFlag) { return Coverage::full; }
+    return Coverage::partial;
+}
+
+MaskPyramid::Coverage MaskPyramid::coverage(const vts::TileId &tileId) const
+{
+    if (tileId.lod <= bottomLod_) {
+        return classify(index_.get(tileId));
+    }
+
+    // below pyramid: only full and empty tiles are inherited
+    const auto c(classify(index_.get
+                          (vts::parent(tileId, tileId.lod - bottomLod_))));
+    return (c == Coverage::partial) ? Coverage::unknown : c;
+}
+
+MaskPyramid::Coverage
+MaskPyramid::neighbourhood(const vts::TileId &tileId) const
+{
+    const auto c(coverage(tileId));
+    if ((c != Coverage::full) && (c != Coverage::empty)) { return c; }
+
+    const long limit(1l << tileId.lod);
+    for (int j(-1); j <= 1; ++j) {
+        for (int i(-1); i <= 1; ++i) {
+            if (!i && !j) { continue; }
+
+            const long x(long(tileId.x) + i);
+            const long y(long(tileId.y) + j);
+
+            const auto nc(((x < 0) || (y < 0) || (x >= limit) || (y >= limit))
+                          ? Coverage::empty
+                          : coverage(vts::TileId(tileId.lod, x, y)));
+            if (nc != c) { return Coverage::partial; }
+        }
+    }
+
+    return c;
+}
+
+fs::path MaskPyramid::companion(const fs::path &maskPath)
+{
+    return utility::addExtension(maskPath, ".pyramid");
+}
+
+MaskPyramid::pointer MaskPyramid::loadCompanion(const fs::path &maskPath)
+{
+    const auto path(companion(maskPath));
+
+    boost::system::error_code ec;
+    if (!fs::exists(path, ec)) { return {}; }
+
+    if (fs::last_write_time(path, ec) < fs::last_write_time(maskPath, ec)) {
+        LOG(warn2) << "Mask pyramid " << path << " is older than mask "
+                   << maskPath << "; ignored.";
+        return {};
+    }
+
+    try {
+        auto pyramid(std::make_shared<MaskPyramid>(path));
+        LOG(info1) << "Loaded mask pyramid " << path << ".";
+        return pyramid;
+    } catch (const std::exception &e) {
+        LOG(warn2) << "Unable to load mask pyramid " << path << ": <"
+                   << e.what() << ">; ignored.";
+    }
+    return {};
+}
+
+MaskPyramid::pointer
+MaskPyramid::loadCompanion(const boost::optional<fs::path> &maskPath)
+{
+    if (!maskPath) { return {}; }
+    return loadCompanion(*maskPath);
+}
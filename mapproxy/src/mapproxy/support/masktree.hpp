@@ -0,0 +1,133 @@
+/**
+ * Copyright (c) 2019 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef mapproxy_support_masktree_hpp_included_
+#define mapproxy_support_masktree_hpp_included_
+
+#include <memory>
+
+#include <boost/optional.hpp>
+#include <boost/filesystem/path.hpp>
+
+#include "imgproc/rastermask/mappedqtree.hpp"
+
+#include "vts-libs/vts/basetypes.hpp"
+#include "vts-libs/vts/tileindex.hpp"
+
+namespace vts = vtslibs::vts;
+
+/** Per-LOD tile classification of a mask tree (empty/partial/full).
+ *
+ *  Generated offline by mapproxy-rf-mask as a companion file of the mask tree
+ *  (MASK.pyramid). Lets runtime skip mask tree rasterization for tiles that
+ *  are completely inside or outside of the mask.
+ *
+ *  Stored as a vts::TileIndex: no flag -> empty, mesh -> partial,
+ *  mesh | watertight -> full.
+ */
+class MaskPyramid {
+public:
+    typedef std::shared_ptr<const MaskPyramid> pointer;
+
+    enum class Coverage { empty, partial, full, unknown };
+
+    /** Builds pyramid from mask tree for LODs [0, bottomLod]. Bottom LOD is
+     *  clipped to mask tree depth.
+     */
+    MaskPyramid(const imgproc::mappedqtree::RasterMask &maskTree
+                , vts::Lod bottomLod);
+
+    /** Loads pyramid from file.
+     */
+    MaskPyramid(const boost::filesystem::path &path);
+
+    void save(const boost::filesystem::path &path) const;
+
+    /** Tile coverage. Tiles below bottom LOD are derived from their ancestor
+     *  (partial ancestor -> unknown).
+     */
+    Coverage coverage(const vts::TileId &tileId) const;
+
+    /** Coverage of tile and all its 8 neighbours: full/empty only if all 9
+     *  tiles are full/empty, partial or unknown otherwise. Tiles outside the
+     *  LOD grid are considered empty.
+     */
+    Coverage neighbourhood(const vts::TileId &tileId) const;
+
+    vts::Lod bottomLod() const { return bottomLod_; }
+
+    const vts::TileIndex& index() const { return index_; }
+
+    static Coverage classify(vts::TileIndex::Flag::value_type flags);
+
+    /** Companion pyramid path for given mask tree path.
+     */
+    static boost::filesystem::path
+    companion(const boost::filesystem::path &maskPath);
+
+    /** Loads companion pyramid if it exists and is not older than the mask
+     *  tree. Returns null pointer otherwise.
+     */
+    static pointer loadCompanion(const boost::filesystem::path &maskPath);
+
+    static pointer
+    loadCompanion(const boost::optional<boost::filesystem::path> &maskPath);
+
+private:
+    vts::Lod bottomLod_;
+    vts::TileIndex index_;
+};
+
+/** Mask tree with optional precomputed pyramid.
+ */
+class MaskTree : public imgproc::mappedqtree::RasterMask {
+public:
+    MaskTree() {}
+
+    /** Opens mask tree and its companion pyramid (if available).
+     *  Path is either boost::filesystem::path or optional path.
+     */
+    template <typename Path>
+    MaskTree(const Path &path)
+        : imgproc::mappedqtree::RasterMask(path)
+        , pyramid_(MaskPyramid::loadCompanion(path))
+    {}
+
+    /** Returns precomputed pyramid, if any.
+     */
+    const MaskPyramid* pyramid() const { return pyramid_.get(); }
+
+    /** Sets (or drops when null) precomputed pyramid.
+     */
+    void setPyramid(const MaskPyramid::pointer &pyramid) {
+        pyramid_ = pyramid;
+    }
+
+private:
+    MaskPyramid::pointer pyramid_;
+};
+
+#endif // mapproxy_support_masktree_hpp_included_
@@ -0,0 +1,179 @@
+/**
+ * Copyright (c) 2019 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <tuple>
+#include <algorithm>
+
+#include <boost/filesystem.hpp>
+
+#include "dbglog/dbglog.hpp"
+
+#include "utility/filesystem.hpp"
+#include "utility/binaryio.hpp"
+
+#include "heighttable.hpp"
+#include "memory-impl.hpp"
+
+namespace mmapped {
+
+namespace fs = boost::filesystem;
+namespace bin = utility::binaryio;
+
+namespace {
+
+const char MM_HEIGHTTABLE_MAGIC[4] = { 'M', 'M', 'H', 'T' };
+const std::uint8_t MM_HEIGHTTABLE_VERSION(1);
+
+/** Header size, records start right after it.
+ */
+const std::size_t HeaderSize(32);
+
+inline std::tuple<std::uint8_t, std::uint32_t, std::uint32_t>
+key(const HeightTable::Record &r)
+{
+    return std::make_tuple(r.lod, r.x, r.y);
+}
+
+} // namespace
+
+HeightTable::HeightTable(const fs::path &path)
+    : memory_(std::make_shared<Memory>(path))
+    , stamp_(), bottomLod_(), records_(), count_()
+{
+    auto &f(memory_->stream);
+    checkHeader(f, MM_HEIGHTTABLE_MAGIC, 0, "mmapped height table");
+
+    const auto version(bin::read<std::uint8_t>(f));
+    if (version != MM_HEIGHTTABLE_VERSION) {
+        LOGTHROW(err2, std::runtime_error)
+            << "Unsupported mmapped height table version " << int(version)
+            << " in " << path << ".";
+    }
+    bottomLod_ = bin::read<std::uint8_t>(f);
+    bin::read<std::uint16_t>(f); // reserved
+
+    stamp_.revision = bin::read<std::uint32_t>(f);
+    bin::read<std::uint32_t>(f); // reserved
+    stamp_.fingerprint = bin::read<std::uint64_t>(f);
+    count_ = bin::read<std::uint64_t>(f);
+
+    if ((HeaderSize + count_ * sizeof(Record)) > memory_->size) {
+        LOGTHROW(err2, std::runtime_error)
+            << "Truncated mmapped height table " << path << ".";
+    }
+
+    records_ = reinterpret_cast<const Record*>(memory_->addr(HeaderSize));
+}
+
+const HeightTable::Node* HeightTable::find(const vts::TileId &tileId) const
+{
+    if (tileId.lod > bottomLod_) { return nullptr; }
+
+    Record k;
+    k.x = tileId.x;
+    k.y = tileId.y;
+    k.lod = tileId.lod;
+
+    const auto end(records_ + count_);
+    const auto irecord(std::lower_bound
+                       (records_, end, k
+                        , [](const Record &l, const Record &r)
+                        {
+                            return key(l) < key(r);
+                        }));
+    if ((irecord == end) || (key(*irecord) != key(k))) { return nullptr; }
+    return &irecord->node;
+}
+
+boost::optional<HeightTable::Stamp>
+HeightTable::readStamp(const fs::path &path)
+{
+    if (!fs::exists(path)) { return boost::none; }
+
+    try {
+        return HeightTable(path).stamp();
+    } catch (const std::exception &e) {
+        LOG(warn2) << "Cannot open height table " << path << ": <"
+                   << e.what() << ">.";
+    }
+    return boost::none;
+}
+
+HeightTable::Writer::Writer(const fs::path &path, const Stamp &stamp
+                            , vts::Lod bottomLod)
+{
+    f_.exceptions(std::ios::failbit | std::ios::badbit);
+    f_.open(path.string(), std::ios_base::out | std::ios_base::trunc);
+
+    bin::write(f_, MM_HEIGHTTABLE_MAGIC); // 4 bytes
+    bin::write(f_, MM_HEIGHTTABLE_VERSION);
+    bin::write(f_, std::uint8_t(bottomLod));
+    bin::write(f_, std::uint16_t(0)); // reserved
+
+    bin::write(f_, std::uint32_t(stamp.revision));
+    bin::write(f_, std::uint32_t(0)); // reserved
+    bin::write(f_, std::uint64_t(stamp.fingerprint));
+
+    // record count, filled in by close()
+    bin::write(f_, std::uint64_t(0));
+}
+
+void HeightTable::Writer::add(const vts::TileId &tileId, const Node &node)
+{
+    Record r = {};
+    r.x = tileId.x;
+    r.y = tileId.y;
+    r.lod = tileId.lod;
+    r.node = node;
+    records_.push_back(r);
+}
+
+void HeightTable::Writer::close()
+{
+    std::sort(records_.begin(), records_.end()
+              , [](const Record &l, const Record &r)
+              {
+                  return key(l) < key(r);
+              });
+
+    // keep single record per tile
+    records_.erase(std::unique(records_.begin(), records_.end()
+                               , [](const Record &l, const Record &r)
+                               {
+                                   return key(l) == key(r);
+                               })
+                   , records_.end());
+
+    f_.write(reinterpret_cast<const char*>(records_.data())
+             , records_.size() * sizeof(Record));
+
+    f_.seekp(HeaderSize - sizeof(std::uint64_t));
+    bin::write(f_, std::uint64_t(records_.size()));
+
+    f_.close();
+}
+
+} // namespace mmapped
@@ -0,0 +1,150 @@
+/**
+ * Copyright (c) 2019 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef mapproxy_support_mmapped_heighttable_hpp_included_
+#define mapproxy_support_mmapped_heighttable_hpp_included_
+
+#include <memory>
+#include <vector>
+#include <cstdint>
+
+#include <boost/optional.hpp>
+#include <boost/filesystem/path.hpp>
+
+#include "utility/streams.hpp"
+
+#include "vts-libs/vts/basetypes.hpp"
+
+#include "tilepack.hpp"
+
+namespace vts = vtslibs::vts;
+
+namespace mmapped {
+
+struct Memory;
+
+/** Memory mapped table of per-tile height information computed from DEM
+ *  (value, min and max datasets) at prepare time.
+ *
+ *  Table is stamped the same way as TilePack, stale table must not be used.
+ *
+ *  Layout:
+ *      header: magic, version, bottom LOD, reserved, revision, reserved,
+ *              fingerprint, record count
+ *      records: sorted fixed-size records (see Record)
+ */
+class HeightTable {
+public:
+    typedef TilePack::Stamp Stamp;
+
+    /** Per-tile accumulators of metatile sample grid. Everything needed to
+     *  build metanode without warping the DEM.
+     */
+    struct Node {
+        /** Physical extents (ll, ur).
+         */
+        double extents[6];
+
+        /** Geometry extents: z range and surrogate.
+         */
+        double geomMin;
+        double geomMax;
+        double geomSurrogate;
+
+        /** Height range in navigation SRS.
+         */
+        double heightMin;
+        double heightMax;
+
+        /** Area of geometry.
+         */
+        double area;
+
+        /** Sum of surrogate heights.
+         */
+        double avgHeightSum;
+
+        std::int32_t triangleCount;
+        std::int32_t avgHeightCount;
+    };
+
+    /** Table record, sorted by (lod, x, y).
+     */
+    struct Record {
+        std::uint32_t x;
+        std::uint32_t y;
+        std::uint8_t lod;
+        std::uint8_t reserved[7];
+        Node node;
+    };
+
+    HeightTable(const boost::filesystem::path &path);
+
+    const Stamp& stamp() const { return stamp_; }
+
+    /** Bottommost LOD covered by the table.
+     */
+    vts::Lod bottomLod() const { return bottomLod_; }
+
+    std::size_t size() const { return count_; }
+
+    /** Finds node in table.
+     */
+    const Node* find(const vts::TileId &tileId) const;
+
+    /** Reads table stamp. Returns none if file doesn't exist or is not a
+     *  valid table.
+     */
+    static boost::optional<Stamp>
+    readStamp(const boost::filesystem::path &path);
+
+    /** Table writer. Records are kept in memory and written by close().
+     */
+    class Writer {
+    public:
+        Writer(const boost::filesystem::path &path, const Stamp &stamp
+               , vts::Lod bottomLod);
+
+        void add(const vts::TileId &tileId, const Node &node);
+
+        void close();
+
+    private:
+        utility::ofstreambuf f_;
+        std::vector<Record> records_;
+    };
+
+private:
+    std::shared_ptr<Memory> memory_;
+    Stamp stamp_;
+    vts::Lod bottomLod_;
+    const Record *records_;
+    std::size_t count_;
+};
+
+} // namespace mmapped
+
+#endif // mapproxy_support_mmapped_heighttable_hpp_included_
@@ -24,6 +24,13 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <array>
+#include <atomic>
+#include <thread>
+
 #include "dbglog/dbglog.hpp"
 
 #include "utility/filesystem.hpp"
@@ -208,6 +215,227 @@ void QTree::write(std::ostream &f, const vts::QTree &tree)
     f.seekp(end);
 }
 
+namespace {
+
+/** Leaf node of vts::QTree.
+ */
+struct Leaf {
+    /** Morton code of node's upper-left corner (y is more significant), i.e.
+     *  leaves sorted by code are in UL, UR, LL, LR depth-first order.
+     */
+    std::uint64_t code;
+    unsigned int size;
+    TileFlag::value_type value;
+
+    bool operator<(const Leaf &o) const { return code < o.code; }
+};
+
+inline std::uint64_t morton(unsigned int x, unsigned int y)
+{
+    std::uint64_t code(0);
+    for (int bit(0); bit < 32; ++bit) {
+        code |= (std::uint64_t((x >> bit) & 1) << (2 * bit));
+        code |= (std::uint64_t((y >> bit) & 1) << (2 * bit + 1));
+    }
+    return code;
+}
+
+template <typename T>
+inline void append(std::string &out, const T &value)
+{
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <typename T>
+inline void place(std::string &out, std::size_t pos, const T &value)
+{
+    out.replace(pos, sizeof(value), reinterpret_cast<const char*>(&value)
+                , sizeof(value));
+}
+
+/** Serializes tree from its sorted leaves. Produces the same layout as
+ *  Converter in QTree::write(out, tree); jump values are relative to their
+ *  own position therefore any subtree can be serialized into its own buffer
+ *  and moved afterwards.
+ */
+class LeafWriter {
+public:
+    typedef std::vector<Leaf> Leaves;
+
+    LeafWriter(const Leaves &leaves) : leaves_(leaves) {}
+
+    struct Children {
+        std::array<TileFlag::value_type, 4> values;
+        std::array<bool, 4> internal;
+        std::array<unsigned int, 4> x;
+        std::array<unsigned int, 4> y;
+    };
+
+    /** Classifies 4 children of internal node.
+     */
+    Children children(unsigned int x, unsigned int y, unsigned int size)
+        const
+    {
+        const auto half(size >> 1);
+
+        Children c;
+        c.x = {{ x, x + half, x, x + half }};
+        c.y = {{ y, y, y + half, y + half }};
+
+        for (int i(0); i < 4; ++i) {
+            const auto &leaf(find(c.x[i], c.y[i]));
+            c.internal[i] = (leaf.size != half);
+            c.values[i] = (c.internal[i] ? TileFlag::value_type
+                           (TileFlag::invalid) : leaf.value);
+        }
+        return c;
+    }
+
+    /** Writes internal node values, jump table and all descendants.
+     */
+    void node(std::string &out, unsigned int x, unsigned int y
+              , unsigned int size) const
+    {
+        const auto c(children(x, y, size));
+        for (const auto &value : c.values) { append(out, value); }
+
+        const auto table(jumpTable(out, c));
+        for (int i(0); i < 4; ++i) {
+            if (!c.internal[i]) { continue; }
+            jump(out, table[i]);
+            node(out, c.x[i], c.y[i], size >> 1);
+        }
+    }
+
+    typedef std::array<long, 4> JumpTable;
+
+    /** Allocates jump table (all internal children but the first one).
+     */
+    static JumpTable jumpTable(std::string &out, const Children &c) {
+        JumpTable table;
+        bool first(true);
+        for (int i(0); i < 4; ++i) {
+            table[i] = -1;
+            if (!c.internal[i]) { continue; }
+            if (first) { first = false; continue; }
+            table[i] = out.size();
+            append(out, std::uint32_t(0));
+        }
+        return table;
+    }
+
+    /** Fills jump to the end of buffer at given position (if any).
+     */
+    static void jump(std::string &out, long pos, std::size_t skip = 0) {
+        if (pos < 0) { return; }
+        place(out, pos, std::uint32_t
+              (out.size() + skip - pos - sizeof(std::uint32_t)));
+    }
+
+private:
+    const Leaf& find(unsigned int x, unsigned int y) const {
+        // leaves cover whole tree, node starts at some leaf's corner
+        const Leaf key{ morton(x, y), 0, 0 };
+        return *std::lower_bound(leaves_.begin(), leaves_.end(), key);
+    }
+
+    const Leaves &leaves_;
+};
+
+} // namespace
+
+void QTree::write(std::ostream &f, const vts::QTree &tree
+                  , unsigned int threadCount)
+{
+    if (!threadCount) {
+        threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+    if (threadCount == 1) { return write(f, tree); }
+
+    // collect leaves in depth-first order
+    LeafWriter::Leaves leaves;
+    tree.forEachNode([&](unsigned int x, unsigned int y, unsigned int size
+                         , vts::QTree::value_type value)
+    {
+        leaves.push_back({ morton(x, y), size, vts2mm(value) });
+    }, vts::QTree::Filter::both);
+    std::sort(leaves.begin(), leaves.end());
+
+    const unsigned int size(1 << tree.order());
+
+    std::string data;
+    std::vector<std::string> quadrants(4);
+
+    if ((leaves.size() == 1) && (leaves.front().size == size)) {
+        // single leaf: root value in all nodes
+        for (int i(0); i < 4; ++i) { append(data, leaves.front().value); }
+    } else {
+        // root is internal
+        for (int i(0); i < 4; ++i) {
+            append(data, TileFlag::value_type(TileFlag::invalid));
+        }
+
+        LeafWriter writer(leaves);
+        const auto c(writer.children(0, 0, size));
+        for (const auto &value : c.values) { append(data, value); }
+        const auto table(LeafWriter::jumpTable(data, c));
+
+        // build internal quadrants in parallel
+        std::vector<int> work;
+        for (int i(0); i < 4; ++i) { if (c.internal[i]) { work.push_back(i); } }
+
+        std::atomic<std::size_t> next(0);
+        auto worker([&]()
+        {
+            for (std::size_t w; (w = next++) < work.size(); ) {
+                const auto i(work[w]);
+                writer.node(quadrants[i], c.x[i], c.y[i], size >> 1);
+            }
+        });
+
+        std::vector<std::thread> threads;
+        for (std::size_t t(1), e(std::min<std::size_t>
+                                 (threadCount, work.size()));
+             t < e; ++t)
+        {
+            threads.emplace_back(worker);
+        }
+        worker();
+        for (auto &thread : threads) { thread.join(); }
+
+        // offset fix-up: quadrant i starts after all preceding quadrants
+        std::size_t skip(0);
+        for (const auto i : work) {
+            LeafWriter::jump(data, table[i], skip);
+            skip += quadrants[i].size();
+        }
+    }
+
+    // header
+    bin::write(f, MM_QTREE_MAGIC); // 4 bytes
+    bin::write(f, std::uint8_t(0)); // reserved
+    bin::write(f, std::uint8_t(0)); // reserved
+    bin::write(f, std::uint8_t(tree.order()));
+
+    // data size, data start is aligned (padding is zero-filled, same as gap
+    // left by seekp in serial write)
+    std::size_t sizePlace(f.tellp());
+    std::uint32_t dataSize(data.size());
+    for (const auto &quadrant : quadrants) { dataSize += quadrant.size(); }
+    bin::write(f, dataSize);
+    const auto padding(utility::align(sizePlace + sizeof(std::uint32_t)
+                                      , sizeof(std::uint32_t))
+                       - (sizePlace + sizeof(std::uint32_t)));
+    for (std::size_t i(0); i < padding; ++i) {
+        bin::write(f, std::uint8_t(0));
+    }
+
+    f.write(data.data(), data.size());
+    for (const auto &quadrant : quadrants) {
+        f.write(quadrant.data(), quadrant.size());
+    }
+}
+
 QTree::value_type QTree::get(unsigned int x, unsigned int y) const
 {
     if ((x >= size_) || (y >= size_)) { return TileFlag::none; }
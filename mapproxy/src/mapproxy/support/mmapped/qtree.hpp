@@ -72,6 +72,16 @@ public:
 
     static void write(std::ostream &out, const vts::QTree &tree);
 
+    /** Parallel variant of write(out, tree): top-level quadrants are
+     *  serialized independently (by up to threadCount threads) and
+     *  concatenated. Output is byte-identical to serial write.
+     *
+     *  threadCount = 0 means hardware concurrency, threadCount = 1 falls back
+     *  to serial write.
+     */
+    static void write(std::ostream &out, const vts::QTree &tree
+                      , unsigned int threadCount);
+
     enum class Filter {
         black, white, both
     };
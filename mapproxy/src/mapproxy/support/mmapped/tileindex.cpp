@@ -66,7 +66,8 @@ TileIndex::TileIndex(const fs::path &path)
     }
 }
 
-void TileIndex::write(std::ostream &f, const vts::TileIndex &ti)
+void TileIndex::write(std::ostream &f, const vts::TileIndex &ti
+                      , unsigned int threadCount)
 {
     bin::write(f, MM_TILEINDEX_MAGIC); // 4 bytes
     bin::write(f, std::uint8_t(0)); // reserved
@@ -82,7 +83,7 @@ void TileIndex::write(std::ostream &f, const vts::TileIndex &ti)
     for (vts::Lod lod(0); lod < lodCount; ++lod) {
         if (const auto *tree = ti.tree(lod)) {
             // tree exists, write
-            QTree::write(f, *tree);
+            QTree::write(f, *tree, threadCount);
         } else {
             // tree doesn't exist, write empty
             QTree::write(f, vts::QTree(lod));
@@ -91,13 +92,14 @@ void TileIndex::write(std::ostream &f, const vts::TileIndex &ti)
 }
 
 void TileIndex::write(const boost::filesystem::path &path
-                      , const vts::TileIndex &ti)
+                      , const vts::TileIndex &ti
+                      , unsigned int threadCount)
 {
     utility::ofstreambuf f;
     f.exceptions(std::ifstream::failbit | std::ifstream::badbit);
     f.open(path.string(), std::ifstream::out | std::ifstream::trunc);
 
-    write(f, ti);
+    write(f, ti, threadCount);
 
     f.close();
 }
@@ -73,13 +73,18 @@ public:
         const;
 
     /** Save vts TileIndex into this mmapped tile index.
+     *
+     *  Trees are converted by threadCount threads (0 = hardware concurrency,
+     *  1 = serial conversion). Output doesn't depend on thread count.
      */
-    static void write(std::ostream &out, const vts::TileIndex &ti);
+    static void write(std::ostream &out, const vts::TileIndex &ti
+                      , unsigned int threadCount = 0);
 
     /** Save vts TileIndex into this mmapped tile index.
      */
     static void write(const boost::filesystem::path &path
-                      , const vts::TileIndex &ti);
+                      , const vts::TileIndex &ti
+                      , unsigned int threadCount = 0);
 
 private:
     std::shared_ptr<Memory> memory_;
@@ -0,0 +1,212 @@
+/**
+ * Copyright (c) 2019 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <tuple>
+#include <algorithm>
+
+#include <boost/filesystem.hpp>
+
+#include "dbglog/dbglog.hpp"
+
+#include "utility/filesystem.hpp"
+#include "utility/binaryio.hpp"
+
+#include "tilepack.hpp"
+#include "memory-impl.hpp"
+
+namespace mmapped {
+
+namespace fs = boost::filesystem;
+namespace bin = utility::binaryio;
+
+namespace {
+
+const char MM_TILEPACK_MAGIC[4] = { 'M', 'M', 'T', 'P' };
+const std::uint8_t MM_TILEPACK_VERSION(1);
+
+/** Offset of index offset field in header.
+ */
+const std::size_t IndexOffsetPosition(24);
+
+inline std::tuple<std::uint8_t, std::uint8_t, std::uint32_t, std::uint32_t>
+key(const TilePack::Record &r)
+{
+    return std::make_tuple(r.type, r.lod, r.x, r.y);
+}
+
+} // namespace
+
+TilePack::TilePack(const fs::path &path)
+    : memory_(std::make_shared<Memory>(path))
+    , stamp_(), records_(), count_()
+{
+    auto &f(memory_->stream);
+    checkHeader(f, MM_TILEPACK_MAGIC, 0, "mmapped tile pack");
+
+    const auto version(bin::read<std::uint8_t>(f));
+    if (version != MM_TILEPACK_VERSION) {
+        LOGTHROW(err2, std::runtime_error)
+            << "Unsupported mmapped tile pack version " << int(version)
+            << " in " << path << ".";
+    }
+    bin::read<std::uint8_t>(f); // reserved
+    bin::read<std::uint16_t>(f); // reserved
+
+    stamp_.revision = bin::read<std::uint32_t>(f);
+    bin::read<std::uint32_t>(f); // reserved
+    stamp_.fingerprint = bin::read<std::uint64_t>(f);
+
+    const auto indexOffset(bin::read<std::uint64_t>(f));
+    count_ = bin::read<std::uint64_t>(f);
+
+    if (!indexOffset
+        || ((indexOffset + count_ * sizeof(Record)) > memory_->size))
+    {
+        LOGTHROW(err2, std::runtime_error)
+            << "Truncated mmapped tile pack " << path << ".";
+    }
+
+    records_ = reinterpret_cast<const Record*>(memory_->addr(indexOffset));
+}
+
+boost::optional<TilePack::File>
+TilePack::find(FileType type, const vts::TileId &tileId) const
+{
+    Record k;
+    k.type = std::uint8_t(type);
+    k.lod = tileId.lod;
+    k.x = tileId.x;
+    k.y = tileId.y;
+
+    const auto end(records_ + count_);
+    const auto irecord(std::lower_bound
+                       (records_, end, k
+                        , [](const Record &l, const Record &r)
+                        {
+                            return key(l) < key(r);
+                        }));
+    if ((irecord == end) || (key(*irecord) != key(k))) { return boost::none; }
+
+    const auto *blob(memory_->addr(irecord->offset));
+    const std::uint8_t ctSize(*blob);
+
+    File file;
+    file.contentType.assign(blob + 1, ctSize);
+    file.data = blob + 1 + ctSize;
+    file.size = irecord->size;
+    return file;
+}
+
+boost::optional<TilePack::Stamp>
+TilePack::readStamp(const fs::path &path)
+{
+    if (!fs::exists(path)) { return boost::none; }
+
+    try {
+        return TilePack(path).stamp();
+    } catch (const std::exception &e) {
+        LOG(warn2) << "Cannot open tile pack " << path << ": <"
+                   << e.what() << ">.";
+    }
+    return boost::none;
+}
+
+TilePack::Writer::Writer(const fs::path &path, const Stamp &stamp)
+{
+    f_.exceptions(std::ios::failbit | std::ios::badbit);
+    f_.open(path.string(), std::ios_base::out | std::ios_base::trunc);
+
+    bin::write(f_, MM_TILEPACK_MAGIC); // 4 bytes
+    bin::write(f_, MM_TILEPACK_VERSION);
+    bin::write(f_, std::uint8_t(0)); // reserved
+    bin::write(f_, std::uint16_t(0)); // reserved
+
+    bin::write(f_, std::uint32_t(stamp.revision));
+    bin::write(f_, std::uint32_t(0)); // reserved
+    bin::write(f_, std::uint64_t(stamp.fingerprint));
+
+    // index offset and file count, filled in by close()
+    bin::write(f_, std::uint64_t(0));
+    bin::write(f_, std::uint64_t(0));
+}
+
+void TilePack::Writer::add(FileType type, const vts::TileId &tileId
+                           , const std::string &contentType
+                           , const std::string &data)
+{
+    const auto ctSize(std::min(contentType.size(), std::size_t(255)));
+
+    Record r;
+    r.x = tileId.x;
+    r.y = tileId.y;
+    r.offset = f_.tellp();
+    r.size = data.size();
+    r.type = std::uint8_t(type);
+    r.lod = tileId.lod;
+    r.reserved = 0;
+    records_.push_back(r);
+
+    bin::write(f_, std::uint8_t(ctSize));
+    f_.write(contentType.data(), ctSize);
+    f_.write(data.data(), data.size());
+}
+
+void TilePack::Writer::close()
+{
+    // align index to record size
+    std::uint64_t indexOffset(f_.tellp());
+    while (indexOffset % alignof(Record)) {
+        bin::write(f_, std::uint8_t(0));
+        ++indexOffset;
+    }
+
+    std::sort(records_.begin(), records_.end()
+              , [](const Record &l, const Record &r)
+              {
+                  return key(l) < key(r);
+              });
+
+    f_.write(reinterpret_cast<const char*>(records_.data())
+             , records_.size() * sizeof(Record));
+
+    f_.seekp(IndexOffsetPosition);
+    bin::write(f_, indexOffset);
+    bin::write(f_, std::uint64_t(records_.size()));
+
+    f_.close();
+}
+
+std::uint64_t TilePack::fingerprint(const std::string &data)
+{
+    std::uint64_t hash(14695981039346656037ull);
+    for (const auto c : data) {
+        hash ^= std::uint8_t(c);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+} // namespace mmapped
@@ -0,0 +1,140 @@
+/**
+ * Copyright (c) 2019 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef mapproxy_support_mmapped_tilepack_hpp_included_
+#define mapproxy_support_mmapped_tilepack_hpp_included_
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include <boost/optional.hpp>
+#include <boost/filesystem/path.hpp>
+
+#include "utility/streams.hpp"
+
+#include "vts-libs/vts/basetypes.hpp"
+
+namespace vts = vtslibs::vts;
+
+namespace mmapped {
+
+struct Memory;
+
+/** Memory mapped pack of pre-rendered tile files (image, mask, metatile).
+ *
+ *  Pack is stamped by resource revision and definition fingerprint, stale
+ *  pack must not be used.
+ *
+ *  Layout:
+ *      header: magic, version, revision, fingerprint, index offset, file
+ *              count
+ *      files: content type length (uint8), content type, content
+ *      index: sorted fixed-size records (see Record)
+ */
+class TilePack {
+public:
+    enum class FileType : std::uint8_t { image = 0, mask = 1, metatile = 2 };
+
+    struct File {
+        std::string contentType;
+        const char *data;
+        std::size_t size;
+    };
+
+    /** Pack stamp.
+     */
+    struct Stamp {
+        std::uint32_t revision;
+        std::uint64_t fingerprint;
+
+        bool operator==(const Stamp &o) const {
+            return (revision == o.revision) && (fingerprint == o.fingerprint);
+        }
+        bool operator!=(const Stamp &o) const { return !operator==(o); }
+    };
+
+    /** Index record, sorted by (type, lod, x, y).
+     */
+    struct Record {
+        std::uint32_t x;
+        std::uint32_t y;
+        std::uint64_t offset;
+        std::uint32_t size;
+        std::uint8_t type;
+        std::uint8_t lod;
+        std::uint16_t reserved;
+    };
+
+    TilePack(const boost::filesystem::path &path);
+
+    const Stamp& stamp() const { return stamp_; }
+
+    std::size_t size() const { return count_; }
+
+    /** Finds file in pack.
+     */
+    boost::optional<File> find(FileType type, const vts::TileId &tileId)
+        const;
+
+    /** Reads pack stamp. Returns none if file doesn't exist or is not a
+     *  valid pack.
+     */
+    static boost::optional<Stamp>
+    readStamp(const boost::filesystem::path &path);
+
+    /** Pack writer. Files are streamed to disk, index is written by
+     *  close().
+     */
+    class Writer {
+    public:
+        Writer(const boost::filesystem::path &path, const Stamp &stamp);
+
+        void add(FileType type, const vts::TileId &tileId
+                 , const std::string &contentType, const std::string &data);
+
+        void close();
+
+    private:
+        utility::ofstreambuf f_;
+        std::vector<Record> records_;
+    };
+
+    /** Fingerprint helper (FNV-1a). Stable between builds.
+     */
+    static std::uint64_t fingerprint(const std::string &data);
+
+private:
+    std::shared_ptr<Memory> memory_;
+    Stamp stamp_;
+    const Record *records_;
+    std::size_t count_;
+};
+
+} // namespace mmapped
+
+#endif // mapproxy_support_mmapped_tilepack_hpp_included_
@@ -0,0 +1,298 @@
+/**
+ * Copyright (c) 2019 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#include <cerrno>
+#include <cstring>
+#include <algorithm>
+#include <system_error>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#include <boost/filesystem.hpp>
+#include <boost/algorithm/string/split.hpp>
+#include <boost/algorithm/string/classification.hpp>
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/algorithm/string/trim.hpp>
+
+#include "dbglog/dbglog.hpp"
+
+#include "placement.hpp"
+
+namespace fs = boost::filesystem;
+namespace ba = boost::algorithm;
+
+namespace {
+
+// from linux/mempolicy.h
+const int MPOL_BIND_(2);
+const int MPOL_INTERLEAVE_(3);
+
+std::string readLine(const fs::path &path)
+{
+    std::ifstream f(path.string());
+    std::string line;
+    std::getline(f, line);
+    return ba::trim_copy(line);
+}
+
+} // namespace
+
+CpuSet CpuSet::intersect(const CpuSet &other) const
+{
+    CpuSet out;
+    for (const auto cpu : cpus_) {
+        if (other.contains(cpu)) { out.cpus_.insert(cpu); }
+    }
+    return out;
+}
+
+CpuSet CpuSet::parse(const std::string &str)
+{
+    auto invalid([&]()
+    {
+        throw std::invalid_argument("Invalid CPU list <" + str + ">.");
+    });
+
+    // parses non-negative integer, whole string must be consumed
+    auto number([&](const std::string &value) -> int
+    {
+        if (value.empty()
+            || (value.find_first_not_of("0123456789") != std::string::npos))
+        {
+            invalid();
+        }
+        try {
+            return std::stoi(value);
+        } catch (const std::exception&) {
+            invalid();
+        }
+        return -1;
+    });
+
+    CpuSet out;
+
+    std::vector<std::string> parts;
+    ba::split(parts, str, ba::is_any_of(","), ba::token_compress_on);
+    for (const auto &part : parts) {
+        if (part.empty()) { continue; }
+
+        const auto dash(part.find('-'));
+        if (dash == std::string::npos) {
+            out.cpus_.insert(number(part));
+            continue;
+        }
+
+        const auto first(number(part.substr(0, dash)));
+        const auto last(number(part.substr(dash + 1)));
+        if (last < first) { invalid(); }
+        for (int cpu(first); cpu <= last; ++cpu) {
+            out.cpus_.insert(cpu);
+        }
+    }
+
+    return out;
+}
+
+CpuSet CpuSet::current()
+{
+    CpuSet out;
+
+    ::cpu_set_t set;
+    CPU_ZERO(&set);
+    if (::sched_getaffinity(0, sizeof(set), &set) == -1) {
+        std::system_error e(errno, std::system_category());
+        LOG(warn2) << "sched_getaffinity failed: <" << e.what() << ">.";
+        return out;
+    }
+
+    for (int cpu(0); cpu < CPU_SETSIZE; ++cpu) {
+        if (CPU_ISSET(cpu, &set)) { out.cpus_.insert(cpu); }
+    }
+    return out;
+}
+
+std::ostream& operator<<(std::ostream &os, const CpuSet &cpus)
+{
+    // compress into ranges
+    const auto &set(cpus.cpus());
+    bool first(true);
+    for (auto i(set.begin()), e(set.end()); i != e; ) {
+        const auto start(*i);
+        auto end(start);
+        while ((++i != e) && (*i == end + 1)) { ++end; }
+
+        if (!first) { os << ','; }
+        first = false;
+        os << start;
+        if (end != start) { os << '-' << end; }
+    }
+    return os;
+}
+
+std::istream& operator>>(std::istream &is, CpuSet &cpus)
+{
+    std::string str;
+    is >> str;
+    try {
+        cpus = CpuSet::parse(str);
+    } catch (const std::invalid_argument&) {
+        is.setstate(std::ios::failbit);
+    }
+    return is;
+}
+
+NumaNode::list numaNodes()
+{
+    NumaNode::list nodes;
+
+    const fs::path root("/sys/devices/system/node");
+    boost::system::error_code ec;
+    for (fs::directory_iterator i(root, ec), e; !ec && (i != e); ++i) {
+        const auto name(i->path().filename().string());
+        if (!ba::starts_with(name, "node")) { continue; }
+
+        int id;
+        try {
+            std::size_t end(0);
+            id = std::stoi(name.substr(4), &end);
+            if (end != (name.size() - 4)) { continue; }
+        } catch (...) { continue; }
+
+        try {
+            auto cpus(CpuSet::parse(readLine(i->path() / "cpulist")));
+            // skip memory-only nodes
+            if (!cpus.empty()) { nodes.emplace_back(id, cpus); }
+        } catch (const std::invalid_argument&) {}
+    }
+
+    if (nodes.empty()) {
+        nodes.emplace_back(0, CpuSet::current());
+    }
+
+    std::sort(nodes.begin(), nodes.end()
+              , [](const NumaNode &l, const NumaNode &r)
+              {
+                  return l.id < r.id;
+              });
+
+    return nodes;
+}
+
+NumaNode::list numaNodes(const NumaNode::list &nodes, const CpuSet &cpus)
+{
+    if (cpus.empty()) { return nodes; }
+
+    NumaNode::list out;
+    for (const auto &node : nodes) {
+        const auto common(node.cpus.intersect(cpus));
+        if (!common.empty()) { out.emplace_back(node.id, common); }
+    }
+    return out;
+}
+
+bool pinThread(const CpuSet &cpus, const std::string &name)
+{
+    if (cpus.empty()) { return true; }
+
+    ::cpu_set_t set;
+    CPU_ZERO(&set);
+    for (const auto cpu : cpus.cpus()) {
+        if (cpu < CPU_SETSIZE) { CPU_SET(cpu, &set); }
+    }
+
+    if (::sched_setaffinity(0, sizeof(set), &set) == -1) {
+        std::system_error e(errno, std::system_category());
+        LOG(warn2) << "Unable to pin <" << name << "> to CPUs [" << cpus
+                   << "]: <" << e.what() << ">.";
+        return false;
+    }
+
+    LOG(info2) << "Pinned <" << name << "> to CPUs [" << cpus << "].";
+    return true;
+}
+
+ScopedPlacement::ScopedPlacement(const CpuSet &cpus, const std::string &name)
+{
+    if (cpus.empty()) { return; }
+    saved_ = CpuSet::current();
+    pinThread(cpus, name);
+}
+
+ScopedPlacement::~ScopedPlacement()
+{
+    if (saved_.empty()) { return; }
+    pinThread(saved_, "main");
+}
+
+CpuSet gdalWorkerCpus(const CpuSet &cpus, bool spread, std::size_t id
+                      , const NumaNode::list &nodes)
+{
+    if (!spread) { return cpus; }
+
+    const auto used(numaNodes(nodes, cpus));
+    if (used.empty()) { return cpus; }
+
+    return used[(id - 1) % used.size()].cpus;
+}
+
+bool applyMemoryPolicy(void *addr, std::size_t size, MemoryPolicy policy
+                       , const NumaNode::list &nodes)
+{
+    if ((policy == MemoryPolicy::none) || nodes.empty()) { return true; }
+
+    // build node mask
+    int maxNode(0);
+    for (const auto &node : nodes) { maxNode = std::max(maxNode, node.id); }
+
+    const std::size_t bits(8 * sizeof(unsigned long));
+    std::vector<unsigned long> mask((maxNode / bits) + 1, 0);
+    for (const auto &node : nodes) {
+        mask[node.id / bits] |= (1ul << (node.id % bits));
+    }
+
+    const int mode((policy == MemoryPolicy::bind)
+                   ? MPOL_BIND_ : MPOL_INTERLEAVE_);
+
+    if (::syscall(SYS_mbind, addr, size, mode, mask.data()
+                  , mask.size() * bits + 1, 0) == -1)
+    {
+        std::system_error e(errno, std::system_category());
+        LOG(warn2) << "Unable to apply memory policy <" << policy
+                   << "> to " << size << " bytes: <" << e.what() << ">.";
+        return false;
+    }
+
+    std::ostringstream os;
+    for (const auto &node : nodes) { os << ' ' << node.id; }
+    LOG(info3) << "Applied memory policy <" << policy << "> to "
+               << size << " bytes on NUMA nodes" << os.str() << ".";
+    return true;
+}
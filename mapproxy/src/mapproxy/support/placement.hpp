@@ -0,0 +1,128 @@
+/**
+ * Copyright (c) 2019 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef mapproxy_support_placement_hpp_included_
+#define mapproxy_support_placement_hpp_included_
+
+#include <set>
+#include <vector>
+#include <string>
+#include <iosfwd>
+
+#include "utility/enum-io.hpp"
+
+/** Set of CPU ids. Textual form uses kernel cpulist syntax ("0-3,8,10-11").
+ *  Empty set means "no placement".
+ */
+class CpuSet {
+public:
+    CpuSet() {}
+    explicit CpuSet(const std::set<int> &cpus) : cpus_(cpus) {}
+
+    bool empty() const { return cpus_.empty(); }
+    std::size_t size() const { return cpus_.size(); }
+    const std::set<int>& cpus() const { return cpus_; }
+
+    bool contains(int cpu) const { return cpus_.count(cpu); }
+
+    CpuSet intersect(const CpuSet &other) const;
+
+    bool operator==(const CpuSet &o) const { return cpus_ == o.cpus_; }
+    bool operator!=(const CpuSet &o) const { return cpus_ != o.cpus_; }
+
+    /** Parses cpulist. Throws std::invalid_argument on malformed input.
+     */
+    static CpuSet parse(const std::string &str);
+
+    /** CPUs the calling thread is allowed to run on (sched_getaffinity).
+     */
+    static CpuSet current();
+
+private:
+    std::set<int> cpus_;
+};
+
+std::ostream& operator<<(std::ostream &os, const CpuSet &cpus);
+std::istream& operator>>(std::istream &is, CpuSet &cpus);
+
+/** NUMA node and its CPUs.
+ */
+struct NumaNode {
+    int id;
+    CpuSet cpus;
+
+    NumaNode(int id, const CpuSet &cpus) : id(id), cpus(cpus) {}
+
+    typedef std::vector<NumaNode> list;
+};
+
+/** Reads NUMA topology from sysfs. Returns single node 0 with all available
+ *  CPUs when the system provides no NUMA information.
+ */
+NumaNode::list numaNodes();
+
+/** Nodes having at least one CPU from given set (all nodes if set is empty).
+ */
+NumaNode::list numaNodes(const NumaNode::list &nodes, const CpuSet &cpus);
+
+/** Pins calling thread to given CPU set; no-op for empty set. Logs placement
+ *  under given name. Returns false (and logs a warning) on failure.
+ */
+bool pinThread(const CpuSet &cpus, const std::string &name);
+
+/** Pins calling thread for the lifetime of this object and restores
+ *  original affinity afterwards. Threads spawned meanwhile inherit the
+ *  placement.
+ */
+class ScopedPlacement {
+public:
+    ScopedPlacement(const CpuSet &cpus, const std::string &name);
+    ~ScopedPlacement();
+
+private:
+    CpuSet saved_;
+};
+
+/** CPU set for GDAL worker with given (1-based) id. Workers are distributed
+ *  round-robin across NUMA nodes of gdal CPU set when spread is on.
+ */
+CpuSet gdalWorkerCpus(const CpuSet &cpus, bool spread, std::size_t id
+                      , const NumaNode::list &nodes);
+
+UTILITY_GENERATE_ENUM(MemoryPolicy,
+    ((none))
+    ((interleave))
+    ((bind))
+)
+
+/** Applies NUMA memory policy to memory range (must be page aligned and not
+ *  touched yet to have effect on all pages). Returns false (and logs
+ *  a warning) on failure.
+ */
+bool applyMemoryPolicy(void *addr, std::size_t size, MemoryPolicy policy
+                       , const NumaNode::list &nodes);
+
+#endif // mapproxy_support_placement_hpp_included_
@@ -0,0 +1,93 @@
+/**
+ * Copyright (c) 2019 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <ostream>
+#include <iterator>
+#include <algorithm>
+
+#include "resampling.hpp"
+
+namespace {
+
+/** Upper bound of resampling enumeration values.
+ */
+constexpr std::size_t ResamplingSlots(32);
+
+typedef StatCounters<TileOperation, TileOperations
+                     , geo::GeoDataset::Resampling, ResamplingSlots> Counters;
+
+struct PolicyCounters {
+    Counters native;
+    Counters overzoom;
+};
+
+PolicyCounters& counters()
+{
+    static PolicyCounters counters;
+    return counters;
+}
+
+} // namespace
+
+void ResamplingPolicy::add(const Rule &rule)
+{
+    rules.insert(std::upper_bound(rules.begin(), rules.end(), rule
+                                  , [](const Rule &l, const Rule &r)
+                                  {
+                                      return l.overzoom < r.overzoom;
+                                  })
+                 , rule);
+}
+
+geo::GeoDataset::Resampling
+ResamplingPolicy::operator()(double overzoom
+                             , geo::GeoDataset::Resampling base
+                             , TileOperation operation) const
+{
+    // find first rule with higher threshold
+    const auto irule
+        (std::upper_bound(rules.begin(), rules.end(), overzoom
+                          , [](double overzoom, const Rule &r)
+                          {
+                              return overzoom < r.overzoom;
+                          }));
+
+    if ((overzoom <= 0.0) || (irule == rules.begin())) {
+        counters().native.count(operation, base);
+        return base;
+    }
+
+    const auto &rule(*std::prev(irule));
+    counters().overzoom.count(operation, rule.resampling);
+    return rule.resampling;
+}
+
+void ResamplingPolicy::stat(std::ostream &os, const std::string &prefix)
+{
+    const auto &c(counters());
+    c.native.stat(os, prefix, ".native.");
+    c.overzoom.stat(os, prefix, ".overzoom.");
+}
@@ -0,0 +1,99 @@
+/**
+ * Copyright (c) 2019 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef mapproxy_support_resampling_hpp_included_
+#define mapproxy_support_resampling_hpp_included_
+
+#include <vector>
+#include <string>
+#include <iosfwd>
+
+#include "geo/geodataset.hpp"
+
+#include "statcounters.hpp"
+
+/** Resampling policy: picks resampling method from tile overzoom, i.e.
+ *  number of tile pixels per one source dataset pixel.
+ *
+ *  Rule with the highest overzoom threshold not exceeding tile overzoom is
+ *  used. Base (configured) resampling is used if no rule matches.
+ */
+struct ResamplingPolicy {
+    struct Rule {
+        /** Minimum overzoom this rule is applied to.
+         */
+        double overzoom;
+
+        geo::GeoDataset::Resampling resampling;
+
+        Rule(double overzoom = 0.0
+             , geo::GeoDataset::Resampling resampling
+             = geo::GeoDataset::Resampling::bilinear)
+            : overzoom(overzoom), resampling(resampling)
+        {}
+
+        bool operator==(const Rule &o) const {
+            return (overzoom == o.overzoom) && (resampling == o.resampling);
+        }
+
+        typedef std::vector<Rule> list;
+    };
+
+    /** Rules sorted by overzoom.
+     */
+    Rule::list rules;
+
+    bool empty() const { return rules.empty(); }
+
+    /** Adds rule, keeps rules sorted.
+     */
+    void add(const Rule &rule);
+
+    /** Picks resampling for given overzoom and accounts the choice under
+     *  given operation.
+     *
+     *  Overzoom of zero means unknown overzoom; base resampling is used.
+     */
+    geo::GeoDataset::Resampling
+    operator()(double overzoom, geo::GeoDataset::Resampling base
+               , TileOperation operation) const;
+
+    bool operator==(const ResamplingPolicy &o) const {
+        return rules == o.rules;
+    }
+
+    bool operator!=(const ResamplingPolicy &o) const {
+        return !operator==(o);
+    }
+
+    /** Writes number of requests per operation, policy (native or
+     *  overzoom) and resampling in stat (key=value) format. Counters are
+     *  process-wide.
+     */
+    static void stat(std::ostream &os, const std::string &prefix);
+};
+
+#endif // mapproxy_support_resampling_hpp_included_
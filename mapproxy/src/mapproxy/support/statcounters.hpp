@@ -0,0 +1,108 @@
+/**
+ * Copyright (c) 2019 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef mapproxy_support_statcounters_hpp_included_
+#define mapproxy_support_statcounters_hpp_included_
+
+#include <array>
+#include <atomic>
+#include <string>
+#include <cstdint>
+#include <ostream>
+
+#include <boost/noncopyable.hpp>
+
+#include "utility/enum-io.hpp"
+
+/** Tile operation accounted in generator statistics.
+ */
+UTILITY_GENERATE_ENUM(TileOperation,
+    ((image))
+    ((mask))
+)
+
+constexpr std::size_t TileOperations(2);
+
+/** Process-wide event counters: fixed table of Rows x Columns atomic slots
+ *  indexed by enumerations, i.e. counting is lock-free.
+ *
+ *  Both Row and Column must be enumerations with values 0..(N-1) and stream
+ *  output operator. Values outside of the table are ignored.
+ */
+template <typename Row, std::size_t Rows
+          , typename Column, std::size_t Columns>
+class StatCounters : boost::noncopyable {
+public:
+    StatCounters() {
+        for (auto &slot : slots_) { slot = 0; }
+    }
+
+    void count(Row row, Column column) {
+        if (auto *slot = this->slot(row, column)) {
+            slot->fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    std::uint64_t get(Row row, Column column) const {
+        const auto *slot(this->slot(row, column));
+        return slot ? slot->load(std::memory_order_relaxed) : 0;
+    }
+
+    /** Dumps non-zero counters in stat format:
+     *      prefix<row><separator><column>=value
+     */
+    void stat(std::ostream &os, const std::string &prefix
+              , const char *separator = ".") const
+    {
+        for (std::size_t r(0); r < Rows; ++r) {
+            for (std::size_t c(0); c < Columns; ++c) {
+                const auto value
+                    (slots_[r * Columns + c].load(std::memory_order_relaxed));
+                if (!value) { continue; }
+                os << prefix << static_cast<Row>(r) << separator
+                   << static_cast<Column>(c) << '=' << value << '\n';
+            }
+        }
+    }
+
+private:
+    typedef std::atomic<std::uint64_t> Slot;
+
+    Slot* slot(Row row, Column column) {
+        const auto r(static_cast<std::size_t>(row));
+        const auto c(static_cast<std::size_t>(column));
+        if ((r >= Rows) || (c >= Columns)) { return nullptr; }
+        return &slots_[r * Columns + c];
+    }
+
+    const Slot* slot(Row row, Column column) const {
+        return const_cast<StatCounters*>(this)->slot(row, column);
+    }
+
+    std::array<Slot, Rows * Columns> slots_;
+};
+
+#endif // mapproxy_support_statcounters_hpp_included_
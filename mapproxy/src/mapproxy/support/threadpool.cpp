@@ -0,0 +1,326 @@
+/**
+ * Copyright (c) 2019 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <algorithm>
+#include <ostream>
+
+#include "dbglog/dbglog.hpp"
+
+#include "threadpool.hpp"
+
+namespace asio = boost::asio;
+namespace chrono = std::chrono;
+
+ThreadPool::Config::Config(unsigned int size)
+    : size(size), adaptive(false), min(1), max(size)
+    , runnable(std::max(std::thread::hardware_concurrency(), 1u))
+    , latency(50), interval(200), shrinkAfter(25)
+{}
+
+ThreadPool::ThreadPool(asio::io_service &ios, const Config &config
+                       , const std::string &name
+                       , const BlockedGauge &blocked
+                       , const ThreadInit &threadInit)
+    : ios_(ios), config_(config), name_(name), blocked_(blocked)
+    , threadInit_(threadInit), work_(ios_), nextId_(1), stopped_(false)
+    , size_(0), active_(0), queued_(0), excess_(0), latency_(0)
+    , grown_(0), shrunk_(0), processed_(0), peak_(0)
+{
+    // make sure threads are released when something goes wrong
+    struct Guard {
+        Guard(const std::function<void()> &func) : func(func) {}
+        ~Guard() { if (func) { func(); } }
+        void release() { func = {}; }
+        std::function<void()> func;
+    } guard([this]() { stop(); });
+
+    auto size(config_.size);
+    if (config_.adaptive) {
+        size = std::min(std::max(size, config_.min), config_.max);
+        LOG(info2)
+            << "Adaptive " << name_ << " pool: " << size
+            << " threads, bounds [" << config_.min << ", " << config_.max
+            << "].";
+    }
+
+    spawn(size);
+
+    if (config_.adaptive) {
+        controller_ = std::thread(&ThreadPool::controller, this);
+    }
+
+    guard.release();
+}
+
+ThreadPool::~ThreadPool()
+{
+    stop();
+}
+
+void ThreadPool::stop()
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (stopped_ && threads_.empty()) { return; }
+        stopped_ = true;
+    }
+    cond_.notify_all();
+    if (controller_.joinable()) { controller_.join(); }
+
+    ios_.stop();
+
+    std::map<std::size_t, std::thread> threads;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        std::swap(threads, threads_);
+        finished_.clear();
+    }
+
+    for (auto &item : threads) { item.second.join(); }
+    size_ = 0;
+}
+
+void ThreadPool::post(const std::function<void()> &task)
+{
+    ++queued_;
+    const auto enqueued(chrono::steady_clock::now());
+
+    ios_.post([this, task, enqueued]()
+    {
+        --queued_;
+        ++active_;
+
+        struct Guard {
+            ThreadPool &pool;
+            Guard(ThreadPool &pool) : pool(pool) {}
+            ~Guard() { --pool.active_; ++pool.processed_; }
+        } guard(*this);
+
+        // remember maximum queueing latency in this tick
+        const std::int64_t wait
+            (chrono::duration_cast<chrono::microseconds>
+             (chrono::steady_clock::now() - enqueued).count());
+        auto current(latency_.load());
+        while ((wait > current)
+               && !latency_.compare_exchange_weak(current, wait))
+        {}
+
+        task();
+    });
+}
+
+void ThreadPool::spawn(unsigned int count)
+{
+    if (!count) { return; }
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (; count; --count) {
+        const auto id(nextId_++);
+        threads_.emplace(id, std::thread(&ThreadPool::worker, this, id));
+        ++size_;
+    }
+
+    auto peak(peak_.load());
+    const auto size(size_.load());
+    while ((size > peak) && !peak_.compare_exchange_weak(peak, size)) {}
+}
+
+void ThreadPool::retire(unsigned int count)
+{
+    if (!count) { return; }
+
+    excess_ += count;
+    size_ -= count;
+
+    // wake up idle threads; first threads to finish a handler exit
+    for (; count; --count) { ios_.post([]() {}); }
+}
+
+void ThreadPool::worker(std::size_t id)
+{
+    if (threadInit_) { threadInit_(id); }
+    LOG(info2) << "Spawned " << name_ << " worker id:" << id << ".";
+
+    const auto retired([this]() -> bool
+    {
+        auto excess(excess_.load());
+        while (excess && !excess_.compare_exchange_weak(excess, excess - 1))
+        {}
+        return excess;
+    });
+
+    for (;;) {
+        try {
+            while (ios_.run_one()) {
+                if (retired()) {
+                    LOG(info2) << "Retired " << name_ << " worker id:"
+                               << id << ".";
+                    std::unique_lock<std::mutex> lock(mutex_);
+                    finished_.push_back(id);
+                    return;
+                }
+            }
+            LOG(info2) << "Terminated " << name_ << " worker id:"
+                       << id << ".";
+            return;
+        } catch (const std::exception &e) {
+            LOG(err3)
+                << "Uncaught exception in worker: <" << e.what()
+                << ">. Going on.";
+        }
+    }
+}
+
+void ThreadPool::reap()
+{
+    std::vector<std::thread> threads;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        for (const auto id : finished_) {
+            auto fthreads(threads_.find(id));
+            if (fthreads == threads_.end()) { continue; }
+            threads.push_back(std::move(fthreads->second));
+            threads_.erase(fthreads);
+        }
+        finished_.clear();
+    }
+
+    for (auto &thread : threads) { thread.join(); }
+}
+
+ThreadPool::Sample ThreadPool::sample()
+{
+    Sample s;
+    s.size = size_;
+    s.active = active_;
+    s.queued = queued_;
+    s.blocked = blocked_ ? std::min(blocked_(), s.size) : 0;
+    s.latency = chrono::microseconds(latency_.exchange(0));
+    return s;
+}
+
+void ThreadPool::controller()
+{
+    dbglog::thread_id(name_ + ":ctrl");
+
+    ControllerState state;
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stopped_) {
+        cond_.wait_for(lock, config_.interval);
+        if (stopped_) { break; }
+        lock.unlock();
+
+        reap();
+
+        const auto s(sample());
+        const auto size(resize(config_, s, state));
+
+        if (size != s.size) {
+            LOG(info2)
+                << "Resizing " << name_ << " pool: " << s.size << " -> "
+                << size << " threads (active: " << s.active
+                << ", queued: " << s.queued << ", blocked: " << s.blocked
+                << ", latency: " << s.latency.count() << " us).";
+
+            if (size > s.size) {
+                spawn(size - s.size);
+                ++grown_;
+            } else {
+                retire(s.size - size);
+                ++shrunk_;
+            }
+        }
+
+        lock.lock();
+    }
+}
+
+unsigned int ThreadPool::resize(const Config &config, const Sample &sample
+                                , ControllerState &state)
+{
+    const auto clamp([&](unsigned int size)
+    {
+        return std::min(std::max(size, config.min), config.max);
+    });
+
+    const auto size(sample.size);
+    const auto idle((sample.active < size) ? (size - sample.active) : 0);
+    const auto runnable((sample.blocked < size) ? (size - sample.blocked) : 0);
+
+    if (sample.queued) {
+        state.idleTicks = 0;
+
+        unsigned int grow(0);
+
+        // work waits while threads are stuck outside of the pool: replace
+        // them (but not by more threads than there is work)
+        if (!idle && sample.blocked) {
+            grow = std::min(sample.queued, sample.blocked);
+        }
+
+        // work waits and there is spare CPU capacity
+        if ((!idle || (sample.latency >= config.latency))
+            && (runnable < config.runnable))
+        {
+            grow = std::max(grow, 1u);
+        }
+
+        return clamp(size + grow);
+    }
+
+    if (idle) {
+        if (++state.idleTicks >= config.shrinkAfter) {
+            state.idleTicks = 0;
+            const auto shrink(std::max(idle / 2, 1u));
+            return clamp((size > shrink) ? (size - shrink) : 0);
+        }
+        return clamp(size);
+    }
+
+    state.idleTicks = 0;
+    return clamp(size);
+}
+
+void ThreadPool::stat(std::ostream &os, const std::string &prefix) const
+{
+    os << prefix << "size=" << size_ << '\n'
+       << prefix << "adaptive=" << (config_.adaptive ? 1 : 0) << '\n'
+       << prefix << "min="
+       << (config_.adaptive ? config_.min : config_.size) << '\n'
+       << prefix << "max="
+       << (config_.adaptive ? config_.max : config_.size) << '\n'
+       << prefix << "peak=" << peak_ << '\n'
+       << prefix << "active=" << active_ << '\n'
+       << prefix << "queued=" << queued_ << '\n'
+       << prefix << "grown=" << grown_ << '\n'
+       << prefix << "shrunk=" << shrunk_ << '\n'
+       << prefix << "processed=" << processed_ << '\n'
+        ;
+    if (blocked_) {
+        os << prefix << "blocked=" << blocked_() << '\n';
+    }
+}
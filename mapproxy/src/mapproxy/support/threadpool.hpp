@@ -0,0 +1,191 @@
+/**
+ * Copyright (c) 2019 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef mapproxy_support_threadpool_hpp_included_
+#define mapproxy_support_threadpool_hpp_included_
+
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <functional>
+#include <condition_variable>
+#include <iosfwd>
+
+#include <boost/noncopyable.hpp>
+#include <boost/asio/io_service.hpp>
+
+/** Pool of threads running asio::io_service handlers.
+ *
+ *  Pool has fixed size unless configured as adaptive. Adaptive pool is
+ *  periodically resized between configured bounds by a controller thread
+ *  based on queue length, number of pool threads blocked outside of the pool
+ *  (e.g. waiting for GDAL warper) and observed queueing latency.
+ */
+class ThreadPool : boost::noncopyable {
+public:
+    struct Config {
+        /** Initial (or fixed) number of threads.
+         */
+        unsigned int size;
+
+        /** Enables adaptive sizing.
+         */
+        bool adaptive;
+
+        /** Size bounds for adaptive mode.
+         */
+        unsigned int min;
+        unsigned int max;
+
+        /** Pool grows on latency only while number of threads not blocked
+         *  outside of the pool is below this number (i.e. CPU count).
+         */
+        unsigned int runnable;
+
+        /** Queueing latency that triggers growth.
+         */
+        std::chrono::milliseconds latency;
+
+        /** Controller tick.
+         */
+        std::chrono::milliseconds interval;
+
+        /** Number of consecutive ticks with idle threads and empty queue
+         *  before the pool shrinks.
+         */
+        unsigned int shrinkAfter;
+
+        Config(unsigned int size = 1);
+    };
+
+    /** Returns number of pool threads blocked outside of the pool.
+     */
+    typedef std::function<unsigned int()> BlockedGauge;
+
+    /** Called at the start of each spawned thread with its (1-based) id.
+     */
+    typedef std::function<void(std::size_t)> ThreadInit;
+
+    ThreadPool(boost::asio::io_service &ios, const Config &config
+               , const std::string &name
+               , const BlockedGauge &blocked = BlockedGauge()
+               , const ThreadInit &threadInit = ThreadInit());
+
+    ~ThreadPool();
+
+    /** Enqueues task for processing.
+     */
+    void post(const std::function<void()> &task);
+
+    /** Stops io_service and joins all threads.
+     */
+    void stop();
+
+    /** Current number of threads.
+     */
+    unsigned int size() const { return size_; }
+
+    /** Writes stat with given prefix (e.g. "core.pool.").
+     */
+    void stat(std::ostream &os, const std::string &prefix) const;
+
+    /** Controller input.
+     */
+    struct Sample {
+        unsigned int size;
+        unsigned int active;
+        unsigned int queued;
+        unsigned int blocked;
+        std::chrono::microseconds latency;
+
+        Sample()
+            : size(), active(), queued(), blocked(), latency()
+        {}
+    };
+
+    /** Controller state kept between ticks.
+     */
+    struct ControllerState {
+        unsigned int idleTicks;
+        ControllerState() : idleTicks() {}
+    };
+
+    /** Controller decision: new pool size for given sample.
+     */
+    static unsigned int resize(const Config &config, const Sample &sample
+                               , ControllerState &state);
+
+private:
+    void spawn(unsigned int count);
+    void retire(unsigned int count);
+    void worker(std::size_t id);
+    void controller();
+    void reap();
+
+    Sample sample();
+
+    boost::asio::io_service &ios_;
+    const Config config_;
+    const std::string name_;
+    BlockedGauge blocked_;
+    ThreadInit threadInit_;
+
+    boost::asio::io_service::work work_;
+
+    /** Threads keyed by id and ids of threads that have finished.
+     */
+    std::mutex mutex_;
+    std::map<std::size_t, std::thread> threads_;
+    std::vector<std::size_t> finished_;
+    std::size_t nextId_;
+    bool stopped_;
+    std::condition_variable cond_;
+    std::thread controller_;
+
+    std::atomic<unsigned int> size_;
+    std::atomic<unsigned int> active_;
+    std::atomic<unsigned int> queued_;
+
+    /** Number of threads asked to exit.
+     */
+    std::atomic<unsigned int> excess_;
+
+    /** Maximum queueing latency in current tick (us).
+     */
+    std::atomic<std::int64_t> latency_;
+
+    std::atomic<std::uint64_t> grown_;
+    std::atomic<std::uint64_t> shrunk_;
+    std::atomic<std::uint64_t> processed_;
+    std::atomic<unsigned int> peak_;
+};
+
+#endif // mapproxy_support_threadpool_hpp_included_
@@ -120,7 +120,36 @@ void prepareTileIndex(vts::TileIndex &index
         /** TODO: RF partial nodes should be handled differently
          */
         const auto treeDepth(maskTree.depth());
+        const auto *pyramid(maskTree.pyramid());
         for (const auto lod : resource.lodRange) {
+            if (pyramid && (lod <= pyramid->bottomLod())) {
+                // use precomputed classification
+                pyramid->index().tree(lod)->forEachNode
+                    ([&](int x, int y, int size
+                         , vts::QTree::value_type value)
+                {
+                    vts::TileRange tileRange
+                        (x, y, x + size - 1, y + size - 1);
+
+                    switch (MaskPyramid::classify(value)) {
+                    case MaskPyramid::Coverage::empty:
+                        ti.set(lod, tileRange, TiFlag::none);
+                        break;
+
+                    case MaskPyramid::Coverage::partial:
+                        ti.update(lod, tileRange
+                                  , [&](TiFlag::value_type flags)
+                        {
+                            return (flags & ~TiFlag::watertight);
+                        }, false);
+                        break;
+
+                    default: break;
+                    }
+                }, vts::QTree::Filter::both);
+                continue;
+            }
+
             auto filterByMask([&](MaskTree::Node node, boost::tribool value)
             {
                 // valid -> nothing to be done
@@ -0,0 +1,787 @@
+/**
+ * Copyright (c) 2019 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <cmath>
+#include <ctime>
+#include <cstring>
+#include <cstdint>
+#include <system_error>
+#include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <functional>
+
+#include <opencv2/core/core.hpp>
+
+#include <boost/optional.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/algorithm/string/predicate.hpp>
+
+#include "utility/streams.hpp"
+#include "utility/buildsys.hpp"
+#include "utility/format.hpp"
+
+#include "service/cmdline.hpp"
+
+#include "imgproc/rastermask/quadtree.hpp"
+#include "imgproc/rastermask/mappedqtree.hpp"
+
+#include "geo/geodataset.hpp"
+
+#include "jsoncpp/json.hpp"
+#include "jsoncpp/io.hpp"
+
+#include "vts-libs/registry/po.hpp"
+#include "vts-libs/vts/io.hpp"
+#include "vts-libs/vts/nodeinfo.hpp"
+#include "vts-libs/vts/tileindex.hpp"
+
+// mapproxy stuff
+#include "mapproxy/fileinfo.hpp"
+#include "mapproxy/localsink.hpp"
+#include "mapproxy/support/coverage.hpp"
+#include "mapproxy/support/metatile.hpp"
+#include "mapproxy/support/mesh.hpp"
+#include "mapproxy/support/atlas.hpp"
+#include "mapproxy/support/demraster.hpp"
+#include "mapproxy/support/geo.hpp"
+#include "mapproxy/support/mmapped/tileindex.hpp"
+#include "mapproxy/gdalsupport/sharedmemory.hpp"
+#include "mapproxy/generator/metatile.hpp"
+
+namespace po = boost::program_options;
+namespace fs = boost::filesystem;
+namespace ba = boost::algorithm;
+
+namespace vts = vtslibs::vts;
+namespace vr = vtslibs::registry;
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+/** Runs kernels repeatedly until minimum time elapses and collects results.
+ *
+ *  Each kernel gets iteration number (to cycle over its inputs) and returns
+ *  a value accumulated into checksum to keep the compiler from optimizing
+ *  the work away.
+ */
+class Runner {
+public:
+    typedef std::function<double(std::size_t)> Kernel;
+
+    Runner(double minTime, const std::string &filter)
+        : minTime_(minTime), filter_(filter)
+        , results_(Json::arrayValue)
+    {}
+
+    /** Runs kernel. Members of info (if object) are added to result.
+     */
+    void run(const std::string &name, const Kernel &kernel
+             , const Json::Value &info = Json::Value());
+
+    const Json::Value& results() const { return results_; }
+
+private:
+    double minTime_;
+    std::string filter_;
+    Json::Value results_;
+};
+
+void Runner::run(const std::string &name, const Kernel &kernel
+                 , const Json::Value &info)
+{
+    if (!filter_.empty() && !ba::contains(name, filter_)) { return; }
+
+    // warm up
+    double checksum(kernel(0));
+
+    std::size_t iterations(0);
+    std::size_t batch(1);
+    double elapsed(0.0);
+    while (elapsed < minTime_) {
+        const auto start(Clock::now());
+        for (std::size_t i(0); i < batch; ++i) {
+            checksum += kernel(iterations + i);
+        }
+        elapsed += std::chrono::duration<double>
+            (Clock::now() - start).count();
+        iterations += batch;
+        batch *= 2;
+    }
+
+    const double nsPerOp(1e9 * elapsed / iterations);
+
+    LOG(info3) << name << ": " << nsPerOp << " ns/op ("
+               << iterations << " iterations).";
+
+    auto &r(results_.append(Json::objectValue));
+    r["name"] = name;
+    r["iterations"] = Json::UInt64(iterations);
+    r["seconds"] = elapsed;
+    r["nsPerOp"] = nsPerOp;
+    r["opsPerSecond"] = iterations / elapsed;
+    r["checksum"] = checksum;
+
+    if (info.isObject()) {
+        for (const auto &member : info.getMemberNames()) {
+            r[member] = info[member];
+        }
+    }
+}
+
+/** Simulates transfer of warped raster between GDAL worker and core: forked
+ *  worker fills a block of shared memory, main process copies it out.
+ *  Blocks are cycled so that pages are reused as by the shared memory
+ *  allocator.
+ */
+class ShmTransfer {
+public:
+    ShmTransfer(HugePages hugePages, std::size_t blockSize
+                , std::size_t blocks);
+    ~ShmTransfer();
+
+    ShmTransfer(const ShmTransfer&) = delete;
+    ShmTransfer& operator=(const ShmTransfer&) = delete;
+
+    double operator()(std::size_t i);
+
+    const SharedMemory& memory() const { return mem_; }
+
+private:
+    void worker();
+
+    SharedMemory mem_;
+    std::size_t blockSize_;
+    std::size_t blocks_;
+    int request_[2];
+    int response_[2];
+    ::pid_t child_;
+    std::vector<char> out_;
+};
+
+ShmTransfer::ShmTransfer(HugePages hugePages, std::size_t blockSize
+                         , std::size_t blocks)
+    : mem_(blockSize * blocks, hugePages), blockSize_(blockSize)
+    , blocks_(blocks), child_(-1), out_(blockSize)
+{
+    if ((::pipe(request_) == -1) || (::pipe(response_) == -1)) {
+        std::system_error e(errno, std::system_category());
+        LOGTHROW(err3, std::system_error)
+            << "Unable to create pipe: <" << e.what() << ">.";
+    }
+
+    child_ = ::fork();
+    if (child_ == -1) {
+        std::system_error e(errno, std::system_category());
+        LOGTHROW(err3, std::system_error)
+            << "Unable to fork: <" << e.what() << ">.";
+    }
+
+    if (!child_) {
+        // keep only worker's ends: reader sees EOF once parent closes its
+        // end of request pipe
+        ::close(request_[1]);
+        ::close(response_[0]);
+        worker();
+        ::_exit(EXIT_SUCCESS);
+    }
+
+    ::close(request_[0]);
+    ::close(response_[1]);
+}
+
+ShmTransfer::~ShmTransfer()
+{
+    // closing request pipe terminates worker
+    ::close(request_[1]);
+    if (child_ > 0) { ::waitpid(child_, nullptr, 0); }
+    ::close(response_[0]);
+}
+
+void ShmTransfer::worker()
+{
+    std::uint64_t index;
+    while (::read(request_[0], &index, sizeof(index)) == sizeof(index)) {
+        auto *block(static_cast<char*>(mem_.address())
+                    + (index % blocks_) * blockSize_);
+        std::memset(block, int(index & 0xff), blockSize_);
+        const char ack(0);
+        if (::write(response_[1], &ack, 1) != 1) { break; }
+    }
+}
+
+double ShmTransfer::operator()(std::size_t i)
+{
+    const std::uint64_t index(i);
+    char ack;
+    if ((::write(request_[1], &index, sizeof(index)) != sizeof(index))
+        || (::read(response_[0], &ack, 1) != 1))
+    {
+        LOGTHROW(err3, std::runtime_error) << "Worker communication failed.";
+    }
+
+    const auto *block(static_cast<const char*>(mem_.address())
+                      + (index % blocks_) * blockSize_);
+    std::memcpy(out_.data(), block, blockSize_);
+    return out_[blockSize_ / 2];
+}
+
+/** Shifts tile range from one LOD to a finer one.
+ */
+vts::TileRange shiftRange(vts::Lod srcLod, const vts::TileRange &tr
+                          , vts::Lod dstLod)
+{
+    const auto depth(dstLod - srcLod);
+    return vts::TileRange(tr.ll(0) << depth, tr.ll(1) << depth
+                          , ((tr.ur(0) + 1) << depth) - 1
+                          , ((tr.ur(1) + 1) << depth) - 1);
+}
+
+} // namespace
+
+class Benchmark : public service::Cmdline {
+public:
+    Benchmark()
+        : service::Cmdline("mapproxy-benchmark", BUILD_TARGET_VERSION)
+        , referenceFrame_("melown2015"), minTime_(1.0)
+        , lodRange_(10, 14), tileRange_(400, 280, 411, 291)
+        , maskDepth_(18), seed_(1)
+    {}
+
+private:
+    void configuration(po::options_description &cmdline
+                       , po::options_description &config
+                       , po::positional_options_description &pd);
+
+    void configure(const po::variables_map &vars);
+
+    bool help(std::ostream &out, const std::string &what) const;
+
+    int run();
+
+    /** Synthetic mask tree: a disc covering half of tile range's extent.
+     */
+    void writeMask(const fs::path &path) const;
+
+    /** Synthetic tile index: random tiles in the tile range.
+     */
+    void writeTileIndex(const fs::path &path) const;
+
+    std::string referenceFrame_;
+    fs::path output_;
+    fs::path tmp_;
+    std::string filter_;
+    std::string label_;
+    double minTime_;
+    vts::LodRange lodRange_;
+    vts::TileRange tileRange_;
+    unsigned int maskDepth_;
+    unsigned int seed_;
+};
+
+void Benchmark::configuration(po::options_description &cmdline
+                              , po::options_description &config
+                              , po::positional_options_description &pd)
+{
+    vr::registryConfiguration(config, vr::defaultPath());
+
+    cmdline.add_options()
+        ("output", po::value(&output_)->default_value("-")->required()
+         , "Output JSON file, - for stdout.")
+        ("tmp", po::value(&tmp_)
+         , "Directory for synthetic input files. Defaults to unique "
+         "directory in system temporary directory.")
+        ("filter", po::value(&filter_)
+         , "Run only benchmarks whose name contains this string.")
+        ("label", po::value(&label_)
+         , "Arbitrary label stored in output (e.g. commit id).")
+        ("minTime", po::value(&minTime_)->default_value(minTime_)->required()
+         , "Minimum run time of each benchmark (in seconds).")
+        ("referenceFrame", po::value(&referenceFrame_)
+         ->default_value(referenceFrame_)->required()
+         , "Reference frame.")
+        ("lodRange", po::value(&lodRange_)
+         ->default_value(lodRange_)->required()
+         , "LOD range of synthetic inputs.")
+        ("tileRange", po::value(&tileRange_)
+         ->default_value(tileRange_)->required()
+         , "Tile range at lodRange.min of synthetic inputs.")
+        ("maskDepth", po::value(&maskDepth_)
+         ->default_value(maskDepth_)->required()
+         , "Depth of synthetic mask tree.")
+        ("seed", po::value(&seed_)->default_value(seed_)->required()
+         , "Random generator seed.")
+        ;
+
+    pd.add("output", 1);
+}
+
+void Benchmark::configure(const po::variables_map &vars)
+{
+    vr::registryConfigure(vars);
+
+    if (tmp_.empty()) {
+        tmp_ = fs::temp_directory_path()
+            / fs::unique_path("mapproxy-benchmark-%%%%-%%%%");
+    }
+}
+
+bool Benchmark::help(std::ostream &out, const std::string &what) const
+{
+    if (what.empty()) {
+        // program help
+        out << ("Runs micro-benchmarks of per-request kernels on synthetic "
+                "inputs\nand writes results as JSON.\n"
+                );
+
+        return true;
+    }
+
+    return false;
+}
+
+void Benchmark::writeMask(const fs::path &path) const
+{
+    typedef imgproc::quadtree::RasterMask RasterMask;
+
+    // quads are set at this depth (fine enough, fast enough)
+    const unsigned int quadDepth(std::min(maskDepth_, 10u));
+    const auto size(1u << maskDepth_);
+    RasterMask mask(size, size, RasterMask::InitMode::EMPTY);
+
+    // disc around tile range center, in quad grid
+    const double scale(double(1u << quadDepth)
+                       / double(1u << lodRange_.min));
+    const math::Point2 center
+        (scale * (tileRange_.ll(0) + tileRange_.ur(0) + 1) / 2.0
+         , scale * (tileRange_.ll(1) + tileRange_.ur(1) + 1) / 2.0);
+    const double radius
+        (scale * (tileRange_.ur(0) - tileRange_.ll(0) + 1) / 4.0);
+
+    const unsigned int quads(1u << quadDepth);
+    for (unsigned int y(0); y < quads; ++y) {
+        for (unsigned int x(0); x < quads; ++x) {
+            const double dx(x + 0.5 - center(0)), dy(y + 0.5 - center(1));
+            if ((dx * dx + dy * dy) <= (radius * radius)) {
+                mask.setQuad(quadDepth, x, y);
+            }
+        }
+    }
+
+    utility::ofstreambuf f(path.string());
+    imgproc::mappedqtree::RasterMask::write(f, mask);
+    f.close();
+}
+
+void Benchmark::writeTileIndex(const fs::path &path) const
+{
+    typedef vts::TileIndex::Flag TiFlag;
+
+    std::mt19937 gen(seed_);
+    vts::TileIndex ti;
+
+    for (const auto lod : lodRange_) {
+        const auto tr(shiftRange(lodRange_.min, tileRange_, lod));
+        std::uniform_int_distribution<unsigned int> x(tr.ll(0), tr.ur(0));
+        std::uniform_int_distribution<unsigned int> y(tr.ll(1), tr.ur(1));
+        for (int i(0); i < 5000; ++i) {
+            ti.set(vts::TileId(lod, x(gen), y(gen))
+                   , TiFlag::mesh | TiFlag::watertight | TiFlag::navtile);
+        }
+    }
+
+    mmapped::TileIndex::write(path, ti);
+}
+
+int Benchmark::run()
+{
+    const auto &rf(vr::system.referenceFrames(referenceFrame_));
+
+    fs::create_directories(tmp_);
+    struct Cleanup {
+        fs::path path;
+        ~Cleanup() { boost::system::error_code ec; fs::remove_all(path, ec); }
+    } cleanup{tmp_};
+
+    // synthetic inputs
+    const auto maskPath(tmp_ / "mask");
+    writeMask(maskPath);
+    const auto tileIndexPath(tmp_ / "tileindex");
+    writeTileIndex(tileIndexPath);
+
+    MaskTree plainMask(maskPath);
+    MaskTree pyramidMask(maskPath);
+    pyramidMask.setPyramid(std::make_shared<MaskPyramid>
+                           (pyramidMask, lodRange_.max));
+
+    const mmapped::TileIndex tileIndex(tileIndexPath);
+
+    std::mt19937 gen(seed_);
+
+    // productive tiles and metatiles in the tile range
+    std::vector<vts::TileId> tiles;
+    std::vector<vts::TileId> metatiles;
+    std::vector<vts::TileId> tmsMetatiles;
+    for (const auto lod : lodRange_) {
+        const auto tr(shiftRange(lodRange_.min, tileRange_, lod));
+        std::uniform_int_distribution<unsigned int> x(tr.ll(0), tr.ur(0));
+        std::uniform_int_distribution<unsigned int> y(tr.ll(1), tr.ur(1));
+        for (int i(0); i < 64; ++i) {
+            const vts::TileId tileId(lod, x(gen), y(gen));
+            if (!vts::NodeInfo(rf, tileId).productive()) { continue; }
+            tiles.push_back(tileId);
+
+            auto meta(tileId);
+            meta.x &= ~((1u << rf.metaBinaryOrder) - 1);
+            meta.y &= ~((1u << rf.metaBinaryOrder) - 1);
+            metatiles.push_back(meta);
+
+            meta = tileId;
+            meta.x &= ~((1u << 8) - 1);
+            meta.y &= ~((1u << 8) - 1);
+            tmsMetatiles.push_back(meta);
+        }
+    }
+
+    if (tiles.empty()) {
+        LOG(fatal) << "No productive tile in " << tileRange_ << " at "
+                   << lodRange_ << ".";
+        return EXIT_FAILURE;
+    }
+
+    std::vector<vts::TileId> queries;
+    for (int i(0); i < 4096; ++i) {
+        const auto lod(std::uniform_int_distribution<vts::Lod>
+                       (lodRange_.min, lodRange_.max)(gen));
+        const auto tr(shiftRange(lodRange_.min, tileRange_, lod));
+        queries.emplace_back
+            (lod, std::uniform_int_distribution<unsigned int>
+             (tr.ll(0), tr.ur(0))(gen)
+             , std::uniform_int_distribution<unsigned int>
+             (tr.ll(1), tr.ur(1))(gen));
+    }
+
+    std::vector<std::string> urls;
+    for (const auto &tileId : tiles) {
+        urls.push_back(utility::format("/%s/tms/group/id/%d-%d-%d.jpg"
+                                       , referenceFrame_, tileId.lod
+                                       , tileId.x, tileId.y));
+        urls.push_back(utility::format("/%s/surface/group/id/%d-%d-%d.bin"
+                                       , referenceFrame_, tileId.lod
+                                       , tileId.x, tileId.y));
+    }
+    urls.push_back("/" + referenceFrame_ + "/surface/group/id/mapConfig.json");
+    urls.push_back("/" + referenceFrame_ + "/tms/group/");
+
+    // synthetic image: smooth gradient with some noise
+    cv::Mat image(256, 256, CV_8UC3);
+    {
+        std::uniform_int_distribution<int> noise(0, 15);
+        for (int j(0); j < image.rows; ++j) {
+            for (int i(0); i < image.cols; ++i) {
+                image.at<cv::Vec3b>(j, i)
+                    = cv::Vec3b(i + noise(gen), j + noise(gen)
+                                , ((i + j) / 2) + noise(gen));
+            }
+        }
+    }
+
+    auto pick([](const std::vector<vts::TileId> &list, std::size_t i)
+              -> const vts::TileId&
+    {
+        return list[i % list.size()];
+    });
+
+    Runner runner(minTime_, filter_);
+
+    runner.run("metatileBlocks", [&](std::size_t i) -> double
+    {
+        return metatileBlocks(rf, pick(metatiles, i)).size();
+    });
+
+    runner.run("metatileBlocks.tms", [&](std::size_t i) -> double
+    {
+        return metatileBlocks(rf, pick(tmsMetatiles, i), 8).size();
+    });
+
+    runner.run("mmapped.TileIndex.get", [&](std::size_t i) -> double
+    {
+        // batch of lookups, single lookup is too short to be measured
+        double sum(0);
+        for (std::size_t k(0); k < 64; ++k) {
+            sum += tileIndex.get(queries[(i * 64 + k) % queries.size()]);
+        }
+        return sum;
+    });
+
+    const HeightSampler heights([](int i, int j, double &h) -> bool
+    {
+        h = 200.0 * std::sin(i * 0.3) + 150.0 * std::cos(j * 0.2);
+        return true;
+    });
+
+    runner.run("meshFromNode", [&](std::size_t i) -> double
+    {
+        vts::NodeInfo node(rf, pick(tiles, i));
+        return meshFromNode(node, math::Size2(32, 32), heights)
+            .mesh.faces.size();
+    });
+
+    runner.run("meshFromNode+simplifyMesh", [&](std::size_t i) -> double
+    {
+        vts::NodeInfo node(rf, pick(tiles, i));
+        auto lm(meshFromNode(node, math::Size2(32, 32), heights));
+        simplifyMesh(lm.mesh, node, TileFacesCalculator(), lm.geoidGrid);
+        return lm.mesh.faces.size();
+    });
+
+    // metatile sampling kernel (metatileFromDemImpl without DEM warp):
+    // synthetic valueMinMax DEM large enough for any block; all tiles have
+    // both mesh and navtile to exercise all computations
+    cv::Mat dem;
+    {
+        math::Size2 gridSize(0, 0);
+        for (const auto &meta : metatiles) {
+            for (const auto &block : metatileBlocks(rf, meta)) {
+                const auto gs(metatileGridSize(block));
+                gridSize.width = std::max(gridSize.width, gs.width);
+                gridSize.height = std::max(gridSize.height, gs.height);
+            }
+        }
+        dem.create(gridSize.height, gridSize.width, CV_32FC3);
+        for (int j(0); j < dem.rows; ++j) {
+            for (int i(0); i < dem.cols; ++i) {
+                const float h(100.0 * std::sin(i * 0.1 + j * 0.05));
+                dem.at<cv::Vec3f>(j, i) = cv::Vec3f(h, h - 10.0, h + 10.0);
+            }
+        }
+    }
+
+    runner.run("metatile.sampleGrid", [&](std::size_t i) -> double
+    {
+        double sum(0);
+        for (const auto &block : metatileBlocks(rf, pick(metatiles, i))) {
+            if (!block.commonAncestor.productive()) { continue; }
+
+            const auto gridSize(metatileGridSize(block));
+            const std::vector<vts::TileIndex::Flag::value_type> flags
+                (math::area(vts::tileRangesSize(block.view))
+                 , (vts::TileIndex::Flag::mesh
+                    | vts::TileIndex::Flag::navtile));
+
+            for (const auto &n
+                     : sampleMetatileBlock
+                     (block, dem(cv::Rect(0, 0, gridSize.width
+                                          , gridSize.height))
+                      , flags, pyramidMask, boost::none))
+            {
+                sum += n.area + n.heightMax;
+            }
+        }
+        return sum;
+    });
+
+    for (const auto *mask : { &plainMask, &pyramidMask }) {
+        const std::string suffix((mask == &plainMask) ? "" : ".pyramid");
+
+        runner.run("boundlayerMetatileFromMaskTree" + suffix
+                   , [&](std::size_t i) -> double
+        {
+            const auto &tileId(pick(tmsMetatiles, i));
+            return cv::countNonZero
+                (boundlayerMetatileFromMaskTree
+                 (tileId, *mask, metatileBlocks(rf, tileId, 8)));
+        });
+
+        runner.run("generateCoverage" + suffix, [&](std::size_t i) -> double
+        {
+            vts::NodeInfo node(rf, pick(tiles, i));
+            return generateCoverage(256, node, *mask).count();
+        });
+    }
+
+    runner.run("FileInfo", [&](std::size_t i) -> double
+    {
+        return FileInfo(urls[i % urls.size()]).filename.size();
+    });
+
+    for (const auto format : { RasterFormat::jpg, RasterFormat::png }) {
+        for (const bool atlas : { false, true }) {
+            if (atlas && (format != RasterFormat::jpg)) { continue; }
+            runner.run(utility::format("sendImage.%s%s", format
+                                       , (atlas ? ".atlas" : ""))
+                       , [&](std::size_t) -> double
+            {
+                auto localSink(std::make_shared<LocalSink>());
+                auto response(localSink->response());
+                Sink sink(localSink);
+                sendImage(image, Sink::FileInfo(), format, atlas, sink);
+                return response.get().data.size();
+            });
+        }
+    }
+
+    // DEM warp results in double and single precision: storing warped data
+    // into result matrix (worker side) and sampling it (core side); sizes
+    // match valueMinMax metatile block (32x32 tiles, 8 samples per tile)
+    // and demOptimal mesh raster (128 samples per side), both in grid
+    // registration
+    for (const auto depth : { CV_64F, CV_32F }) {
+        const std::string type((depth == CV_32F) ? "float32" : "float64");
+
+        struct Case { std::string name; int size; int channels; };
+        for (const auto &c : { Case{ "metatile", 257, 3 }
+                               , Case{ "mesh", 129, 1 } })
+        {
+            cv::Mat warped(c.size, c.size, CV_64FC(c.channels));
+            cv::randu(warped, cv::Scalar::all(-100.0)
+                      , cv::Scalar::all(1000.0));
+            cv::Mat dem(c.size, c.size, CV_MAKETYPE(depth, c.channels));
+            warped.convertTo(dem, dem.type());
+
+            Json::Value info(Json::objectValue);
+            info["bytesPerOp"] = Json::UInt64(dem.total() * dem.elemSize());
+
+            runner.run(utility::format("dem.%s.store.%s", c.name, type)
+                       , [&](std::size_t) -> double
+            {
+                warped.convertTo(dem, dem.type());
+                return demValue(dem, 0, 0);
+            }, info);
+
+            runner.run(utility::format("dem.%s.sample.%s", c.name, type)
+                       , [&](std::size_t) -> double
+            {
+                double sum(0);
+                for (int j(0); j < dem.rows; ++j) {
+                    for (int i(0); i < dem.cols; ++i) {
+                        if (c.channels == 1) {
+                            sum += demValue(dem, i, j);
+                        } else {
+                            const auto v(demValueMinMax(dem, i, j));
+                            sum += v[0] + v[1] + v[2];
+                        }
+                    }
+                }
+                return sum;
+            }, info);
+        }
+    }
+
+    // over-zoomed tile warp (8 tile pixels per source pixel) with different
+    // resampling methods and overzoom computation used by resampling policy
+    {
+        const vts::NodeInfo node(rf, tiles.front());
+        const auto &extents(node.extents());
+        const auto es(math::size(extents));
+
+        auto src(geo::GeoDataset::create
+                 ("", node.srsDef(), extents, math::Size2(64, 64)
+                  , geo::GeoDataset::Format::coverage
+                  (geo::GeoDataset::Format::Storage::memory)
+                  , geo::NodataValue(0)));
+        cv::randu(src.data(), cv::Scalar::all(1.0), cv::Scalar::all(255.0));
+        src.flush();
+
+        // upper left quadrant of source
+        const math::Extents2 dstExtents
+            (extents.ll(0), extents.ll(1) + es.height / 2
+             , extents.ll(0) + es.width / 2, extents.ur(1));
+
+        const auto descriptor(src.descriptor());
+        runner.run("resampling.tileOverzoom", [&](std::size_t) -> double
+        {
+            return tileOverzoom(dstExtents, node.srsDef()
+                                , math::Size2(256, 256), descriptor);
+        });
+
+        for (const auto resampling : { geo::GeoDataset::Resampling::cubic
+                    , geo::GeoDataset::Resampling::bilinear
+                    , geo::GeoDataset::Resampling::nearest })
+        {
+            runner.run(utility::format("resampling.overzoom.%s", resampling)
+                       , [&](std::size_t) -> double
+            {
+                auto dst(geo::GeoDataset::deriveInMemory
+                         (src, node.srsDef(), math::Size2(256, 256)
+                          , dstExtents));
+                src.warpInto(dst, resampling);
+                return cv::sum(dst.cdata())[0];
+            });
+        }
+    }
+
+    // large warp result transfer through shared memory with different page
+    // sizes (32 MB is a 2048x2048 3-channel double raster; approximately)
+    for (const auto hugePages : { HugePages::none, HugePages::transparent
+                                  , HugePages::hugetlb })
+    {
+        const auto name(utility::format("shm.transfer.%s", hugePages));
+        if (!filter_.empty() && !ba::contains(name, filter_)) { continue; }
+
+        ShmTransfer transfer(hugePages, std::size_t(32) << 20, 8);
+
+        Json::Value info(Json::objectValue);
+        info["hugePages"] = boost::lexical_cast<std::string>
+            (transfer.memory().hugePages());
+        info["pageSize"] = Json::UInt64(transfer.memory().pageSize());
+        info["bytesPerOp"] = Json::UInt64(std::size_t(32) << 20);
+
+        runner.run(name, [&](std::size_t i) { return transfer(i); }, info);
+    }
+
+    Json::Value out(Json::objectValue);
+    out["program"] = "mapproxy-benchmark";
+    out["version"] = BUILD_TARGET_VERSION;
+    out["label"] = label_;
+    out["timestamp"] = Json::Int64(std::time(nullptr));
+    out["minTime"] = minTime_;
+    out["referenceFrame"] = referenceFrame_;
+    out["benchmarks"] = runner.results();
+
+    if (output_ == "-") {
+        Json::write(std::cout, out);
+    } else {
+        utility::ofstreambuf f(output_.string());
+        Json::write(f, out);
+        f.close();
+    }
+
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[])
+{
+    return Benchmark()(argc, argv);
+}
@@ -0,0 +1,312 @@
+/**
+ * Copyright (c) 2019 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include <boost/lexical_cast.hpp>
+
+#include "dbglog/dbglog.hpp"
+
+#include "utility/buildsys.hpp"
+#include "utility/openmp.hpp"
+#include "utility/duration.hpp"
+
+#include "service/cmdline.hpp"
+
+#include "geo/geodataset.hpp"
+#include "gdal-drivers/register.hpp"
+
+#include "vts-libs/registry/po.hpp"
+#include "vts-libs/registry/io.hpp"
+#include "vts-libs/vts/io.hpp"
+
+#include "calipers/calipers.hpp"
+
+namespace po = boost::program_options;
+namespace vts = vtslibs::vts;
+namespace vr = vtslibs::registry;
+
+namespace {
+
+/** Synthetic dataset: only its descriptor is used by calipers.
+ */
+struct Dataset {
+    std::string name;
+    geo::SrsDefinition srs;
+    math::Extents2 extents;
+    math::Size2 size;
+
+    typedef std::vector<Dataset> list;
+};
+
+geo::GeoDataset::Descriptor descriptor(const Dataset &dataset)
+{
+    return geo::GeoDataset::create
+        ("", dataset.srs, dataset.extents, dataset.size
+         , geo::GeoDataset::Format::coverage
+         (geo::GeoDataset::Format::Storage::memory)
+         , geo::NodataValue(0)).descriptor();
+}
+
+template <typename T>
+bool same(const math::Extents2_<T> &a, const math::Extents2_<T> &b)
+{
+    return ((a.ll(0) == b.ll(0)) && (a.ll(1) == b.ll(1))
+            && (a.ur(0) == b.ur(0)) && (a.ur(1) == b.ur(1)));
+}
+
+bool same(const vts::LodRange &a, const vts::LodRange &b)
+{
+    return (a.min == b.min) && (a.max == b.max);
+}
+
+bool same(const vr::Position &a, const vr::Position &b)
+{
+    for (int i(0); i < 3; ++i) {
+        if (a.position(i) != b.position(i)) { return false; }
+        if (a.orientation(i) != b.orientation(i)) { return false; }
+    }
+    return ((a.type == b.type) && (a.heightMode == b.heightMode)
+            && (a.verticalExtent == b.verticalExtent)
+            && (a.verticalFov == b.verticalFov));
+}
+
+/** Compares measurements field by field, returns number of differences.
+ */
+std::size_t compare(const std::string &what
+                    , const calipers::Measurement &serial
+                    , const calipers::Measurement &parallel)
+{
+    std::size_t failed(0);
+    auto report([&](const std::string &field)
+    {
+        ++failed;
+        LOG(err3) << "Check failed: " << what << ": " << field
+                  << " differs.";
+    });
+
+    if (serial.datasetType != parallel.datasetType) {
+        report("datasetType");
+    }
+    if (serial.gsd != parallel.gsd) { report("gsd"); }
+    if (!same(serial.lodRange, parallel.lodRange)) {
+        report("lodRange");
+    }
+    if (!same(serial.tileRange, parallel.tileRange)) {
+        report("tileRange");
+    }
+    if (!same(serial.position, parallel.position)) {
+        report("position");
+    }
+    if (serial.datasetSrs.srs != parallel.datasetSrs.srs) {
+        report("datasetSrs");
+    }
+    if (!same(serial.datasetExtents, parallel.datasetExtents)) {
+        report("datasetExtents");
+    }
+    if (serial.xOverlap != parallel.xOverlap) { report("xOverlap"); }
+
+    if (serial.nodes.size() != parallel.nodes.size()) {
+        report("number of nodes");
+        return failed;
+    }
+
+    for (std::size_t i(0), e(serial.nodes.size()); i != e; ++i) {
+        const auto &s(serial.nodes[i]);
+        const auto &p(parallel.nodes[i]);
+        const auto node("node #" + std::to_string(i) + " ");
+
+        if (s.srs != p.srs) { report(node + "srs"); }
+
+        const auto lr(s.ranges.lodRange());
+        if (!same(lr, p.ranges.lodRange())) {
+            report(node + "lodRange");
+            continue;
+        }
+
+        for (const auto lod : lr) {
+            if (!same(s.ranges.tileRange(lod), p.ranges.tileRange(lod))) {
+                report(node + "tileRange at LOD "
+                       + std::to_string(lod));
+            }
+        }
+    }
+
+    return failed;
+}
+
+} // namespace
+
+class CheckCalipers : public service::Cmdline {
+public:
+    CheckCalipers()
+        : service::Cmdline("check-calipers", BUILD_TARGET_VERSION)
+        , referenceFrame_("melown2015")
+    {}
+
+private:
+    void configuration(po::options_description &cmdline
+                       , po::options_description &config
+                       , po::positional_options_description &pd);
+
+    void configure(const po::variables_map &vars);
+
+    bool help(std::ostream &out, const std::string &what) const;
+
+    int run();
+
+    std::string referenceFrame_;
+};
+
+void CheckCalipers::configuration(po::options_description &cmdline
+                                  , po::options_description &config
+                                  , po::positional_options_description &pd)
+{
+    vr::registryConfiguration(config, vr::defaultPath());
+
+    cmdline.add_options()
+        ("referenceFrame", po::value(&referenceFrame_)
+         ->default_value(referenceFrame_)->required()
+         , "Reference frame.")
+        ;
+
+    (void) pd;
+}
+
+void CheckCalipers::configure(const po::variables_map &vars)
+{
+    vr::registryConfigure(vars);
+}
+
+bool CheckCalipers::help(std::ostream &out, const std::string &what) const
+{
+    if (what.empty()) {
+        // program help
+        out << ("Checks that calipers measurement of synthetic datasets "
+                "computed by single\nthread is identical to the one "
+                "computed in parallel.\n"
+                );
+
+        return true;
+    }
+
+    return false;
+}
+
+int CheckCalipers::run()
+{
+    const auto &rf(vr::system.referenceFrames(referenceFrame_));
+
+    const geo::SrsDefinition latlon
+        ("+proj=longlat +datum=WGS84 +no_defs"
+         , geo::SrsDefinition::Type::proj4);
+    const geo::SrsDefinition merc
+        ("+proj=merc +a=6378137 +b=6378137 +lat_ts=0 +lon_0=0 +x_0=0 +y_0=0 "
+         "+k=1 +units=m +nadgrids=@null +no_defs"
+         , geo::SrsDefinition::Type::proj4);
+    const geo::SrsDefinition utm
+        ("+proj=utm +zone=33 +datum=WGS84 +units=m +no_defs"
+         , geo::SrsDefinition::Type::proj4);
+
+    // local datasets inside single node as well as datasets spanning
+    // several reference frame nodes (incl. polar caps and x-wrap)
+    const Dataset::list datasets = {
+        { "merc", merc, math::Extents2(1.0e6, 6.0e6, 1.4e6, 6.4e6)
+          , math::Size2(4000, 4000) }
+        , { "utm", utm, math::Extents2(400000, 5400000, 420000, 5420000)
+            , math::Size2(2000, 2000) }
+        , { "latlon-world", latlon, math::Extents2(-180, -90, 180, 90)
+            , math::Size2(3600, 1800) }
+        , { "latlon-north", latlon, math::Extents2(-30, 60, 30, 90)
+            , math::Size2(1200, 600) }
+    };
+
+#ifdef _OPENMP
+    const int threads(omp_get_max_threads());
+#else
+    const int threads(1);
+    LOG(warn3) << "Built without OpenMP, both measurements are serial.";
+#endif
+
+    std::size_t failed(0), checked(0);
+
+    for (const auto &dataset : datasets) {
+        const auto ds(descriptor(dataset));
+
+        for (const auto type : { calipers::DatasetType::ophoto
+                                 , calipers::DatasetType::dem })
+        {
+            calipers::Config config;
+            config.datasetType = type;
+
+            const auto what(dataset.name + "/"
+                            + boost::lexical_cast<std::string>(type));
+
+#ifdef _OPENMP
+            omp_set_num_threads(1);
+#endif
+            utility::DurationMeter serialTimer;
+            const auto serial(calipers::measure(rf, ds, config));
+            const auto serialDuration(serialTimer.duration());
+
+#ifdef _OPENMP
+            omp_set_num_threads(threads);
+#endif
+            utility::DurationMeter parallelTimer;
+            const auto parallel(calipers::measure(rf, ds, config));
+            const auto parallelDuration(parallelTimer.duration());
+
+            if (serial.nodes.empty()) {
+                ++failed;
+                LOG(err3) << "Check failed: " << what
+                          << ": dataset not measurable.";
+                continue;
+            }
+
+            failed += compare(what, serial, parallel);
+            ++checked;
+
+            LOG(info3)
+                << what << ": " << serial.nodes.size() << " node(s), "
+                << "serial: " << utility::formatDuration(serialDuration)
+                << ", parallel (" << threads << " threads): "
+                << utility::formatDuration(parallelDuration) << ".";
+        }
+    }
+
+    LOG(info3) << "Compared " << checked << " measurements.";
+
+    LOG(info4) << (failed ? "Some checks failed." : "All checks passed.");
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[])
+{
+    gdal_drivers::registerAll();
+    return CheckCalipers()(argc, argv);
+}
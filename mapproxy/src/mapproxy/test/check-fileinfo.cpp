@@ -0,0 +1,466 @@
+/**
+ * Copyright (c) 2019 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <functional>
+
+#include <boost/lexical_cast.hpp>
+#include <boost/algorithm/string/split.hpp>
+#include <boost/algorithm/string/classification.hpp>
+#include <boost/range/iterator.hpp>
+
+#include "utility/streams.hpp"
+#include "utility/buildsys.hpp"
+
+#include "service/cmdline.hpp"
+
+#include "vts-libs/registry/po.hpp"
+#include "vts-libs/vts/tileop.hpp"
+
+// mapproxy stuff
+#include "mapproxy/error.hpp"
+#include "mapproxy/fileinfo.hpp"
+
+namespace po = boost::program_options;
+namespace ba = boost::algorithm;
+
+namespace vts = vtslibs::vts;
+namespace vr = vtslibs::registry;
+
+namespace {
+
+/** Outcome of URL parsing, used to compare implementations.
+ */
+struct Parsed {
+    bool valid;
+    FileInfo::Type type;
+    GeneratorInterface interface;
+    Resource::Id resourceId;
+    std::string filename;
+
+    /** Image tile: -1 = not a tile, 0 = invalid, 1 = valid
+     */
+    int tile;
+    vts::TileId tileId;
+    RasterFormat format;
+
+    Parsed()
+        : valid(false), type(FileInfo::Type::resourceFile), tile(-1)
+        , format()
+    {}
+
+    bool operator==(const Parsed &o) const;
+};
+
+bool Parsed::operator==(const Parsed &o) const
+{
+    if (valid != o.valid) { return false; }
+    if (!valid) { return true; }
+    return ((type == o.type) && (interface == o.interface)
+            && (resourceId == o.resourceId) && (filename == o.filename)
+            && (tile == o.tile)
+            && ((tile <= 0)
+                || ((tileId == o.tileId) && (format == o.format))));
+}
+
+std::ostream& operator<<(std::ostream &os, const Parsed &p)
+{
+    if (!p.valid) { return os << "<invalid>"; }
+    os << "type=" << int(p.type) << ", interface=" << p.interface
+       << ", resource=" << p.resourceId << ", filename=<" << p.filename
+       << ">";
+    if (p.tile > 0) {
+        os << ", tile=" << p.tileId << "." << p.format;
+    } else if (!p.tile) {
+        os << ", tile=<invalid>";
+    }
+    return os;
+}
+
+/** Reference implementation: the original split/lexical_cast based parser.
+ */
+namespace legacy {
+
+template <typename E>
+bool asEnum(const std::string &str, E &value)
+{
+    try {
+        value = boost::lexical_cast<E>(str);
+    } catch (const boost::bad_lexical_cast&) {
+        return false;
+    }
+    return true;
+}
+
+void tile(const std::string &filename, Parsed &parsed)
+{
+    if (const auto *p = vts::parseTileIdPrefix(parsed.tileId, filename)) {
+        const std::string ext(p);
+        if ((ext == "mask") || (ext == "meta")) { return; }
+        parsed.tile = asEnum(ext, parsed.format);
+    }
+}
+
+Parsed parse(const std::string &url)
+{
+    Parsed parsed;
+
+    const std::string path(url.substr(0, url.find('?')));
+
+    std::vector<std::string> components;
+    {
+        auto range(boost::make_iterator_range(path.begin(), path.end()));
+        ba::split(components, range, ba::is_any_of("/")
+                  , ba::token_compress_on);
+    }
+
+    auto rf([&]() -> bool
+    {
+        parsed.resourceId.referenceFrame = components[1];
+        return vr::system.referenceFrames(components[1], std::nothrow);
+    });
+
+    switch (components.size() - 1) {
+    case 1:
+        parsed.filename = components[1];
+        parsed.type = (((parsed.filename == "index.html")
+                        || parsed.filename.empty())
+                       ? FileInfo::Type::referenceFrameListing
+                       : FileInfo::Type::dirRedir);
+        break;
+
+    case 2:
+        if (!rf()) { return parsed; }
+        parsed.filename = components[2];
+        if (parsed.filename == "index.html") {
+            parsed.type = FileInfo::Type::referenceFrameBrowser;
+        } else if (parsed.filename == "dems.html") {
+            parsed.type = FileInfo::Type::referenceFrameDems;
+        } else if (parsed.filename.empty()) {
+            parsed.type = FileInfo::Type::typeListing;
+        } else {
+            parsed.type = FileInfo::Type::dirRedir;
+        }
+        break;
+
+    case 3:
+        if (!rf() || !asEnum(components[2], parsed.interface)) {
+            return parsed;
+        }
+        parsed.filename = components[3];
+        if (parsed.filename == "index.html") {
+            parsed.type = FileInfo::Type::typeBrowser;
+        } else if (parsed.filename.empty()) {
+            parsed.type = FileInfo::Type::groupListing;
+        } else {
+            parsed.type = FileInfo::Type::dirRedir;
+        }
+        break;
+
+    case 4:
+        if (!rf() || !asEnum(components[2], parsed.interface)) {
+            return parsed;
+        }
+        parsed.resourceId.group = components[3];
+        parsed.filename = components[4];
+        if (parsed.filename == "index.html") {
+            parsed.type = FileInfo::Type::groupBrowser;
+        } else if (parsed.filename.empty()) {
+            parsed.type = FileInfo::Type::idListing;
+        } else {
+            parsed.type = FileInfo::Type::dirRedir;
+        }
+        break;
+
+    case 5:
+        if (!rf() || !asEnum(components[2], parsed.interface)) {
+            return parsed;
+        }
+        parsed.resourceId.group = components[3];
+        parsed.resourceId.id = components[4];
+        parsed.filename = components[5];
+        parsed.type = FileInfo::Type::resourceFile;
+        if (parsed.interface.type == Resource::Generator::Type::tms) {
+            tile(parsed.filename, parsed);
+        }
+        break;
+
+    default:
+        return parsed;
+    }
+
+    parsed.valid = true;
+    return parsed;
+}
+
+} // namespace legacy
+
+/** Tested implementation.
+ */
+Parsed parse(const std::string &url)
+{
+    Parsed parsed;
+    try {
+        FileInfo fi(url);
+        parsed.type = fi.type;
+        parsed.interface = fi.interface;
+        parsed.resourceId = fi.resourceId;
+        parsed.filename = fi.filename;
+        parsed.valid = true;
+
+        if ((fi.type == FileInfo::Type::resourceFile)
+            && (fi.interface.type == Resource::Generator::Type::tms)
+            && vts::parseTileIdPrefix(parsed.tileId, fi.filename))
+        {
+            try {
+                TmsFileInfo tfi(fi);
+                if (tfi.type == TmsFileInfo::Type::image) {
+                    parsed.tile = 1;
+                    parsed.tileId = tfi.tileId;
+                    parsed.format = tfi.format;
+                }
+            } catch (const NotFound&) {
+                parsed.tile = 0;
+            }
+        }
+    } catch (const NotFound&) {
+        parsed.valid = false;
+    }
+    return parsed;
+}
+
+} // namespace
+
+class CheckFileInfo : public service::Cmdline {
+public:
+    CheckFileInfo()
+        : service::Cmdline("check-fileinfo", BUILD_TARGET_VERSION)
+        , referenceFrame_("melown2015"), iterations_(100000)
+        , seed_(1), benchmark_(100)
+    {}
+
+private:
+    void configuration(po::options_description &cmdline
+                       , po::options_description &config
+                       , po::positional_options_description &pd);
+
+    void configure(const po::variables_map &vars);
+
+    bool help(std::ostream &out, const std::string &what) const;
+
+    int run();
+
+    std::vector<std::string> corpus() const;
+
+    std::string mutate(std::string url, std::mt19937 &gen) const;
+
+    std::string referenceFrame_;
+    std::size_t iterations_;
+    unsigned int seed_;
+    std::size_t benchmark_;
+};
+
+void CheckFileInfo::configuration(po::options_description &cmdline
+                                  , po::options_description &config
+                                  , po::positional_options_description &pd)
+{
+    vr::registryConfiguration(config, vr::defaultPath());
+
+    cmdline.add_options()
+        ("referenceFrame", po::value(&referenceFrame_)
+         ->default_value(referenceFrame_)->required()
+         , "Reference frame used in generated URLs.")
+        ("iterations", po::value(&iterations_)
+         ->default_value(iterations_)->required()
+         , "Number of fuzzed URLs.")
+        ("seed", po::value(&seed_)->default_value(seed_)->required()
+         , "Random generator seed.")
+        ("benchmark", po::value(&benchmark_)
+         ->default_value(benchmark_)->required()
+         , "Number of benchmark passes over URL corpus, 0 to disable.")
+        ;
+
+    (void) config;
+    (void) pd;
+}
+
+void CheckFileInfo::configure(const po::variables_map &vars)
+{
+    vr::registryConfigure(vars);
+}
+
+bool CheckFileInfo::help(std::ostream &out, const std::string &what) const
+{
+    if (what.empty()) {
+        // program help
+        out << ("Checks URL parsing against reference implementation "
+                "using fuzzed\nURLs and measures parsing speed.\n"
+                );
+
+        return true;
+    }
+
+    return false;
+}
+
+std::vector<std::string> CheckFileInfo::corpus() const
+{
+    const std::string rf("/" + referenceFrame_);
+
+    std::vector<std::string> urls = {
+        "/", "", "//", rf, rf + "/", rf + "/index.html", rf + "/dems.html"
+        , rf + "/tms", rf + "/tms/", rf + "/surface/index.html"
+        , rf + "/terrain/group", rf + "/wmts/group/"
+        , rf + "/geodata/group/index.html", rf + "/tms/group/id"
+        , "/unknown-rf/tms/group/id/", rf + "/unknown/group/id/"
+        , rf + "//tms///group//id//", rf + "/tms/group/id/a/b"
+        };
+
+    for (const auto &type : { "tms", "surface", "geodata", "terrain"
+                              , "wmts" })
+    {
+        const auto base(rf + "/" + type + "/group/id/");
+        for (const auto &file : {
+                "", "index.html", "mapConfig.json", "boundlayer.json"
+                    , "freelayer.json", "layer.json", "tileset.conf"
+                    , "WMTSCapabilities.xml", "10-550-345.jpg"
+                    , "10-550-345.png", "10-550-345.gif"
+                    , "10-550-345.mask", "10-512-256.meta"
+                    , "12-1024-2048.bin", "12-1024-2048.terrain"
+                    , "12-1024-2048.geo", "15-1-2.rf.terrain"
+                    , "3-1-1.jpg?gen=4", "x-1-2.jpg" })
+        {
+            urls.push_back(base + file);
+        }
+    }
+
+    return urls;
+}
+
+std::string CheckFileInfo::mutate(std::string url, std::mt19937 &gen) const
+{
+    // uppercase letters exercise case handling of enum/extension parsers
+    static const std::string alphabet
+        ("/-.?0123456789abcjpgmskt ABCDEFGHIJKLMNOPQRSTUVWXYZ");
+
+    std::uniform_int_distribution<int> op(0, 4);
+    std::uniform_int_distribution<std::size_t> ch(0, alphabet.size() - 1);
+
+    const int count(std::uniform_int_distribution<int>(1, 3)(gen));
+    for (int i(0); i < count; ++i) {
+        const auto pos(std::uniform_int_distribution<std::size_t>
+                       (0, url.size())(gen));
+        switch (op(gen)) {
+        case 0: // insert
+            url.insert(pos, 1, alphabet[ch(gen)]);
+            break;
+
+        case 1: // erase
+            if (pos < url.size()) { url.erase(pos, 1); }
+            break;
+
+        case 2: // replace
+            if (pos < url.size()) { url[pos] = alphabet[ch(gen)]; }
+            break;
+
+        case 3: // duplicate slash
+            url.insert(pos, "/");
+            break;
+
+        case 4: // truncate
+            url.resize(pos);
+            break;
+        }
+    }
+
+    return url;
+}
+
+int CheckFileInfo::run()
+{
+    const auto urls(corpus());
+
+    std::size_t failed(0);
+    auto check([&](const std::string &url)
+    {
+        const auto expected(legacy::parse(url));
+        const auto parsed(parse(url));
+        if (!(expected == parsed)) {
+            if (++failed <= 100) {
+                LOG(err3) << "Mismatch for <" << url << ">: expected "
+                          << expected << ", got " << parsed << ".";
+            }
+        }
+    });
+
+    for (const auto &url : urls) { check(url); }
+
+    std::mt19937 gen(seed_);
+    std::uniform_int_distribution<std::size_t> pick(0, urls.size() - 1);
+    for (std::size_t i(0); i < iterations_; ++i) {
+        check(mutate(urls[pick(gen)], gen));
+    }
+
+    LOG(info4) << "Checked " << (urls.size() + iterations_) << " URLs, "
+               << failed << " mismatches.";
+
+    if (benchmark_) {
+        typedef std::chrono::steady_clock clock;
+
+        auto measure([&](const char *name
+                         , const std::function<Parsed(const std::string&)>
+                         &parser)
+        {
+            std::size_t valid(0);
+            const auto start(clock::now());
+            for (std::size_t pass(0); pass < benchmark_; ++pass) {
+                for (const auto &url : urls) {
+                    valid += parser(url).valid;
+                }
+            }
+            const std::chrono::duration<double, std::nano>
+                elapsed(clock::now() - start);
+
+            LOG(info4) << name << ": "
+                       << (elapsed.count() / (benchmark_ * urls.size()))
+                       << " ns/URL (" << valid << " valid).";
+        });
+
+        measure("legacy", &legacy::parse);
+        measure("current", &parse);
+    }
+
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[])
+{
+    return CheckFileInfo()(argc, argv);
+}
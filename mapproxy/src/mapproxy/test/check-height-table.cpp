@@ -0,0 +1,421 @@
+/**
+ * Copyright (c) 2019 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <unistd.h>
+
+#include <cstdlib>
+#include <algorithm>
+#include <ctime>
+#include <string>
+#include <set>
+#include <fstream>
+
+#include <boost/lexical_cast.hpp>
+#include <boost/filesystem.hpp>
+
+#include "dbglog/dbglog.hpp"
+
+#include "utility/buildsys.hpp"
+#include "utility/format.hpp"
+#include "utility/runnable.hpp"
+
+#include "service/cmdline.hpp"
+
+#include "geo/geodataset.hpp"
+#include "gdal-drivers/register.hpp"
+
+#include "vts-libs/registry/po.hpp"
+#include "vts-libs/vts/io.hpp"
+#include "vts-libs/vts/nodeinfo.hpp"
+#include "vts-libs/vts/tileindex.hpp"
+#include "vts-libs/vts/tileop.hpp"
+
+#include "http/contentfetcher.hpp"
+#include "http/error.hpp"
+
+#include "mapproxy/resource.hpp"
+#include "mapproxy/resourcebackend.hpp"
+#include "mapproxy/resourcebackend/conffile.hpp"
+#include "mapproxy/generator.hpp"
+#include "mapproxy/generator/metatile.hpp"
+#include "mapproxy/gdalsupport.hpp"
+#include "mapproxy/core.hpp"
+#include "mapproxy/localsink.hpp"
+#include "mapproxy/support/wmts.hpp"
+#include "mapproxy/support/mmapped/heighttable.hpp"
+
+namespace po = boost::program_options;
+namespace fs = boost::filesystem;
+namespace vr = vtslibs::registry;
+namespace vts = vtslibs::vts;
+
+namespace {
+
+/** No remote resources available.
+ */
+class NoFetcher : public http::ContentFetcher {
+private:
+    virtual void fetch_impl(const std::string &location
+                            , const http::ClientSink::pointer &sink
+                            , const RequestOptions&) const
+    {
+        sink->error(utility::makeError<http::NotFound>
+                    ("Remote resource <%s> not available.", location));
+    }
+};
+
+/** Writes synthetic complex DEM dataset (dem, dem.min, dem.max and tiling)
+ *  covering whole tile range.
+ */
+void writeDem(const fs::path &dir, const geo::SrsDefinition &srs
+              , const math::Extents2 &extents, const math::Size2 &size
+              , const std::string &referenceFrame
+              , const vts::LodRange &lodRange
+              , const vts::TileRange &tileRange)
+{
+    auto ds(geo::GeoDataset::create
+            ("", srs, extents, size
+             , geo::GeoDataset::Format::coverage
+             (geo::GeoDataset::Format::Storage::memory)
+             , geo::NodataValue(-1e6)));
+
+    auto &data(ds.data());
+    for (int y(0); y < size.height; ++y) {
+        for (int x(0); x < size.width; ++x) {
+            // nodata stripe makes some nodes partial or empty
+            if ((x >= size.width / 3) && (x < size.width / 3 + 16)) {
+                data.at<double>(y, x) = -1e6;
+                continue;
+            }
+            data.at<double>(y, x)
+                = 200.0 + 0.1 * ((x * 7 + y * 13) % 1000);
+        }
+    }
+    ds.flush();
+
+    fs::create_directories(dir);
+    for (const auto *name : { "dem", "dem.min", "dem.max" }) {
+        fs::remove(dir / name);
+        ds.copy(dir / name, "GTiff", geo::Options()("TILED", true));
+    }
+
+    // dataset covers whole tile range
+    vts::TileIndex tiling;
+    for (const auto lod : lodRange) {
+        tiling.set(lod, vts::shiftRange(lodRange.min, tileRange, lod)
+                   , vts::TileIndex::Flag::mesh);
+    }
+    tiling.save(dir / ("tiling." + referenceFrame));
+}
+
+/** Writes conffile resource definition: the same DEM served without and with
+ *  height table.
+ */
+void writeResources(const fs::path &path, const std::string &referenceFrame
+                    , const vts::LodRange &lodRange
+                    , const vts::TileRange &tileRange)
+{
+    const auto ranges
+        (utility::format("\"referenceFrames\": { \"%s\": {"
+                         " \"lodRange\": [%d, %d],"
+                         " \"tileRange\": [[%d, %d], [%d, %d]] } }"
+                         , referenceFrame, lodRange.min, lodRange.max
+                         , tileRange.ll(0), tileRange.ll(1)
+                         , tileRange.ur(0), tileRange.ur(1)));
+
+    std::ofstream f(path.string());
+    f.exceptions(std::ios::badbit | std::ios::failbit);
+    f << "[\n"
+      << "{ \"group\": \"check\", \"id\": \"dem\", \"type\": \"surface\""
+      << ", \"driver\": \"surface-dem\", " << ranges
+      << ", \"credits\": []"
+      << ", \"definition\": { \"dataset\": \"dem\" } }\n"
+      << ", { \"group\": \"check\", \"id\": \"dem-table\""
+      << ", \"type\": \"surface\""
+      << ", \"driver\": \"surface-dem\", " << ranges
+      << ", \"credits\": []"
+      << ", \"definition\": { \"dataset\": \"dem\""
+      << ", \"heightTableLod\": " << lodRange.max << " } }\n"
+      << "]\n";
+    f.close();
+}
+
+} // namespace
+
+class CheckHeightTable : public service::Cmdline
+                       , public utility::Runnable
+{
+public:
+    CheckHeightTable()
+        : service::Cmdline("check-height-table", BUILD_TARGET_VERSION)
+        , referenceFrame_("melown2015")
+        , lodRange_(10, 12), tileRange_(400, 280, 401, 281)
+        , size_(1024, 1024), threadCount_(2), readyTimeout_(600)
+    {
+        gdalWarperOptions_.processCount = 1;
+    }
+
+private:
+    void configuration(po::options_description &cmdline
+                       , po::options_description &config
+                       , po::positional_options_description &pd);
+
+    void configure(const po::variables_map &vars);
+
+    bool help(std::ostream &out, const std::string &what) const;
+
+    int run();
+
+    virtual bool isRunning() { return true; }
+    virtual void stop() {}
+
+    fs::path tmp_;
+    std::string referenceFrame_;
+    vts::LodRange lodRange_;
+    vts::TileRange tileRange_;
+    math::Size2 size_;
+    unsigned int threadCount_;
+    std::size_t readyTimeout_;
+
+    Generators::Config generatorsConfig_;
+    GdalWarper::Options gdalWarperOptions_;
+};
+
+void CheckHeightTable::configuration(po::options_description &cmdline
+                                     , po::options_description &config
+                                     , po::positional_options_description
+                                     &pd)
+{
+    vr::registryConfiguration(cmdline, vr::defaultPath());
+
+    cmdline.add_options()
+        ("tmp", po::value(&tmp_)->required()
+         , "Scratch directory.")
+        ("referenceFrame", po::value(&referenceFrame_)
+         ->default_value(referenceFrame_)->required()
+         , "Reference frame of checked resources.")
+        ("lodRange", po::value(&lodRange_)
+         ->default_value(lodRange_)->required()
+         , "LOD range of checked resources; height table is computed down "
+         "to lodRange.max.")
+        ("tileRange", po::value(&tileRange_)
+         ->default_value(tileRange_)->required()
+         , "Tile range at lodRange.min of checked resources.")
+        ("size", po::value(&size_)->default_value(size_)->required()
+         , "Size of synthetic DEM.")
+        ("threadCount", po::value(&threadCount_)
+         ->default_value(threadCount_)->required()
+         , "Number of generating threads.")
+        ("readyTimeout", po::value(&readyTimeout_)
+         ->default_value(readyTimeout_)->required()
+         , "Maximum time to wait for resources to be ready (in seconds).")
+        ;
+
+    pd.add("tmp", 1);
+
+    (void) config;
+}
+
+void CheckHeightTable::configure(const po::variables_map &vars)
+{
+    vr::registryConfigure(vars);
+
+    tmp_ = fs::absolute(tmp_);
+
+    generatorsConfig_.root = tmp_ / "store";
+    generatorsConfig_.resourceRoot = tmp_;
+    gdalWarperOptions_.tmpRoot = tmp_ / "tmp";
+    generatorsConfig_.tmpRoot = gdalWarperOptions_.tmpRoot / "generators";
+    generatorsConfig_.resourceUpdatePeriod = 0;
+}
+
+bool CheckHeightTable::help(std::ostream &out, const std::string &what)
+    const
+{
+    if (what.empty()) {
+        // program help
+        out << ("Serves synthetic DEM as surface-dem with and without "
+                "height table and checks\nthat metatiles built from the "
+                "table are identical to the ones built from\nthe warped "
+                "DEM.\n"
+                );
+
+        return true;
+    }
+
+    return false;
+}
+
+int CheckHeightTable::run()
+{
+    fs::remove_all(tmp_);
+    fs::create_directories(tmp_);
+
+    // synthetic DEM in SRS of the first tile
+    const auto &rf(vr::system.referenceFrames(referenceFrame_));
+    const vts::NodeInfo llNode
+        (rf, vts::TileId(lodRange_.min, tileRange_.ll(0), tileRange_.ll(1)));
+    const vts::NodeInfo urNode
+        (rf, vts::TileId(lodRange_.min, tileRange_.ur(0), tileRange_.ur(1)));
+
+    const auto &lle(llNode.extents());
+    const auto &ure(urNode.extents());
+    const math::Extents2 extents
+        (std::min(lle.ll(0), ure.ll(0)), std::min(lle.ll(1), ure.ll(1))
+         , std::max(lle.ur(0), ure.ur(0)), std::max(lle.ur(1), ure.ur(1)));
+    const auto es(math::size(extents));
+
+    // DEM overlaps tile range to cover mesh sampling margin
+    writeDem(tmp_ / "dem", llNode.srsDef()
+             , math::Extents2(extents.ll(0) - es.width / 8
+                              , extents.ll(1) - es.height / 8
+                              , extents.ur(0) + es.width / 8
+                              , extents.ur(1) + es.height / 8)
+             , size_, referenceFrame_, lodRange_, tileRange_);
+
+    writeResources(tmp_ / "resources.json", referenceFrame_, lodRange_
+                   , tileRange_);
+
+    std::size_t failed(0), checked(0);
+    auto check([&](bool ok, const std::string &what)
+    {
+        ++checked;
+        if (!ok) {
+            ++failed;
+            LOG(err3) << "Check failed: " << what << ".";
+        }
+    });
+
+    wmts::prepareTileMatrixSets();
+
+    GdalWarper warper(gdalWarperOptions_, *this);
+
+    ResourceBackend::TypedConfig rbConfig("conffile");
+    rbConfig.assign<resource_backend::Conffile::Config>().path
+        = tmp_ / "resources.json";
+    auto resourceBackend(ResourceBackend::create({}, rbConfig));
+    const auto resources(resourceBackend->load());
+
+    NoFetcher fetcher;
+    auto generators(std::make_shared<Generators>
+                    (generatorsConfig_, resourceBackend));
+    Core core(*generators, warper, threadCount_, fetcher);
+
+    const Resource::Id plainId(referenceFrame_, "check", "dem");
+    const Resource::Id tableId(referenceFrame_, "check", "dem-table");
+
+    const auto deadline(std::time(nullptr) + readyTimeout_);
+    for (const auto &resourceId : { plainId, tableId }) {
+        while (!generators->isReady(resourceId)
+               && (std::time(nullptr) < deadline))
+        {
+            warper.housekeeping();
+            ::usleep(100000);
+        }
+
+        if (!generators->isReady(resourceId)) {
+            LOG(err3) << "Check failed: resource <" << resourceId.id
+                      << "> is ready.";
+            return EXIT_FAILURE;
+        }
+    }
+
+    // table must exist and be stamped by current resource definition
+    {
+        const auto table(generatorsConfig_.root / tableId.referenceFrame
+                         / tableId.group / tableId.id / "height.table");
+        const auto stamp(mmapped::HeightTable::readStamp(table));
+        const auto iresource(resources.find(tableId));
+        check(stamp && (iresource != resources.end())
+              && (*stamp == heightTableStamp(iresource->second))
+              , "height table is up to date");
+        if (stamp) {
+            const mmapped::HeightTable ht(table);
+            check(ht.bottomLod() == lodRange_.max
+                  , "height table covers whole LOD range");
+            check(ht.size() > 0, "height table is not empty");
+        }
+    }
+
+    auto generate([&](const Resource::Id &resourceId
+                      , const vts::TileId &tileId)
+    {
+        const auto url
+            (utility::format("/%s/surface/%s/%s/%d-%d-%d.meta"
+                             , resourceId.referenceFrame, resourceId.group
+                             , resourceId.id, tileId.lod, tileId.x
+                             , tileId.y));
+
+        auto sink(std::make_shared<LocalSink>());
+        auto response(sink->response());
+
+        http::Request request;
+        request.method = "GET";
+        request.uri = request.path = url;
+        core.generate(request, sink);
+        return response.get();
+    });
+
+    const auto metaMask(~((1u << rf.metaBinaryOrder) - 1));
+
+    std::size_t metatiles(0);
+    for (const auto lod : lodRange_) {
+        const auto range(vts::shiftRange(lodRange_.min, tileRange_, lod));
+
+        std::set<vts::TileId> ids;
+        for (auto y(range.ll(1)); y <= range.ur(1); ++y) {
+            for (auto x(range.ll(0)); x <= range.ur(0); ++x) {
+                ids.insert(vts::TileId(lod, x & metaMask, y & metaMask));
+            }
+        }
+
+        for (const auto &tileId : ids) {
+            const auto plain(generate(plainId, tileId));
+            const auto table(generate(tableId, tileId));
+            ++metatiles;
+
+            const auto name(boost::lexical_cast<std::string>(tileId));
+            check(plain.ok() && table.ok()
+                  , utility::format("metatile %s generated", name));
+            check((plain.contentType == table.contentType)
+                  && (plain.data == table.data)
+                  , utility::format("metatile %s from height table is "
+                                    "identical to warped one", name));
+        }
+    }
+
+    LOG(info3) << "Compared " << metatiles << " metatiles.";
+
+    LOG(info4) << checked << " checks, "
+               << (failed ? "some checks failed." : "all checks passed.");
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[])
+{
+    gdal_drivers::registerAll();
+    return CheckHeightTable()(argc, argv);
+}
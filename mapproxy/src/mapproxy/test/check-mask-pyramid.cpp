@@ -0,0 +1,270 @@
+/**
+ * Copyright (c) 2019 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+#include <boost/optional.hpp>
+#include <boost/filesystem.hpp>
+
+#include "utility/streams.hpp"
+#include "utility/buildsys.hpp"
+
+#include "service/cmdline.hpp"
+
+#include "vts-libs/registry/po.hpp"
+#include "vts-libs/vts/io.hpp"
+#include "vts-libs/vts/nodeinfo.hpp"
+
+// mapproxy stuff
+#include "mapproxy/support/coverage.hpp"
+#include "mapproxy/support/tileindex.hpp"
+
+namespace po = boost::program_options;
+namespace fs = boost::filesystem;
+
+namespace vts = vtslibs::vts;
+namespace vr = vtslibs::registry;
+
+class CheckMaskPyramid : public service::Cmdline {
+public:
+    CheckMaskPyramid()
+        : service::Cmdline("check-mask-pyramid", BUILD_TARGET_VERSION)
+        , resource_({}), sizes_{ 4, 5, 16, 64, 255, 256 }
+    {}
+
+private:
+    void configuration(po::options_description &cmdline
+                       , po::options_description &config
+                       , po::positional_options_description &pd);
+
+    void configure(const po::variables_map &vars);
+
+    bool help(std::ostream &out, const std::string &what) const;
+
+    int run();
+
+    fs::path mask_;
+    boost::optional<vts::Lod> bottomLod_;
+    Resource resource_;
+    std::vector<int> sizes_;
+};
+
+void CheckMaskPyramid::configuration(po::options_description &cmdline
+                                     , po::options_description &config
+                                     , po::positional_options_description &pd)
+{
+    vr::registryConfiguration(config, vr::defaultPath());
+
+    cmdline.add_options()
+        ("mask", po::value(&mask_)->required()
+         , "Path to mask tree (output of mapproxy-rf-mask).")
+        ("referenceFrame", po::value(&resource_.id.referenceFrame)->required()
+         , "Reference frame.")
+        ("lodRange", po::value(&resource_.lodRange)->required()
+         , "Checked LOD range.")
+        ("tileRange", po::value(&resource_.tileRange)->required()
+         , "Checked tile range at lodRange.min.")
+        ("bottomLod", po::value<vts::Lod>()
+         , "Bottom LOD of pyramid built in memory. Companion pyramid "
+         "file is used when not set.")
+        ;
+
+    pd.add("mask", 1);
+
+    (void) config;
+}
+
+void CheckMaskPyramid::configure(const po::variables_map &vars)
+{
+    vr::registryConfigure(vars);
+
+    resource_.referenceFrame
+        = &vr::system.referenceFrames(resource_.id.referenceFrame);
+
+    if (vars.count("bottomLod")) {
+        bottomLod_ = vars["bottomLod"].as<vts::Lod>();
+    }
+}
+
+bool CheckMaskPyramid::help(std::ostream &out, const std::string &what) const
+{
+    if (what.empty()) {
+        // program help
+        out << ("Checks that coverage and tile index generated using mask "
+                "pyramid match\nruntime rasterized mask tree.\n"
+                );
+
+        return true;
+    }
+
+    return false;
+}
+
+vts::TileRange shiftRange(vts::Lod srcLod, const vts::TileRange &tr
+                          , vts::Lod dstLod)
+{
+    const auto depth(dstLod - srcLod);
+    return vts::TileRange(tr.ll(0) << depth, tr.ll(1) << depth
+                          , ((tr.ur(0) + 1) << depth) - 1
+                          , ((tr.ur(1) + 1) << depth) - 1);
+}
+
+bool same(const vts::NodeInfo::CoverageMask &a
+          , const vts::NodeInfo::CoverageMask &b, const math::Size2 &size)
+{
+    for (int j(0); j < size.height; ++j) {
+        for (int i(0); i < size.width; ++i) {
+            if (a.get(i, j) != b.get(i, j)) { return false; }
+        }
+    }
+    return true;
+}
+
+int CheckMaskPyramid::run()
+{
+    // reference: plain rasterization
+    MaskTree plain(mask_);
+    plain.setPyramid({});
+
+    // tested: with pyramid
+    MaskTree accelerated(mask_);
+    if (bottomLod_) {
+        accelerated.setPyramid(std::make_shared<MaskPyramid>
+                               (accelerated, *bottomLod_));
+    }
+    if (!accelerated.pyramid()) {
+        LOG(fatal) << "No mask pyramid available for " << mask_ << ".";
+        return EXIT_FAILURE;
+    }
+
+    std::size_t checked(0), shortcuts(0), failed(0);
+
+    auto report([&](const vts::TileId &tileId, const std::string &what)
+    {
+        if (++failed <= 100) {
+            LOG(err3) << "Mismatch at " << tileId << ": " << what << ".";
+        }
+    });
+
+    const auto &rf(*resource_.referenceFrame);
+    const auto &pyramid(*accelerated.pyramid());
+
+    for (const auto lod : resource_.lodRange) {
+        const auto tr(shiftRange(resource_.lodRange.min
+                                 , resource_.tileRange, lod));
+        for (auto y(tr.ll(1)); y <= tr.ur(1); ++y) {
+            for (auto x(tr.ll(0)); x <= tr.ur(0); ++x) {
+                const vts::TileId tileId(lod, x, y);
+                vts::NodeInfo node(rf, tileId);
+                if (!node.productive()) { continue; }
+
+                const auto c(pyramid.coverage(tileId));
+                if ((c == MaskPyramid::Coverage::full)
+                    || (c == MaskPyramid::Coverage::empty))
+                {
+                    ++shortcuts;
+                }
+
+                // surface coverage
+                for (const auto size : sizes_) {
+                    for (const auto type
+                             : { vts::NodeInfo::CoverageType::pixel
+                                 , vts::NodeInfo::CoverageType::grid })
+                    {
+                        const int gs
+                            (size + (type
+                                     == vts::NodeInfo::CoverageType::grid));
+                        if (!same(generateCoverage(size, node, plain, type)
+                                  , generateCoverage(size, node, accelerated
+                                                     , type)
+                                  , math::Size2(gs, gs)))
+                        {
+                            report(tileId, "coverage " + std::to_string(size)
+                                   + ((type == vts::NodeInfo::CoverageType
+                                       ::grid) ? " grid" : " pixel"));
+                        }
+                        ++checked;
+                    }
+                }
+
+                // boundlayer mask
+                const auto diff(boundlayerMask(tileId, plain)
+                                != boundlayerMask(tileId, accelerated));
+                if (cv::countNonZero(diff)) {
+                    report(tileId, "boundlayer mask");
+                }
+                ++checked;
+            }
+        }
+    }
+
+    // tile index
+    {
+        vts::TileIndex a, b;
+        prepareTileIndex(a, resource_, true, plain);
+        prepareTileIndex(b, resource_, true, accelerated);
+
+        for (const auto lod : resource_.lodRange) {
+            const auto *ta(a.tree(lod));
+            const auto *tb(b.tree(lod));
+            if (!ta || !tb) {
+                if (ta != tb) {
+                    report(vts::TileId(lod, 0, 0), "tile index LOD presence");
+                }
+                continue;
+            }
+
+            ta->forEachNode([&](int x, int y, int size
+                                , vts::QTree::value_type value)
+            {
+                for (int j(0); j < size; ++j) {
+                    for (int i(0); i < size; ++i) {
+                        const vts::TileId tileId(lod, x + i, y + j);
+                        if (b.get(tileId) != value) {
+                            report(tileId, "tile index");
+                        }
+                    }
+                }
+            }, vts::QTree::Filter::both);
+            ++checked;
+        }
+    }
+
+    LOG(info4) << "Checked " << checked << " items, " << shortcuts
+               << " tiles resolved by pyramid, " << failed
+               << " mismatches.";
+
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[])
+{
+    return CheckMaskPyramid()(argc, argv);
+}
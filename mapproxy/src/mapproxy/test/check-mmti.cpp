@@ -0,0 +1,216 @@
+/**
+ * Copyright (c) 2019 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cstdlib>
+#include <string>
+#include <algorithm>
+#include <fstream>
+#include <random>
+#include <chrono>
+
+#include <boost/filesystem.hpp>
+
+#include "dbglog/dbglog.hpp"
+
+#include "utility/buildsys.hpp"
+#include "utility/format.hpp"
+
+#include "service/cmdline.hpp"
+
+#include "vts-libs/vts/tileindex.hpp"
+
+// mapproxy stuff
+#include "mapproxy/support/mmapped/tileindex.hpp"
+
+namespace po = boost::program_options;
+namespace fs = boost::filesystem;
+namespace vts = vtslibs::vts;
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+/** Random tile index: random tiles and random tile ranges over LOD range.
+ */
+vts::TileIndex randomTileIndex(std::mt19937 &gen, vts::Lod maxLod
+                               , unsigned int tileCount)
+{
+    typedef vts::TileIndex::Flag TiFlag;
+
+    const TiFlag::value_type flags[] = {
+        TiFlag::none, TiFlag::mesh, TiFlag::mesh | TiFlag::watertight
+        , TiFlag::mesh | TiFlag::watertight | TiFlag::navtile
+    };
+    std::uniform_int_distribution<int> flag(0, 3);
+
+    vts::TileIndex ti;
+    for (vts::Lod lod(0); lod <= maxLod; ++lod) {
+        const unsigned int size(1 << lod);
+        std::uniform_int_distribution<unsigned int> coord(0, size - 1);
+
+        // few ranges
+        for (int i(0); i < 4; ++i) {
+            const auto x1(coord(gen)), y1(coord(gen));
+            const auto x2(std::min(size - 1, x1 + coord(gen) / 4));
+            const auto y2(std::min(size - 1, y1 + coord(gen) / 4));
+            ti.set(lod, vts::TileRange(x1, y1, x2, y2), flags[flag(gen)]);
+        }
+
+        // and lots of single tiles
+        for (unsigned int i(0); i < tileCount; ++i) {
+            ti.set(vts::TileId(lod, coord(gen), coord(gen))
+                   , flags[flag(gen)]);
+        }
+    }
+    return ti;
+}
+
+std::string slurp(const fs::path &path)
+{
+    std::ifstream f(path.string(), std::ios_base::in | std::ios_base::binary);
+    return std::string((std::istreambuf_iterator<char>(f))
+                       , std::istreambuf_iterator<char>());
+}
+
+} // namespace
+
+class CheckMmti : public service::Cmdline {
+public:
+    CheckMmti()
+        : service::Cmdline("check-mmti", BUILD_TARGET_VERSION)
+        , iterations_(20), maxLod_(14), tileCount_(2000), seed_(1)
+    {}
+
+private:
+    void configuration(po::options_description &cmdline
+                       , po::options_description &config
+                       , po::positional_options_description &pd);
+
+    void configure(const po::variables_map &vars);
+
+    bool help(std::ostream &out, const std::string &what) const;
+
+    int run();
+
+    fs::path tmp_;
+    unsigned int iterations_;
+    vts::Lod maxLod_;
+    unsigned int tileCount_;
+    unsigned int seed_;
+};
+
+void CheckMmti::configuration(po::options_description &cmdline
+                              , po::options_description &config
+                              , po::positional_options_description &pd)
+{
+    cmdline.add_options()
+        ("tmp", po::value(&tmp_)->required()
+         , "Scratch directory.")
+        ("iterations", po::value(&iterations_)
+         ->default_value(iterations_)->required()
+         , "Number of random tile indices.")
+        ("maxLod", po::value(&maxLod_)
+         ->default_value(maxLod_)->required()
+         , "Maximum LOD of random tile indices.")
+        ("tileCount", po::value(&tileCount_)
+         ->default_value(tileCount_)->required()
+         , "Number of random tiles per LOD.")
+        ("seed", po::value(&seed_)->default_value(seed_)->required()
+         , "Random generator seed.")
+        ;
+
+    pd.add("tmp", 1);
+
+    (void) config;
+}
+
+void CheckMmti::configure(const po::variables_map &vars)
+{
+    (void) vars;
+}
+
+bool CheckMmti::help(std::ostream &out, const std::string &what) const
+{
+    if (what.empty()) {
+        // program help
+        out << ("Checks that parallel tileindex to mmapped tileindex "
+                "conversion produces\nthe same bytes as serial conversion "
+                "on random tile indices.\n"
+                );
+
+        return true;
+    }
+
+    return false;
+}
+
+int CheckMmti::run()
+{
+    fs::create_directories(tmp_);
+
+    std::size_t failed(0);
+    double serialTime(0), parallelTime(0);
+
+    auto write([&](const vts::TileIndex &ti, unsigned int threadCount
+                   , double &time) -> std::string
+    {
+        const auto path(tmp_ / utility::format("mmti.%d", threadCount));
+        const auto start(Clock::now());
+        mmapped::TileIndex::write(path, ti, threadCount);
+        time += std::chrono::duration<double, std::milli>
+            (Clock::now() - start).count();
+        auto data(slurp(path));
+        fs::remove(path);
+        return data;
+    });
+
+    std::mt19937 gen(seed_);
+    for (unsigned int i(0); i < iterations_; ++i) {
+        const auto ti(randomTileIndex(gen, i % (maxLod_ + 1), tileCount_));
+
+        const auto serial(write(ti, 1, serialTime));
+        for (unsigned int threadCount : { 2, 3, 4, 0 }) {
+            if (write(ti, threadCount, parallelTime) != serial) {
+                ++failed;
+                LOG(err3) << "Check failed: tile index #" << i
+                          << " converted by " << threadCount
+                          << " threads differs from serial conversion.";
+            }
+        }
+    }
+
+    LOG(info3) << "Serial conversion: " << serialTime
+               << " ms, parallel conversion: " << (parallelTime / 4)
+               << " ms (average).";
+
+    LOG(info4) << (failed ? "Some checks failed." : "All checks passed.");
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[])
+{
+    return CheckMmti()(argc, argv);
+}
@@ -0,0 +1,199 @@
+/**
+ * Copyright (c) 2019 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <sys/mman.h>
+
+#include <cstdlib>
+#include <set>
+#include <string>
+#include <thread>
+#include <stdexcept>
+
+#include <boost/lexical_cast.hpp>
+
+#include "dbglog/dbglog.hpp"
+
+#include "utility/buildsys.hpp"
+
+#include "service/cmdline.hpp"
+
+// mapproxy stuff
+#include "mapproxy/support/placement.hpp"
+
+namespace po = boost::program_options;
+
+class CheckPlacement : public service::Cmdline {
+public:
+    CheckPlacement()
+        : service::Cmdline("check-placement", BUILD_TARGET_VERSION)
+    {}
+
+private:
+    void configuration(po::options_description &cmdline
+                       , po::options_description &config
+                       , po::positional_options_description &pd);
+
+    void configure(const po::variables_map &vars);
+
+    bool help(std::ostream &out, const std::string &what) const;
+
+    int run();
+
+    CpuSet cpus_;
+};
+
+void CheckPlacement::configuration(po::options_description &cmdline
+                                   , po::options_description &config
+                                   , po::positional_options_description &pd)
+{
+    cmdline.add_options()
+        ("cpus", po::value(&cpus_)
+         , "CPUs to test pinning to. Defaults to the first allowed CPU.")
+        ;
+
+    (void) config;
+    (void) pd;
+}
+
+void CheckPlacement::configure(const po::variables_map &vars)
+{
+    (void) vars;
+}
+
+bool CheckPlacement::help(std::ostream &out, const std::string &what) const
+{
+    if (what.empty()) {
+        // program help
+        out << ("Checks CPU list parsing, thread pinning (verified by "
+                "sched_getaffinity),\nGDAL worker NUMA distribution and "
+                "memory policy application.\n"
+                );
+
+        return true;
+    }
+
+    return false;
+}
+
+int CheckPlacement::run()
+{
+    std::size_t failed(0);
+    auto check([&](bool ok, const std::string &what)
+    {
+        if (!ok) {
+            ++failed;
+            LOG(err3) << "Check failed: " << what << ".";
+        }
+    });
+
+    // parsing and formatting
+    for (const auto &str : { "0", "0-3", "0-3,8,10-11", "1,3,5" }) {
+        check(boost::lexical_cast<std::string>(CpuSet::parse(str)) == str
+              , std::string("round trip of <") + str + ">");
+    }
+    check(CpuSet::parse("3,0-2") == CpuSet::parse("0-3")
+          , "normalization of <3,0-2>");
+    for (const auto &str : { "a", "1-", "-1", "3-1", "1-2-3", "1,x" }) {
+        bool thrown(false);
+        try { CpuSet::parse(str); } catch (const std::invalid_argument&) {
+            thrown = true;
+        }
+        check(thrown, std::string("rejection of <") + str + ">");
+    }
+
+    // pinning, checked via sched_getaffinity in a fresh thread
+    const auto allowed(CpuSet::current());
+    check(!allowed.empty(), "non-empty affinity");
+    if (!allowed.empty()) {
+        const auto target(cpus_.empty()
+                          ? CpuSet(std::set<int>{ *allowed.cpus().begin() })
+                          : cpus_);
+
+        CpuSet seen, inherited;
+        std::thread([&]()
+        {
+            pinThread(target, "test");
+            seen = CpuSet::current();
+
+            // threads inherit placement of their creator
+            std::thread([&]() { inherited = CpuSet::current(); }).join();
+        }).join();
+
+        check(seen == target, "pinned affinity");
+        check(inherited == target, "inherited affinity");
+        check(CpuSet::current() == allowed, "untouched main thread");
+
+        {
+            ScopedPlacement placement(target, "scoped");
+            check(CpuSet::current() == target, "scoped affinity");
+        }
+        check(CpuSet::current() == allowed, "restored affinity");
+    }
+
+    // NUMA distribution of GDAL workers
+    const auto nodes(numaNodes());
+    for (const auto &node : nodes) {
+        LOG(info3) << "NUMA node " << node.id << ": CPUs ["
+                   << node.cpus << "].";
+    }
+
+    const auto used(numaNodes(nodes, allowed));
+    for (std::size_t id(1); id <= 2 * used.size(); ++id) {
+        const auto cpus(gdalWorkerCpus(allowed, true, id, nodes));
+        const auto &expected(used[(id - 1) % used.size()]);
+        check(cpus == expected.cpus
+              , "GDAL worker " + std::to_string(id) + " on NUMA node "
+              + std::to_string(expected.id));
+    }
+    check(gdalWorkerCpus(allowed, false, 1, nodes) == allowed
+          , "GDAL worker without spreading");
+
+    // memory policy: must succeed or fail cleanly (e.g. no NUMA support)
+    {
+        const std::size_t size(std::size_t(1) << 24);
+        void *mem(::mmap(nullptr, size, PROT_READ | PROT_WRITE
+                         , MAP_SHARED | MAP_ANONYMOUS, -1, 0));
+        check(mem != MAP_FAILED, "mmap");
+        if (mem != MAP_FAILED) {
+            const bool interleaved(applyMemoryPolicy
+                                   (mem, size, MemoryPolicy::interleave
+                                    , nodes));
+            LOG(info3) << "Interleave policy "
+                       << (interleaved ? "applied" : "not supported") << ".";
+            check(applyMemoryPolicy(mem, size, MemoryPolicy::none, nodes)
+                  , "no-op memory policy");
+            ::munmap(mem, size);
+        }
+    }
+
+    LOG(info4) << (failed ? "Some checks failed." : "All checks passed.");
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[])
+{
+    return CheckPlacement()(argc, argv);
+}
@@ -0,0 +1,508 @@
+/**
+ * Copyright (c) 2019 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <unistd.h>
+
+#include <cstdlib>
+#include <algorithm>
+#include <ctime>
+#include <string>
+#include <vector>
+#include <set>
+#include <fstream>
+
+#include <boost/lexical_cast.hpp>
+#include <boost/filesystem.hpp>
+
+#include "dbglog/dbglog.hpp"
+
+#include "utility/buildsys.hpp"
+#include "utility/format.hpp"
+#include "utility/runnable.hpp"
+
+#include "service/cmdline.hpp"
+
+#include "geo/geodataset.hpp"
+#include "gdal-drivers/register.hpp"
+
+#include "vts-libs/registry/po.hpp"
+#include "vts-libs/vts/io.hpp"
+#include "vts-libs/vts/nodeinfo.hpp"
+#include "vts-libs/vts/tileop.hpp"
+
+#include "http/contentfetcher.hpp"
+#include "http/error.hpp"
+
+#include "mapproxy/resource.hpp"
+#include "mapproxy/resourcebackend.hpp"
+#include "mapproxy/resourcebackend/conffile.hpp"
+#include "mapproxy/generator.hpp"
+#include "mapproxy/gdalsupport.hpp"
+#include "mapproxy/core.hpp"
+#include "mapproxy/localsink.hpp"
+#include "mapproxy/support/wmts.hpp"
+#include "mapproxy/support/mmapped/tilepack.hpp"
+
+namespace po = boost::program_options;
+namespace fs = boost::filesystem;
+namespace vr = vtslibs::registry;
+namespace vts = vtslibs::vts;
+
+namespace {
+
+/** Binary order of tms metatile, see generator/tms-raster.cpp
+ */
+const unsigned int RasterMetatileBinaryOrder(8);
+
+/** No remote resources available.
+ */
+class NoFetcher : public http::ContentFetcher {
+private:
+    virtual void fetch_impl(const std::string &location
+                            , const http::ClientSink::pointer &sink
+                            , const RequestOptions&) const
+    {
+        sink->error(utility::makeError<http::NotFound>
+                    ("Remote resource <%s> not available.", location));
+    }
+};
+
+/** Writes synthetic orthophoto: smooth RGB pattern with nodata hole.
+ */
+void writeOphoto(const fs::path &path, const geo::SrsDefinition &srs
+                 , const math::Extents2 &extents, const math::Size2 &size)
+{
+    auto format(geo::GeoDataset::Format::gtiffRGBPhoto());
+    format.storageType = geo::GeoDataset::Format::Storage::memory;
+
+    auto ds(geo::GeoDataset::create("", srs, extents, size, format
+                                    , geo::NodataValue(0)));
+
+    auto &data(ds.data());
+    for (int y(0); y < size.height; ++y) {
+        for (int x(0); x < size.width; ++x) {
+            // hole in upper left quadrant
+            if ((x >= size.width / 8) && (x < size.width / 4)
+                && (y >= size.height / 8) && (y < size.height / 4))
+            {
+                data.at<cv::Vec3d>(y, x) = cv::Vec3d(0, 0, 0);
+                continue;
+            }
+            data.at<cv::Vec3d>(y, x) = cv::Vec3d
+                (1 + (x * 7 + y * 13) % 250, 1 + (x * 3) % 250
+                 , 1 + (y * 5) % 250);
+        }
+    }
+    ds.flush();
+
+    fs::remove(path);
+    ds.copy(path, "GTiff", geo::Options()("TILED", true));
+}
+
+/** Writes conffile resource definition: the same orthophoto served without
+ *  and with pre-rendered tiles.
+ */
+void writeResources(const fs::path &path, const std::string &referenceFrame
+                    , const vts::LodRange &lodRange
+                    , const vts::TileRange &tileRange)
+{
+    const auto ranges
+        (utility::format("\"referenceFrames\": { \"%s\": {"
+                         " \"lodRange\": [%d, %d],"
+                         " \"tileRange\": [[%d, %d], [%d, %d]] } }"
+                         , referenceFrame, lodRange.min, lodRange.max
+                         , tileRange.ll(0), tileRange.ll(1)
+                         , tileRange.ur(0), tileRange.ur(1)));
+
+    std::ofstream f(path.string());
+    f.exceptions(std::ios::badbit | std::ios::failbit);
+    f << "[\n"
+      << "{ \"group\": \"check\", \"id\": \"ophoto\", \"type\": \"tms\""
+      << ", \"driver\": \"tms-raster\", " << ranges
+      << ", \"credits\": []"
+      << ", \"definition\": { \"dataset\": \"ophoto.tif\""
+      << ", \"format\": \"png\" } }\n"
+      << ", { \"group\": \"check\", \"id\": \"ophoto-prerendered\""
+      << ", \"type\": \"tms\""
+      << ", \"driver\": \"tms-raster\", " << ranges
+      << ", \"credits\": []"
+      << ", \"definition\": { \"dataset\": \"ophoto.tif\""
+      << ", \"format\": \"png\""
+      << ", \"prerender\": " << lodRange.max << " } }\n"
+      << "]\n";
+    f.close();
+}
+
+} // namespace
+
+class CheckPrerender : public service::Cmdline
+                     , public utility::Runnable
+{
+public:
+    CheckPrerender()
+        : service::Cmdline("check-prerender", BUILD_TARGET_VERSION)
+        , referenceFrame_("melown2015")
+        , lodRange_(10, 11), tileRange_(400, 280, 401, 281)
+        , size_(1024, 1024), threadCount_(2), readyTimeout_(600)
+    {
+        gdalWarperOptions_.processCount = 1;
+    }
+
+private:
+    void configuration(po::options_description &cmdline
+                       , po::options_description &config
+                       , po::positional_options_description &pd);
+
+    void configure(const po::variables_map &vars);
+
+    bool help(std::ostream &out, const std::string &what) const;
+
+    int run();
+
+    virtual bool isRunning() { return true; }
+    virtual void stop() {}
+
+    /** Writes synthetic pack and reads it back.
+     */
+    std::size_t checkRoundTrip() const;
+
+    /** Compares pre-rendered tiles with generated ones.
+     */
+    std::size_t checkPrerendered();
+
+    fs::path tmp_;
+    std::string referenceFrame_;
+    vts::LodRange lodRange_;
+    vts::TileRange tileRange_;
+    math::Size2 size_;
+    unsigned int threadCount_;
+    std::size_t readyTimeout_;
+
+    Generators::Config generatorsConfig_;
+    GdalWarper::Options gdalWarperOptions_;
+};
+
+void CheckPrerender::configuration(po::options_description &cmdline
+                                   , po::options_description &config
+                                   , po::positional_options_description &pd)
+{
+    vr::registryConfiguration(cmdline, vr::defaultPath());
+
+    cmdline.add_options()
+        ("tmp", po::value(&tmp_)->required()
+         , "Scratch directory.")
+        ("referenceFrame", po::value(&referenceFrame_)
+         ->default_value(referenceFrame_)->required()
+         , "Reference frame of checked resources.")
+        ("lodRange", po::value(&lodRange_)
+         ->default_value(lodRange_)->required()
+         , "LOD range of checked resources; all LODs are pre-rendered.")
+        ("tileRange", po::value(&tileRange_)
+         ->default_value(tileRange_)->required()
+         , "Tile range at lodRange.min of checked resources.")
+        ("size", po::value(&size_)->default_value(size_)->required()
+         , "Size of synthetic orthophoto.")
+        ("threadCount", po::value(&threadCount_)
+         ->default_value(threadCount_)->required()
+         , "Number of generating threads.")
+        ("readyTimeout", po::value(&readyTimeout_)
+         ->default_value(readyTimeout_)->required()
+         , "Maximum time to wait for resources to be ready (in seconds).")
+        ;
+
+    pd.add("tmp", 1);
+
+    (void) config;
+}
+
+void CheckPrerender::configure(const po::variables_map &vars)
+{
+    vr::registryConfigure(vars);
+
+    tmp_ = fs::absolute(tmp_);
+
+    generatorsConfig_.root = tmp_ / "store";
+    generatorsConfig_.resourceRoot = tmp_;
+    gdalWarperOptions_.tmpRoot = tmp_ / "tmp";
+    generatorsConfig_.tmpRoot = gdalWarperOptions_.tmpRoot / "generators";
+    generatorsConfig_.resourceUpdatePeriod = 0;
+}
+
+bool CheckPrerender::help(std::ostream &out, const std::string &what) const
+{
+    if (what.empty()) {
+        // program help
+        out << ("Checks that tile pack reads back what was written and that "
+                "pre-rendered\nimage, mask and metatiles of synthetic "
+                "orthophoto are identical to the\ndirectly generated "
+                "ones.\n"
+                );
+
+        return true;
+    }
+
+    return false;
+}
+
+std::size_t CheckPrerender::checkRoundTrip() const
+{
+    typedef mmapped::TilePack::FileType FileType;
+
+    struct Item {
+        FileType type;
+        vts::TileId tileId;
+        std::string contentType;
+        std::string data;
+    };
+
+    // deliberately unsorted, including empty file and same tile with
+    // different types
+    const std::vector<Item> items = {
+        { FileType::metatile, vts::TileId(12, 256, 0)
+          , "image/png", std::string(300, 'm') }
+        , { FileType::image, vts::TileId(12, 7, 9)
+            , "image/jpeg", "image 12-7-9" }
+        , { FileType::mask, vts::TileId(12, 7, 9)
+            , "image/png", "mask 12-7-9" }
+        , { FileType::image, vts::TileId(3, 1, 2)
+            , "image/png", std::string("\0binary\0", 8) }
+        , { FileType::image, vts::TileId(12, 7, 8)
+            , "application/octet-stream", "" }
+    };
+
+    mmapped::TilePack::Stamp stamp;
+    stamp.revision = 42;
+    stamp.fingerprint = mmapped::TilePack::fingerprint("check-prerender");
+
+    const auto path(tmp_ / "roundtrip.pack");
+    {
+        mmapped::TilePack::Writer writer(path, stamp);
+        for (const auto &item : items) {
+            writer.add(item.type, item.tileId, item.contentType, item.data);
+        }
+        writer.close();
+    }
+
+    std::size_t failed(0);
+    auto check([&](bool ok, const std::string &what)
+    {
+        if (!ok) {
+            ++failed;
+            LOG(err3) << "Check failed: " << what << ".";
+        }
+    });
+
+    const auto readStamp(mmapped::TilePack::readStamp(path));
+    check(readStamp && (*readStamp == stamp), "pack stamp read back");
+    check(!mmapped::TilePack::readStamp(tmp_ / "nonexistent.pack")
+          , "missing pack has no stamp");
+
+    const mmapped::TilePack pack(path);
+    check(pack.stamp() == stamp, "opened pack has written stamp");
+    check(pack.size() == items.size(), "pack has all files");
+
+    for (const auto &item : items) {
+        const auto name
+            (utility::format("%s (%d)"
+                             , boost::lexical_cast<std::string>(item.tileId)
+                             , int(item.type)));
+        const auto file(pack.find(item.type, item.tileId));
+        check(file && (file->contentType == item.contentType)
+              && (std::string(file->data, file->size) == item.data)
+              , utility::format("file %s read back", name));
+    }
+
+    check(!pack.find(FileType::mask, vts::TileId(12, 7, 8))
+          , "file of other type is not found");
+    check(!pack.find(FileType::image, vts::TileId(12, 8, 9))
+          , "missing tile is not found");
+    check(!pack.find(FileType::image, vts::TileId(11, 7, 9))
+          , "tile at other LOD is not found");
+
+    return failed;
+}
+
+std::size_t CheckPrerender::checkPrerendered()
+{
+    // synthetic orthophoto in SRS of the first tile
+    const auto &rf(vr::system.referenceFrames(referenceFrame_));
+    const vts::NodeInfo llNode
+        (rf, vts::TileId(lodRange_.min, tileRange_.ll(0), tileRange_.ll(1)));
+    const vts::NodeInfo urNode
+        (rf, vts::TileId(lodRange_.min, tileRange_.ur(0), tileRange_.ur(1)));
+
+    const auto &lle(llNode.extents());
+    const auto &ure(urNode.extents());
+    const math::Extents2 extents
+        (std::min(lle.ll(0), ure.ll(0)), std::min(lle.ll(1), ure.ll(1))
+         , std::max(lle.ur(0), ure.ur(0)), std::max(lle.ur(1), ure.ur(1)));
+    const auto es(math::size(extents));
+
+    // orthophoto leaves right and bottom parts of the tile range uncovered
+    writeOphoto(tmp_ / "ophoto.tif", llNode.srsDef()
+                , math::Extents2(extents.ll(0), extents.ll(1) + es.height / 4
+                                 , extents.ll(0) + es.width * 5 / 8
+                                 , extents.ur(1))
+                , size_);
+
+    writeResources(tmp_ / "resources.json", referenceFrame_, lodRange_
+                   , tileRange_);
+
+    std::size_t failed(0);
+    auto check([&](bool ok, const std::string &what)
+    {
+        if (!ok) {
+            ++failed;
+            LOG(err3) << "Check failed: " << what << ".";
+        }
+    });
+
+    wmts::prepareTileMatrixSets();
+
+    GdalWarper warper(gdalWarperOptions_, *this);
+
+    ResourceBackend::TypedConfig rbConfig("conffile");
+    rbConfig.assign<resource_backend::Conffile::Config>().path
+        = tmp_ / "resources.json";
+    auto resourceBackend(ResourceBackend::create({}, rbConfig));
+
+    NoFetcher fetcher;
+    auto generators(std::make_shared<Generators>
+                    (generatorsConfig_, resourceBackend));
+    Core core(*generators, warper, threadCount_, fetcher);
+
+    const Resource::Id plainId(referenceFrame_, "check", "ophoto");
+    const Resource::Id packedId(referenceFrame_, "check"
+                                , "ophoto-prerendered");
+
+    const auto deadline(std::time(nullptr) + readyTimeout_);
+    for (const auto &resourceId : { plainId, packedId }) {
+        while (!generators->isReady(resourceId)
+               && (std::time(nullptr) < deadline))
+        {
+            warper.housekeeping();
+            ::usleep(100000);
+        }
+
+        if (!generators->isReady(resourceId)) {
+            check(false, utility::format("resource <%s> is ready"
+                                         , resourceId.id));
+            return failed;
+        }
+    }
+
+    const auto packPath(generatorsConfig_.root / packedId.referenceFrame
+                        / packedId.group / packedId.id / "prerender.pack");
+    check(bool(mmapped::TilePack::readStamp(packPath))
+          , "pre-rendered pack exists");
+    check(!fs::exists(generatorsConfig_.root / plainId.referenceFrame
+                      / plainId.group / plainId.id / "prerender.pack")
+          , "resource without prerender has no pack");
+
+    auto generate([&](const Resource::Id &resourceId
+                      , const vts::TileId &tileId, const std::string &ext)
+    {
+        const auto url
+            (utility::format("/%s/tms/%s/%s/%d-%d-%d.%s"
+                             , resourceId.referenceFrame, resourceId.group
+                             , resourceId.id, tileId.lod, tileId.x
+                             , tileId.y, ext));
+
+        auto sink(std::make_shared<LocalSink>());
+        auto response(sink->response());
+
+        http::Request request;
+        request.method = "GET";
+        request.uri = request.path = url;
+        core.generate(request, sink);
+        return response.get();
+    });
+
+    std::size_t compared(0), notFound(0);
+    auto compare([&](const vts::TileId &tileId, const std::string &ext)
+    {
+        const auto plain(generate(plainId, tileId, ext));
+        const auto packed(generate(packedId, tileId, ext));
+        ++compared;
+
+        const auto name
+            (utility::format("%s.%s"
+                             , boost::lexical_cast<std::string>(tileId)
+                             , ext));
+        check(plain.status == packed.status
+              , utility::format("%s has the same status", name));
+        if (!plain.ok()) {
+            ++notFound;
+            return;
+        }
+
+        check((plain.contentType == packed.contentType)
+              && (plain.data == packed.data)
+              , utility::format("pre-rendered %s is identical to generated"
+                                , name));
+    });
+
+    const auto metaMask(~((1u << RasterMetatileBinaryOrder) - 1));
+
+    for (const auto lod : lodRange_) {
+        const auto range(vts::shiftRange(lodRange_.min, tileRange_, lod));
+
+        std::set<vts::TileId> metatiles;
+        for (auto y(range.ll(1)); y <= range.ur(1); ++y) {
+            for (auto x(range.ll(0)); x <= range.ur(0); ++x) {
+                const vts::TileId tileId(lod, x, y);
+                compare(tileId, "png");
+                compare(tileId, "mask");
+                metatiles.insert
+                    (vts::TileId(lod, x & metaMask, y & metaMask));
+            }
+        }
+
+        for (const auto &tileId : metatiles) { compare(tileId, "meta"); }
+    }
+
+    LOG(info3) << "Compared " << compared << " files (" << notFound
+               << " not found).";
+
+    return failed;
+}
+
+int CheckPrerender::run()
+{
+    fs::remove_all(tmp_);
+    fs::create_directories(tmp_);
+
+    const auto failed(checkRoundTrip() + checkPrerendered());
+
+    LOG(info4) << (failed ? "Some checks failed." : "All checks passed.");
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[])
+{
+    gdal_drivers::registerAll();
+    return CheckPrerender()(argc, argv);
+}
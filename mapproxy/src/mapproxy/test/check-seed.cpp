@@ -0,0 +1,599 @@
+/**
+ * Copyright (c) 2019 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <cerrno>
+#include <algorithm>
+#include <ctime>
+#include <system_error>
+#include <string>
+#include <vector>
+#include <fstream>
+
+#include <boost/optional.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/filesystem.hpp>
+
+#include "dbglog/dbglog.hpp"
+
+#include "utility/buildsys.hpp"
+#include "utility/format.hpp"
+#include "utility/runnable.hpp"
+
+#include "service/cmdline.hpp"
+
+#include "geo/geodataset.hpp"
+#include "gdal-drivers/register.hpp"
+
+#include "vts-libs/registry/po.hpp"
+#include "vts-libs/vts/io.hpp"
+#include "vts-libs/vts/nodeinfo.hpp"
+#include "vts-libs/vts/tileindex.hpp"
+
+#include "http/contentfetcher.hpp"
+#include "http/error.hpp"
+
+#include "mapproxy/resource.hpp"
+#include "mapproxy/resourcebackend.hpp"
+#include "mapproxy/resourcebackend/conffile.hpp"
+#include "mapproxy/generator.hpp"
+#include "mapproxy/gdalsupport.hpp"
+#include "mapproxy/core.hpp"
+#include "mapproxy/localsink.hpp"
+#include "mapproxy/support/wmts.hpp"
+
+#include "seed/pack.hpp"
+
+namespace po = boost::program_options;
+namespace fs = boost::filesystem;
+namespace vr = vtslibs::registry;
+namespace vts = vtslibs::vts;
+
+namespace {
+
+/** No remote resources available.
+ */
+class NoFetcher : public http::ContentFetcher {
+private:
+    virtual void fetch_impl(const std::string &location
+                            , const http::ClientSink::pointer &sink
+                            , const RequestOptions&) const
+    {
+        sink->error(utility::makeError<http::NotFound>
+                    ("Remote resource <%s> not available.", location));
+    }
+};
+
+/** Seeded resource.
+ */
+struct Seeded {
+    std::string id;
+    Resource::Generator::Type type;
+};
+
+/** Writes synthetic orthophoto: smooth RGB pattern with nodata hole.
+ */
+void writeOphoto(const fs::path &path, const geo::SrsDefinition &srs
+                 , const math::Extents2 &extents, const math::Size2 &size)
+{
+    auto format(geo::GeoDataset::Format::gtiffRGBPhoto());
+    format.storageType = geo::GeoDataset::Format::Storage::memory;
+
+    auto ds(geo::GeoDataset::create("", srs, extents, size, format
+                                    , geo::NodataValue(0)));
+
+    auto &data(ds.data());
+    for (int y(0); y < size.height; ++y) {
+        for (int x(0); x < size.width; ++x) {
+            // hole in upper left quadrant
+            if ((x >= size.width / 8) && (x < size.width / 4)
+                && (y >= size.height / 8) && (y < size.height / 4))
+            {
+                data.at<cv::Vec3d>(y, x) = cv::Vec3d(0, 0, 0);
+                continue;
+            }
+            data.at<cv::Vec3d>(y, x) = cv::Vec3d
+                (1 + (x * 7 + y * 13) % 250, 1 + (x * 3) % 250
+                 , 1 + (y * 5) % 250);
+        }
+    }
+    ds.flush();
+
+    fs::remove(path);
+    ds.copy(path, "GTiff", geo::Options()("TILED", true));
+}
+
+/** Writes synthetic complex DEM dataset (dem, dem.min, dem.max and tiling)
+ *  covering whole tile range.
+ */
+void writeDem(const fs::path &dir, const geo::SrsDefinition &srs
+              , const math::Extents2 &extents, const math::Size2 &size
+              , const std::string &referenceFrame
+              , const vts::LodRange &lodRange
+              , const vts::TileRange &tileRange)
+{
+    auto ds(geo::GeoDataset::create
+            ("", srs, extents, size
+             , geo::GeoDataset::Format::coverage
+             (geo::GeoDataset::Format::Storage::memory)
+             , geo::NodataValue(-1e6)));
+
+    auto &data(ds.data());
+    for (int y(0); y < size.height; ++y) {
+        for (int x(0); x < size.width; ++x) {
+            data.at<double>(y, x)
+                = 200.0 + 0.1 * ((x * 7 + y * 13) % 1000);
+        }
+    }
+    ds.flush();
+
+    fs::create_directories(dir);
+    for (const auto *name : { "dem", "dem.min", "dem.max" }) {
+        fs::remove(dir / name);
+        ds.copy(dir / name, "GTiff", geo::Options()("TILED", true));
+    }
+
+    // dataset covers whole tile range
+    vts::TileIndex tiling;
+    for (const auto lod : lodRange) {
+        const auto depth(lod - lodRange.min);
+        tiling.set(lod, vts::TileRange
+                   (tileRange.ll(0) << depth, tileRange.ll(1) << depth
+                    , ((tileRange.ur(0) + 1) << depth) - 1
+                    , ((tileRange.ur(1) + 1) << depth) - 1)
+                   , vts::TileIndex::Flag::mesh);
+    }
+    tiling.save(dir / ("tiling." + referenceFrame));
+}
+
+/** Writes conffile resource definition with both seeded resources.
+ */
+void writeResources(const fs::path &path, const std::string &referenceFrame
+                    , const vts::LodRange &lodRange
+                    , const vts::TileRange &tileRange)
+{
+    const auto ranges
+        (utility::format("\"referenceFrames\": { \"%s\": {"
+                         " \"lodRange\": [%d, %d],"
+                         " \"tileRange\": [[%d, %d], [%d, %d]] } }"
+                         , referenceFrame, lodRange.min, lodRange.max
+                         , tileRange.ll(0), tileRange.ll(1)
+                         , tileRange.ur(0), tileRange.ur(1)));
+
+    std::ofstream f(path.string());
+    f.exceptions(std::ios::badbit | std::ios::failbit);
+    f << "[\n"
+      << "{ \"group\": \"check\", \"id\": \"ophoto\", \"type\": \"tms\""
+      << ", \"driver\": \"tms-raster\", " << ranges
+      << ", \"credits\": []"
+      << ", \"definition\": { \"dataset\": \"ophoto.tif\""
+      << ", \"format\": \"png\" } }\n"
+      << ", { \"group\": \"check\", \"id\": \"dem\", \"type\": \"surface\""
+      << ", \"driver\": \"surface-dem\", " << ranges
+      << ", \"credits\": []"
+      << ", \"definition\": { \"dataset\": \"dem\" } }\n"
+      << "]\n";
+    f.close();
+}
+
+/** Runs program with given arguments, returns its exit status.
+ */
+int execute(const fs::path &program, const std::vector<std::string> &args)
+{
+    std::vector<char*> argv;
+    argv.push_back(const_cast<char*>(program.c_str()));
+    for (const auto &arg : args) {
+        argv.push_back(const_cast<char*>(arg.c_str()));
+    }
+    argv.push_back(nullptr);
+
+    const auto child(::fork());
+    if (child == -1) {
+        std::system_error e(errno, std::system_category());
+        LOGTHROW(err3, std::system_error)
+            << "Unable to fork: <" << e.what() << ">.";
+    }
+
+    if (!child) {
+        ::execv(program.c_str(), argv.data());
+        ::_exit(EXIT_FAILURE);
+    }
+
+    int status(0);
+    while (::waitpid(child, &status, 0) == -1) {
+        if (errno != EINTR) {
+            std::system_error e(errno, std::system_category());
+            LOGTHROW(err3, std::system_error)
+                << "Unable to wait for " << program << ": <"
+                << e.what() << ">.";
+        }
+    }
+
+    return WIFEXITED(status) ? WEXITSTATUS(status) : EXIT_FAILURE;
+}
+
+/** Maps pack file kind to file extension; same as in seed tool.
+ */
+std::string extension(const std::string &kind)
+{
+    if (kind == "image") { return "png"; }
+    if (kind == "mesh") { return "bin"; }
+    if (kind == "navtile") { return "nav"; }
+    return kind;
+}
+
+} // namespace
+
+class CheckSeed : public service::Cmdline
+                , public utility::Runnable
+{
+public:
+    CheckSeed()
+        : service::Cmdline("check-seed", BUILD_TARGET_VERSION)
+        , referenceFrame_("melown2015")
+        , lodRange_(10, 11), tileRange_(400, 280, 401, 281)
+        , size_(1024, 1024), threadCount_(2), readyTimeout_(600)
+    {
+        gdalWarperOptions_.processCount = 1;
+    }
+
+private:
+    void configuration(po::options_description &cmdline
+                       , po::options_description &config
+                       , po::positional_options_description &pd);
+
+    void configure(const po::variables_map &vars);
+
+    bool help(std::ostream &out, const std::string &what) const;
+
+    int run();
+
+    virtual bool isRunning() { return true; }
+    virtual void stop() {}
+
+    /** Runs seed tool for given resource.
+     */
+    bool runSeed(const Seeded &seeded, const fs::path &pack
+                 , const vts::TileRange &tileRange, bool resume) const;
+
+    fs::path tmp_;
+    fs::path seed_;
+    std::string referenceFrame_;
+    vts::LodRange lodRange_;
+    vts::TileRange tileRange_;
+    math::Size2 size_;
+    unsigned int threadCount_;
+    std::size_t readyTimeout_;
+
+    Generators::Config generatorsConfig_;
+    GdalWarper::Options gdalWarperOptions_;
+};
+
+void CheckSeed::configuration(po::options_description &cmdline
+                              , po::options_description &config
+                              , po::positional_options_description &pd)
+{
+    vr::registryConfiguration(cmdline, vr::defaultPath());
+
+    cmdline.add_options()
+        ("tmp", po::value(&tmp_)->required()
+         , "Scratch directory.")
+        ("seed", po::value(&seed_)
+         , "Path to mapproxy-seed binary. Defaults to mapproxy-seed next "
+         "to this program.")
+        ("referenceFrame", po::value(&referenceFrame_)
+         ->default_value(referenceFrame_)->required()
+         , "Reference frame of seeded resources.")
+        ("lodRange", po::value(&lodRange_)
+         ->default_value(lodRange_)->required()
+         , "LOD range of seeded resources.")
+        ("tileRange", po::value(&tileRange_)
+         ->default_value(tileRange_)->required()
+         , "Tile range at lodRange.min of seeded resources.")
+        ("size", po::value(&size_)->default_value(size_)->required()
+         , "Size of synthetic input datasets.")
+        ("threadCount", po::value(&threadCount_)
+         ->default_value(threadCount_)->required()
+         , "Number of generating threads (both seeding and direct "
+         "generation).")
+        ("readyTimeout", po::value(&readyTimeout_)
+         ->default_value(readyTimeout_)->required()
+         , "Maximum time to wait for resources to be ready (in seconds).")
+        ;
+
+    pd.add("tmp", 1);
+
+    (void) config;
+}
+
+void CheckSeed::configure(const po::variables_map &vars)
+{
+    vr::registryConfigure(vars);
+
+    tmp_ = fs::absolute(tmp_);
+    if (seed_.empty()) {
+        seed_ = fs::read_symlink("/proc/self/exe").parent_path()
+            / "mapproxy-seed";
+    }
+
+    generatorsConfig_.root = tmp_ / "direct.store";
+    generatorsConfig_.resourceRoot = tmp_;
+    gdalWarperOptions_.tmpRoot = tmp_ / "direct.tmp";
+    generatorsConfig_.tmpRoot = gdalWarperOptions_.tmpRoot / "generators";
+    generatorsConfig_.resourceUpdatePeriod = 0;
+}
+
+bool CheckSeed::help(std::ostream &out, const std::string &what) const
+{
+    if (what.empty()) {
+        // program help
+        out << ("Seeds synthetic orthophoto and DEM into packs and checks "
+                "that stored tiles\nare identical to directly generated "
+                "ones and that resumed seeding skips\ntiles already "
+                "stored in the pack.\n"
+                );
+
+        return true;
+    }
+
+    return false;
+}
+
+bool CheckSeed::runSeed(const Seeded &seeded, const fs::path &pack
+                        , const vts::TileRange &tileRange, bool resume)
+    const
+{
+    std::vector<std::string> args = {
+        (tmp_ / "resources.json").string(), pack.string()
+        , "--group", "check", "--id", seeded.id
+        , "--format", "png"
+        , "--lodRange", boost::lexical_cast<std::string>(lodRange_)
+        , "--tileRange", boost::lexical_cast<std::string>(tileRange)
+        , "--threadCount", boost::lexical_cast<std::string>(threadCount_)
+        , "--gdal.processCount", "1"
+    };
+    if (resume) { args.push_back("--resume"); }
+
+    LOG(info3) << "Seeding <" << seeded.id << "> into " << pack
+               << (resume ? " (resume)." : ".");
+    return execute(seed_, args) == EXIT_SUCCESS;
+}
+
+int CheckSeed::run()
+{
+    fs::remove_all(tmp_);
+    fs::create_directories(tmp_);
+
+    // synthetic inputs in SRS of the first tile
+    const auto &rf(vr::system.referenceFrames(referenceFrame_));
+    const vts::NodeInfo llNode
+        (rf, vts::TileId(lodRange_.min, tileRange_.ll(0), tileRange_.ll(1)));
+    const vts::NodeInfo urNode
+        (rf, vts::TileId(lodRange_.min, tileRange_.ur(0), tileRange_.ur(1)));
+    const auto srs(llNode.srsDef());
+
+    const auto &lle(llNode.extents());
+    const auto &ure(urNode.extents());
+    const math::Extents2 extents
+        (std::min(lle.ll(0), ure.ll(0)), std::min(lle.ll(1), ure.ll(1))
+         , std::max(lle.ur(0), ure.ur(0)), std::max(lle.ur(1), ure.ur(1)));
+    const auto es(math::size(extents));
+
+    // orthophoto leaves right and bottom parts of the tile range uncovered
+    writeOphoto(tmp_ / "ophoto.tif", srs
+                , math::Extents2(extents.ll(0), extents.ll(1) + es.height / 4
+                                 , extents.ll(0) + es.width * 5 / 8
+                                 , extents.ur(1))
+                , size_);
+
+    // DEM overlaps tile range to cover mesh sampling margin
+    writeDem(tmp_ / "dem", srs
+             , math::Extents2(extents.ll(0) - es.width / 8
+                              , extents.ll(1) - es.height / 8
+                              , extents.ur(0) + es.width / 8
+                              , extents.ur(1) + es.height / 8)
+             , size_, referenceFrame_, lodRange_, tileRange_);
+
+    writeResources(tmp_ / "resources.json", referenceFrame_, lodRange_
+                   , tileRange_);
+
+    const std::vector<Seeded> seededList = {
+        { "ophoto", Resource::Generator::Type::tms }
+        , { "dem", Resource::Generator::Type::surface }
+    };
+
+    std::size_t failed(0), checked(0);
+    auto check([&](bool ok, const std::string &what)
+    {
+        ++checked;
+        if (!ok) {
+            ++failed;
+            LOG(err3) << "Check failed: " << what << ".";
+        }
+    });
+
+    // seed everything first: seeding runs in separate processes and must not
+    // be forked from process running GDAL warper
+    const vts::TileRange firstTile
+        (tileRange_.ll(0), tileRange_.ll(1), tileRange_.ll(0)
+         , tileRange_.ll(1));
+    const std::string sentinel("not regenerated");
+    std::vector<seed::Pack::Key> sentinels;
+
+    for (const auto &seeded : seededList) {
+        const auto full(tmp_ / (seeded.id + ".pack"));
+        const auto resumed(tmp_ / (seeded.id + ".resumed.pack"));
+
+        check(runSeed(seeded, full, tileRange_, false)
+              , utility::format("<%s> seeded", seeded.id));
+
+        // seed first tile only and mark one of stored files; resume must
+        // keep it intact
+        check(runSeed(seeded, resumed, firstTile, false)
+              , utility::format("<%s> partially seeded", seeded.id));
+
+        boost::optional<seed::Pack::Key> marked;
+        {
+            seed::Pack pack(resumed, true);
+            for (const auto &key : pack.keys()) {
+                const auto file(pack.load(key));
+                if (!file || (file->status
+                              != static_cast<int>(utility::HttpCode::OK)))
+                {
+                    continue;
+                }
+
+                pack.store(vts::TileId(std::get<0>(key), std::get<1>(key)
+                                       , std::get<2>(key))
+                           , std::get<3>(key), file->contentType
+                           , file->status, sentinel);
+                marked = key;
+                break;
+            }
+        }
+        check(bool(marked)
+              , utility::format("<%s> partial pack is not empty"
+                                , seeded.id));
+
+        check(runSeed(seeded, resumed, tileRange_, true)
+              , utility::format("<%s> seeding resumed", seeded.id));
+        if (marked) { sentinels.push_back(*marked); }
+    }
+
+    // direct generation
+    wmts::prepareTileMatrixSets();
+
+    GdalWarper warper(gdalWarperOptions_, *this);
+
+    ResourceBackend::TypedConfig rbConfig("conffile");
+    rbConfig.assign<resource_backend::Conffile::Config>().path
+        = tmp_ / "resources.json";
+    auto resourceBackend(ResourceBackend::create({}, rbConfig));
+    const auto resources(resourceBackend->load());
+
+    NoFetcher fetcher;
+    auto generators(std::make_shared<Generators>
+                    (generatorsConfig_, resourceBackend));
+    Core core(*generators, warper, threadCount_, fetcher);
+
+    auto isSentinel([&](const seed::Pack::Key &key)
+    {
+        return (std::find(sentinels.begin(), sentinels.end(), key)
+                != sentinels.end());
+    });
+
+    for (const auto &seeded : seededList) {
+        const Resource::Id resourceId(referenceFrame_, "check", seeded.id);
+
+        const auto deadline(std::time(nullptr) + readyTimeout_);
+        while (!generators->isReady(resourceId)
+               && (std::time(nullptr) < deadline))
+        {
+            warper.housekeeping();
+            ::usleep(100000);
+        }
+
+        if (!generators->isReady(resourceId)) {
+            check(false, utility::format("resource <%s> is ready"
+                                         , seeded.id));
+            continue;
+        }
+
+        const seed::Pack full(tmp_ / (seeded.id + ".pack"), true);
+        const seed::Pack resumed(tmp_ / (seeded.id + ".resumed.pack"), true);
+
+        const auto keys(full.keys());
+        check(!keys.empty(), utility::format("<%s> pack is not empty"
+                                             , seeded.id));
+        check(keys == resumed.keys()
+              , utility::format("<%s> resumed pack has the same files"
+                                , seeded.id));
+
+        const auto prefix
+            (utility::format("/%s/%s/%s/%s/", referenceFrame_, seeded.type
+                             , resourceId.group, resourceId.id));
+
+        std::size_t notFound(0);
+        for (const auto &key : keys) {
+            const auto url
+                (prefix + utility::format("%d-%d-%d.%s", std::get<0>(key)
+                                          , std::get<1>(key)
+                                          , std::get<2>(key)
+                                          , extension(std::get<3>(key))));
+
+            auto sink(std::make_shared<LocalSink>());
+            auto response(sink->response());
+
+            http::Request request;
+            request.method = "GET";
+            request.uri = request.path = url;
+            core.generate(request, sink);
+
+            const auto r(response.get());
+            const auto stored(full.load(key));
+
+            check(stored && (stored->status == static_cast<int>(r.status))
+                  , utility::format("<%s> stored with generated status"
+                                    , url));
+            if (!r.ok()) {
+                ++notFound;
+                continue;
+            }
+
+            check(stored && (stored->contentType == r.contentType)
+                  && (stored->data == r.data)
+                  , utility::format("<%s> stored is identical to generated"
+                                    , url));
+
+            const auto again(resumed.load(key));
+            if (isSentinel(key)) {
+                check(again && (again->data == sentinel)
+                      , utility::format("<%s> skipped on resume", url));
+            } else {
+                check(again && (again->data == r.data)
+                      , utility::format("<%s> resumed is identical to "
+                                        "generated", url));
+            }
+        }
+
+        LOG(info3) << "<" << seeded.id << ">: checked " << keys.size()
+                   << " files (" << notFound << " not found).";
+    }
+
+    LOG(info4) << checked << " checks, "
+               << (failed ? "some checks failed." : "all checks passed.");
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[])
+{
+    gdal_drivers::registerAll();
+    return CheckSeed()(argc, argv);
+}
@@ -0,0 +1,273 @@
+/**
+ * Copyright (c) 2019 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <utility>
+#include <ctime>
+
+#include <unistd.h>
+
+#include <boost/filesystem.hpp>
+#include <boost/thread.hpp>
+
+#include "utility/buildsys.hpp"
+#include "utility/format.hpp"
+#include "utility/runnable.hpp"
+#include "service/cmdline.hpp"
+
+#include "vts-libs/registry/po.hpp"
+
+#include "http/contentfetcher.hpp"
+#include "http/error.hpp"
+
+// mapproxy stuff
+#include "mapproxy/resource.hpp"
+#include "mapproxy/resourcebackend.hpp"
+#include "mapproxy/resourcebackend/conffile.hpp"
+#include "mapproxy/generator.hpp"
+#include "mapproxy/generator/surface.hpp"
+#include "mapproxy/gdalsupport.hpp"
+#include "mapproxy/core.hpp"
+#include "mapproxy/localsink.hpp"
+#include "mapproxy/support/wmts.hpp"
+
+namespace po = boost::program_options;
+namespace fs = boost::filesystem;
+namespace vr = vtslibs::registry;
+
+namespace {
+
+/** No remote resources available.
+ */
+class NoFetcher : public http::ContentFetcher {
+private:
+    virtual void fetch_impl(const std::string &location
+                            , const http::ClientSink::pointer &sink
+                            , const RequestOptions&) const
+    {
+        sink->error(utility::makeError<http::NotFound>
+                    ("Remote resource <%s> not available.", location));
+    }
+};
+
+} // namespace
+
+class CheckSurfaceDocuments : public service::Cmdline
+                            , public utility::Runnable
+{
+public:
+    CheckSurfaceDocuments()
+        : service::Cmdline("check-surface-documents", BUILD_TARGET_VERSION)
+        , threadCount_(2), readyTimeout_(600)
+    {
+        gdalWarperOptions_.processCount = 1;
+    }
+
+private:
+    void configuration(po::options_description &cmdline
+                       , po::options_description &config
+                       , po::positional_options_description &pd);
+
+    void configure(const po::variables_map &vars);
+
+    bool help(std::ostream &out, const std::string &what) const;
+
+    int run();
+
+    virtual bool isRunning() { return true; }
+    virtual void stop() {}
+
+    fs::path resourceFile_;
+    unsigned int threadCount_;
+    std::size_t readyTimeout_;
+
+    Generators::Config generatorsConfig_;
+    GdalWarper::Options gdalWarperOptions_;
+};
+
+void CheckSurfaceDocuments
+::configuration(po::options_description &cmdline
+                , po::options_description &config
+                , po::positional_options_description &pd)
+{
+    vr::registryConfiguration(cmdline, vr::defaultPath());
+
+    cmdline.add_options()
+        ("resource", po::value(&resourceFile_)->required()
+         , "Path to resource definition file (same format as conffile "
+         "resource backend).")
+        ("store.path", po::value(&generatorsConfig_.root)->required()
+         , "Path to internal store (scratch directory).")
+        ("resource-backend.root"
+         , po::value(&generatorsConfig_.resourceRoot)
+         , "Root of datasets defined as relative path. Defaults to "
+         "directory of resource file.")
+        ("core.threadCount", po::value(&threadCount_)
+         ->default_value(threadCount_)->required()
+         , "Number of core processing threads.")
+        ("readyTimeout", po::value(&readyTimeout_)
+         ->default_value(readyTimeout_)->required()
+         , "Maximum time to wait for resources to be ready (in seconds).")
+        ;
+
+    pd.add("resource", 1);
+
+    (void) config;
+}
+
+void CheckSurfaceDocuments::configure(const po::variables_map &vars)
+{
+    vr::registryConfigure(vars);
+
+    resourceFile_ = fs::absolute(resourceFile_);
+    generatorsConfig_.root = fs::absolute(generatorsConfig_.root);
+    if (generatorsConfig_.resourceRoot.empty()) {
+        generatorsConfig_.resourceRoot = resourceFile_.parent_path();
+    }
+    generatorsConfig_.resourceRoot
+        = fs::absolute(generatorsConfig_.resourceRoot);
+
+    gdalWarperOptions_.tmpRoot = generatorsConfig_.root / "tmp";
+    generatorsConfig_.tmpRoot = gdalWarperOptions_.tmpRoot / "generators";
+    generatorsConfig_.resourceUpdatePeriod = 0;
+}
+
+bool CheckSurfaceDocuments::help(std::ostream &out
+                                 , const std::string &what) const
+{
+    if (what.empty()) {
+        // program help
+        out << ("Checks that surface definition, map configuration, debug "
+                "and registry\ndocuments served from serialized buffers are "
+                "byte-identical to freshly\nserialized ones.\n"
+                );
+
+        return true;
+    }
+
+    return false;
+}
+
+int CheckSurfaceDocuments::run()
+{
+    typedef generator::SurfaceBase::Document Document;
+
+    wmts::prepareTileMatrixSets();
+
+    GdalWarper warper(gdalWarperOptions_, *this);
+
+    ResourceBackend::TypedConfig rbConfig("conffile");
+    rbConfig.assign<resource_backend::Conffile::Config>().path
+        = resourceFile_;
+    auto resourceBackend(ResourceBackend::create({}, rbConfig));
+    const auto resources(resourceBackend->load());
+
+    NoFetcher fetcher;
+    auto generators(std::make_shared<Generators>
+                    (generatorsConfig_, resourceBackend));
+    Core core(*generators, warper, threadCount_, fetcher);
+
+    std::size_t failed(0), checked(0);
+    auto check([&](bool ok, const std::string &what)
+    {
+        ++checked;
+        if (!ok) {
+            ++failed;
+            LOG(err3) << "Check failed: " << what << ".";
+        }
+    });
+
+    const std::vector<std::pair<std::string, Document>> documents = {
+        { "freelayer.json", Document::definition }
+        , { "mapConfig.json", Document::mapConfig }
+        , { "debug.json", Document::debug }
+        , { "tileset.registry", Document::registry }
+    };
+
+    for (const auto &item : resources) {
+        const auto &resource(item.second);
+        if (resource.generator.type != Resource::Generator::Type::surface) {
+            continue;
+        }
+
+        const auto deadline(std::time(nullptr) + readyTimeout_);
+        while (!generators->isReady(item.first)
+               && (std::time(nullptr) < deadline))
+        {
+            warper.housekeeping();
+            ::usleep(100000);
+        }
+
+        auto gen(generators->generator(resource.generator, item.first));
+        const auto *surface
+            (dynamic_cast<const generator::SurfaceBase*>(gen.get()));
+        if (!surface || !gen->ready()) {
+            check(false, utility::format("resource <%s> is ready"
+                                         , item.first));
+            continue;
+        }
+
+        const auto prefix
+            (utility::format("/%s/%s/%s/%s/", resource.id.referenceFrame
+                             , resource.generator.type, resource.id.group
+                             , resource.id.id));
+
+        for (const auto &document : documents) {
+            const auto expected
+                (surface->serialize(document.second, ResourceRoot::none));
+
+            // first request serializes, second one hits shared buffer
+            for (int pass(0); pass < 2; ++pass) {
+                const auto url(prefix + document.first);
+
+                auto sink(std::make_shared<LocalSink>());
+                auto response(sink->response());
+
+                http::Request request;
+                request.method = "GET";
+                request.uri = request.path = url;
+                core.generate(request, sink);
+
+                const auto r(response.get());
+                check(r.ok(), utility::format("<%s> served", url));
+                check(r.data == expected
+                      , utility::format("<%s> (pass %d) is byte-identical"
+                                        , url, pass));
+            }
+        }
+    }
+
+    LOG(info4) << checked << " checks, "
+               << (failed ? "some checks failed." : "all checks passed.");
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[])
+{
+    return CheckSurfaceDocuments()(argc, argv);
+}
@@ -0,0 +1,350 @@
+/**
+ * Copyright (c) 2019 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cstdlib>
+#include <string>
+#include <sstream>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <condition_variable>
+
+#include <boost/asio/io_service.hpp>
+#include <boost/algorithm/string/predicate.hpp>
+
+#include "dbglog/dbglog.hpp"
+
+#include "utility/buildsys.hpp"
+
+#include "service/cmdline.hpp"
+
+// mapproxy stuff
+#include "mapproxy/support/threadpool.hpp"
+
+namespace po = boost::program_options;
+namespace asio = boost::asio;
+namespace ba = boost::algorithm;
+namespace chrono = std::chrono;
+
+namespace {
+
+/** Synthetic GDAL warper: limited number of worker processes, each request
+ *  takes fixed time. Counts waiting threads as GdalWarper::waiting().
+ */
+class SlowWarper {
+public:
+    SlowWarper(unsigned int processCount, chrono::milliseconds latency)
+        : free_(processCount), latency_(latency), waiting_(0)
+    {}
+
+    void warp() {
+        ++waiting_;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cond_.wait(lock, [this]() { return free_ > 0; });
+            --free_;
+        }
+
+        std::this_thread::sleep_for(latency_);
+
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            ++free_;
+        }
+        cond_.notify_one();
+        --waiting_;
+    }
+
+    unsigned int waiting() const { return waiting_; }
+
+private:
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    unsigned int free_;
+    chrono::milliseconds latency_;
+    std::atomic<unsigned int> waiting_;
+};
+
+void spin(chrono::microseconds duration)
+{
+    const auto end(chrono::steady_clock::now() + duration);
+    while (chrono::steady_clock::now() < end) {}
+}
+
+/** Posts count tasks (CPU work followed by optional warper call) and waits
+ *  for them to finish. Returns elapsed time.
+ */
+chrono::milliseconds load(ThreadPool &pool, SlowWarper *warper
+                          , unsigned int count, chrono::microseconds cpu)
+{
+    std::mutex mutex;
+    std::condition_variable cond;
+    unsigned int done(0);
+
+    const auto start(chrono::steady_clock::now());
+    for (unsigned int i(0); i < count; ++i) {
+        pool.post([&]()
+        {
+            spin(cpu);
+            if (warper) { warper->warp(); }
+
+            std::unique_lock<std::mutex> lock(mutex);
+            if (++done == count) { cond.notify_all(); }
+        });
+    }
+
+    std::unique_lock<std::mutex> lock(mutex);
+    cond.wait(lock, [&]() { return done == count; });
+
+    return chrono::duration_cast<chrono::milliseconds>
+        (chrono::steady_clock::now() - start);
+}
+
+/** Extracts numeric value from pool stat.
+ */
+unsigned long statValue(const ThreadPool &pool, const std::string &name)
+{
+    std::ostringstream os;
+    pool.stat(os, "pool.");
+
+    std::istringstream is(os.str());
+    const std::string prefix("pool." + name + "=");
+    for (std::string line; std::getline(is, line); ) {
+        if (ba::starts_with(line, prefix)) {
+            return std::stoul(line.substr(prefix.size()));
+        }
+    }
+    return 0;
+}
+
+} // namespace
+
+class CheckThreadPool : public service::Cmdline {
+public:
+    CheckThreadPool()
+        : service::Cmdline("check-threadpool", BUILD_TARGET_VERSION)
+        , taskCount_(200), warperLatency_(10), warperProcessCount_(4)
+    {}
+
+private:
+    void configuration(po::options_description &cmdline
+                       , po::options_description &config
+                       , po::positional_options_description &pd);
+
+    void configure(const po::variables_map &vars);
+
+    bool help(std::ostream &out, const std::string &what) const;
+
+    int run();
+
+    unsigned int taskCount_;
+    long warperLatency_;
+    unsigned int warperProcessCount_;
+};
+
+void CheckThreadPool::configuration(po::options_description &cmdline
+                                    , po::options_description &config
+                                    , po::positional_options_description &pd)
+{
+    cmdline.add_options()
+        ("taskCount", po::value(&taskCount_)
+         ->default_value(taskCount_)->required()
+         , "Number of tasks per load phase.")
+        ("warperLatency", po::value(&warperLatency_)
+         ->default_value(warperLatency_)->required()
+         , "Duration of one synthetic warp (ms).")
+        ("warperProcessCount", po::value(&warperProcessCount_)
+         ->default_value(warperProcessCount_)->required()
+         , "Number of synthetic warper processes.")
+        ;
+
+    (void) config;
+    (void) pd;
+}
+
+void CheckThreadPool::configure(const po::variables_map &vars)
+{
+    (void) vars;
+}
+
+bool CheckThreadPool::help(std::ostream &out, const std::string &what) const
+{
+    if (what.empty()) {
+        // program help
+        out << ("Checks adaptive thread pool controller decisions and drives "
+                "adaptive pool\nwith a synthetic slow GDAL warper.\n"
+                );
+
+        return true;
+    }
+
+    return false;
+}
+
+int CheckThreadPool::run()
+{
+    std::size_t failed(0);
+    auto check([&](bool ok, const std::string &what)
+    {
+        if (!ok) {
+            ++failed;
+            LOG(err3) << "Check failed: " << what << ".";
+        }
+    });
+
+    // controller decisions
+    {
+        ThreadPool::Config config(4);
+        config.adaptive = true;
+        config.min = 2;
+        config.max = 16;
+        config.runnable = 4;
+        config.shrinkAfter = 3;
+
+        auto sample([](unsigned int size, unsigned int active
+                       , unsigned int queued, unsigned int blocked
+                       , long latency)
+        {
+            ThreadPool::Sample s;
+            s.size = size;
+            s.active = active;
+            s.queued = queued;
+            s.blocked = blocked;
+            s.latency = chrono::milliseconds(latency);
+            return s;
+        });
+
+        ThreadPool::ControllerState state;
+        check(ThreadPool::resize(config, sample(4, 4, 10, 4, 100), state)
+              == 8, "blocked threads are replaced");
+        check(ThreadPool::resize(config, sample(4, 4, 2, 4, 100), state)
+              == 6, "growth bounded by queue length");
+        check(ThreadPool::resize(config, sample(4, 4, 10, 0, 100), state)
+              == 4, "CPU-bound pool is not oversubscribed");
+        check(ThreadPool::resize(config, sample(2, 2, 3, 0, 0), state)
+              == 3, "saturated pool grows up to CPU count");
+        check(ThreadPool::resize(config, sample(3, 1, 3, 0, 1), state)
+              == 3, "pool with idle threads and low latency is kept");
+        check(ThreadPool::resize(config, sample(3, 1, 3, 0, 100), state)
+              == 4, "latency triggers growth");
+        check(ThreadPool::resize(config, sample(16, 16, 100, 16, 100), state)
+              == 16, "maximum is honored");
+
+        state = {};
+        check(ThreadPool::resize(config, sample(8, 0, 0, 0, 0), state)
+              == 8, "idle pool is kept (1st tick)");
+        check(ThreadPool::resize(config, sample(8, 0, 0, 0, 0), state)
+              == 8, "idle pool is kept (2nd tick)");
+        check(ThreadPool::resize(config, sample(8, 0, 0, 0, 0), state)
+              == 4, "idle pool shrinks");
+        state = {};
+        for (int i(0); i < 3; ++i) {
+            check(ThreadPool::resize(config, sample(3, 0, 0, 0, 0), state)
+                  >= 2, "minimum is honored");
+        }
+    }
+
+    const chrono::milliseconds latency(warperLatency_);
+
+    ThreadPool::Config config(2);
+    config.min = 2;
+    config.max = 32;
+    config.interval = chrono::milliseconds(10);
+    config.latency = chrono::milliseconds(5);
+    config.shrinkAfter = 5;
+
+    // fixed pool with slow warper
+    chrono::milliseconds fixed;
+    {
+        asio::io_service ios;
+        SlowWarper warper(warperProcessCount_, latency);
+        ThreadPool pool(ios, config, "fixed"
+                        , [&]() { return warper.waiting(); });
+        fixed = load(pool, &warper, taskCount_, chrono::microseconds(100));
+        LOG(info3) << "Fixed pool (" << pool.size() << " threads): "
+                   << fixed.count() << " ms.";
+    }
+
+    // adaptive pool with slow warper
+    {
+        auto c(config);
+        c.adaptive = true;
+
+        asio::io_service ios;
+        SlowWarper warper(warperProcessCount_, latency);
+        ThreadPool pool(ios, c, "adaptive"
+                        , [&]() { return warper.waiting(); });
+        const auto adaptive(load(pool, &warper, taskCount_
+                                 , chrono::microseconds(100)));
+        const auto peak(statValue(pool, "peak"));
+        LOG(info3) << "Adaptive pool (peak " << peak << " threads): "
+                   << adaptive.count() << " ms.";
+
+        check(peak > c.size, "adaptive pool grows under slow warper");
+        check(statValue(pool, "grown") > 0, "growth reported in stat");
+        if (warperProcessCount_ > c.size) {
+            check(adaptive < fixed, "adaptive pool is faster than fixed");
+        }
+
+        // wait for shrinking back to minimum
+        const auto deadline(chrono::steady_clock::now()
+                            + chrono::seconds(5));
+        while ((pool.size() > c.min)
+               && (chrono::steady_clock::now() < deadline))
+        {
+            std::this_thread::sleep_for(c.interval);
+        }
+        check(pool.size() == c.min, "idle pool shrinks to minimum");
+        check(statValue(pool, "shrunk") > 0, "shrinking reported in stat");
+    }
+
+    // adaptive pool with CPU-light load and no warper
+    {
+        auto c(config);
+        c.adaptive = true;
+        c.min = 1;
+        c.size = 1;
+        c.runnable = 2;
+
+        asio::io_service ios;
+        ThreadPool pool(ios, c, "cpu", [&]() { return 0; });
+        load(pool, nullptr, taskCount_, chrono::microseconds(1000));
+        const auto peak(statValue(pool, "peak"));
+        LOG(info3) << "CPU-bound adaptive pool peak: " << peak
+                   << " threads.";
+        check(peak <= c.runnable
+              , "CPU-bound adaptive pool stays within CPU count");
+    }
+
+    LOG(info4) << (failed ? "Some checks failed." : "All checks passed.");
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[])
+{
+    return CheckThreadPool()(argc, argv);
+}
@@ -0,0 +1,208 @@
+/**
+ * Copyright (c) 2019 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <random>
+
+#include <opencv2/core/core.hpp>
+
+#include "dbglog/dbglog.hpp"
+
+#include "utility/buildsys.hpp"
+
+#include "service/cmdline.hpp"
+
+// mapproxy stuff
+#include "mapproxy/gdalsupport/operations.hpp"
+
+namespace po = boost::program_options;
+
+namespace {
+
+const double Nodata(-1e10f);
+
+/** Original (scalar) valueMinMax merge.
+ */
+template <typename Vec3>
+void reference(cv::Mat &tile, const cv::Mat &d
+               , const cv::Mat &dmin, const cv::Mat &dmax)
+{
+    tile = cv::Scalar(Nodata, Nodata, Nodata);
+
+    auto id(d.begin<double>());
+    auto idmin(dmin.begin<double>());
+    auto idmax(dmax.begin<double>());
+
+    for (auto itile(tile.begin<Vec3>()), etile(tile.end<Vec3>());
+         itile != etile; ++itile, ++id, ++idmin, ++idmax)
+    {
+        auto value(*id);
+        if (value == Nodata) {
+            if ((*idmin == Nodata) || (*idmax == Nodata)) { continue; }
+            value = (*idmin + *idmax) / 2;
+        }
+
+        auto &sample(*itile);
+        sample[0] = value;
+        sample[1] = ((*idmin == Nodata) || (*idmin > value)) ? value : *idmin;
+        sample[2] = ((*idmax == Nodata) || (*idmax < value)) ? value : *idmax;
+    }
+}
+
+/** Random warped raster with given probability of nodata pixels.
+ */
+cv::Mat randomRaster(std::mt19937 &gen, const cv::Size &size
+                     , double nodataProbability)
+{
+    std::uniform_real_distribution<double> value(-500.0, 9000.0);
+    std::bernoulli_distribution nodata(nodataProbability);
+
+    cv::Mat m(size, CV_64F);
+    for (auto i(m.begin<double>()), e(m.end<double>()); i != e; ++i) {
+        // warped in floats
+        *i = (nodata(gen) ? Nodata : float(value(gen)));
+    }
+    return m;
+}
+
+bool same(const cv::Mat &a, const cv::Mat &b)
+{
+    if ((a.size() != b.size()) || (a.type() != b.type())) { return false; }
+    for (int j(0); j < a.rows; ++j) {
+        if (std::memcmp(a.ptr(j), b.ptr(j), a.cols * a.elemSize())) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+class CheckValueMinMax : public service::Cmdline {
+public:
+    CheckValueMinMax()
+        : service::Cmdline("check-valueminmax", BUILD_TARGET_VERSION)
+        , iterations_(100), seed_(1)
+    {}
+
+private:
+    void configuration(po::options_description &cmdline
+                       , po::options_description &config
+                       , po::positional_options_description &pd);
+
+    void configure(const po::variables_map &vars);
+
+    bool help(std::ostream &out, const std::string &what) const;
+
+    int run();
+
+    unsigned int iterations_;
+    unsigned int seed_;
+};
+
+void CheckValueMinMax
+::configuration(po::options_description &cmdline
+                , po::options_description &config
+                , po::positional_options_description &pd)
+{
+    cmdline.add_options()
+        ("iterations", po::value(&iterations_)
+         ->default_value(iterations_)->required()
+         , "Number of random rasters.")
+        ("seed", po::value(&seed_)->default_value(seed_)->required()
+         , "Random generator seed.")
+        ;
+
+    (void) config;
+    (void) pd;
+}
+
+void CheckValueMinMax::configure(const po::variables_map &vars)
+{
+    (void) vars;
+}
+
+bool CheckValueMinMax::help(std::ostream &out, const std::string &what) const
+{
+    if (what.empty()) {
+        // program help
+        out << ("Checks that vectorized valueMinMax merge produces the same "
+                "result as the\noriginal scalar implementation.\n"
+                );
+
+        return true;
+    }
+
+    return false;
+}
+
+int CheckValueMinMax::run()
+{
+    std::size_t failed(0);
+
+    std::mt19937 gen(seed_);
+    std::uniform_int_distribution<int> side(1, 300);
+    const double probabilities[] = { 0.0, 0.05, 0.5, 0.95, 1.0 };
+
+    for (unsigned int i(0); i < iterations_; ++i) {
+        const cv::Size size(side(gen), side(gen));
+        const auto p(probabilities[i % 5]);
+        const auto d(randomRaster(gen, size, p));
+        const auto dmin(randomRaster(gen, size, p));
+        const auto dmax(randomRaster(gen, size, p));
+
+        for (const int type : { CV_64FC3, CV_32FC3 }) {
+            cv::Mat expected(size, type);
+            if (type == CV_32FC3) {
+                reference<cv::Vec3f>(expected, d, dmin, dmax);
+            } else {
+                reference<cv::Vec3d>(expected, d, dmin, dmax);
+            }
+
+            // garbage in output must be overwritten
+            cv::Mat tile(size, type, cv::Scalar::all(42.0));
+            combineValueMinMax(tile, d, dmin, dmax, Nodata);
+
+            if (!same(tile, expected)) {
+                ++failed;
+                LOG(err3) << "Check failed: raster #" << i << " ("
+                          << size << ", nodata probability " << p
+                          << ((type == CV_32FC3) ? ", float" : ", double")
+                          << ") differs from reference.";
+            }
+        }
+    }
+
+    LOG(info4) << (failed ? "Some checks failed." : "All checks passed.");
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[])
+{
+    return CheckValueMinMax()(argc, argv);
+}
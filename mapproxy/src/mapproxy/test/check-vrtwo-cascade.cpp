@@ -0,0 +1,285 @@
+/**
+ * Copyright (c) 2019 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cstdlib>
+#include <string>
+#include <set>
+#include <vector>
+
+#include <boost/lexical_cast.hpp>
+#include <boost/filesystem.hpp>
+
+#include <opencv2/core/core.hpp>
+
+#include "dbglog/dbglog.hpp"
+
+#include "utility/buildsys.hpp"
+#include "utility/format.hpp"
+#include "utility/duration.hpp"
+
+#include "service/cmdline.hpp"
+
+#include "geo/geodataset.hpp"
+#include "geo/gdal.hpp"
+#include "gdal-drivers/register.hpp"
+
+#include "generatevrtwo/generatevrtwo.hpp"
+
+namespace po = boost::program_options;
+namespace fs = boost::filesystem;
+
+namespace {
+
+/** Pixel window [ll, ur).
+ */
+struct Window {
+    int x1, y1, x2, y2;
+};
+
+/** Writes synthetic input dataset: high-frequency pattern (any filter
+ *  support mismatch shows up) with nodata holes.
+ */
+void writeInput(const fs::path &path, const math::Size2 &size
+                , const std::vector<Window> &holes)
+{
+    auto ds(geo::GeoDataset::create
+            ("", geo::SrsDefinition("+proj=merc +datum=WGS84 +units=m"
+                                    , geo::SrsDefinition::Type::proj4)
+             , math::Extents2(0, 0, size.width, size.height), size
+             , geo::GeoDataset::Format::coverage
+             (geo::GeoDataset::Format::Storage::memory)
+             , geo::NodataValue(0)));
+
+    auto &data(ds.data());
+    for (int y(0); y < size.height; ++y) {
+        for (int x(0); x < size.width; ++x) {
+            double value(1 + (x * 7 + y * 13) % 250);
+            for (const auto &w : holes) {
+                if ((x >= w.x1) && (x < w.x2) && (y >= w.y1) && (y < w.y2)) {
+                    value = 0;
+                }
+            }
+            data.at<double>(y, x) = value;
+        }
+    }
+    ds.flush();
+
+    fs::remove(path);
+    ds.copy(path, "GTiff", geo::Options()("TILED", true));
+}
+
+std::set<std::string> tiles(const fs::path &dir)
+{
+    std::set<std::string> tiles;
+    for (fs::directory_iterator idir(dir), edir; idir != edir; ++idir) {
+        if (idir->path().extension() == ".tif") {
+            tiles.insert(idir->path().filename().string());
+        }
+    }
+    return tiles;
+}
+
+/** Compares content of two datasets (data and mask).
+ */
+bool same(const fs::path &aPath, const fs::path &bPath)
+{
+    const auto a(geo::GeoDataset::open(aPath));
+    const auto b(geo::GeoDataset::open(bPath));
+
+    if (a.size() != b.size()) { return false; }
+
+    const int bands(a.bandCount());
+    for (const auto &bi : a.getBlocking()) {
+        for (int i(-1); i < bands; ++i) {
+            const auto ab(a.readBlock(bi.offset, i, true));
+            const auto bb(b.readBlock(bi.offset, i, true));
+            if (cv::countNonZero(ab.data != bb.data)) { return false; }
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+class CheckVrtwoCascade : public service::Cmdline {
+public:
+    CheckVrtwoCascade()
+        : service::Cmdline("check-vrtwo-cascade", BUILD_TARGET_VERSION)
+        , size_(3000, 2000)
+        , resamplings_{ geo::GeoDataset::Resampling::nearest
+                        , geo::GeoDataset::Resampling::bilinear
+                        , geo::GeoDataset::Resampling::cubic
+                        , geo::GeoDataset::Resampling::cubicspline
+                        , geo::GeoDataset::Resampling::average }
+    {
+        config_.tileSize = math::Size2(256, 256);
+        config_.createOptions("TILED", true);
+    }
+
+private:
+    void configuration(po::options_description &cmdline
+                       , po::options_description &config
+                       , po::positional_options_description &pd);
+
+    void configure(const po::variables_map &vars);
+
+    bool help(std::ostream &out, const std::string &what) const;
+
+    int run();
+
+    fs::path tmp_;
+    math::Size2 size_;
+    std::vector<geo::GeoDataset::Resampling> resamplings_;
+    vrtwo::Config config_;
+};
+
+void CheckVrtwoCascade::configuration(po::options_description &cmdline
+                                      , po::options_description &config
+                                      , po::positional_options_description
+                                      &pd)
+{
+    cmdline.add_options()
+        ("tmp", po::value(&tmp_)->required()
+         , "Scratch directory.")
+        ("size", po::value(&size_)->default_value(size_)->required()
+         , "Size of synthetic input dataset.")
+        ("tileSize", po::value(&config_.tileSize)
+         ->default_value(config_.tileSize)->required()
+         , "Overview tile size.")
+        ("threadCount", po::value(&config_.threadCount)
+         ->default_value(config_.threadCount)->required()
+         , "Number of worker threads; 0 means number of available CPUs.")
+        ("resampling", po::value<geo::GeoDataset::Resampling>()
+         , "Check only given resampling (all filters in turn by default).")
+        ;
+
+    pd.add("tmp", 1);
+
+    (void) config;
+}
+
+void CheckVrtwoCascade::configure(const po::variables_map &vars)
+{
+    if (vars.count("resampling")) {
+        resamplings_ = { vars["resampling"].as<geo::GeoDataset::Resampling>() };
+    }
+}
+
+bool CheckVrtwoCascade::help(std::ostream &out, const std::string &what)
+    const
+{
+    if (what.empty()) {
+        // program help
+        out << ("Checks that overviews generated in cascade (tile warped "
+                "from dependency\ntiles only) are identical to overviews "
+                "generated level by level (tile\nwarped from complete "
+                "previous level), i.e. that source window margin\ncovers "
+                "resampling filter support. Logs timing of both modes.\n"
+                );
+
+        return true;
+    }
+
+    return false;
+}
+
+int CheckVrtwoCascade::run()
+{
+    fs::remove_all(tmp_);
+    fs::create_directories(tmp_);
+
+    const auto input(tmp_ / "input.tif");
+
+    // nodata holes crossing tile boundaries
+    writeInput(input, size_, { { 0, 0, 600, 600 }
+                               , { 1000, 500, 1300, 1700 }
+                               , { size_.width - 700, size_.height - 300
+                                   , size_.width, size_.height } });
+
+    std::size_t failed(0);
+
+    for (const auto resampling : resamplings_) {
+        const auto name(boost::lexical_cast<std::string>(resampling));
+        const auto cascade(tmp_ / (name + "-cascade"));
+        const auto levels(tmp_ / (name + "-levels"));
+
+        auto config(config_);
+        config.resampling = resampling;
+
+        config.cascade = true;
+        utility::DurationMeter cascadeTimer;
+        vrtwo::generate(input, cascade, config);
+        const auto cascadeDuration(cascadeTimer.duration());
+
+        config.cascade = false;
+        utility::DurationMeter levelsTimer;
+        vrtwo::generate(input, levels, config);
+        const auto levelsDuration(levelsTimer.duration());
+
+        int count(0);
+        for (; fs::exists(levels / utility::format("%d", count)); ++count) {
+            const auto dir(utility::format("%d", count));
+            const auto cTiles(tiles(cascade / dir));
+            const auto lTiles(tiles(levels / dir));
+
+            if (cTiles != lTiles) {
+                ++failed;
+                LOG(err3) << "Check failed: " << name << ": overview #"
+                          << count << " has different set of tiles.";
+            }
+
+            if (!same(cascade / dir / "ovr.vrt", levels / dir / "ovr.vrt")) {
+                ++failed;
+                LOG(err3) << "Check failed: " << name << ": overview #"
+                          << count << " content differs.";
+            }
+        }
+
+        if (count < 2) {
+            ++failed;
+            LOG(err3) << "Check failed: " << name << ": only " << count
+                      << " overview(s) generated.";
+        }
+
+        LOG(info3)
+            << name << ": " << count << " overviews, cascade: "
+            << utility::formatDuration(cascadeDuration)
+            << ", level-by-level: "
+            << utility::formatDuration(levelsDuration) << ".";
+    }
+
+    LOG(info4) << (failed ? "Some checks failed." : "All checks passed.");
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[])
+{
+    gdal_drivers::registerAll();
+    // force VRT not to share undelying datasets
+    geo::Gdal::setOption("VRT_SHARED_SOURCE", 0);
+    geo::Gdal::setOption("GDAL_TIFF_INTERNAL_MASK", "YES");
+    return CheckVrtwoCascade()(argc, argv);
+}
@@ -0,0 +1,322 @@
+/**
+ * Copyright (c) 2019 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cstdlib>
+#include <string>
+#include <set>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include <opencv2/core/core.hpp>
+
+#include "dbglog/dbglog.hpp"
+
+#include "utility/buildsys.hpp"
+#include "utility/format.hpp"
+
+#include "service/cmdline.hpp"
+
+#include "geo/geodataset.hpp"
+#include "geo/gdal.hpp"
+#include "gdal-drivers/register.hpp"
+
+#include "generatevrtwo/generatevrtwo.hpp"
+
+namespace po = boost::program_options;
+namespace fs = boost::filesystem;
+
+namespace {
+
+/** Pixel window [ll, ur).
+ */
+struct Window {
+    int x1, y1, x2, y2;
+};
+
+/** Writes synthetic input dataset: smooth pattern with nodata holes, windows
+ *  are filled with given value.
+ */
+void writeInput(const fs::path &path, const math::Size2 &size
+                , const std::vector<std::pair<Window, double>> &fills)
+{
+    auto ds(geo::GeoDataset::create
+            ("", geo::SrsDefinition("+proj=merc +datum=WGS84 +units=m"
+                                    , geo::SrsDefinition::Type::proj4)
+             , math::Extents2(0, 0, size.width, size.height), size
+             , geo::GeoDataset::Format::coverage
+             (geo::GeoDataset::Format::Storage::memory)
+             , geo::NodataValue(0)));
+
+    auto &data(ds.data());
+    for (int y(0); y < size.height; ++y) {
+        for (int x(0); x < size.width; ++x) {
+            double value(1 + (x * 7 + y * 13) % 250);
+            for (const auto &fill : fills) {
+                const auto &w(fill.first);
+                if ((x >= w.x1) && (x < w.x2) && (y >= w.y1) && (y < w.y2)) {
+                    value = fill.second;
+                }
+            }
+            data.at<double>(y, x) = value;
+        }
+    }
+    ds.flush();
+
+    fs::remove(path);
+    ds.copy(path, "GTiff", geo::Options()("TILED", true));
+}
+
+math::Extents2 extents(const math::Size2 &size, const Window &w)
+{
+    return math::Extents2(w.x1, size.height - w.y2, w.x2, size.height - w.y1);
+}
+
+std::set<std::string> tiles(const fs::path &dir)
+{
+    std::set<std::string> tiles;
+    for (fs::directory_iterator idir(dir), edir; idir != edir; ++idir) {
+        if (idir->path().extension() == ".tif") {
+            tiles.insert(idir->path().filename().string());
+        }
+    }
+    return tiles;
+}
+
+/** Compares content of two datasets (data and mask).
+ */
+bool same(const fs::path &aPath, const fs::path &bPath)
+{
+    const auto a(geo::GeoDataset::open(aPath));
+    const auto b(geo::GeoDataset::open(bPath));
+
+    if (a.size() != b.size()) { return false; }
+
+    const int bands(a.bandCount());
+    for (const auto &bi : a.getBlocking()) {
+        for (int i(-1); i < bands; ++i) {
+            const auto ab(a.readBlock(bi.offset, i, true));
+            const auto bb(b.readBlock(bi.offset, i, true));
+            if (cv::countNonZero(ab.data != bb.data)) { return false; }
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+class CheckVrtwoUpdate : public service::Cmdline {
+public:
+    CheckVrtwoUpdate()
+        : service::Cmdline("check-vrtwo-update", BUILD_TARGET_VERSION)
+        , size_(3000, 2000), wrapx_(200)
+    {
+        config_.tileSize = math::Size2(256, 256);
+        config_.resampling = geo::GeoDataset::Resampling::average;
+        config_.createOptions("TILED", true);
+    }
+
+private:
+    void configuration(po::options_description &cmdline
+                       , po::options_description &config
+                       , po::positional_options_description &pd);
+
+    void configure(const po::variables_map &vars);
+
+    bool help(std::ostream &out, const std::string &what) const;
+
+    int run();
+
+    /** Generates overviews, applies changes, updates overviews and compares
+     *  them with ones generated from scratch. Returns number of failures.
+     */
+    std::size_t check(const fs::path &root, const vrtwo::Config &config
+                      , const std::vector<Window> &changes) const;
+
+    fs::path tmp_;
+    math::Size2 size_;
+    int wrapx_;
+    vrtwo::Config config_;
+};
+
+void CheckVrtwoUpdate::configuration(po::options_description &cmdline
+                                     , po::options_description &config
+                                     , po::positional_options_description
+                                     &pd)
+{
+    cmdline.add_options()
+        ("tmp", po::value(&tmp_)->required()
+         , "Scratch directory.")
+        ("size", po::value(&size_)->default_value(size_)->required()
+         , "Size of synthetic input dataset.")
+        ("wrapx", po::value(&wrapx_)->default_value(wrapx_)->required()
+         , "Overlap (in pixels) of wrapped dataset check; should exceed "
+         "wrap margin to exercise shifted wrap strips.")
+        ("tileSize", po::value(&config_.tileSize)
+         ->default_value(config_.tileSize)->required()
+         , "Overview tile size.")
+        ("threadCount", po::value(&config_.threadCount)
+         ->default_value(config_.threadCount)->required()
+         , "Number of worker threads; 0 means number of available CPUs.")
+        ;
+
+    pd.add("tmp", 1);
+
+    (void) config;
+}
+
+void CheckVrtwoUpdate::configure(const po::variables_map &vars)
+{
+    (void) vars;
+}
+
+bool CheckVrtwoUpdate::help(std::ostream &out, const std::string &what)
+    const
+{
+    if (what.empty()) {
+        // program help
+        out << ("Checks that overviews updated after change of input "
+                "dataset are identical\nto overviews generated from "
+                "scratch, both for plain and X-wrapped dataset.\n"
+                );
+
+        return true;
+    }
+
+    return false;
+}
+
+std::size_t CheckVrtwoUpdate::check(const fs::path &root
+                                    , const vrtwo::Config &config
+                                    , const std::vector<Window> &changes)
+    const
+{
+    fs::create_directories(root);
+
+    const auto input(root / "input.tif");
+    const auto updated(root / "updated");
+    const auto rebuilt(root / "rebuilt");
+
+    // nodata hole in upper-left corner
+    const Window hole{ 0, 0, 600, 600 };
+
+    // changes: partially fill the hole, add new hole, overwrite some data
+    const Window fill{ 0, 0, 300, 300 };
+    const Window newHole{ size_.width - 600, size_.height - 600
+                         , size_.width, size_.height };
+
+    std::vector<std::pair<Window, double>> fills
+        = { { hole, 0 }, { fill, 100 }, { newHole, 0 } };
+    std::vector<math::Extents2> changed
+        = { extents(size_, fill), extents(size_, newHole) };
+    for (const auto &change : changes) {
+        fills.emplace_back(change, 42);
+        changed.push_back(extents(size_, change));
+    }
+
+    writeInput(input, size_, { { hole, 0 } });
+    vrtwo::generate(input, updated, config);
+
+    writeInput(input, size_, fills);
+
+    const auto affected(vrtwo::update(input, updated, changed, config));
+
+    vrtwo::generate(input, rebuilt, config);
+
+    std::size_t failed(0), total(0);
+
+    for (int i(0); fs::exists(rebuilt / utility::format("%d", i)); ++i) {
+        const auto dir(utility::format("%d", i));
+        const auto uTiles(tiles(updated / dir));
+        const auto rTiles(tiles(rebuilt / dir));
+        total += rTiles.size();
+
+        if (uTiles != rTiles) {
+            ++failed;
+            LOG(err3) << "Check failed: " << rebuilt << ": overview #" << i
+                      << " has different set of tiles.";
+        }
+
+        if (!same(updated / dir / "ovr.vrt", rebuilt / dir / "ovr.vrt")) {
+            ++failed;
+            LOG(err3) << "Check failed: " << rebuilt << ": overview #" << i
+                      << " content differs.";
+        }
+
+        for (const auto &tile : rTiles) {
+            if (!uTiles.count(tile)) { continue; }
+            if (!same(updated / dir / tile, rebuilt / dir / tile)) {
+                ++failed;
+                LOG(err3) << "Check failed: " << rebuilt << ": tile " << i
+                          << '-' << tile << " differs.";
+            }
+        }
+    }
+
+    if (affected.empty() || (affected.size() >= total)) {
+        ++failed;
+        LOG(err3) << "Check failed: " << rebuilt << ": " << affected.size()
+                  << " of " << total << " tiles regenerated.";
+    }
+
+    LOG(info3) << rebuilt << ": regenerated " << affected.size()
+               << " tiles.";
+
+    return failed;
+}
+
+int CheckVrtwoUpdate::run()
+{
+    fs::remove_all(tmp_);
+    fs::create_directories(tmp_);
+
+    std::size_t failed(0);
+
+    failed += check(tmp_ / "plain", config_
+                    , { Window{ 1000, 500, 1300, 700 } });
+
+    // wrapped dataset: changes replicated into wrap strips on the other side
+    // of the dataset, i.e. just after wrapx overlap and just before it
+    auto wrapped(config_);
+    wrapped.wrapx = wrapx_;
+    failed += check(tmp_ / "wrapx", wrapped
+                    , { Window{ 1000, 500, 1300, 700 }
+                        , Window{ wrapx_, 1000, wrapx_ + 20, 1100 }
+                        , Window{ size_.width - wrapx_ - 20, 1200
+                                  , size_.width - wrapx_, 1300 } });
+
+    LOG(info4) << (failed ? "Some checks failed." : "All checks passed.");
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[])
+{
+    gdal_drivers::registerAll();
+    // force VRT not to share undelying datasets
+    geo::Gdal::setOption("VRT_SHARED_SOURCE", 0);
+    geo::Gdal::setOption("GDAL_TIFF_INTERNAL_MASK", "YES");
+    return CheckVrtwoUpdate()(argc, argv);
+}
@@ -0,0 +1,337 @@
+/**
+ * Copyright (c) 2019 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cstdlib>
+#include <cmath>
+#include <string>
+#include <memory>
+#include <sstream>
+
+#include <boost/filesystem.hpp>
+
+#include <opencv2/core/core.hpp>
+
+#include "dbglog/dbglog.hpp"
+
+#include "utility/streams.hpp"
+#include "utility/buildsys.hpp"
+
+#include "service/cmdline.hpp"
+
+#include "imgproc/rastermask/quadtree.hpp"
+#include "imgproc/rastermask/mappedqtree.hpp"
+
+#include "vts-libs/registry/po.hpp"
+#include "vts-libs/vts/io.hpp"
+#include "vts-libs/vts/nodeinfo.hpp"
+#include "vts-libs/vts/tileindex.hpp"
+
+// mapproxy stuff
+#include "mapproxy/resource.hpp"
+#include "mapproxy/support/coverage.hpp"
+#include "mapproxy/support/tileindex.hpp"
+#include "mapproxy/support/mmapped/tileindex.hpp"
+
+namespace po = boost::program_options;
+namespace fs = boost::filesystem;
+namespace vts = vtslibs::vts;
+namespace vr = vtslibs::registry;
+
+namespace {
+
+/** Shifts tile range from one LOD to a finer one.
+ */
+vts::TileRange shiftRange(vts::Lod srcLod, const vts::TileRange &tr
+                          , vts::Lod dstLod)
+{
+    const auto depth(dstLod - srcLod);
+    return vts::TileRange(tr.ll(0) << depth, tr.ll(1) << depth
+                          , ((tr.ur(0) + 1) << depth) - 1
+                          , ((tr.ur(1) + 1) << depth) - 1);
+}
+
+std::uint64_t counter(const std::string &stat, const std::string &key)
+{
+    std::istringstream is(stat);
+    std::string line;
+    const auto prefix(key + "=");
+    while (std::getline(is, line)) {
+        if (!line.compare(0, prefix.size(), prefix)) {
+            return std::stoull(line.substr(prefix.size()));
+        }
+    }
+    return 0;
+}
+
+} // namespace
+
+class CheckWatertight : public service::Cmdline {
+public:
+    CheckWatertight()
+        : service::Cmdline("check-watertight", BUILD_TARGET_VERSION)
+        , resource_({}), maskDepth_(18)
+    {
+        resource_.id.referenceFrame = "melown2015";
+        resource_.lodRange = vts::LodRange(10, 12);
+        resource_.tileRange = vts::TileRange(400, 280, 411, 291);
+    }
+
+private:
+    void configuration(po::options_description &cmdline
+                       , po::options_description &config
+                       , po::positional_options_description &pd);
+
+    void configure(const po::variables_map &vars);
+
+    bool help(std::ostream &out, const std::string &what) const;
+
+    int run();
+
+    /** Synthetic mask tree: a disc inside tile range. Disc is drawn two
+     *  LODs below lodRange.max, i.e. its boundary cuts tiles at all checked
+     *  LODs.
+     */
+    void writeMask(const fs::path &path) const;
+
+    fs::path tmp_;
+    Resource resource_;
+    unsigned int maskDepth_;
+};
+
+void CheckWatertight::configuration(po::options_description &cmdline
+                                    , po::options_description &config
+                                    , po::positional_options_description
+                                    &pd)
+{
+    vr::registryConfiguration(config, vr::defaultPath());
+
+    cmdline.add_options()
+        ("tmp", po::value(&tmp_)->required()
+         , "Scratch directory.")
+        ("referenceFrame", po::value(&resource_.id.referenceFrame)
+         ->default_value(resource_.id.referenceFrame)->required()
+         , "Reference frame.")
+        ("lodRange", po::value(&resource_.lodRange)
+         ->default_value(resource_.lodRange)->required()
+         , "Checked LOD range.")
+        ("tileRange", po::value(&resource_.tileRange)
+         ->default_value(resource_.tileRange)->required()
+         , "Checked tile range at lodRange.min.")
+        ("maskDepth", po::value(&maskDepth_)
+         ->default_value(maskDepth_)->required()
+         , "Depth of synthetic mask tree.")
+        ;
+
+    pd.add("tmp", 1);
+
+    (void) config;
+}
+
+void CheckWatertight::configure(const po::variables_map &vars)
+{
+    vr::registryConfigure(vars);
+
+    resource_.referenceFrame
+        = &vr::system.referenceFrames(resource_.id.referenceFrame);
+}
+
+bool CheckWatertight::help(std::ostream &out, const std::string &what)
+    const
+{
+    if (what.empty()) {
+        // program help
+        out << ("Builds tile index from synthetic mask tree the same way "
+                "tms-raster does and\nchecks that tiles marked as watertight "
+                "are really fully covered by mask\n(as generated by mask "
+                "tree path) and that only those tiles skip mask\n"
+                "computation.\n"
+                );
+
+        return true;
+    }
+
+    return false;
+}
+
+void CheckWatertight::writeMask(const fs::path &path) const
+{
+    typedef imgproc::quadtree::RasterMask RasterMask;
+
+    const auto &lodRange(resource_.lodRange);
+    const auto &tileRange(resource_.tileRange);
+
+    const unsigned int quadDepth
+        (std::min(maskDepth_, unsigned(lodRange.max) + 2));
+    const auto size(1u << maskDepth_);
+    RasterMask mask(size, size, RasterMask::InitMode::EMPTY);
+
+    // disc around tile range center, in quad grid
+    const double scale(double(1u << quadDepth)
+                       / double(1u << lodRange.min));
+    const math::Point2 center
+        (scale * (tileRange.ll(0) + tileRange.ur(0) + 1) / 2.0
+         , scale * (tileRange.ll(1) + tileRange.ur(1) + 1) / 2.0);
+    const double radius
+        (scale * (tileRange.ur(0) - tileRange.ll(0) + 1) / 3.0);
+
+    const auto x1(unsigned(std::floor(center(0) - radius)));
+    const auto y1(unsigned(std::floor(center(1) - radius)));
+    const auto x2(unsigned(std::ceil(center(0) + radius)));
+    const auto y2(unsigned(std::ceil(center(1) + radius)));
+    for (unsigned int y(y1); y <= y2; ++y) {
+        for (unsigned int x(x1); x <= x2; ++x) {
+            const double dx(x + 0.5 - center(0)), dy(y + 0.5 - center(1));
+            if ((dx * dx + dy * dy) <= (radius * radius)) {
+                mask.setQuad(quadDepth, x, y);
+            }
+        }
+    }
+
+    utility::ofstreambuf f(path.string());
+    imgproc::mappedqtree::RasterMask::write(f, mask);
+    f.close();
+}
+
+int CheckWatertight::run()
+{
+    fs::remove_all(tmp_);
+    fs::create_directories(tmp_);
+
+    const auto maskPath(tmp_ / "mask");
+    writeMask(maskPath);
+
+    // reference: plain rasterization of mask tree
+    MaskTree plain(maskPath);
+    plain.setPyramid({});
+
+    // mask tree with pyramid: tile index is classified by pyramid
+    MaskTree accelerated(maskPath);
+    accelerated.setPyramid(std::make_shared<MaskPyramid>
+                           (accelerated, resource_.lodRange.max));
+
+    const auto &rf(*resource_.referenceFrame);
+
+    std::size_t failed(0), skipped(0), computed(0), missed(0);
+
+    auto report([&](const vts::TileId &tileId, const std::string &what)
+    {
+        if (++failed <= 100) {
+            LOG(err3) << "Check failed at " << tileId << ": " << what << ".";
+        }
+    });
+
+    auto check([&](const MaskTree &maskTree, const std::string &name)
+    {
+        // tile index exactly as tms-raster builds it for mask tree dataset,
+        // go through mmapped tile index as the generator does
+        vts::TileIndex ti;
+        prepareTileIndex(ti, resource_, false, maskTree);
+        const auto indexPath(tmp_ / (name + ".index"));
+        mmapped::TileIndex::write(indexPath, ti);
+        const mmapped::TileIndex index(indexPath);
+
+        for (const auto lod : resource_.lodRange) {
+            const auto tr(shiftRange(resource_.lodRange.min
+                                     , resource_.tileRange, lod));
+            for (auto y(tr.ll(1)); y <= tr.ur(1); ++y) {
+                for (auto x(tr.ll(0)); x <= tr.ur(0); ++x) {
+                    const vts::TileId tileId(lod, x, y);
+                    if (!vts::NodeInfo(rf, tileId).productive()) {
+                        continue;
+                    }
+
+                    // mask served by generateTileMaskFromTree
+                    const auto mask(boundlayerMask(tileId, maskTree));
+                    const auto valid(cv::countNonZero(mask));
+                    const auto reference
+                        (cv::countNonZero(boundlayerMask(tileId, plain)));
+                    if (valid != reference) {
+                        report(tileId, name + ": mask differs from plain "
+                               "mask tree rasterization");
+                    }
+
+                    const auto flags(index.get(tileId));
+                    if (!vts::TileIndex::Flag::isReal(flags)) {
+                        // tile dropped from index must have no data
+                        if (reference) {
+                            report(tileId, name + ": tile with valid pixels "
+                                   "missing in tile index");
+                        }
+                        continue;
+                    }
+
+                    const bool covered(reference == int(mask.total()));
+
+                    const bool skip(watertightTile(flags
+                                                   , TileOperation::mask));
+                    if (skip) { ++skipped; } else { ++computed; }
+
+                    // not an error, just a missed optimization
+                    if (covered && !skip) { ++missed; }
+
+                    // shortcut answers FullImage, every pixel must be valid
+                    if (skip && !covered) {
+                        report(tileId, name + ": watertight tile has "
+                               + std::to_string(mask.total() - reference)
+                               + " invalid pixels");
+                    }
+                }
+            }
+        }
+    });
+
+    check(plain, "plain");
+    check(accelerated, "pyramid");
+
+    if (!skipped || !computed) {
+        ++failed;
+        LOG(err3) << "Check failed: " << skipped << " tiles skipped, "
+                  << computed << " tiles computed.";
+    }
+
+    // counters must match
+    std::ostringstream os;
+    watertightStat(os, "watertight.");
+    const auto stat(os.str());
+    if ((counter(stat, "watertight.mask.skipped") != skipped)
+        || (counter(stat, "watertight.mask.computed") != computed))
+    {
+        ++failed;
+        LOG(err3) << "Check failed: counters mismatch:\n" << stat;
+    }
+
+    LOG(info3) << "Skipped mask computation for " << skipped
+               << " tiles, computed for " << computed << " tiles ("
+               << missed << " fully covered tiles not marked watertight).";
+
+    LOG(info4) << (failed ? "Some checks failed." : "All checks passed.");
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[])
+{
+    return CheckWatertight()(argc, argv);
+}
@@ -0,0 +1,860 @@
+/**
+ * Copyright (c) 2019 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cstdlib>
+#include <cmath>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <random>
+#include <fstream>
+#include <deque>
+#include <map>
+#include <set>
+
+#include <unistd.h>
+
+#include <boost/optional.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/thread.hpp>
+#include <boost/algorithm/string/predicate.hpp>
+
+#include "utility/streams.hpp"
+#include "utility/buildsys.hpp"
+#include "utility/format.hpp"
+#include "utility/runnable.hpp"
+#include "service/cmdline.hpp"
+
+#include "gdal-drivers/register.hpp"
+
+#include "vts-libs/registry/po.hpp"
+#include "vts-libs/vts/io.hpp"
+
+#include "http/contentfetcher.hpp"
+#include "http/error.hpp"
+
+// mapproxy stuff
+#include "mapproxy/error.hpp"
+#include "mapproxy/resource.hpp"
+#include "mapproxy/resourcebackend.hpp"
+#include "mapproxy/resourcebackend/conffile.hpp"
+#include "mapproxy/generator.hpp"
+#include "mapproxy/gdalsupport.hpp"
+#include "mapproxy/core.hpp"
+#include "mapproxy/fileinfo.hpp"
+#include "mapproxy/localsink.hpp"
+#include "mapproxy/support/wmts.hpp"
+#include "mapproxy/definition/tms.hpp"
+
+namespace po = boost::program_options;
+namespace fs = boost::filesystem;
+namespace ba = boost::algorithm;
+namespace vr = vtslibs::registry;
+namespace vts = vtslibs::vts;
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+/** Stand-in for HTTP client: serves remote resources from local directory
+ *  (http://host/path -> ROOT/host/path), everything else is not found. Keeps
+ *  measurements independent of network.
+ */
+class LocalFetcher : public http::ContentFetcher {
+public:
+    LocalFetcher(const boost::optional<fs::path> &root) : root_(root) {}
+
+private:
+    virtual void fetch_impl(const std::string &location
+                            , const http::ClientSink::pointer &sink
+                            , const RequestOptions &options) const;
+
+    boost::optional<fs::path> root_;
+};
+
+void LocalFetcher::fetch_impl(const std::string &location
+                              , const http::ClientSink::pointer &sink
+                              , const RequestOptions&) const
+{
+    try {
+        if (root_) {
+            auto path(location);
+            const auto scheme(path.find("://"));
+            if (scheme != std::string::npos) {
+                path = path.substr(scheme + 3);
+            }
+            path = path.substr(0, path.find('?'));
+
+            const auto file(*root_ / path);
+            if (fs::is_regular_file(file)) {
+                std::ifstream f(file.string()
+                                , std::ios_base::in | std::ios_base::binary);
+                std::string data((std::istreambuf_iterator<char>(f))
+                                 , std::istreambuf_iterator<char>());
+                sink->content(data, http::ClientSink::FileInfo());
+                return;
+            }
+        }
+
+        sink->error(utility::makeError<http::NotFound>
+                    ("Remote resource <%s> not available locally."
+                     , location));
+    } catch (...) {
+        sink->error();
+    }
+}
+
+/** Extracts local URL from access log line. Understands common/combined log
+ *  format ("GET /path HTTP/1.1") and bare URLs, one per line.
+ */
+boost::optional<std::string> parseLogLine(const std::string &line
+                                          , const std::string &prefix)
+{
+    std::string url;
+
+    const auto quote(line.find('"'));
+    if (quote != std::string::npos) {
+        // "METHOD URL PROTOCOL"
+        const auto method(line.find(' ', quote));
+        if (method == std::string::npos) { return boost::none; }
+        if (line.compare(quote + 1, method - quote - 1, "GET")) {
+            return boost::none;
+        }
+        const auto end(line.find_first_of(" \"", method + 1));
+        if (end == std::string::npos) { return boost::none; }
+        url = line.substr(method + 1, end - method - 1);
+    } else {
+        const auto b(line.find_first_not_of(" \t"));
+        if (b == std::string::npos) { return boost::none; }
+        url = line.substr(b, line.find_first_of(" \t", b) - b);
+    }
+
+    // strip scheme and host
+    const auto scheme(url.find("://"));
+    if (scheme != std::string::npos) {
+        const auto slash(url.find('/', scheme + 3));
+        if (slash == std::string::npos) { return boost::none; }
+        url = url.substr(slash);
+    }
+
+    if (!prefix.empty()) {
+        if (!ba::starts_with(url, prefix)) { return boost::none; }
+        url = url.substr(prefix.size());
+    }
+
+    if (url.empty() || (url[0] != '/')) { return boost::none; }
+    return url;
+}
+
+/** Zipf distribution over ranks [0, n).
+ */
+class Zipf {
+public:
+    Zipf(std::size_t n, double exponent)
+        : cdf_(n)
+    {
+        double sum(0.0);
+        for (std::size_t i(0); i < n; ++i) {
+            sum += 1.0 / std::pow(double(i + 1), exponent);
+            cdf_[i] = sum;
+        }
+    }
+
+    template <typename Generator>
+    std::size_t operator()(Generator &gen) const {
+        std::uniform_real_distribution<double> u(0.0, cdf_.back());
+        return std::min
+            (std::size_t(std::lower_bound(cdf_.begin(), cdf_.end(), u(gen))
+                         - cdf_.begin())
+             , cdf_.size() - 1);
+    }
+
+private:
+    std::vector<double> cdf_;
+};
+
+/** Shifts tile range from one LOD to a finer one.
+ */
+vts::TileRange shiftRange(vts::Lod srcLod, const vts::TileRange &tr
+                          , vts::Lod dstLod)
+{
+    const auto depth(dstLod - srcLod);
+    return vts::TileRange(tr.ll(0) << depth, tr.ll(1) << depth
+                          , ((tr.ur(0) + 1) << depth) - 1
+                          , ((tr.ur(1) + 1) << depth) - 1);
+}
+
+/** Image format of tms resource as configured in its definition. Transparent
+ *  tms-raster is always served as PNG.
+ */
+RasterFormat tmsFormat(const Resource &r)
+{
+    const auto *definition(r.definition().get());
+    if (const auto *raster = dynamic_cast<const resource::TmsRaster*>
+        (definition))
+    {
+        return raster->transparent ? RasterFormat::png : raster->format;
+    }
+    if (const auto *synthetic = dynamic_cast
+        <const resource::TmsRasterSynthetic*>(definition))
+    {
+        return synthetic->format;
+    }
+    return RasterFormat::jpg;
+}
+
+/** Tile file extensions (and metatile binary order) served by resource via
+ *  vts interface.
+ */
+std::vector<std::string> tileExtensions(const Resource &resource
+                                        , unsigned int &metaOrder)
+{
+    switch (resource.generator.type) {
+    case Resource::Generator::Type::tms:
+        metaOrder = 8; // see generator/tms-raster.cpp
+        return { boost::lexical_cast<std::string>(tmsFormat(resource))
+                , "mask", "meta" };
+
+    case Resource::Generator::Type::surface:
+        metaOrder = resource.referenceFrame->metaBinaryOrder;
+        return { "bin", "meta", "nav" };
+
+    case Resource::Generator::Type::geodata:
+        metaOrder = resource.referenceFrame->metaBinaryOrder;
+        if (ba::ends_with(resource.generator.driver, "-tiled")) {
+            return { "geo", "meta" };
+        }
+        return {};
+    }
+    return {};
+}
+
+/** Builds synthetic workload candidates ordered by expected popularity:
+ *  map configurations first, then tiles from coarse to fine LODs.
+ */
+std::vector<std::string> syntheticCandidates(const Resource::map &resources
+                                             , std::size_t tileCount)
+{
+    std::vector<std::string> configs;
+    std::vector<std::pair<vts::Lod, std::string>> tiles;
+
+    for (const auto &item : resources) {
+        const auto &resource(item.second);
+        const auto prefix
+            (utility::format("/%s/%s/%s/%s/", resource.id.referenceFrame
+                             , resource.generator.type, resource.id.group
+                             , resource.id.id));
+
+        configs.push_back(prefix + "mapConfig.json");
+
+        unsigned int metaOrder(0);
+        const auto extensions(tileExtensions(resource, metaOrder));
+        if (extensions.empty()) { continue; }
+        const unsigned int metaMask((1u << metaOrder) - 1);
+
+        // generates up to tileCount tiles from coarse to fine LODs
+        [&]() {
+            std::size_t count(0);
+            for (auto lod : resource.lodRange) {
+                const auto tr(shiftRange(resource.lodRange.min
+                                         , resource.tileRange, lod));
+                for (auto y(tr.ll(1)); y <= tr.ur(1); ++y) {
+                    for (auto x(tr.ll(0)); x <= tr.ur(0); ++x) {
+                        for (const auto &ext : extensions) {
+                            if (count >= tileCount) { return; }
+                            vts::TileId tileId(lod, x, y);
+                            if (ext == "meta") {
+                                if (((x & metaMask) && (x != tr.ll(0)))
+                                    || ((y & metaMask) && (y != tr.ll(1))))
+                                {
+                                    continue;
+                                }
+                                tileId.x &= ~metaMask;
+                                tileId.y &= ~metaMask;
+                            }
+                            tiles.emplace_back
+                                (lod, prefix + utility::format
+                                 ("%d-%d-%d.%s", tileId.lod, tileId.x
+                                  , tileId.y, ext));
+                            ++count;
+                        }
+                    }
+                }
+            }
+        }();
+    }
+
+    std::stable_sort(tiles.begin(), tiles.end()
+                     , [](const std::pair<vts::Lod, std::string> &a
+                          , const std::pair<vts::Lod, std::string> &b)
+                     {
+                         return a.first < b.first;
+                     });
+
+    for (auto &tile : tiles) { configs.push_back(std::move(tile.second)); }
+    return configs;
+}
+
+/** File type (for statistics): extension of requested file.
+ */
+std::string fileType(const std::string &filename)
+{
+    const auto dot(filename.rfind('.'));
+    if (dot == std::string::npos) {
+        return filename.empty() ? "listing" : "other";
+    }
+    return filename.substr(dot + 1);
+}
+
+/** Per-key latency statistics.
+ */
+struct Stats {
+    std::vector<double> latency; // ms
+    std::size_t ok;
+    std::size_t notFound;
+    std::size_t failed;
+    std::size_t bytes;
+
+    Stats() : ok(), notFound(), failed(), bytes() {}
+
+    void add(const LocalSink::Response &r, double ms) {
+        latency.push_back(ms);
+        if (r.ok()) {
+            ++ok;
+            bytes += r.data.size();
+        } else if (r.status == utility::HttpCode::NotFound) {
+            ++notFound;
+        } else {
+            ++failed;
+        }
+    }
+};
+
+typedef std::map<std::string, Stats> StatsMap;
+
+double percentile(const std::vector<double> &sorted, double p)
+{
+    if (sorted.empty()) { return 0.0; }
+    return sorted[std::min(sorted.size() - 1
+                           , std::size_t(p * sorted.size()))];
+}
+
+void report(const std::string &title, StatsMap &stats, double seconds)
+{
+    LOG(info4) << title << ":";
+    for (auto &item : stats) {
+        auto &s(item.second);
+        std::sort(s.latency.begin(), s.latency.end());
+        LOG(info4)
+            << "    " << item.first << ": " << s.latency.size()
+            << " requests (" << s.ok << " ok, " << s.notFound
+            << " not found, " << s.failed << " failed), "
+            << (seconds ? (s.latency.size() / seconds) : 0.0)
+            << " req/s, " << (s.bytes / 1048576.0) << " MB; latency [ms]"
+            << " p50=" << percentile(s.latency, 0.5)
+            << " p90=" << percentile(s.latency, 0.9)
+            << " p99=" << percentile(s.latency, 0.99)
+            << " max=" << (s.latency.empty() ? 0.0 : s.latency.back());
+    }
+}
+
+} // namespace
+
+class Replay : public service::Cmdline
+             , public utility::Runnable
+{
+public:
+    Replay()
+        : service::Cmdline("mapproxy-replay", BUILD_TARGET_VERSION)
+        , synthetic_(), zipf_(1.0), tileCount_(100000), seed_(1)
+        , repeat_(1)
+        , threadCount_(boost::thread::hardware_concurrency())
+        , concurrency_(), readyTimeout_(600)
+        , running_(true)
+    {
+        gdalWarperOptions_.processCount
+            = boost::thread::hardware_concurrency();
+    }
+
+private:
+    void configuration(po::options_description &cmdline
+                       , po::options_description &config
+                       , po::positional_options_description &pd);
+
+    void configure(const po::variables_map &vars);
+
+    bool help(std::ostream &out, const std::string &what) const;
+
+    int run();
+
+    virtual bool isRunning() { return running_; }
+    virtual void stop() { running_ = false; }
+
+    std::vector<std::string> workload(const Resource::map &resources) const;
+
+    bool waitReady(GdalWarper &warper, const Generators &generators
+                   , const Resource::map &resources);
+
+    fs::path resourceFile_;
+    boost::optional<fs::path> logFile_;
+    std::string prefix_;
+    std::size_t synthetic_;
+    double zipf_;
+    std::size_t tileCount_;
+    unsigned int seed_;
+    std::size_t repeat_;
+    unsigned int threadCount_;
+    std::size_t concurrency_;
+    boost::optional<fs::path> fetchRoot_;
+    std::size_t readyTimeout_;
+
+    Generators::Config generatorsConfig_;
+    GdalWarper::Options gdalWarperOptions_;
+
+    std::atomic<bool> running_;
+};
+
+void Replay::configuration(po::options_description &cmdline
+                           , po::options_description &config
+                           , po::positional_options_description &pd)
+{
+    vr::registryConfiguration(cmdline, vr::defaultPath());
+
+    cmdline.add_options()
+        ("resource", po::value(&resourceFile_)->required()
+         , "Path to resource definition file (same format as conffile "
+         "resource backend).")
+        ("store.path", po::value(&generatorsConfig_.root)->required()
+         , "Path to internal store (scratch directory).")
+        ("resource-backend.root"
+         , po::value(&generatorsConfig_.resourceRoot)
+         , "Root of datasets defined as relative path. Defaults to "
+         "directory of resource file.")
+
+        ("log", po::value<fs::path>()
+         , "Access log to replay (common/combined log format or one URL "
+         "per line). Only GET requests are replayed.")
+        ("prefix", po::value(&prefix_)
+         , "URL prefix to strip from logged URLs (e.g. /mapproxy); lines "
+         "not starting with prefix are ignored.")
+        ("synthetic", po::value(&synthetic_)
+         ->default_value(synthetic_)->required()
+         , "Number of synthetic requests to generate when no log is given.")
+        ("zipf", po::value(&zipf_)->default_value(zipf_)->required()
+         , "Exponent of Zipf distribution of synthetic tile popularity.")
+        ("tileCount", po::value(&tileCount_)
+         ->default_value(tileCount_)->required()
+         , "Maximum number of distinct tile files per resource in synthetic "
+         "workload.")
+        ("seed", po::value(&seed_)->default_value(seed_)->required()
+         , "Random generator seed for synthetic workload.")
+        ("repeat", po::value(&repeat_)->default_value(repeat_)->required()
+         , "Number of passes over the workload.")
+
+        ("core.threadCount", po::value(&threadCount_)
+         ->default_value(threadCount_)->required()
+         , "Number of core processing threads.")
+        ("concurrency", po::value(&concurrency_)
+         ->default_value(concurrency_)->required()
+         , "Number of requests in flight. 0 means 4 * core.threadCount.")
+        ("fetch.root", po::value<fs::path>()
+         , "Directory with local copies of remote resources "
+         "(http://host/path -> ROOT/host/path). Remote fetches fail "
+         "when not set.")
+        ("readyTimeout", po::value(&readyTimeout_)
+         ->default_value(readyTimeout_)->required()
+         , "Maximum time to wait for resources to be ready (in seconds).")
+
+        ("gdal.processCount"
+         , po::value(&gdalWarperOptions_.processCount)
+         ->default_value(gdalWarperOptions_.processCount)->required()
+         , "Number of GDAL processes.")
+        ("gdal.tmpRoot"
+         , po::value(&gdalWarperOptions_.tmpRoot)
+         , "Root for GDAL temporary stuff. Defaults to STORE/tmp.")
+        ("gdal.rssLimit"
+         , po::value(&gdalWarperOptions_.rssLimit)
+         ->default_value(gdalWarperOptions_.rssLimit)->required()
+         , "Real memory limit of all GDAL processes (in MB).")
+        ("gdal.rssCheckPeriod"
+         , po::value(&gdalWarperOptions_.rssCheckPeriod)
+         ->default_value(gdalWarperOptions_.rssCheckPeriod)->required()
+         , "Memory check period (in seconds)")
+        ("gdal.hugePages"
+         , po::value(&gdalWarperOptions_.hugePages)
+         ->default_value(gdalWarperOptions_.hugePages)->required()
+         , "Huge page backing of GDAL shared memory (none, transparent, "
+         "hugetlb, auto).")
+        ;
+
+    pd
+        .add("resource", 1)
+        .add("log", 1);
+
+    (void) config;
+}
+
+void Replay::configure(const po::variables_map &vars)
+{
+    vr::registryConfigure(vars);
+
+    if (vars.count("log")) { logFile_ = vars["log"].as<fs::path>(); }
+    if (vars.count("fetch.root")) {
+        fetchRoot_ = fs::absolute(vars["fetch.root"].as<fs::path>());
+    }
+
+    if (!logFile_ && !synthetic_) {
+        throw po::required_option("log");
+    }
+
+    if (!threadCount_) {
+        throw po::validation_error
+            (po::validation_error::invalid_option_value, "core.threadCount");
+    }
+    if (!concurrency_) { concurrency_ = 4 * threadCount_; }
+
+    resourceFile_ = fs::absolute(resourceFile_);
+    generatorsConfig_.root = fs::absolute(generatorsConfig_.root);
+
+    if (generatorsConfig_.resourceRoot.empty()) {
+        generatorsConfig_.resourceRoot = resourceFile_.parent_path();
+    }
+    generatorsConfig_.resourceRoot
+        = fs::absolute(generatorsConfig_.resourceRoot);
+
+    if (gdalWarperOptions_.tmpRoot.empty()) {
+        gdalWarperOptions_.tmpRoot = generatorsConfig_.root / "tmp";
+    }
+    gdalWarperOptions_.tmpRoot = fs::absolute(gdalWarperOptions_.tmpRoot);
+    generatorsConfig_.tmpRoot = gdalWarperOptions_.tmpRoot / "generators";
+
+    // load resources once, never update
+    generatorsConfig_.resourceUpdatePeriod = 0;
+
+    LOG(info3, log_)
+        << std::boolalpha
+        << "Config:"
+        << "\nresource = " << resourceFile_
+        << "\nlog = " << logFile_
+        << "\nprefix = " << prefix_
+        << "\nsynthetic = " << synthetic_
+        << "\nzipf = " << zipf_
+        << "\ntileCount = " << tileCount_
+        << "\nrepeat = " << repeat_
+        << "\ncore.threadCount = " << threadCount_
+        << "\nconcurrency = " << concurrency_
+        << "\nfetch.root = " << fetchRoot_
+        << "\nstore.path = " << generatorsConfig_.root
+        << "\nresource-backend.root = " << generatorsConfig_.resourceRoot
+        << "\ngdal.processCount = " << gdalWarperOptions_.processCount
+        << "\ngdal.tmpRoot = " << gdalWarperOptions_.tmpRoot
+        << "\ngdal.hugePages = " << gdalWarperOptions_.hugePages
+        << "\n"
+        ;
+}
+
+bool Replay::help(std::ostream &out, const std::string &what) const
+{
+    if (what.empty()) {
+        // program help
+        out << ("mapproxy load replay tool\n"
+                "    Replays recorded access log (or synthetic Zipf "
+                "distributed tile\n"
+                "    workload) directly against mapproxy core and reports "
+                "throughput,\n"
+                "    latency percentiles per file type and resource type and "
+                "GDAL worker\n"
+                "    utilization.\n"
+                "\n"
+                );
+
+        return true;
+    }
+
+    return false;
+}
+
+std::vector<std::string>
+Replay::workload(const Resource::map &resources) const
+{
+    std::vector<std::string> urls;
+
+    if (logFile_) {
+        std::ifstream f(logFile_->string());
+        if (!f) {
+            LOGTHROW(err4, std::runtime_error)
+                << "Unable to open access log " << *logFile_ << ".";
+        }
+
+        std::string line;
+        while (std::getline(f, line)) {
+            if (auto url = parseLogLine(line, prefix_)) {
+                urls.push_back(*url);
+            }
+        }
+
+        LOG(info3) << "Loaded " << urls.size() << " requests from "
+                   << *logFile_ << ".";
+        return urls;
+    }
+
+    const auto candidates(syntheticCandidates(resources, tileCount_));
+    if (candidates.empty()) { return urls; }
+
+    std::mt19937 gen(seed_);
+    const Zipf zipf(candidates.size(), zipf_);
+    urls.reserve(synthetic_);
+    for (std::size_t i(0); i < synthetic_; ++i) {
+        urls.push_back(candidates[zipf(gen)]);
+    }
+
+    LOG(info3) << "Generated " << urls.size() << " synthetic requests over "
+               << candidates.size() << " distinct files.";
+    return urls;
+}
+
+bool Replay::waitReady(GdalWarper &warper, const Generators &generators
+                       , const Resource::map &resources)
+{
+    LOG(info3) << "Waiting for " << resources.size()
+               << " resource(s) to be ready.";
+
+    const auto deadline(Clock::now() + std::chrono::seconds(readyTimeout_));
+    for (const auto &item : resources) {
+        while (!generators.isReady(item.first)) {
+            if (!running_) { return false; }
+            if (generators.updatedSince(0) && !generators.has(item.first)) {
+                LOG(warn3) << "Resource <" << item.first
+                           << "> failed to prepare; its requests will fail.";
+                break;
+            }
+            if (Clock::now() > deadline) {
+                LOG(err4) << "Timed out waiting for resource <"
+                          << item.first << ">.";
+                return false;
+            }
+
+            warper.housekeeping();
+            ::usleep(100000);
+        }
+    }
+
+    return true;
+}
+
+int Replay::run()
+{
+    wmts::prepareTileMatrixSets();
+
+    // warper must be first since it uses processes
+    GdalWarper warper(gdalWarperOptions_, *this);
+
+    ResourceBackend::TypedConfig rbConfig("conffile");
+    rbConfig.assign<resource_backend::Conffile::Config>().path
+        = resourceFile_;
+    auto resourceBackend(ResourceBackend::create({}, rbConfig));
+    const auto resources(resourceBackend->load());
+
+    const auto urls(workload(resources));
+    if (urls.empty()) {
+        LOG(err4) << "Empty workload.";
+        return EXIT_FAILURE;
+    }
+
+    LocalFetcher fetcher(fetchRoot_);
+    auto generators(std::make_shared<Generators>
+                    (generatorsConfig_, resourceBackend));
+
+    // starts generators
+    Core core(*generators, warper, threadCount_, fetcher);
+    if (!waitReady(warper, *generators, resources)) {
+        return EXIT_FAILURE;
+    }
+
+    struct Result {
+        std::string url;
+        LocalSink::Response response;
+        Clock::duration duration;
+
+        Result(const std::string &url, LocalSink::Response &&response
+               , Clock::duration duration)
+            : url(url), response(std::move(response)), duration(duration)
+        {}
+    };
+
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::vector<Result> results;
+    std::size_t inflight(0);
+
+    auto submit([&](const std::string &url)
+    {
+        const auto start(Clock::now());
+        auto sink(std::make_shared<LocalSink>
+                  ([&, url, start](LocalSink::Response &&response)
+        {
+            const auto duration(Clock::now() - start);
+            std::unique_lock<std::mutex> lock(mutex);
+            results.emplace_back(url, std::move(response), duration);
+            cond.notify_one();
+        }));
+
+        http::Request request;
+        request.method = "GET";
+        request.uri = url;
+        const auto qm(url.find('?'));
+        request.path = url.substr(0, qm);
+        if (qm != std::string::npos) { request.query = url.substr(qm + 1); }
+
+        core.generate(request, sink);
+    });
+
+    StatsMap byFile, byResource;
+    Stats total;
+
+    auto drain([&](std::vector<Result> &batch)
+    {
+        for (auto &result : batch) {
+            const double ms(std::chrono::duration<double, std::milli>
+                            (result.duration).count());
+
+            std::string file("invalid"), resource("invalid");
+            try {
+                FileInfo fi(result.url);
+                file = fileType(fi.filename);
+                resource = boost::lexical_cast<std::string>(fi.interface);
+                if (fi.type != FileInfo::Type::resourceFile) {
+                    resource = "browsing";
+                }
+            } catch (const std::exception&) {}
+
+            byFile[file].add(result.response, ms);
+            byResource[resource].add(result.response, ms);
+            total.add(result.response, ms);
+        }
+        batch.clear();
+    });
+
+    // GDAL utilization sampling
+    double busySum(0.0);
+    std::size_t busySamples(0);
+    unsigned int busyMax(0);
+    auto sample([&]()
+    {
+        const auto busy(warper.busyWorkers());
+        busySum += busy;
+        ++busySamples;
+        busyMax = std::max(busyMax, busy);
+    });
+
+    LOG(info4) << "Replaying " << urls.size() << " requests "
+               << repeat_ << " time(s) with concurrency "
+               << concurrency_ << ".";
+
+    const auto replayStart(Clock::now());
+    std::vector<Result> batch;
+    std::size_t pass(0), next(0), processed(0);
+    const std::size_t totalRequests(urls.size() * repeat_);
+
+    while (running_ && ((pass < repeat_) || inflight)) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (running_ && (pass < repeat_) && (inflight < concurrency_))
+            {
+                ++inflight;
+                lock.unlock();
+                submit(urls[next]);
+                lock.lock();
+                if (++next == urls.size()) { next = 0; ++pass; }
+            }
+
+            cond.wait_for(lock, std::chrono::milliseconds(10)
+                          , [&]() { return !results.empty(); });
+            inflight -= results.size();
+            std::swap(batch, results);
+        }
+
+        processed += batch.size();
+        drain(batch);
+        sample();
+        warper.housekeeping();
+
+        if (!running_) {
+            LOG(warn3) << "Interrupted, waiting for " << inflight
+                       << " requests in flight.";
+        }
+    }
+
+    // wait for stragglers when interrupted
+    while (inflight) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cond.wait_for(lock, std::chrono::milliseconds(10)
+                          , [&]() { return !results.empty(); });
+            inflight -= results.size();
+            std::swap(batch, results);
+        }
+        processed += batch.size();
+        drain(batch);
+        warper.housekeeping();
+    }
+
+    const double seconds(std::chrono::duration<double>
+                         (Clock::now() - replayStart).count());
+
+    // report
+    report("Per file type", byFile, seconds);
+    report("Per resource type", byResource, seconds);
+
+    StatsMap overall;
+    overall["all"] = std::move(total);
+    report("Total", overall, seconds);
+
+    LOG(info4)
+        << "Processed " << processed << "/" << totalRequests
+        << " requests in " << seconds << " s ("
+        << (seconds ? (processed / seconds) : 0.0) << " req/s).";
+    LOG(info4)
+        << "GDAL worker utilization: "
+        << (busySamples ? (100.0 * busySum / busySamples
+                           / gdalWarperOptions_.processCount) : 0.0)
+        << " % average, " << busyMax << "/"
+        << gdalWarperOptions_.processCount << " peak busy workers.";
+
+    return running_ ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int main(int argc, char *argv[])
+{
+    ::GDALAllRegister();
+    ::OGRRegisterAll();
+    gdal_drivers::registerAll();
+
+    return Replay()(argc, argv);
+}
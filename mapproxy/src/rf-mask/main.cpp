@@ -54,6 +54,8 @@
 #include "vts-libs/vts/io.hpp"
 #include "vts-libs/vts/tileindex.hpp"
 
+#include "mapproxy/support/masktree.hpp"
+
 #include "./ogrsupport.hpp"
 
 #include "gdal-drivers/mask.hpp"
@@ -88,6 +90,7 @@ public:
         , dilate_(10.), segments_(30)
         , tileSizeOrder_(8), workBlock_(5)
         , generateGdalDatasets_(false)
+        , generatePyramid_(false)
     {}
 
 private:
@@ -116,6 +119,7 @@ private:
     math::Size2 tileSize_;
     int workBlock_;
     bool generateGdalDatasets_;
+    bool generatePyramid_;
 
     boost::optional<FeatureFilter> featureFilter_;
 };
@@ -162,6 +166,14 @@ void RfMask::configuration(po::options_description &cmdline
          , "Generates gdal dataset per reference frame node."
          )
 
+        ("generatePyramid"
+         , po::value(&generatePyramid_)->required()
+         ->default_value(false)->implicit_value(true)
+         , "Generates companion mask pyramid (OUTPUT.pyramid): per-LOD "
+         "empty/partial/full tile flags down to bottom LOD. Lets mapproxy "
+         "skip mask rasterization for fully covered or empty tiles."
+         )
+
         ("layer"
          , po::value(&layer_)->required()->default_value(layer_)
          , "Layer selector. Not needed if there is just one layer "
@@ -212,6 +224,7 @@ void RfMask::configure(const po::variables_map &vars)
         << "\n\ttileSize = " << tileSize_
         << "\n\tworkBlock = " << workBlock_
         << "\n\tgenerateGdalDatasets = " << generateGdalDatasets_
+        << "\n\tgeneratePyramid = " << generatePyramid_
         << "\n"
         ;
 }
@@ -709,6 +722,15 @@ int RfMask::run()
         f.close();
     }
 
+    if (generatePyramid_) {
+        // build from saved tree to get exactly what mapproxy sees
+        const auto path(MaskPyramid::companion(output_));
+        LOG(info3)
+            << "Saving mask pyramid to " << path << ".";
+        imgproc::mappedqtree::RasterMask saved(output_);
+        MaskPyramid(saved, lod_).save(path);
+    }
+
     return EXIT_SUCCESS;
 }
 
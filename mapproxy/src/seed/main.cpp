@@ -0,0 +1,841 @@
+/**
+ * Copyright (c) 2019 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cstdlib>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <deque>
+#include <map>
+
+#include <unistd.h>
+
+#include <boost/optional.hpp>
+#include <boost/utility/in_place_factory.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/thread.hpp>
+#include <boost/asio.hpp>
+#include <boost/format.hpp>
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/algorithm/string/split.hpp>
+#include <boost/algorithm/string/classification.hpp>
+
+#include "utility/streams.hpp"
+#include "utility/buildsys.hpp"
+#include "utility/format.hpp"
+#include "utility/enum-io.hpp"
+#include "utility/duration.hpp"
+#include "utility/runnable.hpp"
+#include "service/cmdline.hpp"
+
+#include "gdal-drivers/register.hpp"
+
+#include "vts-libs/registry/po.hpp"
+#include "vts-libs/vts/io.hpp"
+
+#include "http/http.hpp"
+#include "http/resourcefetcher.hpp"
+
+// mapproxy stuff
+#include "mapproxy/error.hpp"
+#include "mapproxy/resource.hpp"
+#include "mapproxy/resourcebackend.hpp"
+#include "mapproxy/resourcebackend/conffile.hpp"
+#include "mapproxy/generator.hpp"
+#include "mapproxy/gdalsupport.hpp"
+#include "mapproxy/fileinfo.hpp"
+#include "mapproxy/localsink.hpp"
+#include "mapproxy/support/wmts.hpp"
+
+#include "./pack.hpp"
+
+namespace po = boost::program_options;
+namespace fs = boost::filesystem;
+namespace ba = boost::algorithm;
+namespace asio = boost::asio;
+namespace vr = vtslibs::registry;
+namespace vts = vtslibs::vts;
+
+namespace {
+
+UTILITY_GENERATE_ENUM(FileKind,
+                      ((image))
+                      ((mask))
+                      ((meta))
+                      ((mesh))
+                      ((navtile))
+                      ((geo))
+                      ((terrain))
+                      )
+
+typedef std::vector<FileKind> FileKinds;
+
+/** Same as RasterMetatileBinaryOrder in generator/tms-raster.cpp
+ */
+const unsigned int RasterMetatileBinaryOrder(8);
+
+/** Lists tile files served by given generator interface.
+ */
+FileKinds tileFiles(const Resource &resource, const GeneratorInterface &gi)
+{
+    switch (gi.interface) {
+    case GeneratorInterface::Interface::vts:
+        switch (gi.type) {
+        case Resource::Generator::Type::tms:
+            return { FileKind::image, FileKind::mask, FileKind::meta };
+
+        case Resource::Generator::Type::surface:
+            return { FileKind::mesh, FileKind::meta, FileKind::navtile };
+
+        case Resource::Generator::Type::geodata:
+            // only tiled geodata are seedable
+            if (ba::ends_with(resource.generator.driver, "-tiled")) {
+                return { FileKind::geo, FileKind::meta };
+            }
+            return {};
+        }
+        break;
+
+    case GeneratorInterface::Interface::terrain:
+        if (gi.type == Resource::Generator::Type::surface) {
+            return { FileKind::terrain };
+        }
+        break;
+
+    default: break;
+    }
+
+    return {};
+}
+
+/** Metatiles exist only at metatile origins. Returns binary order of metatile
+ *  grid.
+ */
+unsigned int metaBinaryOrder(const Resource &resource)
+{
+    if (resource.generator.type == Resource::Generator::Type::tms) {
+        return RasterMetatileBinaryOrder;
+    }
+    return resource.referenceFrame->metaBinaryOrder;
+}
+
+std::string filename(const vts::TileId &tileId, FileKind kind
+                     , RasterFormat format)
+{
+    const auto ext([&]() -> std::string
+    {
+        switch (kind) {
+        case FileKind::image: return boost::lexical_cast<std::string>(format);
+        case FileKind::mask: return "mask";
+        case FileKind::meta: return "meta";
+        case FileKind::mesh: return "bin";
+        case FileKind::navtile: return "nav";
+        case FileKind::geo: return "geo";
+        case FileKind::terrain: return "terrain";
+        }
+        return {};
+    }());
+
+    return utility::format("%d-%d-%d.%s", tileId.lod, tileId.x, tileId.y
+                           , ext);
+}
+
+/** Shifts tile range from one LOD to a finer one.
+ */
+vts::TileRange shiftRange(vts::Lod srcLod, const vts::TileRange &tr
+                          , vts::Lod dstLod)
+{
+    const auto depth(dstLod - srcLod);
+    return vts::TileRange(tr.ll(0) << depth, tr.ll(1) << depth
+                          , ((tr.ur(0) + 1) << depth) - 1
+                          , ((tr.ur(1) + 1) << depth) - 1);
+}
+
+struct Job {
+    vts::TileId tileId;
+    FileKind kind;
+
+    Job(const vts::TileId &tileId, FileKind kind)
+        : tileId(tileId), kind(kind) {}
+};
+
+struct Result {
+    Job job;
+    LocalSink::Response response;
+    std::chrono::steady_clock::duration duration;
+
+    Result(const Job &job, LocalSink::Response &&response
+           , std::chrono::steady_clock::duration duration)
+        : job(job), response(std::move(response)), duration(duration)
+    {}
+};
+
+/** Per-kind statistics.
+ */
+struct Stats {
+    std::size_t files;
+    std::size_t empty;
+    std::size_t failed;
+    std::size_t bytes;
+    std::chrono::steady_clock::duration time;
+
+    Stats() : files(), empty(), failed(), bytes(), time() {}
+};
+
+typedef std::map<FileKind, Stats> StatsMap;
+
+} // namespace
+
+class Seed : public service::Cmdline
+           , public utility::Runnable
+{
+public:
+    Seed()
+        : service::Cmdline("mapproxy-seed", BUILD_TARGET_VERSION)
+        , interface_(GeneratorInterface::Interface::vts)
+        , format_(RasterFormat::jpg)
+        , threadCount_(boost::thread::hardware_concurrency())
+        , queueSize_()
+        , batchSize_(256)
+        , resume_(false)
+        , running_(true)
+    {
+        gdalWarperOptions_.processCount
+            = boost::thread::hardware_concurrency();
+    }
+
+private:
+    void configuration(po::options_description &cmdline
+                       , po::options_description &config
+                       , po::positional_options_description &pd);
+
+    void configure(const po::variables_map &vars);
+
+    bool help(std::ostream &out, const std::string &what) const;
+
+    int run();
+
+    virtual bool isRunning() { return running_; }
+    virtual void stop() { running_ = false; }
+
+    Resource findResource(const ResourceBackend &backend) const;
+
+    void waitReady(GdalWarper &warper, const Generators &generators
+                   , const Resource::Id &resourceId);
+
+    fs::path resourceFile_;
+    fs::path output_;
+    boost::optional<std::string> referenceFrame_;
+    boost::optional<std::string> group_;
+    boost::optional<std::string> id_;
+    GeneratorInterface::Interface interface_;
+    FileKinds kinds_;
+    RasterFormat format_;
+    boost::optional<vts::LodRange> lodRange_;
+    boost::optional<vts::TileRange> tileRange_;
+    unsigned int threadCount_;
+    std::size_t queueSize_;
+    std::size_t batchSize_;
+    bool resume_;
+
+    Generators::Config generatorsConfig_;
+    GdalWarper::Options gdalWarperOptions_;
+
+    std::atomic<bool> running_;
+};
+
+void Seed::configuration(po::options_description &cmdline
+                         , po::options_description &config
+                         , po::positional_options_description &pd)
+{
+    vr::registryConfiguration(cmdline, vr::defaultPath());
+
+    cmdline.add_options()
+        ("resource", po::value(&resourceFile_)->required()
+         , "Path to resource definition file (same format as conffile "
+         "resource backend).")
+        ("output", po::value(&output_)->required()
+         , "Path to output pack (SQLite database).")
+
+        ("referenceFrame", po::value<std::string>()
+         , "Reference frame of seeded resource. Needed only when resource "
+         "file defines more than one resource.")
+        ("group", po::value<std::string>()
+         , "Group of seeded resource. Needed only when resource "
+         "file defines more than one resource.")
+        ("id", po::value<std::string>()
+         , "Id of seeded resource. Needed only when resource "
+         "file defines more than one resource.")
+
+        ("interface", po::value(&interface_)
+         ->default_value(interface_)->required()
+         , "Generator interface to seed (vts or terrain).")
+        ("kinds", po::value<std::string>()
+         , "Comma-separated list of tile files to generate. Defaults to all "
+         "tile files served by given interface (image, mask, meta for tms; "
+         "mesh, meta, navtile for surface; geo, meta for tiled geodata; "
+         "terrain for terrain interface).")
+        ("format", po::value(&format_)
+         ->default_value(format_)->required()
+         , "Raster format of TMS images.")
+
+        ("lodRange", po::value<vts::LodRange>()
+         , "LOD range to seed. Defaults to resource's LOD range. "
+         "Clipped to resource's LOD range for vts interface.")
+        ("tileRange", po::value<vts::TileRange>()
+         , "Tile range at minimum seeded LOD. Defaults to resource's tile "
+         "range. Mandatory for terrain interface.")
+
+        ("threadCount", po::value(&threadCount_)
+         ->default_value(threadCount_)->required()
+         , "Number of generating threads.")
+        ("queueSize", po::value(&queueSize_)
+         ->default_value(queueSize_)->required()
+         , "Maximum number of files being generated at once. "
+         "0 means 4 * threadCount.")
+        ("batchSize", po::value(&batchSize_)
+         ->default_value(batchSize_)->required()
+         , "Number of files written in one pack transaction.")
+        ("resume", po::bool_switch(&resume_)
+         , "Resume interrupted seeding: keep existing pack and generate only "
+         "files not stored yet.")
+
+        ("store.path", po::value(&generatorsConfig_.root)
+         , "Path to internal store. Defaults to OUTPUT.store.")
+        ("resource-backend.root"
+         , po::value(&generatorsConfig_.resourceRoot)
+         , "Root of datasets defined as relative path. Defaults to "
+         "directory of resource file.")
+
+        ("gdal.processCount"
+         , po::value(&gdalWarperOptions_.processCount)
+         ->default_value(gdalWarperOptions_.processCount)->required()
+         , "Number of GDAL processes.")
+        ("gdal.tmpRoot"
+         , po::value(&gdalWarperOptions_.tmpRoot)
+         , "Root for GDAL temporary stuff. Defaults to OUTPUT.tmp.")
+        ("gdal.rssLimit"
+         , po::value(&gdalWarperOptions_.rssLimit)
+         ->default_value(gdalWarperOptions_.rssLimit)->required()
+         , "Real memory limit of all GDAL processes (in MB).")
+        ("gdal.rssCheckPeriod"
+         , po::value(&gdalWarperOptions_.rssCheckPeriod)
+         ->default_value(gdalWarperOptions_.rssCheckPeriod)->required()
+         , "Memory check period (in seconds)")
+        ;
+
+    pd
+        .add("resource", 1)
+        .add("output", 1);
+
+    (void) config;
+}
+
+void Seed::configure(const po::variables_map &vars)
+{
+    vr::registryConfigure(vars);
+
+    if (vars.count("referenceFrame")) {
+        referenceFrame_ = vars["referenceFrame"].as<std::string>();
+    }
+    if (vars.count("group")) { group_ = vars["group"].as<std::string>(); }
+    if (vars.count("id")) { id_ = vars["id"].as<std::string>(); }
+
+    if (vars.count("kinds")) {
+        std::vector<std::string> parts;
+        const auto &value(vars["kinds"].as<std::string>());
+        ba::split(parts, value, ba::is_any_of(", "), ba::token_compress_on);
+        for (const auto &part : parts) {
+            if (part.empty()) { continue; }
+            try {
+                kinds_.push_back(boost::lexical_cast<FileKind>(part));
+            } catch (const boost::bad_lexical_cast&) {
+                throw po::validation_error
+                    (po::validation_error::invalid_option_value, "kinds");
+            }
+        }
+    }
+
+    if (vars.count("lodRange")) {
+        lodRange_ = vars["lodRange"].as<vts::LodRange>();
+    }
+    if (vars.count("tileRange")) {
+        tileRange_ = vars["tileRange"].as<vts::TileRange>();
+    }
+
+    if ((interface_ == GeneratorInterface::Interface::terrain)
+        && !(lodRange_ && tileRange_))
+    {
+        // terrain tiles live in different tile grid
+        throw po::required_option
+            (lodRange_ ? "tileRange" : "lodRange");
+    }
+
+    if (!threadCount_) {
+        throw po::validation_error
+            (po::validation_error::invalid_option_value, "threadCount");
+    }
+    if (!queueSize_) { queueSize_ = 4 * threadCount_; }
+
+    resourceFile_ = fs::absolute(resourceFile_);
+    output_ = fs::absolute(output_);
+
+    if (generatorsConfig_.root.empty()) {
+        generatorsConfig_.root = output_.string() + ".store";
+    }
+    generatorsConfig_.root = fs::absolute(generatorsConfig_.root);
+
+    if (generatorsConfig_.resourceRoot.empty()) {
+        generatorsConfig_.resourceRoot = resourceFile_.parent_path();
+    }
+    generatorsConfig_.resourceRoot
+        = fs::absolute(generatorsConfig_.resourceRoot);
+
+    if (gdalWarperOptions_.tmpRoot.empty()) {
+        gdalWarperOptions_.tmpRoot = output_.string() + ".tmp";
+    }
+    gdalWarperOptions_.tmpRoot = fs::absolute(gdalWarperOptions_.tmpRoot);
+
+    // share same root
+    generatorsConfig_.tmpRoot = gdalWarperOptions_.tmpRoot / "generators";
+
+    // load resources once, never update
+    generatorsConfig_.resourceUpdatePeriod = 0;
+
+    LOG(info3, log_)
+        << std::boolalpha
+        << "Config:"
+        << "\nresource = " << resourceFile_
+        << "\noutput = " << output_
+        << "\ninterface = " << interface_
+        << "\nkinds = [" << utility::join(kinds_, ",") << "]"
+        << "\nformat = " << format_
+        << "\nlodRange = " << lodRange_
+        << "\ntileRange = " << tileRange_
+        << "\nthreadCount = " << threadCount_
+        << "\nqueueSize = " << queueSize_
+        << "\nbatchSize = " << batchSize_
+        << "\nresume = " << resume_
+        << "\nstore.path = " << generatorsConfig_.root
+        << "\nresource-backend.root = " << generatorsConfig_.resourceRoot
+        << "\ngdal.processCount = " << gdalWarperOptions_.processCount
+        << "\ngdal.tmpRoot = " << gdalWarperOptions_.tmpRoot
+        << "\n"
+        ;
+}
+
+bool Seed::help(std::ostream &out, const std::string &what) const
+{
+    if (what.empty()) {
+        // program help
+        out << ("mapproxy seeding tool\n"
+                "    Renders all tile files of given resource in given LOD "
+                "and tile range\n"
+                "    into single-file pack using the same generators as "
+                "mapproxy daemon.\n"
+                "\n"
+                );
+
+        return true;
+    }
+
+    return false;
+}
+
+Resource Seed::findResource(const ResourceBackend &backend) const
+{
+    const auto resources(backend.load());
+
+    boost::optional<Resource> found;
+    for (const auto &item : resources) {
+        const auto &id(item.first);
+        if (referenceFrame_ && (*referenceFrame_ != id.referenceFrame)) {
+            continue;
+        }
+        if (group_ && (*group_ != id.group)) { continue; }
+        if (id_ && (*id_ != id.id)) { continue; }
+
+        if (found) {
+            LOGTHROW(err4, std::runtime_error)
+                << "Multiple resources match in " << resourceFile_
+                << " (<" << found->id << ">, <" << id
+                << ">); use --referenceFrame, --group and --id to pick one.";
+        }
+        found = item.second;
+    }
+
+    if (!found) {
+        LOGTHROW(err4, std::runtime_error)
+            << "No matching resource found in " << resourceFile_ << ".";
+    }
+
+    return *found;
+}
+
+void Seed::waitReady(GdalWarper &warper, const Generators &generators
+                     , const Resource::Id &resourceId)
+{
+    LOG(info3) << "Waiting for resource <" << resourceId << "> to be ready.";
+
+    while (running_ && !generators.isReady(resourceId)) {
+        // resources loaded but ours is gone -> preparation failed
+        if (generators.updatedSince(0) && !generators.has(resourceId)) {
+            LOGTHROW(err4, std::runtime_error)
+                << "Failed to prepare resource <" << resourceId << ">.";
+        }
+
+        warper.housekeeping();
+        ::usleep(100000);
+    }
+}
+
+int Seed::run()
+{
+    wmts::prepareTileMatrixSets();
+
+    // warper must be first since it uses processes
+    GdalWarper warper(gdalWarperOptions_, *this);
+
+    ResourceBackend::TypedConfig rbConfig("conffile");
+    rbConfig.assign<resource_backend::Conffile::Config>().path
+        = resourceFile_;
+    auto resourceBackend(ResourceBackend::create({}, rbConfig));
+
+    const auto resource(findResource(*resourceBackend));
+    const GeneratorInterface gi(resource.generator.type, interface_);
+
+    // validate requested files
+    const auto served(tileFiles(resource, gi));
+    if (served.empty()) {
+        LOG(err4) << "Resource <" << resource.id << "> has no tile files "
+                  << "to seed via " << gi << " interface.";
+        return EXIT_FAILURE;
+    }
+    auto kinds(kinds_.empty() ? served : kinds_);
+    for (auto kind : kinds) {
+        if (std::find(served.begin(), served.end(), kind) == served.end()) {
+            LOG(err4) << "Tile file <" << kind << "> is not served by "
+                      << gi << " interface.";
+            return EXIT_FAILURE;
+        }
+    }
+
+    // compute seeded area
+    auto lodRange(lodRange_ ? *lodRange_ : resource.lodRange);
+    auto tileRange(tileRange_ ? *tileRange_
+                   : shiftRange(resource.lodRange.min, resource.tileRange
+                                , lodRange.min));
+    if (interface_ == GeneratorInterface::Interface::vts) {
+        if ((lodRange.min < resource.lodRange.min)
+            || (lodRange.max > resource.lodRange.max))
+        {
+            LOG(err4) << "LOD range " << lodRange << " is outside of "
+                      << "resource's LOD range " << resource.lodRange << ".";
+            return EXIT_FAILURE;
+        }
+    }
+
+    const auto metaOrder(metaBinaryOrder(resource));
+
+    // open pack
+    seed::Pack pack(output_, resume_, batchSize_);
+    const auto revision
+        (boost::lexical_cast<std::string>(resource.revision));
+    const auto resourceId
+        (boost::lexical_cast<std::string>(resource.id));
+    seed::Pack::KeySet done;
+    if (resume_) {
+        const auto packId(pack.getMeta("resource"));
+        const auto packRevision(pack.getMeta("revision"));
+        if ((packId && (*packId != resourceId))
+            || (packRevision && (*packRevision != revision)))
+        {
+            LOG(err4) << "Pack " << output_ << " was seeded from different "
+                      << "resource or revision (<" << packId << ">, rev "
+                      << packRevision << "); refusing to resume.";
+            return EXIT_FAILURE;
+        }
+        done = pack.keys();
+        LOG(info3) << "Resuming: " << done.size()
+                   << " files already in pack.";
+    }
+    pack.setMeta("resource", resourceId);
+    pack.setMeta("revision", revision);
+    pack.setMeta("interface", boost::lexical_cast<std::string>(gi));
+    pack.setMeta("lodRange", boost::lexical_cast<std::string>(lodRange));
+    pack.setMeta("tileRange", boost::lexical_cast<std::string>(tileRange));
+
+    // build job list
+    std::deque<Job> jobs;
+    const unsigned int metaMask((1u << metaOrder) - 1);
+    for (auto lod : lodRange) {
+        const auto tr(shiftRange(lodRange.min, tileRange, lod));
+
+        for (auto y(tr.ll(1)); y <= tr.ur(1); ++y) {
+            for (auto x(tr.ll(0)); x <= tr.ur(0); ++x) {
+                for (auto kind : kinds) {
+                    vts::TileId tileId(lod, x, y);
+                    if (kind == FileKind::meta) {
+                        // only one metatile per metatile block: at block
+                        // origin or at range's edge when range starts inside
+                        // the block
+                        if (((x & metaMask) && (x != tr.ll(0)))
+                            || ((y & metaMask) && (y != tr.ll(1))))
+                        {
+                            continue;
+                        }
+                        tileId.x &= ~metaMask;
+                        tileId.y &= ~metaMask;
+                    }
+
+                    if (done.count(seed::Pack::Key
+                                   (tileId.lod, tileId.x, tileId.y
+                                    , boost::lexical_cast<std::string>
+                                    (kind))))
+                    {
+                        continue;
+                    }
+                    jobs.emplace_back(tileId, kind);
+                }
+            }
+        }
+    }
+    done.clear();
+
+    LOG(info4) << "Seeding " << jobs.size() << " files of <"
+               << resource.id << "> (" << gi << "), LOD range " << lodRange
+               << ", tile range " << tileRange << ".";
+
+    // generating machinery: same as in daemon's core
+    auto generators(std::make_shared<Generators>
+                    (generatorsConfig_, resourceBackend));
+
+    // NB: io service must outlive HTTP client
+    asio::io_service ios;
+
+    http::Http http;
+    http.startClient(1);
+
+    http::ResourceFetcher resourceFetcher(http.fetcher(), &ios);
+    Arsenal arsenal(warper, resourceFetcher);
+
+    std::unique_ptr<asio::io_service::work> work
+        (new asio::io_service::work(ios));
+    std::vector<std::thread> workers;
+    for (std::size_t id(1); id <= threadCount_; ++id) {
+        workers.emplace_back([&ios, id]()
+        {
+            dbglog::thread_id(str(boost::format("seed:%u") % id));
+            for (;;) {
+                try {
+                    ios.run();
+                    return;
+                } catch (const std::exception &e) {
+                    LOG(err3)
+                        << "Uncaught exception in worker: <" << e.what()
+                        << ">. Going on.";
+                }
+            }
+        });
+    }
+
+    struct Guard {
+        Guard(const std::function<void()> &func) : func(func) {}
+        ~Guard() { if (func) { func(); } }
+        std::function<void()> func;
+    } guard([&]() {
+        work.reset();
+        ios.stop();
+        for (auto &worker : workers) { worker.join(); }
+        generators->stop();
+    });
+
+    generators->start(arsenal);
+    waitReady(warper, *generators, resource.id);
+    if (!running_) { return EXIT_FAILURE; }
+
+    const auto generator(generators->generator(resource.generator.type
+                                               , resource.id));
+    const auto urlPrefix
+        (utility::format("/%s/%s/%s/%s/", resource.id.referenceFrame
+                         , gi, resource.id.group, resource.id.id));
+
+    // result queue
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::vector<Result> results;
+    std::size_t inflight(0);
+
+    auto submit([&](const Job &job)
+    {
+        ios.post([&, job]()
+        {
+            const auto start(std::chrono::steady_clock::now());
+            auto handler([&, job, start](LocalSink::Response &&response)
+            {
+                const auto duration
+                    (std::chrono::steady_clock::now() - start);
+                std::unique_lock<std::mutex> lock(mutex);
+                results.emplace_back(job, std::move(response), duration);
+                cond.notify_one();
+            });
+
+            auto localSink(std::make_shared<LocalSink>(handler));
+            Sink sink(localSink);
+
+            try {
+                FileInfo fi(urlPrefix + filename(job.tileId, job.kind
+                                                 , format_)
+                            , generatorsConfig_.fileFlags);
+                sink.assignFileClassSettings
+                    (generator->resource().fileClassSettings);
+                if (auto task = generator->generateFile(fi, sink)) {
+                    task(sink, arsenal);
+                }
+            } catch (...) {
+                sink.error();
+            }
+        });
+    });
+
+    StatsMap stats;
+    std::size_t processed(0);
+    const std::size_t total(jobs.size());
+    utility::DurationMeter timer;
+    const auto seedStart(std::chrono::steady_clock::now());
+
+    auto drain([&](std::vector<Result> &batch)
+    {
+        for (auto &result : batch) {
+            auto &s(stats[result.job.kind]);
+            const auto &r(result.response);
+            s.time += result.duration;
+
+            // not found means "no such tile": store to skip on resume
+            if (r.ok() || (r.status == utility::HttpCode::NotFound)) {
+                pack.store(result.job.tileId
+                           , boost::lexical_cast<std::string>
+                           (result.job.kind)
+                           , r.contentType, static_cast<int>(r.status)
+                           , r.ok() ? r.data : std::string());
+                if (r.ok()) {
+                    ++s.files;
+                    s.bytes += r.data.size();
+                } else {
+                    ++s.empty;
+                }
+            } else {
+                ++s.failed;
+                LOG(warn2) << "Failed to generate <"
+                           << filename(result.job.tileId, result.job.kind
+                                       , format_)
+                           << ">: " << static_cast<int>(r.status)
+                           << " <" << r.data << ">.";
+            }
+
+            if (!(++processed % 1000)) {
+                LOG(info3) << "Processed " << processed << "/" << total
+                           << " files.";
+            }
+        }
+        batch.clear();
+    });
+
+    std::vector<Result> batch;
+    while (running_ && (!jobs.empty() || inflight)) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            // fill queue
+            while (running_ && !jobs.empty() && (inflight < queueSize_)) {
+                submit(jobs.front());
+                jobs.pop_front();
+                ++inflight;
+            }
+
+            cond.wait_for(lock, std::chrono::milliseconds(100)
+                          , [&]() { return !results.empty(); });
+            inflight -= results.size();
+            std::swap(batch, results);
+        }
+
+        drain(batch);
+        warper.housekeeping();
+    }
+
+    // wait for stragglers when interrupted
+    while (inflight) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cond.wait_for(lock, std::chrono::milliseconds(100)
+                          , [&]() { return !results.empty(); });
+            inflight -= results.size();
+            std::swap(batch, results);
+        }
+        drain(batch);
+        warper.housekeeping();
+    }
+
+    pack.flush();
+
+    // report
+    const double seconds
+        (std::chrono::duration<double>
+         (std::chrono::steady_clock::now() - seedStart).count());
+    std::size_t failed(0);
+    for (const auto &item : stats) {
+        const auto &s(item.second);
+        failed += s.failed;
+        const auto count(s.files + s.empty + s.failed);
+        LOG(info4)
+            << item.first << ": " << s.files << " files ("
+            << s.empty << " empty, " << s.failed << " failed), "
+            << (s.bytes / 1048576.0) << " MB, "
+            << (seconds ? (count / seconds) : 0.0) << " files/s, "
+            << (seconds ? (s.bytes / 1048576.0 / seconds) : 0.0) << " MB/s, "
+            << (count ? (std::chrono::duration<double, std::milli>
+                         (s.time).count() / count) : 0.0)
+            << " ms/file avg.";
+    }
+
+    LOG(info4) << "Seeded " << processed << " files in "
+               << utility::formatDuration(timer.duration())
+               << (running_ ? "." : " (interrupted; use --resume).");
+
+    return (running_ && !failed) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int main(int argc, char *argv[])
+{
+    ::GDALAllRegister();
+    ::OGRRegisterAll();
+    gdal_drivers::registerAll();
+
+    return Seed()(argc, argv);
+}
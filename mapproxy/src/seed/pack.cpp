@@ -0,0 +1,277 @@
+/**
+ * Copyright (c) 2019 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <sqlite3.h>
+
+#include <boost/filesystem.hpp>
+
+#include "dbglog/dbglog.hpp"
+
+#include "./pack.hpp"
+
+namespace fs = boost::filesystem;
+
+namespace seed {
+
+namespace {
+
+class SQLStatement {
+public:
+    SQLStatement() : stmt_() {}
+    ~SQLStatement() { if (stmt_) { ::sqlite3_finalize(stmt_); } }
+    operator ::sqlite3_stmt*() { return stmt_; }
+    operator ::sqlite3_stmt**() { return &stmt_; }
+
+private:
+    ::sqlite3_stmt *stmt_;
+};
+
+const char *schema(R"RAW(
+CREATE TABLE IF NOT EXISTS metadata (
+    name TEXT PRIMARY KEY
+    , value TEXT
+);
+CREATE TABLE IF NOT EXISTS files (
+    lod INTEGER NOT NULL
+    , x INTEGER NOT NULL
+    , y INTEGER NOT NULL
+    , kind TEXT NOT NULL
+    , contentType TEXT
+    , status INTEGER NOT NULL
+    , data BLOB
+    , PRIMARY KEY (lod, x, y, kind)
+);
+)RAW");
+
+} // namespace
+
+Pack::Pack(const fs::path &path, bool resume, std::size_t batchSize)
+    : path_(path), batchSize_(batchSize ? batchSize : 1), pending_()
+    , db_(), insert_()
+{
+    if (!resume) {
+        // remove stale WAL and shared memory index as well; leftover WAL
+        // from an interrupted run would be replayed into new database
+        fs::remove(path);
+        fs::remove(path.string() + "-wal");
+        fs::remove(path.string() + "-shm");
+    }
+
+    check(::sqlite3_open_v2
+          (path.c_str(), &db_, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE
+           , nullptr)
+          , "sqlite3_open_v2");
+
+    // single writer, durability is provided by resume
+    exec("PRAGMA journal_mode=WAL");
+    exec("PRAGMA synchronous=NORMAL");
+    exec(schema);
+
+    const std::string insert
+        ("INSERT OR REPLACE INTO files"
+         " (lod, x, y, kind, contentType, status, data)"
+         " VALUES (?, ?, ?, ?, ?, ?, ?)");
+    check(::sqlite3_prepare_v2(db_, insert.data(), insert.size()
+                               , &insert_, nullptr)
+          , "sqlite3_prepare");
+}
+
+Pack::~Pack()
+{
+    try {
+        flush();
+    } catch (const std::exception &e) {
+        LOG(err2) << "Failed to flush pack " << path_ << ": <"
+                  << e.what() << ">.";
+    }
+
+    if (insert_) { ::sqlite3_finalize(insert_); }
+    if (db_) { ::sqlite3_close(db_); }
+}
+
+void Pack::check(int status, const char *what) const
+{
+    if (status) {
+        const char *msg(db_ ? ::sqlite3_errmsg(db_) : "unknown error");
+        LOGTHROW(err1, PackError)
+            << "Sqlite3 operation " << what << " failed: <"
+            << msg << "> (file " << path_ << ").";
+    }
+}
+
+void Pack::exec(const char *sql)
+{
+    check(::sqlite3_exec(db_, sql, nullptr, nullptr, nullptr)
+          , "sqlite3_exec");
+}
+
+void Pack::begin()
+{
+    if (!pending_) { exec("BEGIN"); }
+}
+
+void Pack::flush()
+{
+    if (!pending_) { return; }
+    exec("COMMIT");
+    pending_ = 0;
+}
+
+void Pack::setMeta(const std::string &name, const std::string &value)
+{
+    SQLStatement stmt;
+    const std::string sql
+        ("INSERT OR REPLACE INTO metadata (name, value) VALUES (?, ?)");
+    check(::sqlite3_prepare_v2(db_, sql.data(), sql.size(), stmt, nullptr)
+          , "sqlite3_prepare");
+    check(::sqlite3_bind_text(stmt, 1, name.data(), name.size()
+                              , SQLITE_TRANSIENT)
+          , "sqlite3_bind_text");
+    check(::sqlite3_bind_text(stmt, 2, value.data(), value.size()
+                              , SQLITE_TRANSIENT)
+          , "sqlite3_bind_text");
+    if (::sqlite3_step(stmt) != SQLITE_DONE) {
+        check(SQLITE_ERROR, "sqlite3_step");
+    }
+}
+
+boost::optional<std::string> Pack::getMeta(const std::string &name) const
+{
+    SQLStatement stmt;
+    const std::string sql("SELECT value FROM metadata WHERE name = ?");
+    check(::sqlite3_prepare_v2(db_, sql.data(), sql.size(), stmt, nullptr)
+          , "sqlite3_prepare");
+    check(::sqlite3_bind_text(stmt, 1, name.data(), name.size()
+                              , SQLITE_TRANSIENT)
+          , "sqlite3_bind_text");
+
+    switch (auto res = ::sqlite3_step(stmt)) {
+    case SQLITE_ROW: break;
+    case SQLITE_DONE: return boost::none;
+    default: check(res, "sqlite3_step");
+    }
+
+    const auto *text(reinterpret_cast<const char*>
+                     (::sqlite3_column_text(stmt, 0)));
+    if (!text) { return boost::none; }
+    return std::string(text, ::sqlite3_column_bytes(stmt, 0));
+}
+
+Pack::KeySet Pack::keys() const
+{
+    KeySet keys;
+
+    SQLStatement stmt;
+    const std::string sql("SELECT lod, x, y, kind FROM files");
+    check(::sqlite3_prepare_v2(db_, sql.data(), sql.size(), stmt, nullptr)
+          , "sqlite3_prepare");
+
+    for (;;) {
+        switch (auto res = ::sqlite3_step(stmt)) {
+        case SQLITE_ROW: break;
+        case SQLITE_DONE: return keys;
+        default: check(res, "sqlite3_step");
+        }
+
+        const auto *kind(reinterpret_cast<const char*>
+                         (::sqlite3_column_text(stmt, 3)));
+        keys.emplace(::sqlite3_column_int(stmt, 0)
+                     , ::sqlite3_column_int64(stmt, 1)
+                     , ::sqlite3_column_int64(stmt, 2)
+                     , std::string(kind, ::sqlite3_column_bytes(stmt, 3)));
+    }
+}
+
+boost::optional<Pack::File> Pack::load(const Key &key) const
+{
+    SQLStatement stmt;
+    const std::string sql
+        ("SELECT contentType, status, data FROM files"
+         " WHERE lod = ? AND x = ? AND y = ? AND kind = ?");
+    check(::sqlite3_prepare_v2(db_, sql.data(), sql.size(), stmt, nullptr)
+          , "sqlite3_prepare");
+
+    const auto &kind(std::get<3>(key));
+    check(::sqlite3_bind_int(stmt, 1, std::get<0>(key)), "sqlite3_bind_int");
+    check(::sqlite3_bind_int64(stmt, 2, std::get<1>(key))
+          , "sqlite3_bind_int64");
+    check(::sqlite3_bind_int64(stmt, 3, std::get<2>(key))
+          , "sqlite3_bind_int64");
+    check(::sqlite3_bind_text(stmt, 4, kind.data(), kind.size()
+                              , SQLITE_STATIC)
+          , "sqlite3_bind_text");
+
+    switch (auto res = ::sqlite3_step(stmt)) {
+    case SQLITE_ROW: break;
+    case SQLITE_DONE: return boost::none;
+    default: check(res, "sqlite3_step");
+    }
+
+    File file;
+    if (const auto *contentType = reinterpret_cast<const char*>
+        (::sqlite3_column_text(stmt, 0)))
+    {
+        file.contentType.assign(contentType
+                                , ::sqlite3_column_bytes(stmt, 0));
+    }
+    file.status = ::sqlite3_column_int(stmt, 1);
+    if (const auto *data = static_cast<const char*>
+        (::sqlite3_column_blob(stmt, 2)))
+    {
+        file.data.assign(data, ::sqlite3_column_bytes(stmt, 2));
+    }
+    return file;
+}
+
+void Pack::store(const vts::TileId &tileId, const std::string &kind
+                 , const std::string &contentType, int status
+                 , const std::string &data)
+{
+    begin();
+
+    check(::sqlite3_reset(insert_), "sqlite3_reset");
+    check(::sqlite3_bind_int(insert_, 1, tileId.lod), "sqlite3_bind_int");
+    check(::sqlite3_bind_int64(insert_, 2, tileId.x), "sqlite3_bind_int64");
+    check(::sqlite3_bind_int64(insert_, 3, tileId.y), "sqlite3_bind_int64");
+    check(::sqlite3_bind_text(insert_, 4, kind.data(), kind.size()
+                              , SQLITE_STATIC)
+          , "sqlite3_bind_text");
+    check(::sqlite3_bind_text(insert_, 5, contentType.data()
+                              , contentType.size(), SQLITE_STATIC)
+          , "sqlite3_bind_text");
+    check(::sqlite3_bind_int(insert_, 6, status), "sqlite3_bind_int");
+    check(::sqlite3_bind_blob(insert_, 7, data.data(), data.size()
+                              , SQLITE_STATIC)
+          , "sqlite3_bind_blob");
+
+    if (::sqlite3_step(insert_) != SQLITE_DONE) {
+        check(SQLITE_ERROR, "sqlite3_step");
+    }
+
+    if (++pending_ >= batchSize_) { flush(); }
+}
+
+} // namespace seed
@@ -0,0 +1,124 @@
+/**
+ * Copyright (c) 2019 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef mapproxy_seed_pack_hpp_included_
+#define mapproxy_seed_pack_hpp_included_
+
+#include <set>
+#include <tuple>
+#include <string>
+#include <stdexcept>
+
+#include <boost/noncopyable.hpp>
+#include <boost/optional.hpp>
+#include <boost/filesystem/path.hpp>
+
+#include "vts-libs/vts/basetypes.hpp"
+
+struct sqlite3;
+struct sqlite3_stmt;
+
+namespace seed {
+
+namespace vts = vtslibs::vts;
+
+struct PackError : std::runtime_error {
+    PackError(const std::string &msg) : std::runtime_error(msg) {}
+};
+
+/** Single-file (SQLite) container of pre-generated files.
+ *
+ *  Tables:
+ *      metadata(name, value)
+ *      files(lod, x, y, kind, contentType, status, data)
+ *
+ *  Files are written in batched transactions; uncommitted batch is lost on
+ *  crash and regenerated on resume.
+ */
+class Pack : boost::noncopyable {
+public:
+    /** File key: (lod, x, y, kind).
+     */
+    typedef std::tuple<vts::Lod, unsigned int, unsigned int, std::string> Key;
+    typedef std::set<Key> KeySet;
+
+    /** Stored file.
+     */
+    struct File {
+        std::string contentType;
+        int status;
+        std::string data;
+
+        File() : status() {}
+    };
+
+    /** Opens existing pack (resume == true) or creates new one (any existing
+     *  file is overwritten).
+     */
+    Pack(const boost::filesystem::path &path, bool resume
+         , std::size_t batchSize = 256);
+
+    ~Pack();
+
+    void setMeta(const std::string &name, const std::string &value);
+
+    boost::optional<std::string> getMeta(const std::string &name) const;
+
+    /** Returns keys of all stored files.
+     */
+    KeySet keys() const;
+
+    /** Loads stored file. Returns none if there is no such file.
+     */
+    boost::optional<File> load(const Key &key) const;
+
+    /** Stores file. Commits when batch is full.
+     */
+    void store(const vts::TileId &tileId, const std::string &kind
+               , const std::string &contentType, int status
+               , const std::string &data);
+
+    /** Commits pending batch.
+     */
+    void flush();
+
+    const boost::filesystem::path& path() const { return path_; }
+
+private:
+    void exec(const char *sql);
+    void check(int status, const char *what) const;
+    void begin();
+
+    boost::filesystem::path path_;
+    std::size_t batchSize_;
+    std::size_t pending_;
+    ::sqlite3 *db_;
+    ::sqlite3_stmt *insert_;
+};
+
+} // namespace seed
+
+#endif // mapproxy_seed_pack_hpp_included_
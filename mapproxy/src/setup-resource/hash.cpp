@@ -0,0 +1,353 @@
+/**
+ * Copyright (c) 2019 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <algorithm>
+#include <system_error>
+#include <map>
+#include <tuple>
+#include <vector>
+#include <fstream>
+#include <sstream>
+
+#include <boost/filesystem.hpp>
+#include <boost/lexical_cast.hpp>
+
+#include "dbglog/dbglog.hpp"
+
+#include "utility/openmp.hpp"
+#include "utility/md5.hpp"
+#include "utility/duration.hpp"
+
+#include "./hash.hpp"
+
+namespace fs = boost::filesystem;
+
+namespace hash {
+
+namespace {
+
+/** Identity of file content as seen by the filesystem.
+ */
+struct FileStamp {
+    std::string path;
+    ::ino_t inode;
+    ::off_t size;
+    long mtimeSec;
+    long mtimeNsec;
+
+    bool operator<(const FileStamp &o) const {
+        return (std::tie(path, inode, size, mtimeSec, mtimeNsec)
+                < std::tie(o.path, o.inode, o.size, o.mtimeSec, o.mtimeNsec));
+    }
+};
+
+class Fd {
+public:
+    Fd(const fs::path &path)
+        : path_(path), fd_(::open(path.c_str(), O_RDONLY | O_CLOEXEC))
+    {
+        if (fd_ == -1) {
+            std::system_error e(errno, std::system_category());
+            LOGTHROW(err2, std::system_error)
+                << "Unable to open file " << path << " for hashing: <"
+                << e.code() << ", " << e.what() << ">.";
+        }
+    }
+
+    ~Fd() { ::close(fd_); }
+
+    operator int() const { return fd_; }
+
+    FileStamp stamp() const {
+        struct ::stat st;
+        if (::fstat(fd_, &st) == -1) {
+            std::system_error e(errno, std::system_category());
+            LOGTHROW(err2, std::system_error)
+                << "Unable to stat file " << path_ << ": <"
+                << e.code() << ", " << e.what() << ">.";
+        }
+        FileStamp s;
+        s.path = fs::absolute(path_).string();
+        s.inode = st.st_ino;
+        s.size = st.st_size;
+        s.mtimeSec = st.st_mtim.tv_sec;
+        s.mtimeNsec = st.st_mtim.tv_nsec;
+        return s;
+    }
+
+private:
+    Fd(const Fd&) = delete;
+    Fd& operator=(const Fd&) = delete;
+
+    fs::path path_;
+    int fd_;
+};
+
+/** Reads exactly size bytes at given offset (or less at end of file).
+ *  Returns -1 on error (errno is set).
+ */
+::ssize_t readFully(int fd, char *buf, std::size_t size, ::off_t offset)
+{
+    std::size_t total(0);
+    while (total < size) {
+        const auto r(::pread(fd, buf + total, size - total
+                             , offset + total));
+        if (r == -1) {
+            if (errno == EINTR) { continue; }
+            return -1;
+        }
+        if (!r) { break; }
+        total += r;
+    }
+    return total;
+}
+
+/** Appends data from given range to md5 sum. Returns errno on failure, 0 on
+ *  success.
+ */
+int md5Range(int fd, utility::md5::Md5Sum &md5, std::vector<char> &buf
+             , ::off_t offset, ::off_t size)
+{
+    while (size > 0) {
+        const std::size_t toRead(std::min<::off_t>(buf.size(), size));
+        const auto r(readFully(fd, buf.data(), toRead, offset));
+        if (r < 0) { return errno; }
+        if (!r) { break; }
+        md5.append(buf.data(), r);
+        offset += r;
+        size -= r;
+    }
+    return 0;
+}
+
+std::string md5Hash(const Fd &fd, ::off_t size, const Config &config)
+{
+    ::posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    std::vector<char> buf(config.blockSize);
+    utility::md5::Md5Sum md5;
+    if (const auto err = md5Range(fd, md5, buf, 0, size)) {
+        std::system_error e(err, std::system_category());
+        LOGTHROW(err2, std::system_error)
+            << "Unable to read file for hashing: <"
+            << e.code() << ", " << e.what() << ">.";
+    }
+    return md5.hash();
+}
+
+std::string treeHash(const Fd &fd, ::off_t size, const Config &config)
+{
+    const ::off_t chunkSize(config.chunkSize);
+    const long chunks((size + chunkSize - 1) / chunkSize);
+
+    std::vector<std::string> digests(chunks);
+    int error(0);
+
+    UTILITY_OMP(parallel)
+    {
+        std::vector<char> buf(std::min<std::size_t>
+                              (config.blockSize, config.chunkSize));
+
+        UTILITY_OMP(for schedule(dynamic))
+        for (long c = 0; c < chunks; ++c) {
+            const ::off_t offset(c * chunkSize);
+            const auto len(std::min(chunkSize, size - offset));
+
+            // let the kernel start reading the whole chunk ahead
+            ::posix_fadvise(fd, offset, len, POSIX_FADV_WILLNEED);
+
+            utility::md5::Md5Sum md5;
+            if (const auto err = md5Range(fd, md5, buf, offset, len)) {
+                UTILITY_OMP(critical(hash_treeHash))
+                    error = err;
+                continue;
+            }
+            digests[c] = md5.hash();
+        }
+    }
+
+    if (error) {
+        std::system_error e(error, std::system_category());
+        LOGTHROW(err2, std::system_error)
+            << "Unable to read file for hashing: <"
+            << e.code() << ", " << e.what() << ">.";
+    }
+
+    utility::md5::Md5Sum md5;
+    for (const auto &digest : digests) {
+        md5.append(digest.data(), digest.size());
+    }
+    return md5.hash();
+}
+
+/** Cache key prefix: hash identity depends on mode and (for tree hash) chunk
+ *  size.
+ */
+std::string modeId(const Config &config)
+{
+    if (config.mode == Mode::tree) {
+        return "tree/" + boost::lexical_cast<std::string>(config.chunkSize);
+    }
+    return boost::lexical_cast<std::string>(config.mode);
+}
+
+/** Hash cache file. One record per line:
+ *
+ *      modeId inode size mtimeSec mtimeNsec hash path
+ *
+ *  Path is last since it can contain spaces.
+ */
+class Cache {
+public:
+    Cache(const boost::optional<fs::path> &path)
+        : path_(path)
+    {
+        if (path_) { load(); }
+    }
+
+    const std::string* get(const std::string &modeId
+                           , const FileStamp &stamp) const
+    {
+        auto fentries(entries_.find(modeId));
+        if (fentries == entries_.end()) { return nullptr; }
+        auto fentry(fentries->second.find(stamp));
+        if (fentry == fentries->second.end()) { return nullptr; }
+        return &fentry->second;
+    }
+
+    void set(const std::string &modeId, const FileStamp &stamp
+             , const std::string &hash)
+    {
+        if (!path_) { return; }
+        auto &entries(entries_[modeId]);
+
+        // drop stale records of the same file
+        for (auto ie(entries.begin()); ie != entries.end(); ) {
+            if (ie->first.path == stamp.path) {
+                ie = entries.erase(ie);
+            } else {
+                ++ie;
+            }
+        }
+
+        entries[stamp] = hash;
+        save();
+    }
+
+private:
+    void load();
+    void save() const;
+
+    typedef std::map<FileStamp, std::string> Entries;
+
+    boost::optional<fs::path> path_;
+    std::map<std::string, Entries> entries_;
+};
+
+void Cache::load()
+{
+    std::ifstream f(path_->string());
+    if (!f) { return; }
+
+    std::string line;
+    while (std::getline(f, line)) {
+        std::istringstream is(line);
+        std::string modeId, hash;
+        FileStamp s;
+        is >> modeId >> s.inode >> s.size >> s.mtimeSec >> s.mtimeNsec
+           >> hash;
+        is.get();
+        std::getline(is, s.path);
+        if (!is && !is.eof()) { continue; }
+        if (s.path.empty() || hash.empty()) { continue; }
+        entries_[modeId][s] = hash;
+    }
+}
+
+void Cache::save() const
+{
+    // unique temporary file: concurrent runs must not share it
+    const auto tmp(fs::unique_path(path_->string() + ".%%%%-%%%%.tmp")
+                   .string());
+    if (path_->has_parent_path()) {
+        fs::create_directories(path_->parent_path());
+    }
+
+    {
+        std::ofstream f(tmp);
+        f.exceptions(std::ios::badbit | std::ios::failbit);
+        for (const auto &modeEntries : entries_) {
+            for (const auto &entry : modeEntries.second) {
+                const auto &s(entry.first);
+                f << modeEntries.first << ' ' << s.inode << ' ' << s.size
+                  << ' ' << s.mtimeSec << ' ' << s.mtimeNsec
+                  << ' ' << entry.second << ' ' << s.path << '\n';
+            }
+        }
+    }
+
+    fs::rename(tmp, *path_);
+}
+
+} // namespace
+
+std::string hashFile(const fs::path &path, const Config &config)
+{
+    Fd fd(path);
+    const auto stamp(fd.stamp());
+    const auto id(modeId(config));
+
+    Cache cache(config.cache);
+    if (const auto *hash = cache.get(id, stamp)) {
+        LOG(info3)
+            << "Using cached " << config.mode << " hash of file "
+            << path << ".";
+        return *hash;
+    }
+
+    utility::DurationMeter timer;
+
+    const auto hash((config.mode == Mode::tree)
+                    ? treeHash(fd, stamp.size, config)
+                    : md5Hash(fd, stamp.size, config));
+
+    LOG(info3)
+        << "Computed " << config.mode << " hash of file " << path
+        << " (" << stamp.size << " bytes) in "
+        << utility::formatDuration(timer.duration()) << ".";
+
+    cache.set(id, stamp, hash);
+    return hash;
+}
+
+} // namespace hash
@@ -0,0 +1,81 @@
+/**
+ * Copyright (c) 2019 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef mapproxy_setup_resource_hash_hpp_included_
+#define mapproxy_setup_resource_hash_hpp_included_
+
+#include <string>
+
+#include <boost/optional.hpp>
+#include <boost/filesystem/path.hpp>
+
+#include "utility/enum-io.hpp"
+
+namespace hash {
+
+/** Dataset hashing mode.
+ *
+ *  md5: plain MD5 of whole file, computed serially (compatible with older
+ *       versions of this tool)
+ *
+ *  tree: file is split into fixed size chunks, MD5 of each chunk is
+ *        computed in parallel and the result is MD5 of concatenated chunk
+ *        hashes
+ */
+UTILITY_GENERATE_ENUM(Mode,
+                      ((md5))
+                      ((tree))
+                      )
+
+struct Config {
+    Mode mode;
+
+    /** Chunk size for tree hash. Part of the hash identity.
+     */
+    std::size_t chunkSize;
+
+    /** Read block size.
+     */
+    std::size_t blockSize;
+
+    /** Hash cache file. Hashes are cached by (path, size, mtime, inode) so
+     *  unchanged files are not re-read.
+     */
+    boost::optional<boost::filesystem::path> cache;
+
+    Config()
+        : mode(Mode::md5), chunkSize(64 << 20), blockSize(4 << 20)
+    {}
+};
+
+/** Computes hash of given file. Result is hex-encoded digest.
+ */
+std::string hashFile(const boost::filesystem::path &path
+                     , const Config &config);
+
+} // namespace hash
+
+#endif // mapproxy_setup_resource_hash_hpp_included_
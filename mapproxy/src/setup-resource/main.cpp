@@ -43,7 +43,6 @@
 #include "utility/path.hpp"
 #include "utility/filesystem.hpp"
 #include "utility/format.hpp"
-#include "utility/md5.hpp"
 #include "utility/implicit-value.hpp"
 
 #include "service/cmdline.hpp"
@@ -68,6 +67,8 @@
 #include "mapproxy/definition.hpp"
 #include "mapproxy/mapproxy.hpp"
 
+#include "./hash.hpp"
+
 namespace po = boost::program_options;
 namespace fs = boost::filesystem;
 namespace ba = boost::algorithm;
@@ -102,6 +103,8 @@ struct Config {
     fs::path mapproxyDefinitionDir;
     fs::path mapproxyCtrl;
 
+    hash::Config hash;
+
     Config()
         : format(RasterFormat::jpg)
         , transparent(false)
@@ -198,6 +201,20 @@ void SetupResource::configuration(po::options_description &cmdline
          "color it is left empty in the output. Solid dataset with this color "
          "is created and places as a first source for each band in "
          "all overviews.")
+
+        ("hash.mode", po::value(&config_.hash.mode)
+         ->default_value(config_.hash.mode)->required()
+         , "Dataset hashing mode used to name dataset directory: md5 "
+         "(plain MD5 of dataset file, compatible with older versions) "
+         "or tree (parallel hash over dataset chunks, much faster for "
+         "huge datasets).")
+        ("hash.chunkSize", po::value(&config_.hash.chunkSize)
+         ->default_value(config_.hash.chunkSize)->required()
+         , "Chunk size (in bytes) used by tree hash. Changes the hash.")
+        ("hash.cache", po::value<fs::path>()
+         , "Path to hash cache file. Hash of a file with the same path, "
+         "size, mtime and inode is taken from the cache instead of "
+         "being recomputed.")
         ;
 
     config.add_options()
@@ -241,6 +258,15 @@ void SetupResource::configure(const po::variables_map &vars)
         config_.background = vars["background"].as<vrtwo::Color>();
     }
 
+    if (!config_.hash.chunkSize) {
+        throw po::validation_error
+            (po::validation_error::invalid_option_value, "hash.chunkSize");
+    }
+
+    if (vars.count("hash.cache")) {
+        config_.hash.cache = fs::absolute(vars["hash.cache"].as<fs::path>());
+    }
+
     // absolutize destination paths
     config_.mapproxyDataRoot = fs::absolute(config_.mapproxyDataRoot);
     config_.mapproxyDefinitionDir
@@ -261,6 +287,9 @@ void SetupResource::configure(const po::variables_map &vars)
         << "\nbackground = " << config_.background
         << "\ndataset = " << dataset_
         << "\nlinkDataset = " << linkDataset_
+        << "\nhash.mode = " << config_.hash.mode
+        << "\nhash.chunkSize = " << config_.hash.chunkSize
+        << "\nhash.cache = " << config_.hash.cache
         << "\n"
         ;
 }
@@ -715,21 +744,6 @@ void addCredits(Resource &r, const vr::Credit::dict &credits)
     r.registry.credits.update(credits);
 }
 
-std::string md5sum(const fs::path &path)
-{
-    utility::ifstreambuf f(path.string());
-    f.exceptions(std::ios::badbit);
-
-    utility::md5::Md5Sum md5;
-    char buf[1<<16];
-    std::size_t total(0);
-    while (f.readsome(buf, sizeof(buf))) {
-        md5.append(buf, f.gcount());
-        total += f.gcount();
-    }
-    return md5.hash();
-}
-
 int SetupResource::run()
 {
     // find reference frame
@@ -820,7 +834,8 @@ int SetupResource::run()
 
     const auto datasetHome
         (utility::addExtension(datasetFileName
-                               , "." + md5sum(dataset_)));
+                               , "." + hash::hashFile
+                               (dataset_, config.hash)));
 
     const auto rootDir(config.mapproxyDataRoot / datasetHome);
     const auto baseDatasetPath("original-dataset" / datasetFileName);
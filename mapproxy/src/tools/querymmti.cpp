@@ -24,21 +24,48 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include <cstdlib>
+#include <cmath>
+#include <bitset>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <fstream>
+#include <algorithm>
+#include <functional>
+
 #include <boost/utility/in_place_factory.hpp>
 #include <boost/optional.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/algorithm/string/trim.hpp>
 
 #include "utility/buildsys.hpp"
+#include "utility/enum-io.hpp"
 #include "service/cmdline.hpp"
 
+#include "vts-libs/vts/io.hpp"
+
 #include "mapproxy/support/mmapped/tileindex.hpp"
 
 namespace po = boost::program_options;
 namespace fs = boost::filesystem;
+namespace ba = boost::algorithm;
+
+UTILITY_GENERATE_ENUM(Generate,
+                      ((none))
+                      ((random))
+                      ((sequential))
+                      )
 
 class QueryMappedTileIndex : public service::Cmdline {
 public:
     QueryMappedTileIndex()
         : service::Cmdline("mapproxy-querymmti", BUILD_TARGET_VERSION)
+        , generate_(Generate::none), count_(100000), seed_(0), repeat_(1)
+        , quiet_(false)
     {
     }
 
@@ -53,8 +80,24 @@ private:
 
     int run();
 
+    typedef std::function<std::uint32_t(const vts::TileId&)> Getter;
+
+    int bulk(const Getter &get, const boost::optional<vts::LodRange> &lr);
+
+    int verify(const mmapped::TileIndex &mti);
+
     fs::path ti_;
-    vts::TileId tileId_;
+    boost::optional<vts::TileId> tileId_;
+
+    boost::optional<fs::path> input_;
+    Generate generate_;
+    std::size_t count_;
+    boost::optional<vts::LodRange> lodRange_;
+    unsigned int seed_;
+    int repeat_;
+    bool quiet_;
+
+    boost::optional<fs::path> verify_;
 };
 
 void QueryMappedTileIndex
@@ -65,8 +108,30 @@ void QueryMappedTileIndex
     cmdline.add_options()
         ("tileIndex", po::value(&ti_)->required()
          , "Path to tile index.")
-        ("tileId", po::value(&tileId_)->required()
+        ("tileId", po::value<vts::TileId>()
          , "Tile ID to query.")
+
+        ("bulk", po::value<fs::path>()
+         , "Bulk query: read tile IDs (one per line) from given file, "
+         "use - for stdin.")
+        ("generate", po::value(&generate_)->default_value(generate_)
+         , "Bulk query: generate tile IDs instead of reading them; one of "
+         "random or sequential. Tile IDs are generated at each LOD.")
+        ("count", po::value(&count_)->default_value(count_)
+         , "Number of tile IDs to generate per LOD.")
+        ("lodRange", po::value<vts::LodRange>()
+         , "LOD range to generate tile IDs in. Defaults to whole index.")
+        ("seed", po::value(&seed_)->default_value(seed_)
+         , "Random generator seed.")
+        ("repeat", po::value(&repeat_)->default_value(repeat_)
+         , "Run whole bulk query given number of times.")
+        ("quiet", po::value(&quiet_)->default_value(false)
+         ->implicit_value(true)
+         , "Bulk query: do not print individual results, report only.")
+
+        ("verify", po::value<fs::path>()
+         , "Verify mmapped tile index against given source tile index "
+         "(i.e. ti2mmti's input). Every tile's flags are compared.")
         ;
 
     pd.add("tileIndex", 1)
@@ -77,7 +142,31 @@ void QueryMappedTileIndex
 
 void QueryMappedTileIndex::configure(const po::variables_map &vars)
 {
-    (void) vars;
+    if (vars.count("tileId")) {
+        tileId_ = vars["tileId"].as<vts::TileId>();
+    }
+    if (vars.count("bulk")) {
+        input_ = vars["bulk"].as<fs::path>();
+    }
+    if (vars.count("lodRange")) {
+        lodRange_ = vars["lodRange"].as<vts::LodRange>();
+    }
+    if (vars.count("verify")) {
+        verify_ = vars["verify"].as<fs::path>();
+    }
+
+    const int modes(bool(tileId_) + bool(input_)
+                    + (generate_ != Generate::none) + bool(verify_));
+    if (modes != 1) {
+        throw po::error
+            ("Exactly one of tileId, --bulk, --generate or --verify "
+             "must be used.");
+    }
+
+    if (repeat_ < 1) {
+        throw po::validation_error
+            (po::validation_error::invalid_option_value, "repeat");
+    }
 }
 
 bool QueryMappedTileIndex::help(std::ostream &out
@@ -86,6 +175,25 @@ bool QueryMappedTileIndex::help(std::ostream &out
     if (what.empty()) {
         // program help
         out << ("mapproxy mmapped tileindex query tool\n"
+                "\n"
+                "    mapproxy-querymmti tileIndex tileId\n"
+                "        Queries single tile.\n"
+                "\n"
+                "    mapproxy-querymmti tileIndex --bulk FILE\n"
+                "    mapproxy-querymmti tileIndex --generate random|sequential\n"
+                "        Bulk query (benchmark). Reports (stdout, machine "
+                "readable):\n"
+                "\n"
+                "            queries: count\n"
+                "            duration: seconds\n"
+                "            throughput: queries per second\n"
+                "            latency.pN: N-th percentile latency in ns\n"
+                "            pageFaults.minor: count\n"
+                "            pageFaults.major: count\n"
+                "\n"
+                "    mapproxy-querymmti tileIndex --verify tileset.index\n"
+                "        Compares every tile of source tile index with "
+                "mmapped tile index.\n"
                 "\n"
                 );
 
@@ -95,6 +203,225 @@ bool QueryMappedTileIndex::help(std::ostream &out
     return false;
 }
 
+namespace {
+
+struct PageFaults {
+    long minor;
+    long major;
+
+    PageFaults() : minor(), major() {
+        struct ::rusage ru;
+        if (!::getrusage(RUSAGE_SELF, &ru)) {
+            minor = ru.ru_minflt;
+            major = ru.ru_majflt;
+        }
+    }
+};
+
+typedef std::vector<vts::TileId> TileIds;
+
+TileIds readTileIds(const fs::path &path)
+{
+    std::ifstream file;
+    std::istream *is(&std::cin);
+    if (path != "-") {
+        file.open(path.string());
+        if (!file) {
+            LOGTHROW(err2, std::runtime_error)
+                << "Unable to open tile ID list " << path << ".";
+        }
+        is = &file;
+    }
+
+    TileIds tileIds;
+    std::string line;
+    while (std::getline(*is, line)) {
+        ba::trim(line);
+        if (line.empty() || (line[0] == '#')) { continue; }
+        try {
+            tileIds.push_back(boost::lexical_cast<vts::TileId>(line));
+        } catch (const boost::bad_lexical_cast&) {
+            LOG(warn2) << "Ignoring invalid tile ID <" << line << ">.";
+        }
+    }
+    return tileIds;
+}
+
+TileIds generateTileIds(Generate generate, const vts::LodRange &lr
+                        , std::size_t count, unsigned int seed)
+{
+    TileIds tileIds;
+    std::mt19937 rng(seed);
+
+    for (const auto lod : lr) {
+        const std::uint64_t size(std::uint64_t(1) << lod);
+        const std::uint64_t total(size * size);
+        const auto n(std::min<std::uint64_t>(count, total));
+
+        if (generate == Generate::random) {
+            std::uniform_int_distribution<std::uint64_t> dist(0, size - 1);
+            for (std::uint64_t i(0); i < n; ++i) {
+                tileIds.emplace_back(lod, dist(rng), dist(rng));
+            }
+        } else {
+            // row-major order
+            for (std::uint64_t i(0); i < n; ++i) {
+                tileIds.emplace_back(lod, i % size, i / size);
+            }
+        }
+    }
+
+    return tileIds;
+}
+
+} // namespace
+
+int QueryMappedTileIndex::bulk(const Getter &get
+                               , const boost::optional<vts::LodRange> &lr)
+{
+    const auto tileIds([&]() -> TileIds
+    {
+        if (input_) { return readTileIds(*input_); }
+        if (!lr) { return {}; }
+        return generateTileIds(generate_, *lr, count_, seed_);
+    }());
+
+    if (tileIds.empty()) {
+        LOG(warn3) << "No tile IDs to query.";
+        return EXIT_SUCCESS;
+    }
+
+    typedef std::chrono::steady_clock Clock;
+
+    std::vector<std::uint64_t> latencies;
+    latencies.reserve(tileIds.size() * repeat_);
+
+    // accumulated result to prevent optimizing lookups out
+    std::uint32_t acc(0);
+
+    const PageFaults pfStart;
+    const auto start(Clock::now());
+
+    for (int r(0); r < repeat_; ++r) {
+        for (const auto &tileId : tileIds) {
+            const auto qs(Clock::now());
+            const auto value(get(tileId));
+            const auto qe(Clock::now());
+            latencies.push_back
+                (std::chrono::duration_cast<std::chrono::nanoseconds>
+                 (qe - qs).count());
+            acc ^= value;
+
+            if (!quiet_ && !r) {
+                std::cout << tileId << ' ' << std::bitset<8>(value) << '\n';
+            }
+        }
+    }
+
+    const std::chrono::duration<double> duration(Clock::now() - start);
+    const PageFaults pfEnd;
+
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile([&](double p) -> std::uint64_t
+    {
+        std::size_t index(std::ceil(p * latencies.size() / 100.0));
+        if (index) { --index; }
+        return latencies[std::min(index, latencies.size() - 1)];
+    });
+
+    std::cout
+        << "queries: " << latencies.size() << '\n'
+        << "duration: " << duration.count() << '\n'
+        << "throughput: " << (latencies.size() / duration.count()) << '\n'
+        << "latency.p50: " << percentile(50) << '\n'
+        << "latency.p90: " << percentile(90) << '\n'
+        << "latency.p99: " << percentile(99) << '\n'
+        << "latency.p99.9: " << percentile(99.9) << '\n'
+        << "latency.max: " << latencies.back() << '\n'
+        << "pageFaults.minor: " << (pfEnd.minor - pfStart.minor) << '\n'
+        << "pageFaults.major: " << (pfEnd.major - pfStart.major) << '\n'
+        << std::flush;
+
+    LOG(info1) << "Accumulated value: " << acc << ".";
+
+    return EXIT_SUCCESS;
+}
+
+int QueryMappedTileIndex::verify(const mmapped::TileIndex &mti)
+{
+    vts::TileIndex ti;
+    ti.load(*verify_);
+
+    std::size_t nodes(0);
+    std::size_t mismatches(0);
+
+    auto mismatch([&](vts::Lod lod, int x, int y, int size
+                      , vts::QTree::value_type expected
+                      , mmapped::TileIndex::value_type found)
+    {
+        if (++mismatches <= 100) {
+            std::cout << "mismatch: " << vts::TileId(lod, x, y)
+                      << " (block size " << size << "): expected "
+                      << std::bitset<8>(expected) << ", found "
+                      << std::bitset<8>(found) << '\n';
+        }
+    });
+
+    if (!ti.empty()) {
+        for (vts::Lod lod(0), maxLod(ti.maxLod()); lod <= maxLod; ++lod) {
+            const auto *tree(ti.tree(lod));
+            if (!tree) { continue; }
+            const auto *mtree(mti.tree(lod));
+
+            tree->forEachNode([&](int x, int y, int size
+                                  , vts::QTree::value_type value)
+            {
+                ++nodes;
+                const mmapped::TileIndex::value_type expected(value);
+
+                if (!mtree) {
+                    if (expected) { mismatch(lod, x, y, size, value, 0); }
+                    return;
+                }
+
+                // depth of source node in the tree
+                unsigned int depth(lod);
+                for (auto s(size); s > 1; s >>= 1) { --depth; }
+
+                // compare with all mmapped nodes covering source node
+                mtree->forEachNode
+                    (depth, x / size, y / size
+                     , [&](unsigned int, unsigned int
+                           , unsigned int, unsigned int
+                           , mmapped::QTree::value_type mvalue)
+                {
+                    if (mvalue != expected) {
+                        mismatch(lod, x, y, size, value, mvalue);
+                    }
+                });
+            }, vts::QTree::Filter::both);
+        }
+    }
+
+    // mmapped index must not contain anything below source index
+    const vts::Lod firstExtra(ti.empty() ? 0 : (ti.maxLod() + 1));
+    for (vts::Lod lod(firstExtra); mti.tree(lod); ++lod) {
+        mti.tree(lod)->forEachNode([&](unsigned int x, unsigned int y
+                                       , unsigned int size, unsigned int
+                                       , mmapped::QTree::value_type mvalue)
+        {
+            mismatch(lod, x, y, size, 0, mvalue);
+        }, mmapped::QTree::Filter::white);
+    }
+
+    std::cout
+        << "nodes: " << nodes << '\n'
+        << "mismatches: " << mismatches << '\n'
+        << std::flush;
+
+    return mismatches ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
 int QueryMappedTileIndex::run()
 {
     // try to open
@@ -108,13 +435,43 @@ int QueryMappedTileIndex::run()
         ti->load(ti_);
     }
 
+    if (verify_) {
+        if (!mti) {
+            LOG(fatal) << "Verification requires mmapped tile index.";
+            return EXIT_FAILURE;
+        }
+        return verify(*mti);
+    }
+
+    if (tileId_) {
+        if (mti) {
+            std::cout << std::bitset<8>(mti->get(*tileId_)) << std::endl;
+        } else {
+            std::cout << std::bitset<32>(ti->get(*tileId_)) << std::endl;
+        }
+        return EXIT_SUCCESS;
+    }
+
     if (mti) {
-        std::cout << std::bitset<8>(mti->get(tileId_)) << std::endl;
-    } else {
-        std::cout << std::bitset<32>(ti->get(tileId_)) << std::endl;
+        // deduce LOD range from present trees
+        auto lr(lodRange_);
+        if (!lr && mti->tree(0)) {
+            vts::Lod maxLod(0);
+            while (mti->tree(maxLod + 1)) { ++maxLod; }
+            lr = vts::LodRange(0, maxLod);
+        }
+        return bulk([&](const vts::TileId &tileId) -> std::uint32_t
+                    {
+                        return mti->get(tileId);
+                    }, lr);
     }
 
-    return EXIT_SUCCESS;
+    auto lr(lodRange_);
+    if (!lr && !ti->empty()) { lr = ti->lodRange(); }
+    return bulk([&](const vts::TileId &tileId) -> std::uint32_t
+                {
+                    return ti->get(tileId);
+                }, lr);
 }
 
 int main(int argc, char *argv[])
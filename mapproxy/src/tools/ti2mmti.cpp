@@ -24,6 +24,10 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <chrono>
+
+#include "dbglog/dbglog.hpp"
+
 #include "utility/buildsys.hpp"
 #include "service/cmdline.hpp"
 
@@ -36,6 +40,7 @@ class TileIndex2MMappedTileIndex : public service::Cmdline {
 public:
     TileIndex2MMappedTileIndex()
         : service::Cmdline("mapproxy-ti2mmti", BUILD_TARGET_VERSION)
+        , threadCount_()
     {
     }
 
@@ -52,6 +57,7 @@ private:
 
     fs::path input_;
     fs::path output_;
+    unsigned int threadCount_;
 };
 
 void TileIndex2MMappedTileIndex
@@ -64,6 +70,11 @@ void TileIndex2MMappedTileIndex
          , "Path to input tile index.")
         ("output", po::value(&output_)->required()
          , "Path to output mmapped tile index.")
+        ("threadCount", po::value(&threadCount_)
+         ->default_value(threadCount_)->required()
+         , "Number of conversion threads, 0 means hardware concurrency, "
+         "1 means serial conversion. Output doesn't depend on thread "
+         "count.")
         ;
 
     pd.add("input", 1)
@@ -94,9 +105,23 @@ bool TileIndex2MMappedTileIndex::help(std::ostream &out
 
 int TileIndex2MMappedTileIndex::run()
 {
+    typedef std::chrono::steady_clock Clock;
+    auto ms([](Clock::duration d) {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(d)
+            .count();
+    });
+
+    const auto start(Clock::now());
     vts::TileIndex ti;
     ti.load(input_);
-    mmapped::TileIndex::write(output_, ti);
+    const auto loaded(Clock::now());
+
+    mmapped::TileIndex::write(output_, ti, threadCount_);
+    const auto written(Clock::now());
+
+    LOG(info3) << "Loaded " << input_ << " in " << ms(loaded - start)
+               << " ms, converted to " << output_ << " in "
+               << ms(written - loaded) << " ms.";
     return EXIT_SUCCESS;
 }
 